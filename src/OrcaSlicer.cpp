@@ -27,6 +27,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <boost/thread.hpp>
+#include <tbb/parallel_for.h>
 //add json logic
 #include "nlohmann/json.hpp"
 
@@ -49,12 +50,14 @@ using namespace nlohmann;
 #include "libslic3r/Config.hpp"
 #include "libslic3r/Geometry.hpp"
 #include "libslic3r/GCode.hpp"
+#include "libslic3r/GCode/GCodeProcessor.hpp"
 #include "libslic3r/GCode/PostProcessor.hpp"
 #include "libslic3r/Model.hpp"
 #include "libslic3r/ModelArrange.hpp"
 #include "libslic3r/Platform.hpp"
 #include "libslic3r/Print.hpp"
 #include "libslic3r/SLAPrint.hpp"
+#include "libslic3r/SlicingCache.hpp"
 #include "libslic3r/TriangleMesh.hpp"
 #include "libslic3r/Format/AMF.hpp"
 #include "libslic3r/Format/3mf.hpp"
@@ -494,6 +497,123 @@ const float bed3d_ax3s_default_stem_length = 25.0f;
 const float bed3d_ax3s_default_tip_radius = 2.5f * bed3d_ax3s_default_stem_radius;
 const float bed3d_ax3s_default_tip_length = 5.0f;
 
+// GCodeProcessor::process_file() switches GCodeProcessor::s_IsBBLPrinter based on the printer model stored in the G-code.
+// Detect it upfront to process the G-codes of the same vendor together.
+static bool is_bbl_printer_gcode(const std::string &file)
+{
+    DynamicPrintConfig config;
+    try {
+        config.load_from_gcode_file(file, ForwardCompatibilitySubstitutionRule::EnableSilent);
+    } catch (...) {
+        return false;
+    }
+    const ConfigOptionString *printer_model = config.opt<ConfigOptionString>("printer_model");
+    return printer_model != nullptr && boost::starts_with(printer_model->value, "Bambu Lab");
+}
+
+static json gcode_estimate_to_json(const GCodeProcessorResult &result)
+{
+    const PrintEstimatedStatistics &stats = result.print_statistics;
+    json j;
+    for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count); ++i) {
+        const PrintEstimatedStatistics::Mode &mode = stats.modes[i];
+        if (i != static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Normal) && mode.time == 0.f)
+            // The time machine was disabled.
+            continue;
+        json mode_json;
+        mode_json["time"]         = mode.time;
+        mode_json["prepare_time"] = mode.prepare_time;
+        mode_json["layers_times"] = mode.layers_times;
+        json roles_json = json::object();
+        for (const auto &[role, time] : mode.roles_times)
+            roles_json[ExtrusionEntity::role_to_string(role)] = time;
+        mode_json["roles_times"] = std::move(roles_json);
+        j["modes"][i == static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Normal) ? "normal" : "silent"] = std::move(mode_json);
+    }
+    json filaments_json = json::array();
+    for (const auto &[extruder_id, volume] : stats.total_volumes_per_extruder) {
+        json filament_json;
+        filament_json["id"]        = extruder_id;
+        filament_json["used_mm3"]  = volume;
+        if (extruder_id < result.filament_diameters.size() && result.filament_diameters[extruder_id] > 0.f)
+            filament_json["used_mm"] = volume / (0.25 * M_PI * sqr(double(result.filament_diameters[extruder_id])));
+        if (extruder_id < result.filament_densities.size())
+            filament_json["used_g"]  = volume * result.filament_densities[extruder_id] * 0.001;
+        filaments_json.push_back(std::move(filament_json));
+    }
+    j["filaments"]        = std::move(filaments_json);
+    j["filament_changes"] = stats.total_filament_changes;
+    j["extruder_changes"] = stats.total_extruder_changes;
+    j["layers"]           = stats.modes[static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Normal)].layers_times.size();
+    return j;
+}
+
+// Process the G-codes with the GCodeProcessor only and save the estimated statistics into result_file.
+// Neither the preset bundle nor the GUI is initialized, the files are processed in parallel.
+static int estimate_gcode_files(const std::vector<std::string> &files, const std::string &result_file)
+{
+    if (files.empty()) {
+        boost::nowide::cerr << "estimate_gcode: no input G-code files" << std::endl;
+        return CLI_FILE_NOTFOUND;
+    }
+    name_tbb_thread_pool_threads_set_locale();
+
+    std::vector<char> is_bbl(files.size());
+    tbb::parallel_for(size_t(0), files.size(), [&files, &is_bbl](size_t i) { is_bbl[i] = is_bbl_printer_gcode(files[i]); });
+
+    std::vector<json> results(files.size());
+    for (bool bbl : { true, false }) {
+        GCodeProcessor::s_IsBBLPrinter = bbl;
+        tbb::parallel_for(size_t(0), files.size(), [&files, &is_bbl, &results, bbl](size_t i) {
+            if (is_bbl[i] != bbl)
+                return;
+            json &j = results[i];
+            j["file"] = files[i];
+            try {
+                GCodeProcessor processor;
+                processor.process_file(files[i]);
+                j.update(gcode_estimate_to_json(processor.get_result()));
+            } catch (const std::exception &ex) {
+                BOOST_LOG_TRIVIAL(error) << "estimate_gcode: failed to process " << files[i] << ": " << ex.what();
+                j["error"] = ex.what();
+            }
+        });
+    }
+
+    int ret = CLI_SUCCESS;
+    json j = json::array();
+    for (json &result : results) {
+        if (result.contains("error"))
+            ret = CLI_DATA_FILE_ERROR;
+        j.push_back(std::move(result));
+    }
+    boost::nowide::ofstream c;
+    c.open(result_file, std::ios::out | std::ios::trunc);
+    if (! c.good()) {
+        boost::nowide::cerr << "estimate_gcode: cannot write " << result_file << std::endl;
+        return CLI_FILE_NOTFOUND;
+    }
+    c << std::setw(4) << j << std::endl;
+    c.close();
+    return ret;
+}
+
+// Append the timing of the G-code export pipeline of a plate to the report and rewrite the report file.
+static void save_gcode_pipeline_stats(const std::string &file, json &report, int plate_index, const GCodePipelineStats &stats)
+{
+    json j = stats.to_json();
+    j["plate"] = plate_index;
+    report.push_back(std::move(j));
+    boost::nowide::ofstream c;
+    c.open(file, std::ios::out | std::ios::trunc);
+    if (! c.good()) {
+        BOOST_LOG_TRIVIAL(error) << "gcode_pipeline_stats: cannot write " << file;
+        return;
+    }
+    c << std::setw(4) << report << std::endl;
+    c.close();
+}
+
 static int load_key_values_from_json(const std::string &file, std::map<std::string, std::string>& key_values)
 {
     json j;
@@ -1213,6 +1333,11 @@ int CLI::run(int argc, char **argv)
         return CLI_INVALID_PARAMS;
     }
     BOOST_LOG_TRIVIAL(info) << "finished setup params, argc="<< argc << std::endl;
+
+    // Headless G-code analysis, which needs neither the presets nor the GUI.
+    if (std::find(m_actions.begin(), m_actions.end(), "estimate_gcode") != m_actions.end())
+        return estimate_gcode_files(m_input_files, m_config.opt_string("estimate_gcode"));
+
     std::string temp_path = wxFileName::GetTempDir().utf8_str().data();
     set_temporary_dir(temp_path);
 
@@ -1237,6 +1362,12 @@ int CLI::run(int argc, char **argv)
     float old_max_radius = 0.f, old_height_to_rod = 0.f, old_height_to_lid = 0.f;
     std::vector<double> old_max_layer_height, old_min_layer_height;
     std::string outfile_dir              =  m_config.opt_string("outputdir", true);
+    std::string pipeline_stats_file      =  m_config.opt_string("gcode_pipeline_stats", true);
+    json        pipeline_stats           =  json::array();
+    std::string slicing_cache_dir        =  m_config.opt_string("slicing_cache", true);
+    std::shared_ptr<SlicingCache> slicing_cache;
+    if (!slicing_cache_dir.empty())
+        slicing_cache = std::make_shared<SlicingCache>(slicing_cache_dir, size_t(std::max(0, m_config.option<ConfigOptionInt>("slicing_cache_size", true)->value)) * 1024 * 1024);
     const std::vector<std::string>              &load_configs               = m_config.option<ConfigOptionStrings>("load_settings", true)->values;
     const std::vector<std::string>              &uptodate_configs          = m_config.option<ConfigOptionStrings>("uptodate_settings", true)->values;
     const std::vector<std::string>              &uptodate_filaments          = m_config.option<ConfigOptionStrings>("uptodate_filaments", true)->values;
@@ -6042,6 +6173,8 @@ int CLI::run(int argc, char **argv)
                                     }
                                 }
                                 else {
+                                    if (printer_technology == ptFFF)
+                                        print_fff->set_slicing_cache(slicing_cache);
                                     print->process(&time_using_cache);
                                     BOOST_LOG_TRIVIAL(info) << "print::process: first time_using_cache is " << time_using_cache << " secs.";
                                 }
@@ -6091,13 +6224,15 @@ int CLI::run(int argc, char **argv)
                                         outfile = part_plate->get_tmp_gcode_path();
                                     }
                                     else {
-                                        outfile = outfile_dir + "/plate_" + std::to_string(index + 1) + ".gcode";
+                                        outfile = outfile_dir + "/plate_" + std::to_string(index + 1) + (print_fff->config().binary_gcode.value ? ".bgcode" : ".gcode");
                                         part_plate->set_tmp_gcode_path(outfile);
                                     }
                                     BOOST_LOG_TRIVIAL(info) << "process finished, will export gcode temporily to " << outfile << std::endl;
                                     temp_time = (long long)Slic3r::Utils::get_current_time_utc();
                                     outfile = print_fff->export_gcode(outfile, gcode_result, nullptr);
                                     time_using_cache = time_using_cache + ((long long)Slic3r::Utils::get_current_time_utc() - temp_time);
+                                    if (! pipeline_stats_file.empty())
+                                        save_gcode_pipeline_stats(pipeline_stats_file, pipeline_stats, index + 1, print_fff->print_statistics().gcode_pipeline);
                                     BOOST_LOG_TRIVIAL(info) << "export_gcode finished: time_using_cache update to " << time_using_cache << " secs.";
                                     if (gcode_result && gcode_result->gcode_check_result.error_code) {
                                         //found gcode error
@@ -313,7 +313,7 @@ namespace AABBTreeLines {
         }
 
         explicit LinesDistancer(std::vector<LineType>&& lines)
-            : lines(lines)
+            : lines(std::move(lines))
         {
             tree = AABBTreeLines::build_aabb_tree_over_indexed_lines(this->lines);
         }
@@ -0,0 +1,672 @@
+// Wide bounding volume hierarchy over an indexed triangle set for batched ray casting.
+// The tree is built top-down with the binned Surface Area Heuristic (SAH) as a binary tree,
+// which is then collapsed into a tree with up to Width children per node. Bounds of the children
+// of a node are stored as a structure of arrays, so that all children of a node are tested against a ray
+// in a single pass of a loop, which the compiler vectorizes.
+
+#ifndef slic3r_AABBTreeWide_hpp_
+#define slic3r_AABBTreeWide_hpp_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
+#include <tbb/parallel_reduce.h>
+
+#include "AABBTreeIndirect.hpp"
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+namespace Slic3r {
+namespace AABBTreeIndirect {
+
+// Wide AABB tree for ray casting, an alternative to the balanced binary Tree<3, CoordType>.
+// Pass it to intersect_ray_first_hit() / intersect_ray_all_hits() in place of the binary Tree,
+// or shoot many rays at once with intersect_rays_first_hit() / intersect_rays_all_hits().
+// Only ray casting is implemented, use the binary Tree for the closest point queries.
+template<int AWidth, typename ACoordType = float>
+class WideTree
+{
+public:
+    static constexpr int    Width         = AWidth;
+    static constexpr int    NumDimensions = 3;
+    using                   CoordType     = ACoordType;
+    using                   VectorType    = Eigen::Matrix<CoordType, 3, 1, Eigen::DontAlign>;
+    using                   BoundingBox   = Eigen::AlignedBox<CoordType, 3>;
+    static_assert(Width == 4 || Width == 8, "WideTree supports 4 or 8 children per node");
+    static_assert(std::is_floating_point<CoordType>::value, "WideTree requires floating point bounding boxes");
+
+    // Maximum number of primitives referenced by a leaf.
+    static constexpr uint32_t max_leaf_size  = 4;
+    // Below this depth of the binary tree the primitives are split by the SAH, above it at the median
+    // to bound the depth of the tree and thus the size of the traversal stack.
+    static constexpr int      max_sah_depth  = 32;
+    static constexpr int      max_depth      = 64;
+    // Worst case number of nodes waiting on the traversal stack.
+    static constexpr size_t   max_stack_size = size_t(max_depth) * (Width - 1) + 1;
+    // Marks an unused child slot.
+    static constexpr uint32_t invalid        = uint32_t(-1);
+
+    struct Node {
+        // Bounding boxes of the children, bmin[axis][child]. Unused slots contain an empty (inverted) box.
+        CoordType bmin[3][Width];
+        CoordType bmax[3][Width];
+        // Index of the child node for inner children, index of the first primitive in primitives() for leaf children.
+        uint32_t  child[Width];
+        // Number of primitives of a leaf child, zero for an inner child.
+        uint32_t  count[Width];
+
+        bool is_leaf(int i)  const { return count[i] > 0; }
+        bool is_valid(int i) const { return child[i] != invalid; }
+    };
+
+    WideTree() = default;
+    WideTree(const WideTree &rhs) = default;
+    WideTree(WideTree &&rhs) = default;
+    WideTree& operator=(const WideTree &rhs) = default;
+    WideTree& operator=(WideTree &&rhs) = default;
+
+    // Build the tree over primitives provided by their bounding boxes, the primitives are referenced
+    // by their position in the input vector.
+    void build(const std::vector<BoundingBox> &bboxes);
+
+    void clear() { m_nodes.clear(); m_primitives.clear(); m_bbox.setEmpty(); }
+    bool empty() const { return m_nodes.empty(); }
+
+    const std::vector<Node>&     nodes()      const { return m_nodes; }
+    const std::vector<uint32_t>& primitives() const { return m_primitives; }
+    // Bounding box of all the primitives.
+    const BoundingBox&           bbox()       const { return m_bbox; }
+
+private:
+    struct BuildNode {
+        BoundingBox bbox;
+        // Children of an inner node, indices into the build nodes.
+        uint32_t    left  { invalid };
+        uint32_t    right { invalid };
+        // Range of the primitives of a leaf.
+        uint32_t    begin { 0 };
+        uint32_t    end   { 0 };
+        bool        is_leaf() const { return left == invalid; }
+    };
+
+    struct BuildContext {
+        const std::vector<BoundingBox> &bboxes;
+        std::vector<VectorType>         centroids {};
+        std::vector<BuildNode>          nodes {};
+        std::atomic<uint32_t>           num_nodes { 0 };
+        // Start of the primitive indices being partitioned, leaf ranges are relative to it.
+        const uint32_t                 *primitives { nullptr };
+    };
+
+    static uint32_t build_recursive(BuildContext &ctx, uint32_t *begin, uint32_t *end, int depth);
+    uint32_t        collapse(const std::vector<BuildNode> &build_nodes, uint32_t build_node_idx, CoordType inflate);
+
+    std::vector<Node>     m_nodes;
+    std::vector<uint32_t> m_primitives;
+    BoundingBox           m_bbox;
+};
+
+using WideTree4f = WideTree<4, float>;
+using WideTree8f = WideTree<8, float>;
+
+namespace detail {
+    inline int lowest_bit_index(uint32_t mask)
+    {
+        assert(mask != 0);
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward(&idx, mask);
+        return int(idx);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    template<typename BoundingBox>
+    inline typename BoundingBox::Scalar half_surface_area(const BoundingBox &bbox)
+    {
+        if (bbox.isEmpty())
+            return 0;
+        auto d = bbox.sizes();
+        return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+    }
+
+    template<typename CoordType>
+    struct SAHBins {
+        static constexpr int num_bins = 16;
+        using BoundingBox = Eigen::AlignedBox<CoordType, 3>;
+        std::array<std::array<BoundingBox, num_bins>, 3> bbox;
+        std::array<std::array<uint32_t,    num_bins>, 3> count;
+        SAHBins() {
+            for (int axis = 0; axis < 3; ++ axis)
+                for (int i = 0; i < num_bins; ++ i) {
+                    bbox[axis][i].setEmpty();
+                    count[axis][i] = 0;
+                }
+        }
+        void merge(const SAHBins &rhs) {
+            for (int axis = 0; axis < 3; ++ axis)
+                for (int i = 0; i < num_bins; ++ i) {
+                    bbox[axis][i].extend(rhs.bbox[axis][i]);
+                    count[axis][i] += rhs.count[axis][i];
+                }
+        }
+    };
+
+    // Ray prepared for the slab test against the bounding boxes of a wide node.
+    template<typename CoordType>
+    struct WideRay {
+        CoordType origin[3];
+        CoordType invdir[3];
+        // Offsets of the near / far planes in the bmin / bmax arrays of a node, selected by the direction signs.
+        int       near_plane[3];
+        int       far_plane[3];
+
+        WideRay() = default;
+        template<typename VectorType>
+        WideRay(const VectorType &o, const VectorType &d) {
+            for (int axis = 0; axis < 3; ++ axis) {
+                origin[axis] = CoordType(o[axis]);
+                auto di      = CoordType(d[axis]);
+                // Avoid infinite inverse direction, which would produce NaNs for origins on a slab plane.
+                invdir[axis] = std::abs(di) > std::numeric_limits<CoordType>::min() ? CoordType(1) / di :
+                    std::copysign(std::numeric_limits<CoordType>::max(), di);
+                bool negative     = invdir[axis] < 0;
+                near_plane[axis]  = negative ? 1 : 0;
+                far_plane[axis]   = negative ? 0 : 1;
+            }
+        }
+    };
+
+    // Slab test of a single ray against all the children of a wide node. Returns a bit mask of the children hit
+    // within the <0, tmax> interval of the ray parameter, fills in the ray parameter of the entry into the children.
+    // The loops run over the children of the node in a structure of arrays layout and they are vectorized.
+    template<typename NodeType, typename CoordType, int Width>
+    inline uint32_t wide_ray_box_intersect(const NodeType &node, const WideRay<CoordType> &ray, CoordType tmax, CoordType (&tnear)[Width])
+    {
+        const CoordType *planes[2][3] = {
+            { node.bmin[0], node.bmin[1], node.bmin[2] },
+            { node.bmax[0], node.bmax[1], node.bmax[2] }
+        };
+        CoordType tfar[Width];
+        for (int i = 0; i < Width; ++ i) {
+            tnear[i] = 0;
+            tfar[i]  = tmax;
+        }
+        for (int axis = 0; axis < 3; ++ axis) {
+            const CoordType *pnear = planes[ray.near_plane[axis]][axis];
+            const CoordType *pfar  = planes[ray.far_plane[axis]][axis];
+            const CoordType  o     = ray.origin[axis];
+            const CoordType  id    = ray.invdir[axis];
+            for (int i = 0; i < Width; ++ i) {
+                CoordType t0 = (pnear[i] - o) * id;
+                CoordType t1 = (pfar[i] - o) * id;
+                tnear[i] = t0 > tnear[i] ? t0 : tnear[i];
+                tfar[i]  = t1 < tfar[i]  ? t1 : tfar[i];
+            }
+        }
+        uint32_t mask = 0;
+        for (int i = 0; i < Width; ++ i)
+            mask |= uint32_t(tnear[i] <= tfar[i]) << i;
+        return mask;
+    }
+
+    // Rays are traced through the wide tree in packets of up to 32 rays, sharing the traversal of the tree.
+    // A node is visited if any of the rays of the packet hits it, each ray of a packet is only tested
+    // against the children of a node and the triangles it reached.
+    static constexpr size_t ray_packet_size = 32;
+
+    // Trace a packet of rays, call hit_fn(ray_idx, igl::Hit) for each ray - triangle intersection with t > 0.
+    // If first_hit, the rays are clipped by their closest intersection found so far.
+    template<bool first_hit, typename VertexType, typename IndexedFaceType, int Width, typename CoordType, typename VectorType, typename HitFn>
+    inline void intersect_ray_packet(
+        const std::vector<VertexType>       &vertices,
+        const std::vector<IndexedFaceType>  &faces,
+        const WideTree<Width, CoordType>    &tree,
+        const VectorType                    *origins,
+        const VectorType                    *dirs,
+        size_t                               num_rays,
+        const double                         eps,
+        HitFn                              &&hit_fn)
+    {
+        using Tree = WideTree<Width, CoordType>;
+        assert(num_rays > 0 && num_rays <= ray_packet_size);
+
+        std::array<WideRay<CoordType>, ray_packet_size>   rays;
+        // The closest hit found so far for each ray.
+        std::array<double, ray_packet_size>               tmax;
+        for (size_t i = 0; i < num_rays; ++ i) {
+            rays[i] = WideRay<CoordType>(origins[i], dirs[i]);
+            tmax[i] = std::numeric_limits<double>::infinity();
+        }
+
+        struct StackEntry {
+            uint32_t node;
+            uint32_t rays;
+        };
+        std::array<StackEntry, Tree::max_stack_size> stack;
+        size_t stack_size = 0;
+        stack[stack_size ++] = { 0, num_rays == 32 ? uint32_t(-1) : (uint32_t(1) << num_rays) - 1 };
+
+        auto test_leaf = [&](uint32_t first, uint32_t count, uint32_t ray_mask) {
+            for (uint32_t p = first; p < first + count; ++ p) {
+                const uint32_t  face_idx = tree.primitives()[p];
+                const auto     &face     = faces[face_idx];
+                for (uint32_t m = ray_mask; m != 0; m &= m - 1) {
+                    const int ray_idx = lowest_bit_index(m);
+                    double t, u, v;
+                    if (intersect_triangle(origins[ray_idx], dirs[ray_idx], vertices[face(0)], vertices[face(1)], vertices[face(2)], t, u, v, eps)
+                        && t > 0. && (! first_hit || t < tmax[ray_idx])) {
+                        if (first_hit)
+                            tmax[ray_idx] = t;
+                        hit_fn(ray_idx, igl::Hit{ int(face_idx), -1, float(u), float(v), float(t) });
+                    }
+                }
+            }
+        };
+
+        while (stack_size > 0) {
+            const StackEntry  entry = stack[-- stack_size];
+            const auto       &node  = tree.nodes()[entry.node];
+            // Rays hitting each child of the node.
+            uint32_t          child_rays[Width] = { 0 };
+            // Entry parameter of the first ray hitting a child, used to order the traversal front to back.
+            CoordType         child_tnear[Width];
+            for (uint32_t m = entry.rays; m != 0; m &= m - 1) {
+                const int ray_idx = lowest_bit_index(m);
+                // Rounding the clipping parameter up, the bounding boxes are inflated to be conservative anyways.
+                const CoordType ray_tmax = first_hit && tmax[ray_idx] < std::numeric_limits<CoordType>::max() ?
+                    CoordType(tmax[ray_idx]) * CoordType(1.0001) : std::numeric_limits<CoordType>::max();
+                CoordType tnear[Width];
+                uint32_t  mask = wide_ray_box_intersect<typename Tree::Node, CoordType, Width>(node, rays[ray_idx], ray_tmax, tnear);
+                for (; mask != 0; mask &= mask - 1) {
+                    const int i = lowest_bit_index(mask);
+                    if (child_rays[i] == 0)
+                        child_tnear[i] = tnear[i];
+                    child_rays[i] |= uint32_t(1) << ray_idx;
+                }
+            }
+            // Test the leaves, collect the inner nodes to be traversed.
+            int       inner[Width];
+            int       num_inner = 0;
+            for (int i = 0; i < Width; ++ i)
+                if (child_rays[i] != 0) {
+                    if (node.is_leaf(i))
+                        test_leaf(node.child[i], node.count[i], child_rays[i]);
+                    else
+                        inner[num_inner ++] = i;
+                }
+            // Push the inner nodes far to near, so that the nearest one is popped first.
+            // Insertion sort of at most Width elements.
+            for (int k = 1; k < num_inner; ++ k) {
+                const int i = inner[k];
+                int       j = k;
+                for (; j > 0 && child_tnear[inner[j - 1]] < child_tnear[i]; -- j)
+                    inner[j] = inner[j - 1];
+                inner[j] = i;
+            }
+            for (int k = 0; k < num_inner; ++ k) {
+                assert(stack_size < stack.size());
+                stack[stack_size ++] = { node.child[inner[k]], child_rays[inner[k]] };
+            }
+        }
+    }
+} // namespace detail
+
+template<int Width, typename CoordType>
+uint32_t WideTree<Width, CoordType>::build_recursive(BuildContext &ctx, uint32_t *begin, uint32_t *end, int depth)
+{
+    using Bins = detail::SAHBins<CoordType>;
+    constexpr int    num_bins      = Bins::num_bins;
+    // Ranges of primitives larger than this are binned and subdivided in parallel.
+    constexpr size_t parallel_size = 4096;
+
+    const uint32_t node_idx = ctx.num_nodes.fetch_add(1, std::memory_order_relaxed);
+    assert(node_idx < ctx.nodes.size());
+    BuildNode     &node     = ctx.nodes[node_idx];
+    const size_t   count    = end - begin;
+
+    // Bounding box of the primitives and of their centroids.
+    using Bounds = std::pair<BoundingBox, BoundingBox>;
+    auto bounds_of = [&ctx](const uint32_t *b, const uint32_t *e, Bounds out) {
+        for (const uint32_t *p = b; p != e; ++ p) {
+            out.first.extend(ctx.bboxes[*p]);
+            out.second.extend(ctx.centroids[*p]);
+        }
+        return out;
+    };
+    Bounds empty_bounds;
+    empty_bounds.first.setEmpty();
+    empty_bounds.second.setEmpty();
+    Bounds bounds = count > parallel_size ?
+        tbb::parallel_reduce(tbb::blocked_range<const uint32_t*>(begin, end, parallel_size), empty_bounds,
+            [&bounds_of](const tbb::blocked_range<const uint32_t*> &range, Bounds init) { return bounds_of(range.begin(), range.end(), init); },
+            [](Bounds l, const Bounds &r) { l.first.extend(r.first); l.second.extend(r.second); return l; }) :
+        bounds_of(begin, end, empty_bounds);
+    node.bbox = bounds.first;
+
+    if (count <= max_leaf_size) {
+        node.begin = uint32_t(begin - ctx.primitives);
+        node.end   = node.begin + uint32_t(count);
+        return node_idx;
+    }
+
+    const BoundingBox &cbox   = bounds.second;
+    const VectorType   extent = cbox.sizes();
+    int                longest_axis;
+    extent.maxCoeff(&longest_axis);
+    uint32_t          *mid    = nullptr;
+
+    if (depth < max_sah_depth && extent[longest_axis] > 0) {
+        // Binned SAH split, see Wald: On fast Construction of SAH-based Bounding Volume Hierarchies, 2007.
+        VectorType scale;
+        for (int axis = 0; axis < 3; ++ axis)
+            scale[axis] = extent[axis] > 0 ? CoordType(num_bins) * (CoordType(1) - CoordType(1e-5)) / extent[axis] : 0;
+        auto bin_of = [&cbox, &scale](const VectorType &c, int axis) {
+            return std::clamp(int((c[axis] - cbox.min()[axis]) * scale[axis]), 0, num_bins - 1);
+        };
+        auto bin = [&ctx, &bin_of](const uint32_t *b, const uint32_t *e, Bins &bins) {
+            for (const uint32_t *p = b; p != e; ++ p) {
+                const VectorType &c = ctx.centroids[*p];
+                for (int axis = 0; axis < 3; ++ axis) {
+                    int i = bin_of(c, axis);
+                    bins.bbox[axis][i].extend(ctx.bboxes[*p]);
+                    ++ bins.count[axis][i];
+                }
+            }
+        };
+        Bins bins;
+        if (count > parallel_size)
+            bins = tbb::parallel_reduce(tbb::blocked_range<const uint32_t*>(begin, end, parallel_size), Bins(),
+                [&bin](const tbb::blocked_range<const uint32_t*> &range, Bins init) { bin(range.begin(), range.end(), init); return init; },
+                [](Bins l, const Bins &r) { l.merge(r); return l; });
+        else
+            bin(begin, end, bins);
+
+        // Evaluate the SAH cost of splitting after each bin, sweeping from the right and then from the left.
+        double best_cost  = std::numeric_limits<double>::max();
+        int    best_axis  = -1;
+        int    best_split = 0;
+        for (int axis = 0; axis < 3; ++ axis) {
+            if (extent[axis] <= 0)
+                continue;
+            std::array<double, num_bins> right_cost;
+            BoundingBox bbox;
+            bbox.setEmpty();
+            size_t n = 0;
+            for (int i = num_bins - 1; i > 0; -- i) {
+                bbox.extend(bins.bbox[axis][i]);
+                n += bins.count[axis][i];
+                right_cost[i] = double(detail::half_surface_area(bbox)) * double(n);
+            }
+            bbox.setEmpty();
+            n = 0;
+            for (int i = 0; i < num_bins - 1; ++ i) {
+                bbox.extend(bins.bbox[axis][i]);
+                n += bins.count[axis][i];
+                double cost = double(detail::half_surface_area(bbox)) * double(n) + right_cost[i + 1];
+                if (n > 0 && n < count && cost < best_cost) {
+                    best_cost  = cost;
+                    best_axis  = axis;
+                    best_split = i + 1;
+                }
+            }
+        }
+        if (best_axis != -1)
+            mid = std::partition(begin, end, [&ctx, &bin_of, best_axis, best_split](uint32_t idx) {
+                return bin_of(ctx.centroids[idx], best_axis) < best_split;
+            });
+    }
+
+    if (mid == nullptr || mid == begin || mid == end) {
+        // Median split along the longest axis: Too deep, all centroids coincide or no SAH split found.
+        mid = begin + count / 2;
+        std::nth_element(begin, mid, end, [&ctx, longest_axis](uint32_t l, uint32_t r) {
+            return ctx.centroids[l][longest_axis] < ctx.centroids[r][longest_axis];
+        });
+    }
+
+    uint32_t left, right;
+    if (count > parallel_size)
+        tbb::parallel_invoke(
+            [&]() { left  = build_recursive(ctx, begin, mid, depth + 1); },
+            [&]() { right = build_recursive(ctx, mid, end, depth + 1); });
+    else {
+        left  = build_recursive(ctx, begin, mid, depth + 1);
+        right = build_recursive(ctx, mid, end, depth + 1);
+    }
+    ctx.nodes[node_idx].left  = left;
+    ctx.nodes[node_idx].right = right;
+    return node_idx;
+}
+
+template<int Width, typename CoordType>
+uint32_t WideTree<Width, CoordType>::collapse(const std::vector<BuildNode> &build_nodes, uint32_t build_node_idx, CoordType inflate)
+{
+    // Gather up to Width children by expanding the inner child with the largest surface area.
+    std::array<uint32_t, Width> children;
+    int                         num_children = 0;
+    const BuildNode            &root         = build_nodes[build_node_idx];
+    if (root.is_leaf())
+        children[num_children ++] = build_node_idx;
+    else {
+        children[num_children ++] = root.left;
+        children[num_children ++] = root.right;
+        while (num_children < Width) {
+            int       best      = -1;
+            CoordType best_area = -1;
+            for (int i = 0; i < num_children; ++ i)
+                if (const BuildNode &n = build_nodes[children[i]]; ! n.is_leaf()) {
+                    CoordType area = detail::half_surface_area(n.bbox);
+                    if (area > best_area) {
+                        best      = i;
+                        best_area = area;
+                    }
+                }
+            if (best == -1)
+                break;
+            const BuildNode &n = build_nodes[children[best]];
+            children[best] = n.left;
+            children[num_children ++] = n.right;
+        }
+    }
+
+    const uint32_t node_idx = uint32_t(m_nodes.size());
+    m_nodes.emplace_back();
+    for (int i = 0; i < Width; ++ i) {
+        m_nodes[node_idx].child[i] = invalid;
+        m_nodes[node_idx].count[i] = 0;
+        for (int axis = 0; axis < 3; ++ axis) {
+            m_nodes[node_idx].bmin[axis][i] = std::numeric_limits<CoordType>::max();
+            m_nodes[node_idx].bmax[axis][i] = std::numeric_limits<CoordType>::lowest();
+        }
+    }
+    for (int i = 0; i < num_children; ++ i) {
+        const BuildNode &n = build_nodes[children[i]];
+        uint32_t child, count;
+        if (n.is_leaf()) {
+            child = n.begin;
+            count = n.end - n.begin;
+        } else {
+            // m_nodes may be reallocated by the recursive call.
+            child = this->collapse(build_nodes, children[i], inflate);
+            count = 0;
+        }
+        Node &node = m_nodes[node_idx];
+        node.child[i] = child;
+        node.count[i] = count;
+        // The bounding boxes are inflated, so that the single precision ray / box intersection test is conservative.
+        for (int axis = 0; axis < 3; ++ axis) {
+            node.bmin[axis][i] = n.bbox.min()[axis] - inflate;
+            node.bmax[axis][i] = n.bbox.max()[axis] + inflate;
+        }
+    }
+    return node_idx;
+}
+
+template<int Width, typename CoordType>
+void WideTree<Width, CoordType>::build(const std::vector<BoundingBox> &bboxes)
+{
+    this->clear();
+    if (bboxes.empty())
+        return;
+
+    BuildContext ctx { bboxes };
+    ctx.centroids.assign(bboxes.size(), VectorType::Zero());
+    m_primitives.assign(bboxes.size(), 0);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, bboxes.size()), [&ctx, this](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); ++ i) {
+            ctx.centroids[i]  = ctx.bboxes[i].center();
+            m_primitives[i]   = uint32_t(i);
+        }
+    });
+    // A binary tree with n leaves has 2n-1 nodes.
+    ctx.nodes.assign(2 * bboxes.size(), BuildNode());
+    ctx.primitives = m_primitives.data();
+    const uint32_t root = build_recursive(ctx, m_primitives.data(), m_primitives.data() + m_primitives.size(), 0);
+    m_bbox = ctx.nodes[root].bbox;
+
+    // Inflate the bounding boxes by a small fraction of the size of the whole tree.
+    const CoordType inflate = std::max(CoordType(1e-6) * m_bbox.sizes().maxCoeff(), std::numeric_limits<CoordType>::min());
+    m_nodes.reserve(ctx.num_nodes / (Width - 1) + 1);
+    this->collapse(ctx.nodes, root, inflate);
+}
+
+// Build a wide AABB Tree over an indexed triangles set with the binned SAH.
+template<int Width, typename VertexType, typename IndexedFaceType>
+inline WideTree<Width, float> build_wide_aabb_tree_over_indexed_triangle_set(
+    // Indexed triangle set - 3D vertices.
+    const std::vector<VertexType>       &vertices,
+    // Indexed triangle set - triangular faces, references to vertices.
+    const std::vector<IndexedFaceType>  &faces)
+{
+    using TreeType    = WideTree<Width, float>;
+    using BoundingBox = typename TreeType::BoundingBox;
+
+    std::vector<BoundingBox> bboxes(faces.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, faces.size()), [&vertices, &faces, &bboxes](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i < range.end(); ++ i) {
+            const IndexedFaceType &face = faces[i];
+            BoundingBox bbox(vertices[face(0)].template cast<float>(), vertices[face(0)].template cast<float>());
+            bbox.extend(vertices[face(1)].template cast<float>());
+            bbox.extend(vertices[face(2)].template cast<float>());
+            bboxes[i] = bbox;
+        }
+    });
+
+    TreeType out;
+    out.build(bboxes);
+    return out;
+}
+
+// Find a first intersection of a ray with indexed triangle set, traversing a wide AABB tree.
+// Same semantics as intersect_ray_first_hit() over the binary Tree.
+template<typename VertexType, typename IndexedFaceType, int Width, typename CoordType, typename VectorType>
+inline bool intersect_ray_first_hit(
+    const std::vector<VertexType>       &vertices,
+    const std::vector<IndexedFaceType>  &faces,
+    const WideTree<Width, CoordType>    &tree,
+    const VectorType                    &origin,
+    const VectorType                    &dir,
+    igl::Hit                            &hit,
+    const double                         eps = 0.000001)
+{
+    bool found = false;
+    if (! tree.empty())
+        detail::intersect_ray_packet<true>(vertices, faces, tree, &origin, &dir, 1, eps, [&hit, &found](int, const igl::Hit &h) {
+            hit   = h;
+            found = true;
+        });
+    return found;
+}
+
+// Find all intersections of a ray with indexed triangle set, traversing a wide AABB tree.
+// Same semantics as intersect_ray_all_hits() over the binary Tree, the output hits are sorted by the ray parameter.
+template<typename VertexType, typename IndexedFaceType, int Width, typename CoordType, typename VectorType>
+inline bool intersect_ray_all_hits(
+    const std::vector<VertexType>       &vertices,
+    const std::vector<IndexedFaceType>  &faces,
+    const WideTree<Width, CoordType>    &tree,
+    const VectorType                    &origin,
+    const VectorType                    &dir,
+    std::vector<igl::Hit>               &hits,
+    const double                         eps = 0.000001)
+{
+    hits.clear();
+    if (! tree.empty()) {
+        detail::intersect_ray_packet<false>(vertices, faces, tree, &origin, &dir, 1, eps, [&hits](int, const igl::Hit &h) { hits.emplace_back(h); });
+        std::sort(hits.begin(), hits.end(), [](const auto &l, const auto &r) { return l.t < r.t; });
+    }
+    return ! hits.empty();
+}
+
+// Find the first intersections of a batch of rays with indexed triangle set.
+// Rays are traced in packets, thus the batch should contain coherent rays, for example rays sharing
+// the same origin. hits[i].id is set to -1 if the i-th ray missed. Returns the number of rays hitting the mesh.
+template<typename VertexType, typename IndexedFaceType, int Width, typename CoordType, typename VectorType>
+inline size_t intersect_rays_first_hit(
+    const std::vector<VertexType>       &vertices,
+    const std::vector<IndexedFaceType>  &faces,
+    const WideTree<Width, CoordType>    &tree,
+    const std::vector<VectorType>       &origins,
+    const std::vector<VectorType>       &dirs,
+    std::vector<igl::Hit>               &hits,
+    const double                         eps = 0.000001)
+{
+    assert(origins.size() == dirs.size());
+    hits.assign(origins.size(), igl::Hit{ -1, -1, 0.f, 0.f, std::numeric_limits<float>::infinity() });
+    if (tree.empty())
+        return 0;
+    for (size_t first = 0; first < origins.size(); first += detail::ray_packet_size)
+        detail::intersect_ray_packet<true>(vertices, faces, tree, origins.data() + first, dirs.data() + first,
+            std::min(detail::ray_packet_size, origins.size() - first), eps,
+            [&hits, first](int ray_idx, const igl::Hit &h) { hits[first + ray_idx] = h; });
+    return std::count_if(hits.begin(), hits.end(), [](const igl::Hit &h) { return h.id != -1; });
+}
+
+// Find all intersections of a batch of rays with indexed triangle set, hits of each ray sorted by the ray parameter.
+// Rays are traced in packets, thus the batch should contain coherent rays. Returns the number of rays hitting the mesh.
+template<typename VertexType, typename IndexedFaceType, int Width, typename CoordType, typename VectorType>
+inline size_t intersect_rays_all_hits(
+    const std::vector<VertexType>       &vertices,
+    const std::vector<IndexedFaceType>  &faces,
+    const WideTree<Width, CoordType>    &tree,
+    const std::vector<VectorType>       &origins,
+    const std::vector<VectorType>       &dirs,
+    // Reusing the memory of the output vectors if there is some memory already pre-allocated.
+    std::vector<std::vector<igl::Hit>>  &hits,
+    const double                         eps = 0.000001)
+{
+    assert(origins.size() == dirs.size());
+    hits.resize(origins.size());
+    for (std::vector<igl::Hit> &h : hits)
+        h.clear();
+    if (tree.empty())
+        return 0;
+    for (size_t first = 0; first < origins.size(); first += detail::ray_packet_size)
+        detail::intersect_ray_packet<false>(vertices, faces, tree, origins.data() + first, dirs.data() + first,
+            std::min(detail::ray_packet_size, origins.size() - first), eps,
+            [&hits, first](int ray_idx, const igl::Hit &h) { hits[first + ray_idx].emplace_back(h); });
+    size_t num_hit = 0;
+    for (std::vector<igl::Hit> &h : hits)
+        if (! h.empty()) {
+            std::sort(h.begin(), h.end(), [](const auto &l, const auto &r) { return l.t < r.t; });
+            ++ num_hit;
+        }
+    return num_hit;
+}
+
+} // namespace AABBTreeIndirect
+} // namespace Slic3r
+
+#endif /* slic3r_AABBTreeWide_hpp_ */
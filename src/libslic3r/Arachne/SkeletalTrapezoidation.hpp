@@ -503,6 +503,18 @@ protected:
      */
     Beading interpolate(const Beading& left, double ratio_left_to_whole, const Beading& right) const;
 
+    /*!
+     * Create a beading to be attached to a node of the graph, allocated
+     * together with its reference count from the arena of the graph.
+     * \param args Arguments of the constructor of the beading propagation.
+     * \return The new beading.
+     */
+    template<typename... Args>
+    std::shared_ptr<BeadingPropagation> makeBeading(Args&&... args)
+    {
+        return std::allocate_shared<BeadingPropagation>(ArenaAllocator<BeadingPropagation>(graph.arena), std::forward<Args>(args)...);
+    }
+
     /*!
      * Get the beading at a certain node of the skeletal graph, or create one if
      * it doesn't have one yet.
@@ -12,6 +12,7 @@
 
 #include "HalfEdge.hpp"
 #include "HalfEdgeNode.hpp"
+#include "MemoryArena.hpp"
 
 namespace Slic3r::Arachne
 {
@@ -21,8 +22,16 @@ class HalfEdgeGraph
 public:
     using edge_t = derived_edge_t;
     using node_t = derived_node_t;
-    using Edges = std::list<edge_t>;
-    using Nodes = std::list<node_t>;
+    // The nodes and edges are allocated from the arena of the graph rather than one by one from the heap.
+    using Edges = std::list<edge_t, ArenaAllocator<edge_t>>;
+    using Nodes = std::list<node_t, ArenaAllocator<node_t>>;
+
+    HalfEdgeGraph() : edges(ArenaAllocator<edge_t>(arena)), nodes(ArenaAllocator<node_t>(arena)) {}
+    HalfEdgeGraph(const HalfEdgeGraph &) = delete;
+    HalfEdgeGraph& operator=(const HalfEdgeGraph &) = delete;
+
+    // Declared first to outlive the edges and nodes. May be used to allocate other data living as long as the graph.
+    MemoryArena arena;
     Edges edges;
     Nodes nodes;
 };
@@ -0,0 +1,138 @@
+#ifndef UTILS_MEMORY_ARENA_H
+#define UTILS_MEMORY_ARENA_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace Slic3r::Arachne
+{
+
+/*!
+ * Bump allocator for the short lived objects of a single Arachne wall generation (the nodes and half-edges of the
+ * skeletal trapezoidation graph and the beadings attached to them). Individual deallocations are ignored, all the
+ * memory is released at once when the arena is destroyed.
+ *
+ * The arena allocates fixed size blocks from a per-thread cache of blocks released by the arenas destroyed on the
+ * same thread before. As a new arena is created for every layer and region, the blocks are reused from layer to
+ * layer and the wall generation does not hit the global allocator for most layers once the cache is warm.
+ * The cache retains at most MAX_CACHED_BLOCKS blocks per thread, see release_cached_blocks().
+ *
+ * The arena itself is not thread safe, it shall only be used by the thread processing the graph.
+ */
+class MemoryArena
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    // Upper limit of the memory retained by the block cache of a single thread (1 MB).
+    // Blocks released above the limit are returned to the global allocator.
+    static constexpr size_t MAX_CACHED_BLOCKS = 16;
+
+    MemoryArena() = default;
+    MemoryArena(const MemoryArena &) = delete;
+    MemoryArena& operator=(const MemoryArena &) = delete;
+    ~MemoryArena() { this->release(); }
+
+    void* allocate(size_t size, size_t alignment)
+    {
+        assert(alignment <= alignof(std::max_align_t));
+        uintptr_t ptr = (reinterpret_cast<uintptr_t>(m_current) + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (m_current == nullptr || ptr + size > reinterpret_cast<uintptr_t>(m_end)) {
+            if (size > BLOCK_SIZE / 4) {
+                // Large allocations get a block of their own, not to waste the rest of the current block.
+                m_large_blocks.emplace_back(new std::max_align_t[(size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)]);
+                return m_large_blocks.back().get();
+            }
+            m_blocks.emplace_back(acquireBlock());
+            m_current = reinterpret_cast<char*>(m_blocks.back().get());
+            m_end     = m_current + BLOCK_SIZE;
+            ptr       = reinterpret_cast<uintptr_t>(m_current);
+        }
+        m_current = reinterpret_cast<char*>(ptr + size);
+        return reinterpret_cast<void*>(ptr);
+    }
+
+    // Return all the memory of this arena, the objects allocated from it shall have been destroyed already.
+    void release()
+    {
+        for (Block &block : m_blocks)
+            releaseBlock(std::move(block));
+        m_blocks.clear();
+        m_large_blocks.clear();
+        m_current = nullptr;
+        m_end     = nullptr;
+    }
+
+    // Number of blocks cached by the calling thread.
+    static size_t cached_blocks() { return blockCache().size(); }
+    // Return the blocks cached by the calling thread to the global allocator.
+    static void   release_cached_blocks()
+    {
+        blockCache().clear();
+        blockCache().shrink_to_fit();
+    }
+
+private:
+    using Block = std::unique_ptr<std::max_align_t[]>;
+
+    static std::vector<Block>& blockCache()
+    {
+        static thread_local std::vector<Block> cache;
+        return cache;
+    }
+
+    static Block acquireBlock()
+    {
+        std::vector<Block> &cache = blockCache();
+        if (cache.empty())
+            return Block(new std::max_align_t[BLOCK_SIZE / sizeof(std::max_align_t)]);
+        Block block = std::move(cache.back());
+        cache.pop_back();
+        return block;
+    }
+
+    static void releaseBlock(Block &&block)
+    {
+        std::vector<Block> &cache = blockCache();
+        if (cache.size() < MAX_CACHED_BLOCKS)
+            cache.emplace_back(std::move(block));
+    }
+
+    std::vector<Block> m_blocks;
+    std::vector<Block> m_large_blocks;
+    char              *m_current = nullptr;
+    char              *m_end     = nullptr;
+};
+
+/*!
+ * Standard allocator allocating from a MemoryArena, to be used with the standard containers and std::allocate_shared().
+ */
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(MemoryArena &arena) noexcept : m_arena(&arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : m_arena(other.arena()) {}
+
+    T*   allocate(size_t n) { return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) noexcept {}
+
+    MemoryArena* arena() const noexcept { return m_arena; }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &rhs) const noexcept { return m_arena == rhs.arena(); }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> &rhs) const noexcept { return m_arena != rhs.arena(); }
+
+private:
+    MemoryArena *m_arena;
+};
+
+} // namespace Slic3r::Arachne
+#endif // UTILS_MEMORY_ARENA_H
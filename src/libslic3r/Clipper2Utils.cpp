@@ -2,6 +2,8 @@
 #include "libslic3r.h"
 #include "clipper2/clipper.h"
 
+#include <cstring>
+
 namespace Slic3r {
 
 //BBS: FIXME
@@ -35,14 +37,26 @@ Clipper2Lib::Paths64 Slic3rPoints_to_Paths64(const Container& in)
     return out;
 }
 
+// Slic3r::Point and Clipper2Lib::Point64 share the memory layout, thus the paths are converted by copying the memory as a whole.
+static_assert(sizeof(Clipper2Lib::Point64) == sizeof(Slic3r::Point) && std::is_same_v<coord_t, int64_t>,
+    "Slic3r::Point and Clipper2Lib::Point64 are expected to have the same memory layout");
+
 Points Path64ToPoints(const Clipper2Lib::Path64& path64)
 {
     Points points;
-    points.reserve(path64.size());
-    for (const Clipper2Lib::Point64 &point64 : path64) points.emplace_back(std::move(Slic3r::Point(point64.x, point64.y)));
+    points.resize(path64.size(), Point::Zero());
+    if (! path64.empty())
+        std::memcpy(reinterpret_cast<void*>(points.data()), path64.data(), path64.size() * sizeof(Clipper2Lib::Point64));
     return points;
 }
 
+static void PointsToPath64(const Points &points, Clipper2Lib::Path64 &path64)
+{
+    path64.resize(points.size());
+    if (! points.empty())
+        std::memcpy(reinterpret_cast<void*>(path64.data()), points.data(), points.size() * sizeof(Clipper2Lib::Point64));
+}
+
 static ExPolygons PolyTreeToExPolygons(Clipper2Lib::PolyTree64 &&polytree)
 {
     struct Inner
@@ -208,4 +222,153 @@ ExPolygons offset2_ex_2(const ExPolygons& expolygons, double delta1, double delt
     return results;
 }
 
-}
\ No newline at end of file
+namespace Clipper2Backend {
+
+// Conversion buffers reused by the thread, so that the per-call conversion does not reallocate the paths.
+static Clipper2Lib::Paths64& subject_buffer()
+{
+    static thread_local Clipper2Lib::Paths64 buffer;
+    return buffer;
+}
+
+static Clipper2Lib::Paths64& clip_buffer()
+{
+    static thread_local Clipper2Lib::Paths64 buffer;
+    return buffer;
+}
+
+static const Clipper2Lib::Paths64& to_paths64(const PathsRef &paths, Clipper2Lib::Paths64 &out)
+{
+    out.resize(paths.size());
+    for (size_t i = 0; i < paths.size(); ++ i)
+        PointsToPath64(*paths[i], out[i]);
+    return out;
+}
+
+static Polygons to_polygons(Clipper2Lib::Paths64 &&paths)
+{
+    Polygons out;
+    out.reserve(paths.size());
+    for (const Clipper2Lib::Path64 &path : paths)
+        out.emplace_back(Path64ToPoints(path));
+    return out;
+}
+
+static Clipper2Lib::ClipType clip_type_2(ClipperLib::ClipType clip_type)
+{
+    switch (clip_type) {
+    case ClipperLib::ctIntersection: return Clipper2Lib::ClipType::Intersection;
+    case ClipperLib::ctUnion:        return Clipper2Lib::ClipType::Union;
+    case ClipperLib::ctDifference:   return Clipper2Lib::ClipType::Difference;
+    case ClipperLib::ctXor:          return Clipper2Lib::ClipType::Xor;
+    }
+    assert(false);
+    return Clipper2Lib::ClipType::NoClip;
+}
+
+static Clipper2Lib::FillRule fill_rule_2(ClipperLib::PolyFillType fill_type)
+{
+    switch (fill_type) {
+    case ClipperLib::pftEvenOdd:  return Clipper2Lib::FillRule::EvenOdd;
+    case ClipperLib::pftNonZero:  return Clipper2Lib::FillRule::NonZero;
+    case ClipperLib::pftPositive: return Clipper2Lib::FillRule::Positive;
+    case ClipperLib::pftNegative: return Clipper2Lib::FillRule::Negative;
+    }
+    assert(false);
+    return Clipper2Lib::FillRule::NonZero;
+}
+
+static Clipper2Lib::ClipperOffset make_offsetter(ClipperLib::JoinType join_type, double miter_limit)
+{
+    // Same as with Clipper 1, the miter limit is interpreted as the arc tolerance for round joins.
+    return join_type == ClipperLib::jtRound ?
+        Clipper2Lib::ClipperOffset(2., miter_limit) :
+        Clipper2Lib::ClipperOffset(miter_limit);
+}
+
+static Clipper2Lib::JoinType join_type_2(ClipperLib::JoinType join_type)
+{
+    switch (join_type) {
+    case ClipperLib::jtSquare: return Clipper2Lib::JoinType::Square;
+    case ClipperLib::jtRound:  return Clipper2Lib::JoinType::Round;
+    case ClipperLib::jtMiter:  return Clipper2Lib::JoinType::Miter;
+    }
+    assert(false);
+    return Clipper2Lib::JoinType::Miter;
+}
+
+template<typename TResult>
+static void offset_paths64(const Clipper2Lib::Paths64 &paths, float delta, ClipperLib::JoinType join_type, double miter_limit, TResult &out)
+{
+    Clipper2Lib::ClipperOffset co = make_offsetter(join_type, miter_limit);
+    co.AddPaths(paths, join_type_2(join_type), Clipper2Lib::EndType::Polygon);
+    co.Execute(delta, out);
+}
+
+template<typename TResult>
+static void clip_paths64(ClipperLib::ClipType clip_type, const PathsRef &subject, const PathsRef &clip, ClipperLib::PolyFillType fill_type, ApplySafetyOffset do_safety_offset, TResult &out)
+{
+    // Safety offset only allowed on intersection and difference.
+    assert(do_safety_offset == ApplySafetyOffset::No || clip_type != ClipperLib::ctUnion);
+    Clipper2Lib::Clipper64 clipper;
+    clipper.AddSubject(to_paths64(subject, subject_buffer()));
+    if (! clip.empty()) {
+        const Clipper2Lib::Paths64 &clip64 = to_paths64(clip, clip_buffer());
+        if (do_safety_offset == ApplySafetyOffset::Yes) {
+            Clipper2Lib::Paths64 clip_offsetted;
+            offset_paths64(clip64, ClipperSafetyOffset, DefaultJoinType, DefaultMiterLimit, clip_offsetted);
+            clipper.AddClip(clip_offsetted);
+        } else
+            clipper.AddClip(clip64);
+    }
+    clipper.Execute(clip_type_2(clip_type), fill_rule_2(fill_type), out);
+}
+
+Polygons clip(ClipperLib::ClipType clip_type, const PathsRef &subject, const PathsRef &clip, ClipperLib::PolyFillType fill_type, ApplySafetyOffset do_safety_offset)
+{
+    Clipper2Lib::Paths64 out;
+    clip_paths64(clip_type, subject, clip, fill_type, do_safety_offset, out);
+    return to_polygons(std::move(out));
+}
+
+ExPolygons clip_ex(ClipperLib::ClipType clip_type, const PathsRef &subject, const PathsRef &clip, ClipperLib::PolyFillType fill_type, ApplySafetyOffset do_safety_offset)
+{
+    Clipper2Lib::PolyTree64 out;
+    clip_paths64(clip_type, subject, clip, fill_type, do_safety_offset, out);
+    return PolyTreeToExPolygons(std::move(out));
+}
+
+Polygons offset(const PathsRef &paths, float delta, ClipperLib::JoinType join_type, double miter_limit)
+{
+    Clipper2Lib::Paths64 out;
+    offset_paths64(to_paths64(paths, subject_buffer()), delta, join_type, miter_limit, out);
+    return to_polygons(std::move(out));
+}
+
+ExPolygons offset_ex(const PathsRef &paths, float delta, ClipperLib::JoinType join_type, double miter_limit)
+{
+    Clipper2Lib::PolyTree64 out;
+    offset_paths64(to_paths64(paths, subject_buffer()), delta, join_type, miter_limit, out);
+    return PolyTreeToExPolygons(std::move(out));
+}
+
+Polygons offset2(const PathsRef &paths, float delta1, float delta2, ClipperLib::JoinType join_type, double miter_limit)
+{
+    Clipper2Lib::Paths64 tmp, out;
+    offset_paths64(to_paths64(paths, subject_buffer()), delta1, join_type, miter_limit, tmp);
+    offset_paths64(tmp, delta2, join_type, miter_limit, out);
+    return to_polygons(std::move(out));
+}
+
+ExPolygons offset2_ex(const PathsRef &paths, float delta1, float delta2, ClipperLib::JoinType join_type, double miter_limit)
+{
+    Clipper2Lib::Paths64    tmp;
+    Clipper2Lib::PolyTree64 out;
+    offset_paths64(to_paths64(paths, subject_buffer()), delta1, join_type, miter_limit, tmp);
+    offset_paths64(tmp, delta2, join_type, miter_limit, out);
+    return PolyTreeToExPolygons(std::move(out));
+}
+
+} // namespace Clipper2Backend
+
+}
@@ -1,6 +1,7 @@
 #ifndef slic3r_Clipper2Utils_hpp_
 #define slic3r_Clipper2Utils_hpp_
 
+#include "ClipperUtils.hpp"
 #include "ExPolygon.hpp"
 #include "Polygon.hpp"
 #include "Polyline.hpp"
@@ -13,6 +14,23 @@ ExPolygons         union_ex_2(const Polygons &expolygons);
 ExPolygons         union_ex_2(const ExPolygons &expolygons);
 ExPolygons         offset_ex_2(const ExPolygons &expolygons, double delta);
 ExPolygons         offset2_ex_2(const ExPolygons &expolygons, double delta1, double delta2);
+
+// Clipper2 implementation of the boolean operations and offsets of ClipperUtils, used if ClipperBackend::Clipper2 is active.
+// The input paths are passed by reference and converted into the Clipper2 representation in a single pass
+// into buffers reused by the calling thread.
+namespace Clipper2Backend {
+    using PathsRef = std::vector<const Points*>;
+
+    Polygons   clip(ClipperLib::ClipType clip_type, const PathsRef &subject, const PathsRef &clip, ClipperLib::PolyFillType fill_type, ApplySafetyOffset do_safety_offset);
+    ExPolygons clip_ex(ClipperLib::ClipType clip_type, const PathsRef &subject, const PathsRef &clip, ClipperLib::PolyFillType fill_type, ApplySafetyOffset do_safety_offset);
+
+    // Offset of closed polygons: CCW contours are offsetted outside, CW holes inside, the result is united.
+    Polygons   offset(const PathsRef &paths, float delta, ClipperLib::JoinType join_type, double miter_limit);
+    ExPolygons offset_ex(const PathsRef &paths, float delta, ClipperLib::JoinType join_type, double miter_limit);
+    Polygons   offset2(const PathsRef &paths, float delta1, float delta2, ClipperLib::JoinType join_type, double miter_limit);
+    ExPolygons offset2_ex(const PathsRef &paths, float delta1, float delta2, ClipperLib::JoinType join_type, double miter_limit);
+} // namespace Clipper2Backend
+
 }
 
 #endif
\ No newline at end of file
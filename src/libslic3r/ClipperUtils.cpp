@@ -1,7 +1,14 @@
 #include "ClipperUtils.hpp"
+#include "Clipper2Utils.hpp"
 #include "Geometry.hpp"
 #include "ShortestPath.hpp"
 
+#include <atomic>
+#include <cstdlib>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/log/trivial.hpp>
+
 // #define CLIPPER_UTILS_DEBUG
 
 #ifdef CLIPPER_UTILS_DEBUG
@@ -401,13 +408,114 @@ static TResult offset_paths(PathsProvider &&paths, float offset, ClipperLib::Joi
         shrink_paths<TResult>(std::forward<PathsProvider>(paths), - offset, joinType, miterLimit);
 }
 
+
+static ClipperBackend clipper_backend_from_environment()
+{
+    if (const char *backend = std::getenv("SLIC3R_CLIPPER_BACKEND"); backend != nullptr) {
+        if (boost::iequals(backend, "clipper2"))
+            return ClipperBackend::Clipper2;
+        if (boost::iequals(backend, "compare"))
+            return ClipperBackend::Compare;
+    }
+    return ClipperBackend::Clipper;
+}
+
+static std::atomic<ClipperBackend>& clipper_backend_storage()
+{
+    static std::atomic<ClipperBackend> backend { clipper_backend_from_environment() };
+    return backend;
+}
+
+static std::atomic<size_t> s_clipper_backend_operations { 0 };
+static std::atomic<size_t> s_clipper_backend_mismatches { 0 };
+
+void set_clipper_backend(ClipperBackend backend) { clipper_backend_storage() = backend; }
+ClipperBackend clipper_backend() { return clipper_backend_storage(); }
+
+ClipperBackendComparison clipper_backend_comparison()
+{
+    ClipperBackendComparison out;
+    out.operations = s_clipper_backend_operations;
+    out.mismatches = s_clipper_backend_mismatches;
+    return out;
+}
+
+void reset_clipper_backend_comparison()
+{
+    s_clipper_backend_operations = 0;
+    s_clipper_backend_mismatches = 0;
+}
+
+// Reference the input paths for Clipper2Backend without copying them.
+template<typename PathsProvider>
+static Clipper2Backend::PathsRef clipper2_paths(PathsProvider &&paths)
+{
+    Clipper2Backend::PathsRef out;
+    out.reserve(paths.size());
+    for (const Points &path : paths)
+        out.emplace_back(&path);
+    return out;
+}
+
+// The two libraries do not produce the same vertices (Clipper 2 does not decimate short edges of offsetted contours,
+// its round and square joins differ slightly), thus the results are compared by the area of their symmetric difference,
+// which shall not exceed a band of 5 microns along the boundaries.
+static bool clipper_backend_results_match(const Polygons &clipper1, const Polygons &clipper2)
+{
+    double xor_area = 0.;
+    for (const ClipperLib::Path &path : clipper_do<ClipperLib::Paths>(ClipperLib::ctXor, ClipperUtils::PolygonsProvider(clipper1), ClipperUtils::PolygonsProvider(clipper2), ClipperLib::pftNonZero))
+        xor_area += ClipperLib::Area(path);
+    double length = 0.;
+    for (const Polygon &polygon : clipper1)
+        length += polygon.length();
+    for (const Polygon &polygon : clipper2)
+        length += polygon.length();
+    const double band = scaled<double>(0.005);
+    return std::abs(xor_area) <= 0.5 * length * band + band * band;
+}
+
+static bool clipper_backend_results_match(const ExPolygons &clipper1, const ExPolygons &clipper2)
+    { return clipper_backend_results_match(to_polygons(clipper1), to_polygons(clipper2)); }
+
+// Run an operation with the active ClipperBackend.
+template<typename TResult, typename Clipper1Fn, typename Clipper2Fn>
+static TResult clipper_backend_run(const char *name, Clipper1Fn &&clipper1, Clipper2Fn &&clipper2)
+{
+    switch (clipper_backend()) {
+    case ClipperBackend::Clipper2:
+        return clipper2();
+    case ClipperBackend::Compare:
+    {
+        TResult out1 = clipper1();
+        TResult out2 = clipper2();
+        ++ s_clipper_backend_operations;
+        if (! clipper_backend_results_match(out1, out2)) {
+            ++ s_clipper_backend_mismatches;
+            BOOST_LOG_TRIVIAL(warning) << "Clipper backends produced different results of " << name << ": Clipper " << out1.size() << " polygons, Clipper2 " << out2.size() << " polygons";
+        }
+        return out1;
+    }
+    case ClipperBackend::Clipper:
+    default:
+        return clipper1();
+    }
+}
+
 Slic3r::Polygons offset(const Slic3r::Polygon &polygon, const float delta, ClipperLib::JoinType joinType, double miterLimit)
     { return to_polygons(raw_offset(ClipperUtils::SinglePathProvider(polygon.points), delta, joinType, miterLimit)); }
 
 Slic3r::Polygons offset(const Slic3r::Polygons &polygons, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return to_polygons(offset_paths<ClipperLib::Paths>(ClipperUtils::PolygonsProvider(polygons), delta, joinType, miterLimit)); }
+{
+    return clipper_backend_run<Polygons>("offset",
+        [&]() { return to_polygons(offset_paths<ClipperLib::Paths>(ClipperUtils::PolygonsProvider(polygons), delta, joinType, miterLimit)); },
+        [&]() { return Clipper2Backend::offset(clipper2_paths(ClipperUtils::PolygonsProvider(polygons)), delta, joinType, miterLimit); });
+}
 Slic3r::ExPolygons offset_ex(const Slic3r::Polygons &polygons, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return PolyTreeToExPolygons(offset_paths<ClipperLib::PolyTree>(ClipperUtils::PolygonsProvider(polygons), delta, joinType, miterLimit)); }
+{
+    return clipper_backend_run<ExPolygons>("offset_ex",
+        [&]() { return PolyTreeToExPolygons(offset_paths<ClipperLib::PolyTree>(ClipperUtils::PolygonsProvider(polygons), delta, joinType, miterLimit)); },
+        [&]() { return Clipper2Backend::offset_ex(clipper2_paths(ClipperUtils::PolygonsProvider(polygons)), delta, joinType, miterLimit); });
+}
 
 Slic3r::Polygons offset(const Slic3r::Polyline &polyline, const float delta, ClipperLib::JoinType joinType, double miterLimit, ClipperLib::EndType end_type)
     { assert(delta > 0); return to_polygons(clipper_union<ClipperLib::Paths>(raw_offset_polyline(ClipperUtils::SinglePathProvider(polyline.points), delta, joinType, miterLimit, end_type))); }
@@ -544,36 +652,66 @@ static ClipperLib::PolyTree expolygons_offset_pt(const ExPolygonVector &expolygo
     return clipper_union<ClipperLib::PolyTree>(output);
 }
 
+// Offset of ExPolygons or Surfaces with the active ClipperBackend. Clipper2 offsets the contours and holes in a single pass.
+template<typename ExPolygonVector, typename PathsProvider>
+static Polygons expolygons_offset_polygons(const ExPolygonVector &expolygons, PathsProvider &&paths, const float delta, ClipperLib::JoinType joinType, double miterLimit)
+{
+    return clipper_backend_run<Polygons>("offset",
+        [&]() { return to_polygons(expolygons_offset(expolygons, delta, joinType, miterLimit)); },
+        [&]() { return Clipper2Backend::offset(clipper2_paths(paths), delta, joinType, miterLimit); });
+}
+template<typename ExPolygonVector, typename PathsProvider>
+static ExPolygons expolygons_offset_expolygons(const ExPolygonVector &expolygons, PathsProvider &&paths, const float delta, ClipperLib::JoinType joinType, double miterLimit)
+{
+    return clipper_backend_run<ExPolygons>("offset_ex",
+        [&]() { return PolyTreeToExPolygons(expolygons_offset_pt(expolygons, delta, joinType, miterLimit)); },
+        [&]() { return Clipper2Backend::offset_ex(clipper2_paths(paths), delta, joinType, miterLimit); });
+}
+
 Slic3r::Polygons offset(const Slic3r::ExPolygon &expolygon, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return to_polygons(expolygon_offset(expolygon, delta, joinType, miterLimit)); }
+{
+    return clipper_backend_run<Polygons>("offset",
+        [&]() { return to_polygons(expolygon_offset(expolygon, delta, joinType, miterLimit)); },
+        [&]() { return Clipper2Backend::offset(clipper2_paths(ClipperUtils::ExPolygonProvider(expolygon)), delta, joinType, miterLimit); });
+}
 Slic3r::Polygons offset(const Slic3r::ExPolygons &expolygons, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return to_polygons(expolygons_offset(expolygons, delta, joinType, miterLimit)); }
+    { return expolygons_offset_polygons(expolygons, ClipperUtils::ExPolygonsProvider(expolygons), delta, joinType, miterLimit); }
 Slic3r::Polygons offset(const Slic3r::Surfaces &surfaces, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return to_polygons(expolygons_offset(surfaces, delta, joinType, miterLimit)); }
+    { return expolygons_offset_polygons(surfaces, ClipperUtils::SurfacesProvider(surfaces), delta, joinType, miterLimit); }
 Slic3r::Polygons offset(const Slic3r::SurfacesPtr &surfaces, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return to_polygons(expolygons_offset(surfaces, delta, joinType, miterLimit)); }
+    { return expolygons_offset_polygons(surfaces, ClipperUtils::SurfacesPtrProvider(surfaces), delta, joinType, miterLimit); }
 Slic3r::ExPolygons offset_ex(const Slic3r::ExPolygon &expolygon, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    //FIXME one may spare one Clipper Union call.
-    { return ClipperPaths_to_Slic3rExPolygons(expolygon_offset(expolygon, delta, joinType, miterLimit)); }
+{
+    return clipper_backend_run<ExPolygons>("offset_ex",
+        //FIXME one may spare one Clipper Union call.
+        [&]() { return ClipperPaths_to_Slic3rExPolygons(expolygon_offset(expolygon, delta, joinType, miterLimit)); },
+        [&]() { return Clipper2Backend::offset_ex(clipper2_paths(ClipperUtils::ExPolygonProvider(expolygon)), delta, joinType, miterLimit); });
+}
 Slic3r::ExPolygons offset_ex(const Slic3r::ExPolygons &expolygons, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return PolyTreeToExPolygons(expolygons_offset_pt(expolygons, delta, joinType, miterLimit)); }
+    { return expolygons_offset_expolygons(expolygons, ClipperUtils::ExPolygonsProvider(expolygons), delta, joinType, miterLimit); }
 Slic3r::ExPolygons offset_ex(const Slic3r::Surfaces &surfaces, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return PolyTreeToExPolygons(expolygons_offset_pt(surfaces, delta, joinType, miterLimit)); }
+    { return expolygons_offset_expolygons(surfaces, ClipperUtils::SurfacesProvider(surfaces), delta, joinType, miterLimit); }
 Slic3r::ExPolygons offset_ex(const Slic3r::SurfacesPtr &surfaces, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return PolyTreeToExPolygons(expolygons_offset_pt(surfaces, delta, joinType, miterLimit)); }
+    { return expolygons_offset_expolygons(surfaces, ClipperUtils::SurfacesPtrProvider(surfaces), delta, joinType, miterLimit); }
 
 Polygons offset2(const ExPolygons &expolygons, const float delta1, const float delta2, ClipperLib::JoinType joinType, double miterLimit)
 {
-    return to_polygons(offset_paths<ClipperLib::Paths>(expolygons_offset(expolygons, delta1, joinType, miterLimit), delta2, joinType, miterLimit));
+    return clipper_backend_run<Polygons>("offset2",
+        [&]() { return to_polygons(offset_paths<ClipperLib::Paths>(expolygons_offset(expolygons, delta1, joinType, miterLimit), delta2, joinType, miterLimit)); },
+        [&]() { return Clipper2Backend::offset2(clipper2_paths(ClipperUtils::ExPolygonsProvider(expolygons)), delta1, delta2, joinType, miterLimit); });
 }
 ExPolygons offset2_ex(const ExPolygons &expolygons, const float delta1, const float delta2, ClipperLib::JoinType joinType, double miterLimit)
 {
-    return PolyTreeToExPolygons(offset_paths<ClipperLib::PolyTree>(expolygons_offset(expolygons, delta1, joinType, miterLimit), delta2, joinType, miterLimit));
+    return clipper_backend_run<ExPolygons>("offset2_ex",
+        [&]() { return PolyTreeToExPolygons(offset_paths<ClipperLib::PolyTree>(expolygons_offset(expolygons, delta1, joinType, miterLimit), delta2, joinType, miterLimit)); },
+        [&]() { return Clipper2Backend::offset2_ex(clipper2_paths(ClipperUtils::ExPolygonsProvider(expolygons)), delta1, delta2, joinType, miterLimit); });
 }
 ExPolygons offset2_ex(const Surfaces &surfaces, const float delta1, const float delta2, ClipperLib::JoinType joinType, double miterLimit)
 {
-    //FIXME it may be more efficient to offset to_expolygons(surfaces) instead of to_polygons(surfaces).
-    return PolyTreeToExPolygons(offset_paths<ClipperLib::PolyTree>(expolygons_offset(surfaces, delta1, joinType, miterLimit), delta2, joinType, miterLimit));
+    return clipper_backend_run<ExPolygons>("offset2_ex",
+        //FIXME it may be more efficient to offset to_expolygons(surfaces) instead of to_polygons(surfaces).
+        [&]() { return PolyTreeToExPolygons(offset_paths<ClipperLib::PolyTree>(expolygons_offset(surfaces, delta1, joinType, miterLimit), delta2, joinType, miterLimit)); },
+        [&]() { return Clipper2Backend::offset2_ex(clipper2_paths(ClipperUtils::SurfacesProvider(surfaces)), delta1, delta2, joinType, miterLimit); });
 }
 
 // Offset outside, then inside produces morphological closing. All deltas should be positive.
@@ -655,9 +793,11 @@ inline ClipperLib::PolyTree clipper_do_polytree(
 }
 
 template<class TSubj, class TClip>
-static inline Polygons _clipper(ClipperLib::ClipType clipType, TSubj &&subject, TClip &&clip, ApplySafetyOffset do_safety_offset)
+static inline Polygons _clipper(ClipperLib::ClipType clipType, TSubj &&subject, TClip &&clip, ApplySafetyOffset do_safety_offset, ClipperLib::PolyFillType fill_type = ClipperLib::pftNonZero)
 {
-    return to_polygons(clipper_do<ClipperLib::Paths>(clipType, std::forward<TSubj>(subject), std::forward<TClip>(clip), ClipperLib::pftNonZero, do_safety_offset));
+    return clipper_backend_run<Polygons>("_clipper",
+        [&]() { return to_polygons(clipper_do<ClipperLib::Paths>(clipType, subject, clip, fill_type, do_safety_offset)); },
+        [&]() { return Clipper2Backend::clip(clipType, clipper2_paths(subject), clipper2_paths(clip), fill_type, do_safety_offset); });
 }
 
 Slic3r::Polygons diff(const Slic3r::Polygon &subject, const Slic3r::Polygon &clip, ApplySafetyOffset do_safety_offset)
@@ -711,7 +851,7 @@ Slic3r::Polygons union_(const Slic3r::Polygons &subject)
 Slic3r::Polygons union_(const Slic3r::ExPolygons &subject)
     { return _clipper(ClipperLib::ctUnion, ClipperUtils::ExPolygonsProvider(subject), ClipperUtils::EmptyPathsProvider(), ApplySafetyOffset::No); }
 Slic3r::Polygons union_(const Slic3r::Polygons &subject, const ClipperLib::PolyFillType fillType)
-    { return to_polygons(clipper_do<ClipperLib::Paths>(ClipperLib::ctUnion, ClipperUtils::PolygonsProvider(subject), ClipperUtils::EmptyPathsProvider(), fillType, ApplySafetyOffset::No)); }
+    { return _clipper(ClipperLib::ctUnion, ClipperUtils::PolygonsProvider(subject), ClipperUtils::EmptyPathsProvider(), ApplySafetyOffset::No, fillType); }
 Slic3r::Polygons union_(const Slic3r::Polygons &subject, const Slic3r::Polygons &subject2)
     {
         // BBS
@@ -723,7 +863,11 @@ Slic3r::Polygons union_(const Slic3r::Polygons &subject, const Slic3r::Polygons
 
 template <typename TSubject, typename TClip>
 static ExPolygons _clipper_ex(ClipperLib::ClipType clipType, TSubject &&subject,  TClip &&clip, ApplySafetyOffset do_safety_offset, ClipperLib::PolyFillType fill_type = ClipperLib::pftNonZero)
-    { return PolyTreeToExPolygons(clipper_do_polytree(clipType, std::forward<TSubject>(subject), std::forward<TClip>(clip), fill_type, do_safety_offset)); }
+{
+    return clipper_backend_run<ExPolygons>("_clipper_ex",
+        [&]() { return PolyTreeToExPolygons(clipper_do_polytree(clipType, subject, clip, fill_type, do_safety_offset)); },
+        [&]() { return Clipper2Backend::clip_ex(clipType, clipper2_paths(subject), clipper2_paths(clip), fill_type, do_safety_offset); });
+}
 
 Slic3r::ExPolygons diff_ex(const Slic3r::Polygons &subject, const Slic3r::Polygons &clip, ApplySafetyOffset do_safety_offset)
     { return _clipper_ex(ClipperLib::ctDifference, ClipperUtils::PolygonsProvider(subject), ClipperUtils::PolygonsProvider(clip), do_safety_offset); }
@@ -800,11 +944,11 @@ Slic3r::ExPolygons intersection_ex(const Slic3r::SurfacesPtr &subject, const Sli
 Slic3r::ExPolygons union_ex(const Slic3r::Polygons &subject, ClipperLib::PolyFillType fill_type)
     { return _clipper_ex(ClipperLib::ctUnion, ClipperUtils::PolygonsProvider(subject), ClipperUtils::EmptyPathsProvider(), ApplySafetyOffset::No, fill_type); }
 Slic3r::ExPolygons union_ex(const Slic3r::ExPolygons &subject)
-    { return PolyTreeToExPolygons(clipper_do_polytree(ClipperLib::ctUnion, ClipperUtils::ExPolygonsProvider(subject), ClipperUtils::EmptyPathsProvider(), ClipperLib::pftNonZero)); }
+    { return _clipper_ex(ClipperLib::ctUnion, ClipperUtils::ExPolygonsProvider(subject), ClipperUtils::EmptyPathsProvider(), ApplySafetyOffset::No); }
 Slic3r::ExPolygons union_ex(const Slic3r::ExPolygons &subject, const Slic3r::Polygons &subject2)
-    { return PolyTreeToExPolygons(clipper_do_polytree(ClipperLib::ctUnion, ClipperUtils::ExPolygonsProvider(subject), ClipperUtils::PolygonsProvider(subject2), ClipperLib::pftNonZero)); }
+    { return _clipper_ex(ClipperLib::ctUnion, ClipperUtils::ExPolygonsProvider(subject), ClipperUtils::PolygonsProvider(subject2), ApplySafetyOffset::No); }
 Slic3r::ExPolygons union_ex(const Slic3r::Surfaces &subject)
-    { return PolyTreeToExPolygons(clipper_do_polytree(ClipperLib::ctUnion, ClipperUtils::SurfacesProvider(subject), ClipperUtils::EmptyPathsProvider(), ClipperLib::pftNonZero)); }
+    { return _clipper_ex(ClipperLib::ctUnion, ClipperUtils::SurfacesProvider(subject), ClipperUtils::EmptyPathsProvider(), ApplySafetyOffset::No); }
 // BBS
 Slic3r::ExPolygons union_ex(const Slic3r::ExPolygons& poly1, const Slic3r::ExPolygons& poly2, bool safety_offset_)
     {
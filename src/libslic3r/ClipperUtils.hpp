@@ -38,6 +38,33 @@ enum class ApplySafetyOffset {
     Yes
 };
 
+// Polygon clipping library running the boolean operations with Polygons / ExPolygons output (diff, intersection, union_, xor)
+// and the offsets of closed polygons (offset, offset_ex, offset2, offset2_ex) of this module.
+// The operations on polylines and lines, the PolyTree producing functions and the morphological closing / opening
+// always run Clipper 1.
+enum class ClipperBackend {
+    // Clipper 1 (ClipperLib), the default.
+    Clipper,
+    // Clipper 2 (Clipper2Lib).
+    Clipper2,
+    // Run both libraries, return the Clipper 1 result and record whether the results match, for differential testing.
+    Compare,
+};
+
+// The initial backend may be selected by the SLIC3R_CLIPPER_BACKEND environment variable ("clipper", "clipper2" or "compare").
+void           set_clipper_backend(ClipperBackend backend);
+ClipperBackend clipper_backend();
+
+// Statistics of ClipperBackend::Compare.
+struct ClipperBackendComparison {
+    // Number of operations run by both libraries.
+    size_t operations { 0 };
+    // Number of operations, where the area of the symmetric difference of the two results exceeded the tolerance.
+    size_t mismatches { 0 };
+};
+ClipperBackendComparison clipper_backend_comparison();
+void                     reset_clipper_backend_comparison();
+
 namespace ClipperUtils {
     class PathsProviderIteratorBase {
     public:
@@ -6,6 +6,7 @@
 #include <iostream>
 #include "FillBase.hpp"
 #include "FillGyroid.hpp"
+#include "WavePatternCache.hpp"
 
 namespace Slic3r {
 
@@ -112,7 +113,9 @@ static Polylines make_gyroid_waves(double gridZ, double density_adjusted, double
 
     //scale factor for 5% : 8 712 388
     // 1z = 10^-6 mm ?
-    const double z     = gridZ / scaleFactor;
+    // The waves are periodic in z, they are generated from the quantized phase of z to be shared through the wave cache.
+    const int64_t phase = WavePatternCache::quantize_phase(gridZ / scaleFactor);
+    const double z     = WavePatternCache::phase(phase);
     const double z_sin = sin(z);
     const double z_cos = cos(z);
 
@@ -127,9 +130,17 @@ static Polylines make_gyroid_waves(double gridZ, double density_adjusted, double
         std::swap(width,height);
     }
 
-    std::vector<Vec2d> one_period_odd = make_one_period(width, scaleFactor, z_cos, z_sin, vertical, flip, tolerance); // creates one period of the waves, so it doesn't have to be recalculated all the time
-    flip = !flip;                                                                   // even polylines are a bit shifted
-    std::vector<Vec2d> one_period_even = make_one_period(width, scaleFactor, z_cos, z_sin, vertical, flip, tolerance);
+    // creates one period of the waves, so it doesn't have to be recalculated all the time
+    std::shared_ptr<const WavePatternCache::Waves> one_period = FillGyroid::wave_cache().get({ phase, scaleFactor, tolerance, std::min(2 * M_PI, width) }, [&]() {
+        WavePatternCache::Waves out;
+        out.emplace_back(make_one_period(width, scaleFactor, z_cos, z_sin, vertical, flip, tolerance));
+        // even polylines are a bit shifted
+        out.emplace_back(make_one_period(width, scaleFactor, z_cos, z_sin, vertical, !flip, tolerance));
+        return out;
+    });
+    const std::vector<Vec2d> &one_period_odd  = (*one_period)[0];
+    const std::vector<Vec2d> &one_period_even = (*one_period)[1];
+    flip = !flip;
     Polylines result;
 
     for (double y0 = lower_bound; y0 < upper_bound + EPSILON; y0 += M_PI) {
@@ -148,6 +159,13 @@ static Polylines make_gyroid_waves(double gridZ, double density_adjusted, double
 // FIXME: needed to fix build on Mac on buildserver
 constexpr double FillGyroid::PatternTolerance;
 
+WavePatternCache& FillGyroid::wave_cache()
+{
+    // A period of the waves takes a few kilobytes, thus thousands of layer phases fit.
+    static WavePatternCache cache(16 * 1024 * 1024);
+    return cache;
+}
+
 void FillGyroid::_fill_surface_single(
     const FillParams                &params,
     unsigned int                     thickness_layers,
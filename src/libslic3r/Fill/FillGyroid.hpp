@@ -7,6 +7,8 @@
 
 namespace Slic3r {
 
+class WavePatternCache;
+
 class FillGyroid : public Fill
 {
 public:
@@ -27,6 +29,9 @@ public:
     // Gyroid upper resolution tolerance (mm^-2)
     static constexpr double PatternTolerance = 0.2;
 
+    // Periods of the gyroid waves shared by all layers, regions and objects.
+    static WavePatternCache& wave_cache();
+
 
 protected:
     void _fill_surface_single(
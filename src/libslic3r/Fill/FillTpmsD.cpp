@@ -11,6 +11,7 @@
 #include "libslic3r/Polygon.hpp"
 #include "libslic3r/libslic3r.h"
 #include "FillTpmsD.hpp"
+#include "WavePatternCache.hpp"
 
 namespace Slic3r {
 
@@ -28,7 +29,9 @@ static Polylines make_waves(double gridZ, double density_adjusted, double line_s
 
     //scale factor for 5% : 8 712 388
     // 1z = 10^-6 mm ?
-    const double z = gridZ / scaleFactor;
+    // The waves are periodic in z, they are generated from the quantized phase of z to be shared through the wave cache.
+    const int64_t phase = WavePatternCache::quantize_phase(gridZ / scaleFactor);
+    const double z = WavePatternCache::phase(phase);
     Polylines result;
 
 	//sin(x)*sin(y)*sin(z)-cos(x)*cos(y)*cos(z)=0
@@ -52,38 +55,50 @@ static Polylines make_waves(double gridZ, double density_adjusted, double line_s
 		std::swap(minU,minV);
 		std::swap(maxU,maxV);
 	}
-	std::vector<std::pair<double,double>> wave;
-	{//fill one wave
+	//one period of the wave starting at u=0 is cached, it is tiled from the period boundary below minU
+	std::shared_ptr<const WavePatternCache::Waves> one_period = FillTpmsD::wave_cache().get({ phase, scaleFactor, tolerance, 0. }, [&]() {
+		std::vector<Vec2d> period;
 		const auto v=[&](double u){return acos(a/b*cos(u));};
 		const int initialSegments=16;
 		for(int c=0;c<=initialSegments;++c){
-			const double u=minU+2*M_PI*c/initialSegments;
-			wave.emplace_back(u,v(u));
+			const double u=2*M_PI*c/initialSegments;
+			period.emplace_back(u,v(u));
 		}
 		{//refine
 			int current=0;
-			while(current+1<int(wave.size())){
-				const double u1=wave[current].first;
-				const double u2=wave[current+1].first;
+			while(current+1<int(period.size())){
+				const double u1=period[current].x();
+				const double u2=period[current+1].x();
 				const double middleU=(u1+u2)/2;
-				const double v1=wave[current].second;
-				const double v2=wave[current+1].second;
+				const double v1=period[current].y();
+				const double v2=period[current+1].y();
 				const double middleV=v((u1+u2)/2);
 				if(std::abs(middleV-(v1+v2)/2)>tolerance)
-					wave.emplace(wave.begin()+current+1,middleU,middleV);
+					period.emplace(period.begin()+current+1,middleU,middleV);
 				else
 					++current;
 			}
 		}
-		for(int c=1;c<int(wave.size()) && wave.back().first<maxU;++c)//we start from 1 because the 0-th one is already duplicated as the last one in a period
-			wave.emplace_back(wave[c].first+2*M_PI,wave[c].second);
+		WavePatternCache::Waves out;
+		out.emplace_back(std::move(period));
+		return out;
+	});
+	std::vector<Vec2d> wave;
+	{//fill one wave
+		const std::vector<Vec2d> &period=(*one_period)[0];
+		const double firstU=scaled_floor(minU,2*M_PI);
+		for(const Vec2d &p:period)
+			wave.emplace_back(p.x()+firstU,p.y());
+		for(double uShift=firstU+2*M_PI;wave.back().x()<maxU;uShift+=2*M_PI)
+			for(size_t c=1;c<period.size() && wave.back().x()<maxU;++c)//we start from 1 because the 0-th one is already duplicated as the last one in a period
+				wave.emplace_back(period[c].x()+uShift,period[c].y());
 	}
 	for(double vShift=scaled_floor(minV,2*M_PI);vShift<maxV+2*M_PI;vShift+=2*M_PI) {
 		for(bool forwardRoot:{false,true}) {
 			result.emplace_back();
-			for(const auto &pair:wave) {
-				const double u=pair.first;
-				double v=pair.second;
+			for(const Vec2d &pair:wave) {
+				const double u=pair.x();
+				double v=pair.y();
 				v=(forwardRoot?v:-v)+vShift;
 				const double x=(u+v)/2;
 				const double y=(v-u)/2*(swapUV?-1:1);
@@ -98,6 +113,13 @@ static Polylines make_waves(double gridZ, double density_adjusted, double line_s
 // FIXME: needed to fix build on Mac on buildserver
 constexpr double FillTpmsD::PatternTolerance;
 
+WavePatternCache& FillTpmsD::wave_cache()
+{
+    // A period of the wave takes a few kilobytes, thus thousands of layer phases fit.
+    static WavePatternCache cache(16 * 1024 * 1024);
+    return cache;
+}
+
 void FillTpmsD::_fill_surface_single(
     const FillParams                &params, 
     unsigned int                     thickness_layers,
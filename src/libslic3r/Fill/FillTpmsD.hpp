@@ -10,6 +10,7 @@
 
 namespace Slic3r {
 class Point;
+class WavePatternCache;
 
 class FillTpmsD : public Fill
 {
@@ -39,6 +40,9 @@ public:
     // Gyroid upper resolution tolerance (mm^-2)
     static constexpr double PatternTolerance = 0.1;
 
+    // Periods of the TPMS-D waves shared by all layers, regions and objects.
+    static WavePatternCache& wave_cache();
+
 };
 
 } // namespace Slic3r
@@ -44,31 +44,45 @@ DistanceField::DistanceField(const coord_t& radius, const Polygons& current_outl
     // Sample source polygons with a regular grid sampling pattern.
     const BoundingBox overhang_bbox = get_extents(current_overhang);
     ExPolygons expolys = offset2_ex(union_ex(current_overhang), -m_cell_size / 2, m_cell_size / 2); // remove dangling lines which causes sample_grid_pattern crash (fails the OUTER_LOW assertions)
-    for (const ExPolygon &expoly : expolys) {
-        const Points sampled_points               = sample_grid_pattern(expoly, m_cell_size, overhang_bbox);
-        const size_t unsupported_points_prev_size = m_unsupported_points.size();
-        m_unsupported_points.resize(unsupported_points_prev_size + sampled_points.size());
-
-        tbb::parallel_for(tbb::blocked_range<size_t>(0, sampled_points.size()), [&self = *this, &expoly = std::as_const(expoly), &sampled_points = std::as_const(sampled_points), &unsupported_points_prev_size = std::as_const(unsupported_points_prev_size)](const tbb::blocked_range<size_t> &range) -> void {
-            for (size_t sp_idx = range.begin(); sp_idx < range.end(); ++sp_idx) {
-                const Point &sp = sampled_points[sp_idx];
-                // Find a squared distance to the source expolygon boundary.
-                double d2 = std::numeric_limits<double>::max();
-                for (size_t icontour = 0; icontour <= expoly.holes.size(); ++icontour) {
-                    const Polygon &contour = icontour == 0 ? expoly.contour : expoly.holes[icontour - 1];
-                    if (contour.size() > 2) {
-                        Point prev = contour.points.back();
-                        for (const Point &p2 : contour.points) {
-                            d2   = std::min(d2, Line::distance_to_squared(sp, prev, p2));
-                            prev = p2;
+
+    // Sample the overhang islands in parallel. The samples are stored in the order of the islands, thus the result does not depend on scheduling.
+    std::vector<Points> sampled_points(expolys.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, expolys.size()), [&expolys = std::as_const(expolys), &sampled_points, &overhang_bbox = std::as_const(overhang_bbox), cell_size = m_cell_size](const tbb::blocked_range<size_t> &range) -> void {
+        for (size_t expoly_idx = range.begin(); expoly_idx < range.end(); ++expoly_idx)
+            sampled_points[expoly_idx] = sample_grid_pattern(expolys[expoly_idx], cell_size, overhang_bbox);
+    }); // end of parallel_for
+
+    std::vector<size_t> sampled_points_offsets(expolys.size() + 1, 0);
+    for (size_t expoly_idx = 0; expoly_idx < expolys.size(); ++expoly_idx)
+        sampled_points_offsets[expoly_idx + 1] = sampled_points_offsets[expoly_idx] + sampled_points[expoly_idx].size();
+    m_unsupported_points.resize(sampled_points_offsets.back());
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, expolys.size()), [&self = *this, &expolys = std::as_const(expolys), &sampled_points = std::as_const(sampled_points), &sampled_points_offsets = std::as_const(sampled_points_offsets)](const tbb::blocked_range<size_t> &expolys_range) -> void {
+        for (size_t expoly_idx = expolys_range.begin(); expoly_idx < expolys_range.end(); ++expoly_idx) {
+            const ExPolygon &expoly                       = expolys[expoly_idx];
+            const Points    &expoly_sampled_points        = sampled_points[expoly_idx];
+            const size_t     unsupported_points_prev_size = sampled_points_offsets[expoly_idx];
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, expoly_sampled_points.size()), [&self, &expoly, &expoly_sampled_points, unsupported_points_prev_size](const tbb::blocked_range<size_t> &range) -> void {
+                for (size_t sp_idx = range.begin(); sp_idx < range.end(); ++sp_idx) {
+                    const Point &sp = expoly_sampled_points[sp_idx];
+                    // Find a squared distance to the source expolygon boundary.
+                    double d2 = std::numeric_limits<double>::max();
+                    for (size_t icontour = 0; icontour <= expoly.holes.size(); ++icontour) {
+                        const Polygon &contour = icontour == 0 ? expoly.contour : expoly.holes[icontour - 1];
+                        if (contour.size() > 2) {
+                            Point prev = contour.points.back();
+                            for (const Point &p2 : contour.points) {
+                                d2   = std::min(d2, Line::distance_to_squared(sp, prev, p2));
+                                prev = p2;
+                            }
                         }
                     }
+                    self.m_unsupported_points[unsupported_points_prev_size + sp_idx] = {sp, coord_t(std::sqrt(d2))};
+                    assert(self.m_unsupported_points_bbox.contains(sp));
                 }
-                self.m_unsupported_points[unsupported_points_prev_size + sp_idx] = {sp, coord_t(std::sqrt(d2))};
-                assert(self.m_unsupported_points_bbox.contains(sp));
-            }
-        }); // end of parallel_for
-    }
+            }); // end of parallel_for
+        }
+    }); // end of parallel_for
     std::stable_sort(m_unsupported_points.begin(), m_unsupported_points.end(), [&radius](const UnsupportedCell &a, const UnsupportedCell &b) {
         constexpr coord_t prime_for_hash = 191;
         return std::abs(b.dist_to_boundary - a.dist_to_boundary) > radius ?
@@ -11,6 +11,7 @@
 #include "Utils.hpp"
 
 #include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 #include <tbb/blocked_range2d.h>
 #include <mutex>
 
@@ -114,6 +115,44 @@ static bool polygonCollidesWithLineSegment(const Point &from, const Point &to, c
     return visitor.intersect;
 }
 
+// Closest point on the outlines to a location, searched in parallel over all the edges of the outlines.
+// On a tie the first edge is picked, as by a sequential search, thus the result does not depend on scheduling.
+static Point closestPointOnOutlines(const Polygons &outlines, const Point &location)
+{
+    std::vector<size_t> edges_offsets;
+    edges_offsets.reserve(outlines.size() + 1);
+    edges_offsets.emplace_back(0);
+    for (const Polygon &contour : outlines)
+        edges_offsets.emplace_back(edges_offsets.back() + (contour.size() > 2 ? contour.size() : 0));
+
+    struct ClosestPoint
+    {
+        double d2 = std::numeric_limits<double>::max();
+        Point  point;
+    };
+
+    // Small outlines are searched by a single task.
+    constexpr size_t grain_size = 1024;
+    return tbb::parallel_reduce(tbb::blocked_range<size_t>(0, edges_offsets.back(), grain_size), ClosestPoint{},
+        [&outlines, &edges_offsets, &location](const tbb::blocked_range<size_t> &range, ClosestPoint closest) -> ClosestPoint {
+            size_t contour_idx = std::upper_bound(edges_offsets.begin(), edges_offsets.end(), range.begin()) - edges_offsets.begin() - 1;
+            for (size_t edge_idx = range.begin(); edge_idx < range.end(); ++edge_idx) {
+                while (edge_idx >= edges_offsets[contour_idx + 1])
+                    ++contour_idx;
+                const Points &points    = outlines[contour_idx].points;
+                const size_t  point_idx = edge_idx - edges_offsets[contour_idx];
+                const Point  &prev      = point_idx == 0 ? points.back() : points[point_idx - 1];
+                Point         closest_point;
+                if (double d = line_alg::distance_to_squared(Line{prev, points[point_idx]}, location, &closest_point); d < closest.d2) {
+                    closest.d2    = d;
+                    closest.point = closest_point;
+                }
+            }
+            return closest;
+        },
+        [](const ClosestPoint &left, const ClosestPoint &right) -> ClosestPoint { return right.d2 < left.d2 ? right : left; }).point;
+}
+
 GroundingLocation Layer::getBestGroundingLocation
 (
     const Point& unsupported_location,
@@ -127,22 +166,7 @@ GroundingLocation Layer::getBestGroundingLocation
 )
 {
     // Closest point on current_outlines to unsupported_location:
-    Point node_location;
-    {
-        double d2 = std::numeric_limits<double>::max();
-        for (const Polygon &contour : current_outlines)
-            if (contour.size() > 2) {
-                Point prev = contour.points.back();
-                for (const Point &p2 : contour.points) {
-                    Point closest_point;
-                    if (double d = line_alg::distance_to_squared(Line{prev, p2}, unsupported_location, &closest_point); d < d2) {
-                        d2 = d;
-                        node_location = closest_point;
-                    }
-                    prev = p2;
-                }
-            }
-    }
+    const Point node_location = closestPointOnOutlines(current_outlines, unsupported_location);
 
     const auto within_dist = coord_t((node_location - unsupported_location).cast<double>().norm());
 
@@ -0,0 +1,76 @@
+#include "WavePatternCache.hpp"
+
+#include <cmath>
+
+#include <boost/container_hash/hash.hpp>
+
+namespace Slic3r {
+
+int64_t WavePatternCache::quantize_phase(double phase)
+{
+    int64_t quantized = std::llround(phase / (2. * M_PI) * double(PhaseSteps)) % PhaseSteps;
+    return quantized < 0 ? quantized + PhaseSteps : quantized;
+}
+
+size_t WavePatternCache::KeyHash::operator()(const Key &key) const
+{
+    size_t seed = std::hash<int64_t>{}(key.phase);
+    boost::hash_combine(seed, std::hash<double>{}(key.scale_factor));
+    boost::hash_combine(seed, std::hash<double>{}(key.tolerance));
+    boost::hash_combine(seed, std::hash<double>{}(key.limit));
+    return seed;
+}
+
+std::shared_ptr<const WavePatternCache::Waves> WavePatternCache::find(const Key &key)
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    if (auto it = m_map.find(key); it != m_map.end()) {
+        // Mark as the most recently used.
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        ++ m_statistics.hits;
+        return it->second->waves;
+    }
+    ++ m_statistics.misses;
+    return nullptr;
+}
+
+std::shared_ptr<const WavePatternCache::Waves> WavePatternCache::insert(const Key &key, std::shared_ptr<const Waves> &&waves)
+{
+    size_t size = sizeof(Entry);
+    for (const std::vector<Vec2d> &wave : *waves)
+        size += sizeof(wave) + wave.size() * sizeof(Vec2d);
+
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    if (auto it = m_map.find(key); it != m_map.end())
+        // Generated by another thread in the meantime.
+        return it->second->waves;
+    if (size > m_max_size)
+        return std::move(waves);
+    while (m_statistics.size + size > m_max_size) {
+        const Entry &oldest = m_entries.back();
+        m_statistics.size -= oldest.size;
+        m_map.erase(oldest.key);
+        m_entries.pop_back();
+        ++ m_statistics.evicted;
+    }
+    m_entries.push_front({ key, std::move(waves), size });
+    m_map.emplace(key, m_entries.begin());
+    m_statistics.size += size;
+    return m_entries.front().waves;
+}
+
+void WavePatternCache::clear()
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    m_map.clear();
+    m_entries.clear();
+    m_statistics = Statistics();
+}
+
+WavePatternCache::Statistics WavePatternCache::statistics() const
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+} // namespace Slic3r
@@ -0,0 +1,96 @@
+#ifndef slic3r_WavePatternCache_hpp_
+#define slic3r_WavePatternCache_hpp_
+
+#include "../libslic3r.h"
+#include "../Point.hpp"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Slic3r {
+
+// Cache of the sampled wave periods of the triply periodic infills (Gyroid, TPMS-D), shared by all layers, regions and
+// objects. The waves of these patterns only depend on the phase of z within the period of the pattern and on the scale
+// of the pattern, while sampling a period with the requested tolerance is the expensive part of generating the infill.
+// The infill then tiles the cached periods over the surface to be filled.
+//
+// The phase is quantized and the waves are always generated from the quantized phase, thus the infill does not depend
+// on the state of the cache. The least recently used entries are evicted to keep the cache below its memory limit.
+class WavePatternCache
+{
+public:
+    // Sampled periods of the waves, pattern specific.
+    using Waves = std::vector<std::vector<Vec2d>>;
+
+    struct Key
+    {
+        // Quantized phase of z in <0, PhaseSteps).
+        int64_t phase;
+        double  scale_factor;
+        double  tolerance;
+        // Pattern specific parameter of the sampling, zero if not used.
+        double  limit;
+
+        bool operator==(const Key &rhs) const
+            { return phase == rhs.phase && scale_factor == rhs.scale_factor && tolerance == rhs.tolerance && limit == rhs.limit; }
+    };
+
+    // Resolution of the phase, about 6e-6 radians.
+    static constexpr int64_t PhaseSteps = int64_t(1) << 20;
+
+    explicit WavePatternCache(size_t max_size) : m_max_size(max_size) {}
+
+    // Quantize a phase given in radians.
+    static int64_t quantize_phase(double phase);
+    // Phase in radians of a quantized phase.
+    static double  phase(int64_t quantized_phase) { return 2. * M_PI * double(quantized_phase) / double(PhaseSteps); }
+
+    // Returns the cached waves, or generates them by generate() and stores them into the cache.
+    // Thread safe, the waves are generated outside of the lock.
+    template<typename GenerateFn>
+    std::shared_ptr<const Waves> get(const Key &key, GenerateFn &&generate)
+    {
+        if (std::shared_ptr<const Waves> waves = this->find(key); waves)
+            return waves;
+        return this->insert(key, std::make_shared<const Waves>(generate()));
+    }
+
+    void clear();
+
+    struct Statistics {
+        size_t hits    { 0 };
+        size_t misses  { 0 };
+        size_t evicted { 0 };
+        // Memory occupied by the cached waves in bytes.
+        size_t size    { 0 };
+    };
+    Statistics statistics() const;
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key &key) const;
+    };
+    struct Entry {
+        Key                          key;
+        std::shared_ptr<const Waves> waves;
+        size_t                       size;
+    };
+    using Entries = std::list<Entry>;
+
+    std::shared_ptr<const Waves> find(const Key &key);
+    std::shared_ptr<const Waves> insert(const Key &key, std::shared_ptr<const Waves> &&waves);
+
+    size_t                                                  m_max_size;
+    mutable std::mutex                                      m_mutex;
+    // Most recently used first.
+    Entries                                                 m_entries;
+    std::unordered_map<Key, Entries::iterator, KeyHash>     m_map;
+    Statistics                                              m_statistics;
+};
+
+} // namespace Slic3r
+
+#endif // slic3r_WavePatternCache_hpp_
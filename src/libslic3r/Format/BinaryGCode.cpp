@@ -0,0 +1,495 @@
+#include "BinaryGCode.hpp"
+
+#include "../Exception.hpp"
+#include "../Utils.hpp"
+#include "libslic3r_version.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <string_view>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/beast/core/detail/base64.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/nowide/cstdio.hpp>
+
+#include "miniz_extension.hpp"
+
+namespace Slic3r {
+namespace BinaryGCode {
+
+static constexpr const uint32_t MAGIC   = 0x45444347; // "GCDE" stored as little endian
+static constexpr const uint32_t VERSION = 1;
+
+enum class EChecksumType : uint16_t
+{
+    None  = 0,
+    CRC32 = 1,
+};
+
+// Encoding of the metadata and G-code blocks.
+static constexpr const uint16_t METADATA_ENCODING_INI = 0;
+static constexpr const uint16_t GCODE_ENCODING_NONE   = 0;
+
+// Config keys copied from the slicer metadata into the printer metadata block, which is read by the printers.
+static const std::array<const char*, 7> printer_metadata_keys = {
+    "printer_model", "filament_type", "nozzle_diameter", "layer_height", "sparse_infill_density", "nozzle_temperature", "filament_colour"
+};
+
+// Prefixes of the keys of the statistics written as "; key = value" comments into the G-code, copied into the print metadata block.
+static const std::array<const char*, 5> print_metadata_key_prefixes = {
+    "filament used", "filament cost", "total filament", "total layers", "estimated"
+};
+
+namespace {
+
+class Writer
+{
+public:
+    Writer(FILE *f, const BinarizerConfig &config) : m_file(f), m_config(config) {}
+
+    void write_file_header()
+    {
+        std::string header;
+        append_u32(header, MAGIC);
+        append_u32(header, VERSION);
+        append_u16(header, uint16_t(m_config.checksum ? EChecksumType::CRC32 : EChecksumType::None));
+        this->write(header.data(), header.size());
+    }
+
+    void write_metadata_block(EBlockType type, const Metadata &metadata)
+    {
+        if (metadata.empty())
+            return;
+        std::string ini;
+        for (const auto &[key, value] : metadata) {
+            ini += key;
+            ini += '=';
+            ini += value;
+            ini += '\n';
+        }
+        std::string params;
+        append_u16(params, METADATA_ENCODING_INI);
+        this->write_block(type, m_config.metadata_compression, params, ini);
+    }
+
+    void write_thumbnail_block(const Thumbnail &thumbnail)
+    {
+        std::string params;
+        append_u16(params, uint16_t(thumbnail.format));
+        append_u16(params, thumbnail.width);
+        append_u16(params, thumbnail.height);
+        // Thumbnails are compressed images already.
+        this->write_block(EBlockType::Thumbnail, ECompressionType::None, params, thumbnail.data);
+    }
+
+    void write_gcode_block(const std::string &gcode)
+    {
+        std::string params;
+        append_u16(params, GCODE_ENCODING_NONE);
+        this->write_block(EBlockType::GCode, m_config.gcode_compression, params, gcode);
+    }
+
+private:
+    static void append_u16(std::string &out, uint16_t v) { out += char(v & 0xff); out += char(v >> 8); }
+    static void append_u32(std::string &out, uint32_t v) { for (int i = 0; i < 4; ++ i) out += char((v >> (8 * i)) & 0xff); }
+
+    void write(const void *data, size_t size)
+    {
+        if (size > 0 && ::fwrite(data, 1, size, m_file) != size)
+            throw Slic3r::RuntimeError("Binary G-code export failed.\nError while writing to file.\n");
+    }
+
+    void write_block(EBlockType type, ECompressionType compression, const std::string &params, const std::string &data)
+    {
+        if (compression != ECompressionType::None && compression != ECompressionType::Deflate)
+            throw Slic3r::RuntimeError("Binary G-code export failed.\nUnsupported compression.\n");
+
+        std::string compressed;
+        if (compression == ECompressionType::Deflate) {
+            mz_ulong compressed_size = mz_compressBound(mz_ulong(data.size()));
+            compressed.resize(compressed_size);
+            if (mz_compress2(reinterpret_cast<unsigned char*>(compressed.data()), &compressed_size,
+                             reinterpret_cast<const unsigned char*>(data.data()), mz_ulong(data.size()), MZ_DEFAULT_LEVEL) != MZ_OK)
+                throw Slic3r::RuntimeError("Binary G-code export failed.\nError while compressing a block.\n");
+            compressed.resize(compressed_size);
+        }
+        const std::string &payload = compression == ECompressionType::None ? data : compressed;
+
+        std::string header;
+        append_u16(header, uint16_t(type));
+        append_u16(header, uint16_t(compression));
+        append_u32(header, uint32_t(data.size()));
+        if (compression != ECompressionType::None)
+            append_u32(header, uint32_t(payload.size()));
+
+        this->write(header.data(), header.size());
+        this->write(params.data(), params.size());
+        this->write(payload.data(), payload.size());
+        if (m_config.checksum) {
+            mz_ulong crc = mz_crc32(MZ_CRC32_INIT, reinterpret_cast<const unsigned char*>(header.data()), header.size());
+            crc = mz_crc32(crc, reinterpret_cast<const unsigned char*>(params.data()), params.size());
+            crc = mz_crc32(crc, reinterpret_cast<const unsigned char*>(payload.data()), payload.size());
+            std::string checksum;
+            append_u32(checksum, uint32_t(crc));
+            this->write(checksum.data(), checksum.size());
+        }
+    }
+
+    FILE                  *m_file;
+    const BinarizerConfig &m_config;
+};
+
+class Reader
+{
+public:
+    Reader(FILE *f, size_t file_size) : m_file(f), m_remaining(file_size) {}
+
+    // Returns false at the end of file.
+    bool read(void *data, size_t size, bool eof_allowed = false)
+    {
+        if (size > m_remaining)
+            // Don't trust the sizes stored in the file, they may be corrupted.
+            throw Slic3r::RuntimeError("Invalid binary G-code.\nUnexpected end of file.\n");
+        size_t cnt = ::fread(data, 1, size, m_file);
+        m_remaining -= cnt;
+        if (cnt == size)
+            return true;
+        if (cnt == 0 && eof_allowed && ::feof(m_file))
+            return false;
+        throw Slic3r::RuntimeError("Invalid binary G-code.\nUnexpected end of file.\n");
+    }
+    uint16_t read_u16() { unsigned char b[2]; this->read(b, 2); return uint16_t(b[0] | (b[1] << 8)); }
+    uint32_t read_u32() { unsigned char b[4]; this->read(b, 4); return uint32_t(b[0]) | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) | (uint32_t(b[3]) << 24); }
+
+    // Number of bytes until the end of file.
+    size_t   remaining() const { return m_remaining; }
+
+private:
+    FILE   *m_file;
+    size_t  m_remaining;
+};
+
+static uint16_t le_u16(const unsigned char *b) { return uint16_t(b[0] | (b[1] << 8)); }
+static uint32_t le_u32(const unsigned char *b) { return uint32_t(b[0]) | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) | (uint32_t(b[3]) << 24); }
+
+static Metadata parse_ini(const std::string &ini)
+{
+    Metadata out;
+    size_t begin = 0;
+    while (begin < ini.size()) {
+        size_t end = ini.find('\n', begin);
+        if (end == std::string::npos)
+            end = ini.size();
+        std::string_view line(ini.data() + begin, end - begin);
+        if (size_t eq = line.find('='); eq != std::string_view::npos)
+            out.emplace_back(std::string(line.substr(0, eq)), std::string(line.substr(eq + 1)));
+        begin = end + 1;
+    }
+    return out;
+}
+
+// Split an ASCII G-code comment "; key = value" into its key and value.
+static bool parse_comment_key_value(std::string_view line, std::string &key, std::string &value)
+{
+    if (line.size() < 2 || line.front() != ';')
+        return false;
+    line.remove_prefix(1);
+    size_t eq = line.find(" = ");
+    if (eq == std::string_view::npos)
+        return false;
+    key   = boost::algorithm::trim_copy(std::string(line.substr(0, eq)));
+    value = boost::algorithm::trim_copy(std::string(line.substr(eq + 3)));
+    return ! key.empty();
+}
+
+// Collect the metadata and the thumbnails from the comments of an ASCII G-code.
+static void collect_binary_data(FILE *f, BinaryData &data)
+{
+    bool        in_config_block = false;
+    bool        in_thumbnail    = false;
+    std::string thumbnail_tag;
+    std::string thumbnail_base64;
+    Thumbnail   thumbnail;
+    std::string key, value;
+
+    auto process_line = [&](std::string_view line) {
+        while (! line.empty() && (line.back() == '\r' || line.back() == '\n'))
+            line.remove_suffix(1);
+        if (line.empty() || line.front() != ';')
+            return;
+        std::string_view comment = line.substr(1);
+        while (! comment.empty() && comment.front() == ' ')
+            comment.remove_prefix(1);
+        if (in_thumbnail) {
+            if (comment == thumbnail_tag + " end") {
+                in_thumbnail = false;
+                thumbnail.data.resize(boost::beast::detail::base64::decoded_size(thumbnail_base64.size()));
+                thumbnail.data.resize(boost::beast::detail::base64::decode(thumbnail.data.data(), thumbnail_base64.data(), thumbnail_base64.size()).first);
+                data.thumbnails.emplace_back(std::move(thumbnail));
+                thumbnail = Thumbnail();
+            } else
+                thumbnail_base64 += comment;
+        } else if (comment == "CONFIG_BLOCK_START") {
+            in_config_block = true;
+        } else if (comment == "CONFIG_BLOCK_END") {
+            in_config_block = false;
+        } else if (in_config_block) {
+            if (parse_comment_key_value(line, key, value))
+                data.slicer_metadata.emplace_back(std::move(key), std::move(value));
+        } else if (size_t pos = comment.find(" begin "); pos != std::string_view::npos &&
+                   (comment.substr(0, pos) == "thumbnail" || comment.substr(0, pos) == "thumbnail_JPG" || comment.substr(0, pos) == "thumbnail_QOI")) {
+            // "; thumbnail begin 300x300 12345"
+            unsigned int w = 0, h = 0;
+            if (sscanf(std::string(comment.substr(pos + 7)).c_str(), "%ux%u", &w, &h) == 2) {
+                thumbnail_tag    = std::string(comment.substr(0, pos));
+                thumbnail.format = thumbnail_tag == "thumbnail_JPG" ? EThumbnailFormat::JPG :
+                                   thumbnail_tag == "thumbnail_QOI" ? EThumbnailFormat::QOI : EThumbnailFormat::PNG;
+                thumbnail.width  = uint16_t(w);
+                thumbnail.height = uint16_t(h);
+                thumbnail_base64.clear();
+                in_thumbnail = true;
+            }
+        } else if (parse_comment_key_value(line, key, value)) {
+            for (const char *prefix : print_metadata_key_prefixes)
+                if (boost::starts_with(key, prefix)) {
+                    data.print_metadata.emplace_back(std::move(key), std::move(value));
+                    break;
+                }
+        }
+    };
+
+    std::vector<char> buffer(65536 * 10);
+    std::string       line;
+    for (;;) {
+        size_t cnt_read = ::fread(buffer.data(), 1, buffer.size(), f);
+        if (::ferror(f))
+            throw Slic3r::RuntimeError("Binary G-code export failed.\nError while reading from file.\n");
+        const char *it  = buffer.data();
+        const char *end = it + cnt_read;
+        while (it != end) {
+            const char *eol = static_cast<const char*>(memchr(it, '\n', end - it));
+            if (eol == nullptr) {
+                line.append(it, end);
+                break;
+            }
+            if (line.empty())
+                process_line(std::string_view(it, eol - it));
+            else {
+                line.append(it, eol);
+                process_line(line);
+                line.clear();
+            }
+            it = eol + 1;
+        }
+        if (cnt_read == 0)
+            break;
+    }
+    if (! line.empty())
+        process_line(line);
+
+    data.file_metadata.emplace_back("Producer", std::string(SLIC3R_APP_NAME) + " " + SoftFever_VERSION);
+    for (const char *key : printer_metadata_keys)
+        for (const auto &kvp : data.slicer_metadata)
+            if (kvp.first == key) {
+                data.printer_metadata.emplace_back(kvp);
+                break;
+            }
+    // The printers display the estimates from the printer metadata block.
+    data.printer_metadata.insert(data.printer_metadata.end(), data.print_metadata.begin(), data.print_metadata.end());
+}
+
+} // namespace
+
+bool is_binary_gcode_file(const std::string &path)
+{
+    FilePtr f{ boost::nowide::fopen(path.c_str(), "rb") };
+    if (f.f == nullptr)
+        return false;
+    unsigned char magic[4];
+    return ::fread(magic, 1, 4, f.f) == 4 && le_u32(magic) == MAGIC;
+}
+
+void convert_ascii_to_binary(const std::string &src_path, const std::string &dst_path, const BinarizerConfig &config)
+{
+    FilePtr in{ boost::nowide::fopen(src_path.c_str(), "rb") };
+    if (in.f == nullptr)
+        throw Slic3r::RuntimeError(std::string("Binary G-code export failed.\nCannot open file for reading: ") + src_path + "\n");
+
+    // The metadata blocks precede the G-code blocks, though the config block and the statistics are stored
+    // at the end of the ASCII G-code: Collect them with a first pass over the G-code.
+    BinaryData data;
+    collect_binary_data(in.f, data);
+    ::rewind(in.f);
+
+    FilePtr out{ boost::nowide::fopen(dst_path.c_str(), "wb") };
+    if (out.f == nullptr)
+        throw Slic3r::RuntimeError(std::string("Binary G-code export failed.\nCannot open file for writing: ") + dst_path + "\n");
+
+    Writer writer(out.f, config);
+    writer.write_file_header();
+    writer.write_metadata_block(EBlockType::FileMetadata, data.file_metadata);
+    writer.write_metadata_block(EBlockType::PrinterMetadata, data.printer_metadata);
+    for (const Thumbnail &thumbnail : data.thumbnails)
+        writer.write_thumbnail_block(thumbnail);
+    writer.write_metadata_block(EBlockType::PrintMetadata, data.print_metadata);
+    writer.write_metadata_block(EBlockType::SlicerMetadata, data.slicer_metadata);
+
+    // Split the G-code into blocks at line ends.
+    std::vector<char> buffer(std::max<size_t>(config.gcode_block_size, 4096));
+    std::string       block;
+    block.reserve(2 * buffer.size());
+    for (;;) {
+        size_t cnt_read = ::fread(buffer.data(), 1, buffer.size(), in.f);
+        if (::ferror(in.f))
+            throw Slic3r::RuntimeError("Binary G-code export failed.\nError while reading from file.\n");
+        block.append(buffer.data(), cnt_read);
+        if (cnt_read == 0) {
+            if (! block.empty())
+                writer.write_gcode_block(block);
+            break;
+        }
+        if (block.size() >= config.gcode_block_size) {
+            size_t last_eol = block.rfind('\n');
+            if (last_eol != std::string::npos) {
+                std::string rest = block.substr(last_eol + 1);
+                block.erase(last_eol + 1);
+                writer.write_gcode_block(block);
+                block = std::move(rest);
+            }
+        }
+    }
+
+    out.close();
+    if (::ferror(in.f))
+        throw Slic3r::RuntimeError("Binary G-code export failed.\nError while reading from file.\n");
+}
+
+void read_binary_gcode(const std::string &path, BinaryData &data, const std::function<void(const char *begin, const char *end)> &gcode_callback)
+{
+    FilePtr f{ boost::nowide::fopen(path.c_str(), "rb") };
+    if (f.f == nullptr)
+        throw Slic3r::RuntimeError(std::string("Cannot open binary G-code for reading: ") + path + "\n");
+
+    boost::system::error_code ec;
+    const uintmax_t file_size = boost::filesystem::file_size(path, ec);
+    if (ec)
+        throw Slic3r::RuntimeError(std::string("Cannot open binary G-code for reading: ") + path + "\n");
+    Reader reader(f.f, size_t(file_size));
+    if (reader.read_u32() != MAGIC)
+        throw Slic3r::RuntimeError("Invalid binary G-code.\nThe file header is missing.\n");
+    if (uint32_t version = reader.read_u32(); version != VERSION)
+        throw Slic3r::RuntimeError("Unsupported binary G-code version " + std::to_string(version) + ".\n");
+    const EChecksumType checksum_type = EChecksumType(reader.read_u16());
+    if (checksum_type != EChecksumType::None && checksum_type != EChecksumType::CRC32)
+        throw Slic3r::RuntimeError("Invalid binary G-code.\nUnknown checksum type.\n");
+
+    std::string payload;
+    std::string block_data;
+    for (;;) {
+        unsigned char header[12];
+        if (reader.remaining() == 0)
+            break;
+        reader.read(header, 8);
+        const EBlockType       type              = EBlockType(le_u16(header));
+        const ECompressionType compression       = ECompressionType(le_u16(header + 2));
+        const uint32_t         uncompressed_size = le_u32(header + 4);
+        size_t                 header_size       = 8;
+        uint32_t               payload_size      = uncompressed_size;
+        switch (compression) {
+        case ECompressionType::None:
+        case ECompressionType::Deflate:
+            break;
+        case ECompressionType::Heatshrink_11_4:
+        case ECompressionType::Heatshrink_12_4:
+            throw Slic3r::RuntimeError("Unsupported binary G-code.\nHeatshrink compressed blocks are not supported.\n");
+        default:
+            throw Slic3r::RuntimeError("Unsupported binary G-code.\nUnknown compression type " + std::to_string(int(compression)) + ".\n");
+        }
+        if (compression != ECompressionType::None) {
+            reader.read(header + 8, 4);
+            payload_size = le_u32(header + 8);
+            header_size  = 12;
+            // Deflate does not compress better than 1032:1, a larger uncompressed size is a corrupted block header.
+            if (uncompressed_size > uint64_t(payload_size) * 1032 + 64)
+                throw Slic3r::RuntimeError("Invalid binary G-code.\nInvalid block size.\n");
+        }
+
+        unsigned char params[6];
+        const size_t  params_size = type == EBlockType::Thumbnail ? 6 : 2;
+        reader.read(params, params_size);
+
+        // The payload is followed by the checksum.
+        if (size_t(payload_size) + (checksum_type == EChecksumType::CRC32 ? 4 : 0) > reader.remaining())
+            throw Slic3r::RuntimeError("Invalid binary G-code.\nInvalid block size.\n");
+        payload.resize(payload_size);
+        reader.read(payload.data(), payload_size);
+
+        if (checksum_type == EChecksumType::CRC32) {
+            mz_ulong crc = mz_crc32(MZ_CRC32_INIT, header, header_size);
+            crc = mz_crc32(crc, params, params_size);
+            crc = mz_crc32(crc, reinterpret_cast<const unsigned char*>(payload.data()), payload.size());
+            if (uint32_t(crc) != reader.read_u32())
+                throw Slic3r::RuntimeError("Invalid binary G-code.\nBlock checksum mismatch.\n");
+        }
+
+        switch (compression) {
+        case ECompressionType::None:
+            block_data.swap(payload);
+            break;
+        case ECompressionType::Deflate: {
+            block_data.resize(uncompressed_size);
+            mz_ulong size = uncompressed_size;
+            if (mz_uncompress(reinterpret_cast<unsigned char*>(block_data.data()), &size,
+                              reinterpret_cast<const unsigned char*>(payload.data()), mz_ulong(payload.size())) != MZ_OK || size != uncompressed_size)
+                throw Slic3r::RuntimeError("Invalid binary G-code.\nError while decompressing a block.\n");
+            break;
+        }
+        default:
+            // Rejected when reading the block header.
+            assert(false);
+        }
+
+        switch (type) {
+        case EBlockType::FileMetadata:    data.file_metadata    = parse_ini(block_data); break;
+        case EBlockType::PrinterMetadata: data.printer_metadata = parse_ini(block_data); break;
+        case EBlockType::PrintMetadata:   data.print_metadata   = parse_ini(block_data); break;
+        case EBlockType::SlicerMetadata:  data.slicer_metadata  = parse_ini(block_data); break;
+        case EBlockType::Thumbnail: {
+            Thumbnail thumbnail;
+            thumbnail.format = EThumbnailFormat(le_u16(params));
+            thumbnail.width  = le_u16(params + 2);
+            thumbnail.height = le_u16(params + 4);
+            thumbnail.data   = std::move(block_data);
+            data.thumbnails.emplace_back(std::move(thumbnail));
+            break;
+        }
+        case EBlockType::GCode:
+            if (le_u16(params) != GCODE_ENCODING_NONE)
+                throw Slic3r::RuntimeError("Unsupported binary G-code.\nMeatPack encoded G-code blocks are not supported.\n");
+            if (gcode_callback)
+                gcode_callback(block_data.data(), block_data.data() + block_data.size());
+            break;
+        default:
+            throw Slic3r::RuntimeError("Invalid binary G-code.\nUnknown block type.\n");
+        }
+    }
+}
+
+void convert_binary_to_ascii(const std::string &src_path, const std::string &dst_path)
+{
+    FilePtr out{ boost::nowide::fopen(dst_path.c_str(), "wb") };
+    if (out.f == nullptr)
+        throw Slic3r::RuntimeError(std::string("Cannot open file for writing: ") + dst_path + "\n");
+    BinaryData data;
+    read_binary_gcode(src_path, data, [&out](const char *begin, const char *end) {
+        if (::fwrite(begin, 1, end - begin, out.f) != size_t(end - begin))
+            throw Slic3r::RuntimeError("Error while writing the ASCII G-code.\n");
+    });
+}
+
+} // namespace BinaryGCode
+} // namespace Slic3r
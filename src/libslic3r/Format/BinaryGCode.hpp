@@ -0,0 +1,96 @@
+#ifndef slic3r_Format_BinaryGCode_hpp_
+#define slic3r_Format_BinaryGCode_hpp_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Slic3r {
+
+// Binary G-code (.bgcode) following the version 1 of the libbgcode file format specification:
+// a file header followed by blocks of file metadata, printer metadata, thumbnails, print metadata,
+// slicer metadata and finally the G-code itself. Each block may be compressed and protected by a CRC32 checksum.
+//
+// Blocks are written with the Deflate compression and without G-code encoding. Heatshrink compression
+// and MeatPack encoding are recognized when reading, but reported as not supported.
+namespace BinaryGCode {
+
+enum class EBlockType : uint16_t
+{
+    FileMetadata    = 0,
+    GCode           = 1,
+    SlicerMetadata  = 2,
+    PrinterMetadata = 3,
+    PrintMetadata   = 4,
+    Thumbnail       = 5,
+};
+
+enum class ECompressionType : uint16_t
+{
+    None           = 0,
+    Deflate        = 1,
+    Heatshrink_11_4 = 2,
+    Heatshrink_12_4 = 3,
+};
+
+enum class EThumbnailFormat : uint16_t
+{
+    PNG = 0,
+    JPG = 1,
+    QOI = 2,
+};
+
+struct BinarizerConfig
+{
+    ECompressionType metadata_compression { ECompressionType::Deflate };
+    ECompressionType gcode_compression    { ECompressionType::Deflate };
+    // Protect each block by a CRC32 checksum.
+    bool             checksum             { true };
+    // Approximate size of the uncompressed G-code blocks, the G-code is split at line ends.
+    size_t           gcode_block_size     { 65536 };
+};
+
+// Key / value pairs of a metadata block in the order they are stored.
+using Metadata = std::vector<std::pair<std::string, std::string>>;
+
+struct Thumbnail
+{
+    EThumbnailFormat format { EThumbnailFormat::PNG };
+    uint16_t         width  { 0 };
+    uint16_t         height { 0 };
+    std::string      data;
+};
+
+struct BinaryData
+{
+    Metadata               file_metadata;
+    Metadata               printer_metadata;
+    Metadata               print_metadata;
+    Metadata               slicer_metadata;
+    std::vector<Thumbnail> thumbnails;
+};
+
+// Does the file start with the binary G-code file header?
+bool is_binary_gcode_file(const std::string &path);
+
+// Convert an ASCII G-code exported by OrcaSlicer into a binary G-code. The G-code text is stored unchanged,
+// the metadata blocks are filled in from the statistics and the config block stored in the G-code comments
+// and the thumbnails are decoded from their base64 comment blocks.
+// Throws Slic3r::RuntimeError on failure.
+void convert_ascii_to_binary(const std::string &src_path, const std::string &dst_path, const BinarizerConfig &config = {});
+
+// Read a binary G-code, fill in its metadata and thumbnails and pass the text of the G-code blocks to gcode_callback
+// in the order they are stored. gcode_callback may be empty.
+// Throws Slic3r::RuntimeError if the file is not a valid binary G-code or if it uses an unsupported compression or encoding.
+void read_binary_gcode(const std::string &path, BinaryData &data, const std::function<void(const char *begin, const char *end)> &gcode_callback);
+
+// Extract the G-code text stored in a binary G-code into an ASCII G-code file.
+// Throws Slic3r::RuntimeError on failure.
+void convert_binary_to_ascii(const std::string &src_path, const std::string &dst_path);
+
+} // namespace BinaryGCode
+} // namespace Slic3r
+
+#endif // slic3r_Format_BinaryGCode_hpp_
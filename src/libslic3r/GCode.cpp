@@ -21,14 +21,20 @@
 #include "libslic3r/format.hpp"
 #include "Time.hpp"
 #include "GCode/ExtrusionProcessor.hpp"
+#include "Thread.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <cstdlib>
 #include <chrono>
 #include <iostream>
 #include <math.h>
 #include <stdlib.h>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <string_view>
 
@@ -1824,7 +1830,7 @@ bool GCode::is_QIDI_Printer()
     return false;
 }
 
-void GCode::do_export(Print* print, const char* path, GCodeProcessorResult* result, ThumbnailsGeneratorCallback thumbnail_cb)
+void GCode::do_export(Print* print, const char* path, GCodeProcessorResult* result, ThumbnailsGeneratorCallback thumbnail_cb, size_t in_memory_limit)
 {
     PROFILE_CLEAR();
 
@@ -1877,7 +1883,11 @@ void GCode::do_export(Print* print, const char* path, GCodeProcessorResult* resu
 
     m_processor.initialize(path_tmp);
     m_processor.set_print(print);
-    GCodeOutputStream file(boost::nowide::fopen(path_tmp.c_str(), "wb"), m_processor);
+    if (in_memory_limit > 0 && is_on_slow_filesystem(path_tmp)) {
+        BOOST_LOG_TRIVIAL(info) << "G-code is exported to a network or removable drive, it is written while being generated";
+        in_memory_limit = 0;
+    }
+    GCodeOutputStream file(boost::nowide::fopen(path_tmp.c_str(), "wb"), m_processor, in_memory_limit);
     if (! file.is_open()) {
         BOOST_LOG_TRIVIAL(error) << std::string("G-code export to ") + path + " failed.\nCannot open the file for writing.\n" << std::endl;
         if (!fs::exists(folder)) {
@@ -1902,6 +1912,8 @@ void GCode::do_export(Print* print, const char* path, GCodeProcessorResult* resu
         boost::nowide::remove(path_tmp.c_str());
         throw;
     }
+    if (file.is_in_memory())
+        m_processor.set_in_memory_gcode(file.extract_in_memory_gcode());
     file.close();
 
     check_placeholder_parser_failed();
@@ -1970,6 +1982,10 @@ void GCode::do_export(Print* print, const char* path, GCodeProcessorResult* resu
     m_processor.finalize(true);
 //    DoExport::update_print_estimated_times_stats(m_processor, print->m_print_statistics);
     DoExport::update_print_estimated_stats(m_processor, m_writer.extruders(), print->m_print_statistics, print->config());
+    if (const GCodePipelineStats::Stage *bottleneck = m_pipeline_stats.bottleneck(); bottleneck != nullptr)
+        BOOST_LOG_TRIVIAL(info) << "G-code export pipeline finished in " << m_pipeline_stats.wall_time << " s, the slowest stage "
+                                << bottleneck->name << " took " << bottleneck->busy_time << " s";
+    print->m_print_statistics.gcode_pipeline = std::move(m_pipeline_stats);
     if (result != nullptr) {
         *result = std::move(m_processor.extract_result());
         // set the filename to the correct value
@@ -1992,7 +2008,7 @@ void GCode::do_export(Print* print, const char* path, GCodeProcessorResult* resu
     BOOST_LOG_TRIVIAL(info) << "Exporting G-code finished" << log_memory_info();
     print->set_done(psGCodeExport);
     
-    if(is_BBL_Printer())
+    if (is_BBL_Printer() && result != nullptr)
         result->label_object_enabled = m_enable_exclude_object;
     // Write the profiler measurements to file
     PROFILE_UPDATE();
@@ -2246,6 +2262,7 @@ void GCode::_do_export(Print& print, GCodeOutputStream &file, ThumbnailsGenerato
 #endif // ENABLE_GCODE_VIEWER_DATA_CHECKING
 
     m_fan_mover.release();
+    m_pipeline_stats.clear();
     
     m_writer.set_is_bbl_machine(is_bbl_printers);
 
@@ -2905,7 +2922,7 @@ void GCode::_do_export(Print& print, GCodeOutputStream &file, ThumbnailsGenerato
 
     //flush FanMover buffer to avoid modifying the start gcode if it's manual.
     if (!machine_start_gcode.empty() && this->m_fan_mover.get() != nullptr)
-        file.write(this->m_fan_mover.get()->process_gcode("", true));
+        file.write(this->m_fan_mover.get()->process_gcode(GCodeLayerBuffer(), true).format());
 
     // Process filament-specific gcode.
    /* if (has_wipe_tower) {
@@ -3347,6 +3364,120 @@ size_t GCode::get_extruder_id(unsigned int filament_id) const
     return 0;
 }
 
+// Size of the G-code passed between the stages of the G-code export pipeline.
+template<typename T> static size_t pipeline_payload_size(const T &)     { return 0; }
+static size_t pipeline_payload_size(const GCodeLayerBuffer &gcode)      { return gcode.formatted_size(); }
+static size_t pipeline_payload_size(const LayerResult &layer_result)    { return layer_result.gcode.formatted_size(); }
+
+// Measures the stages of a single run of the G-code export pipeline. Each stage records when it started and finished
+// processing a layer, the times are accumulated into GCodePipelineStats once the pipeline finished.
+class GCodePipelineProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    GCodePipelineProfiler(size_t num_layers) : m_num_layers(num_layers), m_start(Clock::now()) {}
+
+    // Wrap the body of a serial_in_order filter. Such a filter receives the layers in order, thus it counts them.
+    template<typename Fn> auto serial_stage(const char *name, Fn fn)
+    {
+        const size_t stage_idx = this->add_stage(name);
+        return [this, stage_idx, fn](auto in) {
+            StageData &stage = *m_stages[stage_idx];
+            return this->measure(stage, stage.next_layer ++, fn, std::move(in));
+        };
+    }
+
+    // Wrap the body of a parallel filter receiving the index of the layer.
+    template<typename Fn> auto parallel_stage(const char *name, Fn fn)
+    {
+        const size_t stage_idx = this->add_stage(name);
+        return [this, stage_idx, fn](size_t layer_idx) {
+            return this->measure(*m_stages[stage_idx], layer_idx, fn, layer_idx);
+        };
+    }
+
+    // To be called after the pipeline finished.
+    void finish(GCodePipelineStats &stats)
+    {
+        stats.wall_time += std::chrono::duration<double>(Clock::now() - m_start).count();
+        ++ stats.pipelines;
+        // Only some of the stages were part of the pipeline. Order them by the time they received the first layer.
+        std::vector<const StageData*> stages;
+        for (const std::unique_ptr<StageData> &stage : m_stages)
+            if (m_num_layers > 0 && stage->end.front() != Clock::time_point())
+                stages.emplace_back(stage.get());
+        std::sort(stages.begin(), stages.end(), [](const StageData *l, const StageData *r) { return l->start.front() < r->start.front(); });
+        for (size_t i = 0; i < stages.size(); ++ i) {
+            const StageData           &data  = *stages[i];
+            GCodePipelineStats::Stage &stage = stats.stage(data.name);
+            for (size_t layer_idx = 0; layer_idx < m_num_layers; ++ layer_idx) {
+                if (data.end[layer_idx] == Clock::time_point())
+                    continue;
+                const double busy_time = std::chrono::duration<double>(data.end[layer_idx] - data.start[layer_idx]).count();
+                ++ stage.layers;
+                stage.busy_time      += busy_time;
+                stage.max_busy_time   = std::max(stage.max_busy_time, busy_time);
+                stage.bytes_out      += data.bytes[layer_idx];
+                stage.max_layer_bytes = std::max(stage.max_layer_bytes, data.bytes[layer_idx]);
+                if (i > 0 && stages[i - 1]->end[layer_idx] != Clock::time_point())
+                    stage.wait_time  += std::max(0., std::chrono::duration<double>(data.start[layer_idx] - stages[i - 1]->end[layer_idx]).count());
+                if (i + 1 == stages.size())
+                    // The output stage.
+                    stats.layer_bytes.emplace_back(data.bytes[layer_idx]);
+            }
+        }
+    }
+
+private:
+    struct StageData
+    {
+        StageData(const char *name, size_t num_layers) : name(name), start(num_layers), end(num_layers), bytes(num_layers, 0) {}
+        std::string                     name;
+        // Indexed by the layer, each layer is written by a single thread only.
+        std::vector<Clock::time_point>  start;
+        std::vector<Clock::time_point>  end;
+        std::vector<size_t>             bytes;
+        // Layer to be processed next by a serial_in_order stage.
+        size_t                          next_layer { 0 };
+    };
+
+    size_t add_stage(const char *name)
+    {
+        m_stages.emplace_back(std::make_unique<StageData>(name, m_num_layers));
+        return m_stages.size() - 1;
+    }
+
+    template<typename Fn, typename In> auto measure(StageData &stage, size_t layer_idx, const Fn &fn, In &&in)
+    {
+        assert(layer_idx < m_num_layers);
+        const Clock::time_point start = Clock::now();
+        if constexpr (std::is_void_v<std::invoke_result_t<const Fn&, In&&>>) {
+            // The output stage, report the size of its input.
+            const size_t bytes = pipeline_payload_size(in);
+            fn(std::forward<In>(in));
+            this->record(stage, layer_idx, start, bytes);
+        } else {
+            auto out = fn(std::forward<In>(in));
+            this->record(stage, layer_idx, start, pipeline_payload_size(out));
+            return out;
+        }
+    }
+
+    void record(StageData &stage, size_t layer_idx, Clock::time_point start, size_t bytes)
+    {
+        if (layer_idx < m_num_layers) {
+            stage.start[layer_idx] = start;
+            stage.end[layer_idx]   = Clock::now();
+            stage.bytes[layer_idx] = bytes;
+        }
+    }
+
+    size_t                                  m_num_layers;
+    Clock::time_point                       m_start;
+    std::vector<std::unique_ptr<StageData>> m_stages;
+};
+
 // Process all layers of all objects (non-sequential mode) with a parallel pipeline:
 // Generate G-code, run the filters (vase mode, cooling buffer), run the G-code analyser
 // and export G-code into file.
@@ -3358,67 +3489,80 @@ void GCode::process_layers(
     GCodeOutputStream                                                   &output_stream)
 {
     // The pipeline is variable: The vase mode filter is optional.
+    // Pressure equalizer need insert empty input. Because it returns one layer back.
+    const size_t num_layers_to_generate = layers_to_print.size() + (m_pressure_equalizer ? 1 : 0);
+    GCodePipelineProfiler profiler(num_layers_to_generate);
     size_t layer_to_print_idx = 0;
-    const auto generator = tbb::make_filter<void, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
-        [this, &print, &tool_ordering, &print_object_instances_ordering, &layers_to_print, &layer_to_print_idx](tbb::flow_control& fc) -> LayerResult {
-            if (layer_to_print_idx >= layers_to_print.size()) {
-                if (layer_to_print_idx == layers_to_print.size() + (m_pressure_equalizer ? 1 : 0)) {
-                    fc.stop();
-                    return {};
-                } else {
-                    // Pressure equalizer need insert empty input. Because it returns one layer back.
-                    // Insert NOP (no operation) layer;
-                    ++layer_to_print_idx;
-                    return LayerResult::make_nop_layer_result();
-                }
+    const auto layer_source = tbb::make_filter<void, size_t>(slic3r_tbb_filtermode::serial_in_order,
+        [&layer_to_print_idx, num_layers_to_generate](tbb::flow_control& fc) -> size_t {
+            if (layer_to_print_idx == num_layers_to_generate) {
+                fc.stop();
+                return 0;
+            }
+            return layer_to_print_idx ++;
+        });
+    // Calculate the part of process_layer() not depending on the G-code generator state for several layers in parallel.
+    const auto layer_preparation = tbb::make_filter<size_t, std::pair<size_t, PreparedLayer>>(slic3r_tbb_filtermode::parallel,
+        profiler.parallel_stage("prepare_layer", [&print, &tool_ordering, &print_object_instances_ordering, &layers_to_print](size_t layer_idx) -> std::pair<size_t, PreparedLayer> {
+            return { layer_idx, layer_idx < layers_to_print.size() ?
+                prepare_layer(print, layers_to_print[layer_idx].second, tool_ordering.tools_for_layer(layers_to_print[layer_idx].first),
+                    &print_object_instances_ordering, size_t(-1)) :
+                PreparedLayer{} };
+        }));
+    const auto generator = tbb::make_filter<std::pair<size_t, PreparedLayer>, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
+        profiler.serial_stage("process_layer", [this, &print, &tool_ordering, &print_object_instances_ordering, &layers_to_print](std::pair<size_t, PreparedLayer> in) -> LayerResult {
+            if (in.first >= layers_to_print.size()) {
+                // Insert NOP (no operation) layer;
+                return LayerResult::make_nop_layer_result();
             } else {
-                const std::pair<coordf_t, std::vector<LayerToPrint>>& layer = layers_to_print[layer_to_print_idx++];
+                const std::pair<coordf_t, std::vector<LayerToPrint>>& layer = layers_to_print[in.first];
                 const LayerTools& layer_tools = tool_ordering.tools_for_layer(layer.first);
-                print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(layer_to_print_idx)));
+                print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(in.first + 1)));
                 if (m_wipe_tower && layer_tools.has_wipe_tower)
                     m_wipe_tower->next_layer();
                 //BBS
                 check_placeholder_parser_failed();
                 print.throw_if_canceled();
-                return this->process_layer(print, layer.second, layer_tools, &layer == &layers_to_print.back(), &print_object_instances_ordering, tool_ordering.get_most_used_extruder(), size_t(-1));
+                return this->process_layer(print, layer.second, layer_tools, &layer == &layers_to_print.back(), &print_object_instances_ordering, tool_ordering.get_most_used_extruder(), size_t(-1), false, &in.second);
             }
-        });
+        }));
     if (m_spiral_vase) {
         float nozzle_diameter  = EXTRUDER_CONFIG(nozzle_diameter);
         float max_xy_smoothing = m_config.get_abs_value("spiral_mode_max_xy_smoothing", nozzle_diameter);
         this->m_spiral_vase->set_max_xy_smoothing(max_xy_smoothing);
     }
     const auto spiral_mode = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
-        [&spiral_mode = *this->m_spiral_vase.get(), &layers_to_print](LayerResult in) -> LayerResult {
+        profiler.serial_stage("spiral_vase", [&spiral_mode = *this->m_spiral_vase.get(), &layers_to_print](LayerResult in) -> LayerResult {
         	if (in.nop_layer_result)
                 return in;
                 
             spiral_mode.enable(in.spiral_vase_enable);
             bool last_layer = in.layer_id == layers_to_print.size() - 1;
-            return { spiral_mode.process_layer(std::move(in.gcode), last_layer), in.layer_id, in.spiral_vase_enable, in.cooling_buffer_flush};
-        });
+            spiral_mode.process_layer(in.gcode, last_layer);
+            return in;
+        }));
     const auto pressure_equalizer = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
-        [pressure_equalizer = this->m_pressure_equalizer.get()](LayerResult in) -> LayerResult {
+        profiler.serial_stage("pressure_equalizer", [pressure_equalizer = this->m_pressure_equalizer.get()](LayerResult in) -> LayerResult {
             return pressure_equalizer->process_layer(std::move(in));
-        });
-    const auto cooling = tbb::make_filter<LayerResult, std::string>(slic3r_tbb_filtermode::serial_in_order,
-        [&cooling_buffer = *this->m_cooling_buffer.get()](LayerResult in) -> std::string {
+        }));
+    const auto cooling = tbb::make_filter<LayerResult, GCodeLayerBuffer>(slic3r_tbb_filtermode::serial_in_order,
+        profiler.serial_stage("cooling_buffer", [&cooling_buffer = *this->m_cooling_buffer.get()](LayerResult in) -> GCodeLayerBuffer {
         	if (in.nop_layer_result)
-                return in.gcode;
+                return std::move(in.gcode);
             return cooling_buffer.process_layer(std::move(in.gcode), in.layer_id, in.cooling_buffer_flush);
-        });
-    const auto pa_processor_filter = tbb::make_filter<std::string, std::string>(slic3r_tbb_filtermode::serial_in_order,
-            [&pa_processor = *this->m_pa_processor](std::string in) -> std::string {
+        }));
+    const auto pa_processor_filter = tbb::make_filter<GCodeLayerBuffer, GCodeLayerBuffer>(slic3r_tbb_filtermode::serial_in_order,
+            profiler.serial_stage("adaptive_pa", [&pa_processor = *this->m_pa_processor](GCodeLayerBuffer in) -> GCodeLayerBuffer {
                 return pa_processor.process_layer(std::move(in));
-            }
+            })
         );
     
-    const auto output = tbb::make_filter<std::string, void>(slic3r_tbb_filtermode::serial_in_order,
-        [&output_stream](std::string s) { output_stream.write(s); }
+    const auto output = tbb::make_filter<GCodeLayerBuffer, void>(slic3r_tbb_filtermode::serial_in_order,
+        profiler.serial_stage("output", [&output_stream](GCodeLayerBuffer s) { output_stream.write(s.format()); })
     );
 
-    const auto fan_mover = tbb::make_filter<std::string, std::string>(slic3r_tbb_filtermode::serial_in_order,
-            [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](std::string in)->std::string {
+    const auto fan_mover = tbb::make_filter<GCodeLayerBuffer, GCodeLayerBuffer>(slic3r_tbb_filtermode::serial_in_order,
+            profiler.serial_stage("fan_mover", [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](GCodeLayerBuffer in)->GCodeLayerBuffer {
 
         CNumericLocalesSetter locales_setter;
 
@@ -3432,20 +3576,21 @@ void GCode::process_layers(
                     config.fan_speedup_overhangs.value,
                     (float)config.fan_kickstart.value));
             //flush as it's a whole layer
-            return fan_mover->process_gcode(in, true);
+            return fan_mover->process_gcode(std::move(in), true);
         }
         return in;
-    });
+    }));
 
     // The pipeline elements are joined using const references, thus no copying is performed.
     if (m_spiral_vase && m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
+        tbb::parallel_pipeline(12, layer_source & layer_preparation & generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
     else if (m_spiral_vase)
-    	tbb::parallel_pipeline(12, generator & spiral_mode & cooling & fan_mover & output);
+    	tbb::parallel_pipeline(12, layer_source & layer_preparation & generator & spiral_mode & cooling & fan_mover & output);
     else if	(m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
+        tbb::parallel_pipeline(12, layer_source & layer_preparation & generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
     else
-    	tbb::parallel_pipeline(12, generator & cooling & fan_mover & pa_processor_filter & output);
+    	tbb::parallel_pipeline(12, layer_source & layer_preparation & generator & cooling & fan_mover & pa_processor_filter & output);
+    profiler.finish(m_pipeline_stats);
 
 }
 
@@ -3462,63 +3607,76 @@ void GCode::process_layers(
     const bool                               prime_extruder)
 {
     // The pipeline is variable: The vase mode filter is optional.
+    // Pressure equalizer need insert empty input. Because it returns one layer back.
+    const size_t num_layers_to_generate = layers_to_print.size() + (m_pressure_equalizer ? 1 : 0);
+    GCodePipelineProfiler profiler(num_layers_to_generate);
     size_t layer_to_print_idx = 0;
-    const auto generator = tbb::make_filter<void, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
-        [this, &print, &tool_ordering, &layers_to_print, &layer_to_print_idx, single_object_idx, prime_extruder](tbb::flow_control& fc) -> LayerResult {
-            if (layer_to_print_idx >= layers_to_print.size()) {
-                if (layer_to_print_idx == layers_to_print.size() + (m_pressure_equalizer ? 1 : 0)) {
-                    fc.stop();
-                    return {};
-                } else {
-                    // Pressure equalizer need insert empty input. Because it returns one layer back.
-                    // Insert NOP (no operation) layer;
-                    ++layer_to_print_idx;
-                    return LayerResult::make_nop_layer_result();
-                }
+    const auto layer_source = tbb::make_filter<void, size_t>(slic3r_tbb_filtermode::serial_in_order,
+        [&layer_to_print_idx, num_layers_to_generate](tbb::flow_control& fc) -> size_t {
+            if (layer_to_print_idx == num_layers_to_generate) {
+                fc.stop();
+                return 0;
+            }
+            return layer_to_print_idx ++;
+        });
+    // Calculate the part of process_layer() not depending on the G-code generator state for several layers in parallel.
+    const auto layer_preparation = tbb::make_filter<size_t, std::pair<size_t, PreparedLayer>>(slic3r_tbb_filtermode::parallel,
+        profiler.parallel_stage("prepare_layer", [&print, &tool_ordering, &layers_to_print, single_object_idx](size_t layer_idx) -> std::pair<size_t, PreparedLayer> {
+            return { layer_idx, layer_idx < layers_to_print.size() ?
+                prepare_layer(print, { layers_to_print[layer_idx] }, tool_ordering.tools_for_layer(layers_to_print[layer_idx].print_z()),
+                    nullptr, single_object_idx) :
+                PreparedLayer{} };
+        }));
+    const auto generator = tbb::make_filter<std::pair<size_t, PreparedLayer>, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
+        profiler.serial_stage("process_layer", [this, &print, &tool_ordering, &layers_to_print, single_object_idx, prime_extruder](std::pair<size_t, PreparedLayer> in) -> LayerResult {
+            if (in.first >= layers_to_print.size()) {
+                // Insert NOP (no operation) layer;
+                return LayerResult::make_nop_layer_result();
             } else {
-                LayerToPrint &layer = layers_to_print[layer_to_print_idx ++];
-                print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(layer_to_print_idx)));
+                LayerToPrint &layer = layers_to_print[in.first];
+                print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(in.first + 1)));
                 //BBS
                 check_placeholder_parser_failed();
                 print.throw_if_canceled();
-                return this->process_layer(print, { std::move(layer) }, tool_ordering.tools_for_layer(layer.print_z()), &layer == &layers_to_print.back(), nullptr, tool_ordering.get_most_used_extruder(), single_object_idx, prime_extruder);
+                return this->process_layer(print, { std::move(layer) }, tool_ordering.tools_for_layer(layer.print_z()), &layer == &layers_to_print.back(), nullptr, tool_ordering.get_most_used_extruder(), single_object_idx, prime_extruder, &in.second);
             }
-        });
+        }));
     if (m_spiral_vase) {
         float nozzle_diameter  = EXTRUDER_CONFIG(nozzle_diameter);
         float max_xy_smoothing = m_config.get_abs_value("spiral_mode_max_xy_smoothing", nozzle_diameter);
         this->m_spiral_vase->set_max_xy_smoothing(max_xy_smoothing);
     }
     const auto spiral_mode = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
-        [&spiral_mode = *this->m_spiral_vase.get(), &layers_to_print](LayerResult in)->LayerResult {
+        profiler.serial_stage("spiral_vase", [&spiral_mode = *this->m_spiral_vase.get(), &layers_to_print](LayerResult in)->LayerResult {
             if (in.nop_layer_result)
                 return in;
             spiral_mode.enable(in.spiral_vase_enable);
             bool last_layer = in.layer_id == layers_to_print.size() - 1;
-            return { spiral_mode.process_layer(std::move(in.gcode), last_layer), in.layer_id, in.spiral_vase_enable, in.cooling_buffer_flush };
-        });
+            spiral_mode.process_layer(in.gcode, last_layer);
+            return in;
+        }));
     const auto pressure_equalizer = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
-        [pressure_equalizer = this->m_pressure_equalizer.get()](LayerResult in) -> LayerResult {
+        profiler.serial_stage("pressure_equalizer", [pressure_equalizer = this->m_pressure_equalizer.get()](LayerResult in) -> LayerResult {
              return pressure_equalizer->process_layer(std::move(in));
-        });
-    const auto cooling = tbb::make_filter<LayerResult, std::string>(slic3r_tbb_filtermode::serial_in_order,
-        [&cooling_buffer = *this->m_cooling_buffer.get()](LayerResult in)->std::string {
+        }));
+    const auto cooling = tbb::make_filter<LayerResult, GCodeLayerBuffer>(slic3r_tbb_filtermode::serial_in_order,
+        profiler.serial_stage("cooling_buffer", [&cooling_buffer = *this->m_cooling_buffer.get()](LayerResult in)->GCodeLayerBuffer {
             if (in.nop_layer_result)
-                return in.gcode;
+                return std::move(in.gcode);
             return cooling_buffer.process_layer(std::move(in.gcode), in.layer_id, in.cooling_buffer_flush);
-        });
-    const auto pa_processor_filter = tbb::make_filter<std::string, std::string>(slic3r_tbb_filtermode::serial_in_order,
-        [&pa_processor = *this->m_pa_processor](std::string in) -> std::string {
+        }));
+    const auto pa_processor_filter = tbb::make_filter<GCodeLayerBuffer, GCodeLayerBuffer>(slic3r_tbb_filtermode::serial_in_order,
+        profiler.serial_stage("adaptive_pa", [&pa_processor = *this->m_pa_processor](GCodeLayerBuffer in) -> GCodeLayerBuffer {
             return pa_processor.process_layer(std::move(in));
-        }
+        })
     );
     
-    const auto output = tbb::make_filter<std::string, void>(slic3r_tbb_filtermode::serial_in_order,
-        [&output_stream](std::string s) { output_stream.write(s); }
+    const auto output = tbb::make_filter<GCodeLayerBuffer, void>(slic3r_tbb_filtermode::serial_in_order,
+        profiler.serial_stage("output", [&output_stream](GCodeLayerBuffer s) { output_stream.write(s.format()); })
     );
 
-    const auto fan_mover = tbb::make_filter<std::string, std::string>(slic3r_tbb_filtermode::serial_in_order,
-        [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](std::string in)->std::string {
+    const auto fan_mover = tbb::make_filter<GCodeLayerBuffer, GCodeLayerBuffer>(slic3r_tbb_filtermode::serial_in_order,
+        profiler.serial_stage("fan_mover", [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](GCodeLayerBuffer in)->GCodeLayerBuffer {
 
         if (config.fan_speedup_time.value != 0 || config.fan_kickstart.value > 0) {
             if (fan_mover.get() == nullptr)
@@ -3530,20 +3688,21 @@ void GCode::process_layers(
                     config.fan_speedup_overhangs.value,
                     (float)config.fan_kickstart.value));
             //flush as it's a whole layer
-            return fan_mover->process_gcode(in, true);
+            return fan_mover->process_gcode(std::move(in), true);
         }
         return in;
-    });
+    }));
 
     // The pipeline elements are joined using const references, thus no copying is performed.
     if (m_spiral_vase && m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
+        tbb::parallel_pipeline(12, layer_source & layer_preparation & generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
     else if (m_spiral_vase)
-    	tbb::parallel_pipeline(12, generator & spiral_mode & cooling & fan_mover & output);
+    	tbb::parallel_pipeline(12, layer_source & layer_preparation & generator & spiral_mode & cooling & fan_mover & output);
     else if	(m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
+        tbb::parallel_pipeline(12, layer_source & layer_preparation & generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
     else
-    	tbb::parallel_pipeline(12, generator & cooling & fan_mover & pa_processor_filter & output);
+    	tbb::parallel_pipeline(12, layer_source & layer_preparation & generator & cooling & fan_mover & pa_processor_filter & output);
+    profiler.finish(m_pipeline_stats);
 }
 
 std::string GCode::placeholder_parser_process(const std::string &name, const std::string &templ, unsigned int current_filament_id, const DynamicConfig *config_override)
@@ -4134,161 +4293,446 @@ std::string GCode::generate_skirt(const Print &print,
     return gcode;
 }
 
-// In sequential mode, process_layer is called once per each object and its copy,
-// therefore layers will contain a single entry and single_object_instance_idx will point to the copy of the object.
-// In non-sequential mode, process_layer is called per each print_z height with all object and support layers accumulated.
-// For multi-material prints, this routine minimizes extruder switches by gathering extruder specific extrusion paths
-// and performing the extruder specific extrusions together.
-LayerResult GCode::process_layer(
-    const Print                    			&print,
-    // Set of object & print layers of the same PrintObject and with the same print_z.
-    const std::vector<LayerToPrint> 		&layers,
-    const LayerTools        		        &layer_tools,
-    const bool                               last_layer,
-    // Pairs of PrintObject index and its instance index.
+// Calculates the part of process_layer() not depending on the state of the G-code generator: The AABB trees used by
+// the overhang speed estimator and by the avoid crossing perimeters, and the grouping of the extrusions by an extruder,
+// by an object, an island and a region with the order of the object instances to be printed.
+GCode::PreparedLayer GCode::prepare_layer(
+    const Print                             &print,
+    const std::vector<LayerToPrint>         &layers,
+    const LayerTools                        &layer_tools,
     const std::vector<const PrintInstance*> *ordering,
-    const int                               most_used_extruder,
-    // If set to size_t(-1), then print all copies of all objects.
-    // Otherwise print a single copy of a single object.
-    const size_t                     		 single_object_instance_idx,
-    // BBS
-    const bool                               prime_extruder)
+    const size_t                             single_object_instance_idx)
 {
-    assert(! layers.empty());
-    // Either printing all copies of all objects, or just a single copy of a single object.
-    assert(single_object_instance_idx == size_t(-1) || layers.size() == 1);
-
-    // First object, support and raft layer, if available.
-    const Layer         *object_layer  = nullptr;
-    const SupportLayer  *support_layer = nullptr;
-    const SupportLayer  *raft_layer    = nullptr;
-    for (const LayerToPrint &l : layers) {
-        if (l.object_layer && ! object_layer)
-            object_layer = l.object_layer;
-        if (l.support_layer) {
-            if (! support_layer)
-                support_layer = l.support_layer;
-            if (! raft_layer && support_layer->id() < support_layer->object()->slicing_parameters().raft_layers())
-                raft_layer = support_layer;
+    PreparedLayer out;
+    out.overhang_boundaries.reserve(layers.size());
+    out.travel_boundaries.reserve(layers.size());
+    for (const LayerToPrint &layer_to_print : layers) {
+        std::optional<ExtrusionQualityEstimator::LayerBoundaries> boundaries;
+        if (layer_to_print.object_layer) {
+            const auto& regions = layer_to_print.object_layer->regions();
+            const bool  enable_overhang_speed = std::any_of(regions.begin(), regions.end(), [](const LayerRegion* r) {
+                return r->has_extrusions() && r->region().config().enable_overhang_speed;
+            });
+            if (enable_overhang_speed)
+                boundaries = ExtrusionQualityEstimator::build_layer_boundaries(*layer_to_print.object_layer);
         }
+        out.overhang_boundaries.emplace_back(std::move(boundaries));
+        // Boundaries of the layer owning PrintObject are cached there, thus reused by a G-code export of a shared object
+        // and by the next G-code export.
+        const Layer *layer = layer_to_print.layer();
+        out.travel_boundaries.emplace_back(layer && layer->object()->print()->config().reduce_crossing_wall ?
+            layer->object()->travel_boundaries_cache().get(*layer) : nullptr);
     }
 
-    const Layer* layer_ptr = nullptr;
-    if (object_layer != nullptr)
-        layer_ptr = object_layer;
-    else if (support_layer != nullptr)
-        layer_ptr = support_layer;
-    const Layer& layer = *layer_ptr;
-    LayerResult   result { {}, layer.id(), false, last_layer };
     if (layer_tools.extruders.empty())
         // Nothing to extrude.
-        return result;
-
-    // Extract 1st object_layer and support_layer of this set of layers with an equal print_z.
-    coordf_t             print_z       = layer.print_z;
-    //BBS: using layer id to judge whether the layer is first layer is wrong. Because if the normal
-    //support is attached above the object, and support layers has independent layer height, then the lowest support
-    //interface layer id is 0.
-    bool                 first_layer   = (layer.id() == 0 && abs(layer.bottom_z()) < EPSILON);
-    m_writer.set_is_first_layer(first_layer);
-    unsigned int         first_extruder_id = layer_tools.extruders.front();
+        return out;
+    const unsigned int first_extruder_id = layer_tools.extruders.front();
 
-    // Initialize config with the 1st object to be printed at this layer.
-    m_config.apply(layer.object()->config(), true);
+    // Group extrusions by an extruder, then by an object, an island and a region.
+    // The ObjectByExtruder instances are referenced by the InstanceToPrint instances, they are not moved
+    // when the PreparedLayer is moved.
+    std::map<unsigned int, std::vector<ObjectByExtruder>> &by_extruder = out.by_extruder;
+    const bool is_anything_overridden = const_cast<LayerTools&>(layer_tools).wiping_extrusions().is_anything_overridden();
+    out.is_anything_overridden = is_anything_overridden;
+    for (const LayerToPrint &layer_to_print : layers) {
+        if (layer_to_print.support_layer != nullptr) {
+            const SupportLayer &support_layer = *layer_to_print.support_layer;
+            const PrintObject& object = *layer_to_print.original_object;
+            if (! support_layer.support_fills.entities.empty()) {
+                ExtrusionRole   role               = support_layer.support_fills.role();
+                bool            has_support        = role == erMixed || role == erSupportMaterial || role == erSupportTransition;
+                bool            has_interface      = role == erMixed || role == erSupportMaterialInterface;
+                // Extruder ID of the support base. -1 if "don't care".
+                unsigned int    support_extruder   = object.config().support_filament.value - 1;
+                // Shall the support be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
+                bool            support_dontcare   = object.config().support_filament.value == 0;
+                // Extruder ID of the support interface. -1 if "don't care".
+                unsigned int    interface_extruder = object.config().support_interface_filament.value - 1;
+                // Shall the support interface be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
+                bool            interface_dontcare = object.config().support_interface_filament.value == 0;
 
-    // Check whether it is possible to apply the spiral vase logic for this layer.
-    // Just a reminder: A spiral vase mode is allowed for a single object, single material print only.
-    m_enable_loop_clipping = true;
-    if (m_spiral_vase && layers.size() == 1 && support_layer == nullptr) {
-        bool enable = (layer.id() > 0 || !print.has_brim()) && (layer.id() >= (size_t)print.config().skirt_height.value && ! print.has_infinite_skirt());
-        if (enable) {
-            for (const LayerRegion *layer_region : layer.regions())
-                if (size_t(layer_region->region().config().bottom_shell_layers.value) > layer.id() ||
-                    layer_region->perimeters.items_count() > 1u ||
-                    layer_region->fills.items_count() > 0) {
-                    enable = false;
-                    break;
+                // BBS: apply wiping overridden extruders
+                WipingExtrusions& wiping_extrusions = const_cast<LayerTools&>(layer_tools).wiping_extrusions();
+                if (support_dontcare) {
+                    int extruder_override = wiping_extrusions.get_support_extruder_overrides(&object);
+                    if (extruder_override >= 0) {
+                        support_extruder = extruder_override;
+                        support_dontcare = false;
+                    }
                 }
-        }
-        result.spiral_vase_enable = enable;
-        // If we're going to apply spiralvase to this layer, disable loop clipping.
-        m_enable_loop_clipping = !enable;
-    }
-
-    std::string gcode;
-    assert(is_decimal_separator_point()); // for the sprintfs
-
-    // add tag for processor
-    gcode += ";" + GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Layer_Change) + "\n";
-    // export layer z
-    char buf[64];
-    sprintf(buf, print.is_BBL_printer() ? "; Z_HEIGHT: %g\n" : ";Z:%g\n", print_z);
-    gcode += buf;
-    // export layer height
-    float height = first_layer ? static_cast<float>(print_z) : static_cast<float>(print_z) - m_last_layer_z;
-    sprintf(buf, ";%s%g\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Height).c_str(), height);
-    gcode += buf;
-    // update caches
-    m_last_layer_z = static_cast<float>(print_z);
-    m_max_layer_z  = std::max(m_max_layer_z, m_last_layer_z);
-    m_last_height = height;
-
-    // Set new layer - this will change Z and force a retraction if retract_when_changing_layer is enabled.
-    if (! m_config.before_layer_change_gcode.value.empty()) {
-        DynamicConfig config;
-        config.set_key_value("layer_num",   new ConfigOptionInt(m_layer_index + 1));
-        config.set_key_value("layer_z",     new ConfigOptionFloat(print_z));
-        config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
-        gcode += this->placeholder_parser_process("before_layer_change_gcode",
-            print.config().before_layer_change_gcode.value, m_writer.filament()->id(), &config)
-            + "\n";
-    }
-
-    PrinterStructure printer_structure           = m_config.printer_structure.value;
-    PrintSequence print_sequence = m_config.print_sequence;
-    bool sequence_by_layer = print_sequence == PrintSequence::ByLayer;
-    bool is_i3_printer = printer_structure == PrinterStructure::psI3;
-    bool is_multi_extruder = m_config.nozzle_diameter.size() > 1;
-
-    bool need_insert_timelapse_gcode_for_traditional = false;
-    if ((!m_wipe_tower || !m_wipe_tower->enable_timelapse_print()) && (is_BBL_Printer() || !m_config.time_lapse_gcode.value.empty())) {
-        need_insert_timelapse_gcode_for_traditional = ((is_i3_printer && !m_spiral_vase) || is_multi_extruder);
-    }
-
-    bool has_insert_timelapse_gcode = false;
-    bool has_wipe_tower             = (layer_tools.has_wipe_tower && m_wipe_tower);
 
+                if (interface_dontcare) {
+                    int extruder_override = wiping_extrusions.get_support_interface_extruder_overrides(&object);
+                    if (extruder_override >= 0) {
+                        interface_extruder = extruder_override;
+                        interface_dontcare = false;
+                    }
+                }
 
-    ZHopType z_hope_type = ZHopType(FILAMENT_CONFIG(z_hop_types));
-    LiftType auto_lift_type = LiftType::NormalLift;
-    if (z_hope_type == ZHopType::zhtAuto || z_hope_type == ZHopType::zhtSpiral || z_hope_type == ZHopType::zhtSlope)
-        auto_lift_type = LiftType::SpiralLift;
+                // BBS: try to print support base with a filament other than interface filament
+                if (support_dontcare && !interface_dontcare) {
+                    unsigned int dontcare_extruder = first_extruder_id;
+                    for (unsigned int extruder_id : layer_tools.extruders) {
+                        if (print.config().filament_soluble.get_at(extruder_id))
+                            continue;
 
-    // BBS: don't use lazy_raise when enable spiral vase
-    gcode += this->change_layer(print_z);  // this will increase m_layer_index
-    m_layer = &layer;
-    m_object_layer_over_raft = false;
+                        //BBS: now we don't consider interface filament used in other object
+                        if (extruder_id == interface_extruder)
+                            continue;
 
-    if (!m_config.time_lapse_gcode.value.empty() && !is_BBL_Printer()) {
-        DynamicConfig config;
-        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
-        config.set_key_value("layer_z", new ConfigOptionFloat(print_z));
-        config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
-        gcode += this->placeholder_parser_process("timelapse_gcode",
-             print.config().time_lapse_gcode.value, m_writer.filament()->id(), &config)
-             + "\n";
-    }
+                        dontcare_extruder = extruder_id;
+                        break;
+                    }
+                #if 0
+                    //BBS: not found a suitable extruder in current layer ,dontcare_extruider==first_extruder_id==interface_extruder
+                    if (dontcare_extruder == interface_extruder && (object.config().support_interface_not_for_body && object.config().support_interface_filament.value!=0)) {
+                        // BBS : get a suitable extruder from other layer
+                        auto all_extruders = print.extruders();
+                        dontcare_extruder = get_next_extruder(dontcare_extruder, all_extruders);
+                    }
+                #endif
 
-    if (!m_config.layer_change_gcode.value.empty()) {
-        DynamicConfig config;
-        config.set_key_value("most_used_physical_extruder_id", new ConfigOptionInt(m_config.physical_extruder_map.get_at(most_used_extruder)));
-        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
-        config.set_key_value("layer_z",   new ConfigOptionFloat(print_z));
-        gcode += this->placeholder_parser_process("layer_change_gcode",
-            print.config().layer_change_gcode.value, m_writer.filament()->id(), &config)
-            + "\n";
-        config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
-    }
+                    if (support_dontcare)
+                        support_extruder = dontcare_extruder;
+                }
+                else if (support_dontcare || interface_dontcare) {
+                    // Some support will be printed with "don't care" material, preferably non-soluble.
+                    // Is the current extruder assigned a soluble filament?
+                    unsigned int dontcare_extruder = first_extruder_id;
+                    if (print.config().filament_soluble.get_at(dontcare_extruder)) {
+                        // The last extruder printed on the previous layer extrudes soluble filament.
+                        // Try to find a non-soluble extruder on the same layer.
+                        for (unsigned int extruder_id : layer_tools.extruders)
+                            if (! print.config().filament_soluble.get_at(extruder_id)) {
+                                dontcare_extruder = extruder_id;
+                                break;
+                            }
+                    }
+                    if (print.config().filament_is_support.get_at(dontcare_extruder)) {
+                        // The last extruder printed on the previous layer extrudes support filament.
+                        // Try to find a non-support extruder on the same layer.
+                        for (unsigned int extruder_id : layer_tools.extruders)
+                            if (!print.config().filament_is_support.get_at(extruder_id)) {
+                                dontcare_extruder = extruder_id;
+                                break;
+                            }
+                    }
+                    if (support_dontcare)
+                        support_extruder = dontcare_extruder;
+                    if (interface_dontcare)
+                        interface_extruder = dontcare_extruder;
+                }
+                // Both the support and the support interface are printed with the same extruder, therefore
+                // the interface may be interleaved with the support base.
+                bool single_extruder = ! has_support || support_extruder == interface_extruder;
+                // Assign an extruder to the base.
+                ObjectByExtruder &obj = object_by_extruder(by_extruder, has_support ? support_extruder : interface_extruder, &layer_to_print - layers.data(), layers.size());
+                obj.support = &support_layer.support_fills;
+                obj.support_extrusion_role = single_extruder ? erMixed : erSupportMaterial;
+                if (! single_extruder && has_interface) {
+                    ObjectByExtruder &obj_interface = object_by_extruder(by_extruder, interface_extruder, &layer_to_print - layers.data(), layers.size());
+                    obj_interface.support = &support_layer.support_fills;
+                    obj_interface.support_extrusion_role = erSupportMaterialInterface;
+                }
+            }
+        }
+
+        if (layer_to_print.object_layer != nullptr) {
+            const Layer &layer = *layer_to_print.object_layer;
+            // We now define a strategy for building perimeters and fills. The separation
+            // between regions doesn't matter in terms of printing order, as we follow
+            // another logic instead:
+            // - we group all extrusions by extruder so that we minimize toolchanges
+            // - we start from the last used extruder
+            // - for each extruder, we group extrusions by island
+            // - for each island, we extrude perimeters first, unless user set the infill_first
+            //   option
+            // (Still, we have to keep track of regions because we need to apply their config)
+            size_t n_slices = layer.lslices.size();
+            const std::vector<BoundingBox> &layer_surface_bboxes = layer.lslices_bboxes;
+            // Traverse the slices in an increasing order of bounding box size, so that the islands inside another islands are tested first,
+            // so we can just test a point inside ExPolygon::contour and we may skip testing the holes.
+            std::vector<size_t> slices_test_order;
+            slices_test_order.reserve(n_slices);
+            for (size_t i = 0; i < n_slices; ++ i)
+                slices_test_order.emplace_back(i);
+            std::sort(slices_test_order.begin(), slices_test_order.end(), [&layer_surface_bboxes](size_t i, size_t j) {
+                const Vec2d s1 = layer_surface_bboxes[i].size().cast<double>();
+                const Vec2d s2 = layer_surface_bboxes[j].size().cast<double>();
+                return s1.x() * s1.y() < s2.x() * s2.y();
+            });
+            auto point_inside_surface = [&layer, &layer_surface_bboxes](const size_t i, const Point &point) {
+                const BoundingBox &bbox = layer_surface_bboxes[i];
+                return point(0) >= bbox.min(0) && point(0) < bbox.max(0) &&
+                       point(1) >= bbox.min(1) && point(1) < bbox.max(1) &&
+                       layer.lslices[i].contour.contains(point);
+            };
+
+            for (size_t region_id = 0; region_id < layer.regions().size(); ++ region_id) {
+                const LayerRegion *layerm = layer.regions()[region_id];
+                if (layerm == nullptr)
+                    continue;
+                // PrintObjects own the PrintRegions, thus the pointer to PrintRegion would be unique to a PrintObject, they would not
+                // identify the content of PrintRegion accross the whole print uniquely. Translate to a Print specific PrintRegion.
+                const PrintRegion &region = print.get_print_region(layerm->region().print_region_id());
+
+                // Now we must process perimeters and infills and create islands of extrusions in by_region std::map.
+                // It is also necessary to save which extrusions are part of MM wiping and which are not.
+                // The process is almost the same for perimeters and infills - we will do it in a cycle that repeats twice:
+                std::vector<unsigned int> printing_extruders;
+                for (const ObjectByExtruder::Island::Region::Type entity_type : { ObjectByExtruder::Island::Region::INFILL, ObjectByExtruder::Island::Region::PERIMETERS }) {
+                    for (const ExtrusionEntity *ee : (entity_type == ObjectByExtruder::Island::Region::INFILL) ? layerm->fills.entities : layerm->perimeters.entities) {
+                        // extrusions represents infill or perimeter extrusions of a single island.
+                        assert(dynamic_cast<const ExtrusionEntityCollection*>(ee) != nullptr);
+                        const auto *extrusions = static_cast<const ExtrusionEntityCollection*>(ee);
+                        if (extrusions->entities.empty()) // This shouldn't happen but first_point() would fail.
+                            continue;
+
+                        // This extrusion is part of certain Region, which tells us which extruder should be used for it:
+                        int correct_extruder_id = layer_tools.extruder(*extrusions, region);
+
+                        // Let's recover vector of extruder overrides:
+                        const WipingExtrusions::ExtruderPerCopy *entity_overrides = nullptr;
+                        if (! layer_tools.has_extruder(correct_extruder_id)) {
+                            // this entity is not overridden, but its extruder is not in layer_tools - we'll print it
+                            // by last extruder on this layer (could happen e.g. when a wiping object is taller than others - dontcare extruders are eradicated from layer_tools)
+                            correct_extruder_id = layer_tools.extruders.back();
+                        }
+                        printing_extruders.clear();
+                        if (is_anything_overridden) {
+                            entity_overrides = const_cast<LayerTools&>(layer_tools).wiping_extrusions().get_extruder_overrides(extrusions, layer_to_print.original_object, correct_extruder_id, layer_to_print.object()->instances().size());
+                            if (entity_overrides == nullptr) {
+                                printing_extruders.emplace_back(correct_extruder_id);
+                            } else {
+                                printing_extruders.reserve(entity_overrides->size());
+                                for (int extruder : *entity_overrides)
+                                    printing_extruders.emplace_back(extruder >= 0 ?
+                                        // at least one copy is overridden to use this extruder
+                                        extruder :
+                                        // at least one copy would normally be printed with this extruder (see get_extruder_overrides function for explanation)
+                                        static_cast<unsigned int>(- extruder - 1));
+                                Slic3r::sort_remove_duplicates(printing_extruders);
+                            }
+                        } else
+                            printing_extruders.emplace_back(correct_extruder_id);
+
+                        // Now we must add this extrusion into the by_extruder map, once for each extruder that will print it:
+                        for (unsigned int extruder : printing_extruders)
+                        {
+                            std::vector<ObjectByExtruder::Island> &islands = object_islands_by_extruder(
+                                by_extruder,
+                                extruder,
+                                &layer_to_print - layers.data(),
+                                layers.size(), n_slices+1);
+                            for (size_t i = 0; i <= n_slices; ++ i) {
+                                bool   last = i == n_slices;
+                                size_t island_idx = last ? n_slices : slices_test_order[i];
+                                if (// extrusions->first_point does not fit inside any slice
+                                    last ||
+                                    // extrusions->first_point fits inside ith slice
+                                    point_inside_surface(island_idx, extrusions->first_point())) {
+                                    if (islands[island_idx].by_region.empty())
+                                        islands[island_idx].by_region.assign(print.num_print_regions(), ObjectByExtruder::Island::Region());
+                                    islands[island_idx].by_region[region.print_region_id()].append(entity_type, extrusions, entity_overrides);
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+            } // for regions
+        }
+    } // for objects
+
+    std::map<unsigned int, std::vector<InstanceToPrint>> &filament_to_print_instances = out.filament_to_print_instances;
+    {
+        for (unsigned int filament_id : layer_tools.extruders) {
+            auto objects_by_extruder_it = by_extruder.find(filament_id);
+            if (objects_by_extruder_it == by_extruder.end()) continue;
+
+            int   plate_idx = print.get_plate_index();
+            Point wt_pos(print.config().wipe_tower_x.get_at(plate_idx), print.config().wipe_tower_y.get_at(plate_idx));
+
+            std::vector<GCode::ObjectByExtruder> &objects_by_extruder = objects_by_extruder_it->second;
+            std::vector<const PrintObject *>      print_objects;
+            for (int obj_idx = 0; obj_idx < objects_by_extruder.size(); obj_idx++) {
+                auto &object_by_extruder = objects_by_extruder[obj_idx];
+                if (object_by_extruder.islands.empty() && (object_by_extruder.support == nullptr || object_by_extruder.support->empty())) continue;
+
+                print_objects.push_back(print.get_object(obj_idx));
+            }
+
+            std::vector<const PrintInstance *> new_ordering = chain_print_object_instances(print_objects, &wt_pos);
+            std::reverse(new_ordering.begin(), new_ordering.end());
+
+            if (print.config().print_sequence == PrintSequence::ByObject) {
+                filament_to_print_instances[filament_id] = sort_print_object_instances(objects_by_extruder_it->second, layers, ordering, single_object_instance_idx);
+            } else {
+                filament_to_print_instances[filament_id] = sort_print_object_instances(objects_by_extruder_it->second, layers, &new_ordering, single_object_instance_idx);
+            }
+        }
+    }
+
+    return out;
+}
+
+// In sequential mode, process_layer is called once per each object and its copy,
+// therefore layers will contain a single entry and single_object_instance_idx will point to the copy of the object.
+// In non-sequential mode, process_layer is called per each print_z height with all object and support layers accumulated.
+// For multi-material prints, this routine minimizes extruder switches by gathering extruder specific extrusion paths
+// and performing the extruder specific extrusions together.
+LayerResult GCode::process_layer(
+    const Print                    			&print,
+    // Set of object & print layers of the same PrintObject and with the same print_z.
+    const std::vector<LayerToPrint> 		&layers,
+    const LayerTools        		        &layer_tools,
+    const bool                               last_layer,
+    // Pairs of PrintObject index and its instance index.
+    const std::vector<const PrintInstance*> *ordering,
+    const int                               most_used_extruder,
+    // If set to size_t(-1), then print all copies of all objects.
+    // Otherwise print a single copy of a single object.
+    const size_t                     		 single_object_instance_idx,
+    // BBS
+    const bool                               prime_extruder,
+    PreparedLayer                           *prepared_layer)
+{
+    assert(! layers.empty());
+    // Either printing all copies of all objects, or just a single copy of a single object.
+    assert(single_object_instance_idx == size_t(-1) || layers.size() == 1);
+
+    // First object, support and raft layer, if available.
+    const Layer         *object_layer  = nullptr;
+    const SupportLayer  *support_layer = nullptr;
+    const SupportLayer  *raft_layer    = nullptr;
+    for (const LayerToPrint &l : layers) {
+        if (l.object_layer && ! object_layer)
+            object_layer = l.object_layer;
+        if (l.support_layer) {
+            if (! support_layer)
+                support_layer = l.support_layer;
+            if (! raft_layer && support_layer->id() < support_layer->object()->slicing_parameters().raft_layers())
+                raft_layer = support_layer;
+        }
+    }
+
+    const Layer* layer_ptr = nullptr;
+    if (object_layer != nullptr)
+        layer_ptr = object_layer;
+    else if (support_layer != nullptr)
+        layer_ptr = support_layer;
+    const Layer& layer = *layer_ptr;
+    LayerResult   result { {}, layer.id(), false, last_layer };
+    if (layer_tools.extruders.empty())
+        // Nothing to extrude.
+        return result;
+
+    // Extract 1st object_layer and support_layer of this set of layers with an equal print_z.
+    coordf_t             print_z       = layer.print_z;
+    //BBS: using layer id to judge whether the layer is first layer is wrong. Because if the normal
+    //support is attached above the object, and support layers has independent layer height, then the lowest support
+    //interface layer id is 0.
+    bool                 first_layer   = (layer.id() == 0 && abs(layer.bottom_z()) < EPSILON);
+    m_writer.set_is_first_layer(first_layer);
+    unsigned int         first_extruder_id = layer_tools.extruders.front();
+
+    // Initialize config with the 1st object to be printed at this layer.
+    m_config.apply(layer.object()->config(), true);
+
+    // Check whether it is possible to apply the spiral vase logic for this layer.
+    // Just a reminder: A spiral vase mode is allowed for a single object, single material print only.
+    m_enable_loop_clipping = true;
+    if (m_spiral_vase && layers.size() == 1 && support_layer == nullptr) {
+        bool enable = (layer.id() > 0 || !print.has_brim()) && (layer.id() >= (size_t)print.config().skirt_height.value && ! print.has_infinite_skirt());
+        if (enable) {
+            for (const LayerRegion *layer_region : layer.regions())
+                if (size_t(layer_region->region().config().bottom_shell_layers.value) > layer.id() ||
+                    layer_region->perimeters.items_count() > 1u ||
+                    layer_region->fills.items_count() > 0) {
+                    enable = false;
+                    break;
+                }
+        }
+        result.spiral_vase_enable = enable;
+        // If we're going to apply spiralvase to this layer, disable loop clipping.
+        m_enable_loop_clipping = !enable;
+    }
+
+    std::string gcode;
+    assert(is_decimal_separator_point()); // for the sprintfs
+
+    // add tag for processor
+    gcode += ";" + GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Layer_Change) + "\n";
+    // export layer z
+    char buf[64];
+    sprintf(buf, print.is_BBL_printer() ? "; Z_HEIGHT: %g\n" : ";Z:%g\n", print_z);
+    gcode += buf;
+    // export layer height
+    float height = first_layer ? static_cast<float>(print_z) : static_cast<float>(print_z) - m_last_layer_z;
+    sprintf(buf, ";%s%g\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Height).c_str(), height);
+    gcode += buf;
+    // update caches
+    m_last_layer_z = static_cast<float>(print_z);
+    m_max_layer_z  = std::max(m_max_layer_z, m_last_layer_z);
+    m_last_height = height;
+
+    // Set new layer - this will change Z and force a retraction if retract_when_changing_layer is enabled.
+    if (! m_config.before_layer_change_gcode.value.empty()) {
+        DynamicConfig config;
+        config.set_key_value("layer_num",   new ConfigOptionInt(m_layer_index + 1));
+        config.set_key_value("layer_z",     new ConfigOptionFloat(print_z));
+        config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
+        gcode += this->placeholder_parser_process("before_layer_change_gcode",
+            print.config().before_layer_change_gcode.value, m_writer.filament()->id(), &config)
+            + "\n";
+    }
+
+    PrinterStructure printer_structure           = m_config.printer_structure.value;
+    PrintSequence print_sequence = m_config.print_sequence;
+    bool sequence_by_layer = print_sequence == PrintSequence::ByLayer;
+    bool is_i3_printer = printer_structure == PrinterStructure::psI3;
+    bool is_multi_extruder = m_config.nozzle_diameter.size() > 1;
+
+    bool need_insert_timelapse_gcode_for_traditional = false;
+    if ((!m_wipe_tower || !m_wipe_tower->enable_timelapse_print()) && (is_BBL_Printer() || !m_config.time_lapse_gcode.value.empty())) {
+        need_insert_timelapse_gcode_for_traditional = ((is_i3_printer && !m_spiral_vase) || is_multi_extruder);
+    }
+
+    bool has_insert_timelapse_gcode = false;
+    bool has_wipe_tower             = (layer_tools.has_wipe_tower && m_wipe_tower);
+
+
+    ZHopType z_hope_type = ZHopType(FILAMENT_CONFIG(z_hop_types));
+    LiftType auto_lift_type = LiftType::NormalLift;
+    if (z_hope_type == ZHopType::zhtAuto || z_hope_type == ZHopType::zhtSpiral || z_hope_type == ZHopType::zhtSlope)
+        auto_lift_type = LiftType::SpiralLift;
+
+    // BBS: don't use lazy_raise when enable spiral vase
+    gcode += this->change_layer(print_z);  // this will increase m_layer_index
+    m_layer = &layer;
+    m_object_layer_over_raft = false;
+
+    if (!m_config.time_lapse_gcode.value.empty() && !is_BBL_Printer()) {
+        DynamicConfig config;
+        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
+        config.set_key_value("layer_z", new ConfigOptionFloat(print_z));
+        config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
+        gcode += this->placeholder_parser_process("timelapse_gcode",
+             print.config().time_lapse_gcode.value, m_writer.filament()->id(), &config)
+             + "\n";
+    }
+
+    if (!m_config.layer_change_gcode.value.empty()) {
+        DynamicConfig config;
+        config.set_key_value("most_used_physical_extruder_id", new ConfigOptionInt(m_config.physical_extruder_map.get_at(most_used_extruder)));
+        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
+        config.set_key_value("layer_z",   new ConfigOptionFloat(print_z));
+        gcode += this->placeholder_parser_process("layer_change_gcode",
+            print.config().layer_change_gcode.value, m_writer.filament()->id(), &config)
+            + "\n";
+        config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
+    }
     //BBS: set layer time fan speed after layer change gcode
     gcode += ";_SET_FAN_SPEED_CHANGING_LAYER\n";
 
@@ -4357,358 +4801,116 @@ LayerResult GCode::process_layer(
                 !m_config.machine_max_junction_deviation.values.empty() &&
                 m_config.machine_max_junction_deviation.values.front() > 0) {
                 gcode += writer().set_junction_deviation(this->interpolate_value_across_layers(print.calib_params().start, print.calib_params().end));
-            } else {
-                gcode += writer().set_jerk_xy(this->interpolate_value_across_layers(print.calib_params().start, print.calib_params().end));
-            }
-            break;
-        }
-    }
-
-    //BBS
-    if (first_layer) {
-        // Orca: we don't need to optimize the Klipper as only set once
-        if (m_config.default_acceleration.value > 0 && m_config.initial_layer_acceleration.value > 0) {
-            gcode += m_writer.set_print_acceleration((unsigned int)floor(m_config.initial_layer_acceleration.value + 0.5));
-        }
-
-        if (m_config.default_jerk.value > 0 && m_config.initial_layer_jerk.value > 0) {
-            gcode += m_writer.set_jerk_xy(m_config.initial_layer_jerk.value);
-        }
-
-        if (m_writer.get_gcode_flavor() == gcfMarlinFirmware && m_config.default_junction_deviation.value > 0) {
-            gcode += m_writer.set_junction_deviation(m_config.default_junction_deviation.value);
-        }
-    }
-
-    if (!first_layer && !m_second_layer_things_done) {
-        // Orca: start tracking power lost recovery
-        if (print.config().enable_power_loss_recovery.value == true) {
-            gcode += m_writer.enable_power_loss_recovery(true);
-        }
-
-        if (print.is_BBL_printer()) {
-            // BBS: open first layer inspection at second layer
-            if (print.config().scan_first_layer.value) {
-                // BBS: retract first to avoid droping when scan model
-                gcode += this->retract();
-                gcode += "M976 S1 P1 ; scan model before printing 2nd layer\n";
-                gcode += "M400 P100\n";
-                gcode += this->unretract();
-            }
-        }
-      // Reset acceleration at sencond layer
-      // Orca: only set once, don't need to call set_accel_and_jerk
-      if (m_config.default_acceleration.value > 0 && m_config.initial_layer_acceleration.value > 0) {
-        gcode += m_writer.set_print_acceleration((unsigned int) floor(m_config.default_acceleration.value + 0.5));
-      }
-
-      if (m_config.default_jerk.value > 0 && m_config.initial_layer_jerk.value > 0) {
-        gcode += m_writer.set_jerk_xy(m_config.default_jerk.value);
-      }
-
-        // Transition from 1st to 2nd layer. Adjust nozzle temperatures as prescribed by the nozzle dependent
-        // nozzle_temperature_initial_layer vs. temperature settings.
-        for (const Extruder& extruder : m_writer.extruders()) {
-            if ((print.config().single_extruder_multi_material.value || m_ooze_prevention.enable) &&
-                extruder.id() != m_writer.filament()->id())
-                // In single extruder multi material mode, set the temperature for the current extruder only.
-                continue;
-            int temperature = print.config().nozzle_temperature.get_at(extruder.id());
-            if (temperature > 0 && temperature != print.config().nozzle_temperature_initial_layer.get_at(extruder.id()))
-                gcode += m_writer.set_temperature(temperature, false, extruder.id());
-        }
-
-        // BBS
-        int bed_temp = 0;
-        if (m_config.bed_temperature_formula == BedTempFormula::btfHighestTemp)
-            bed_temp = get_highest_bed_temperature(false,print);
-        else
-            bed_temp = get_bed_temperature(first_extruder_id, false, m_config.curr_bed_type);
-        gcode += m_writer.set_bed_temperature(bed_temp);
-        // Mark the temperature transition from 1st to 2nd layer to be finished.
-        m_second_layer_things_done = true;
-    }
-
-    if (single_object_instance_idx == size_t(-1)) {
-        // Normal (non-sequential) print.
-        gcode += ProcessLayer::emit_custom_gcode_per_print_z(*this, layer_tools.custom_gcode, m_writer.filament()->id(), first_extruder_id, print.config());
-    }
-
-    // BBS: get next extruder according to flush and soluble
-    auto get_next_extruder = [&](int current_extruder,const std::vector<unsigned int>&extruders) {
-        std::vector<float> flush_matrix(cast<float>(get_flush_volumes_matrix(m_config.flush_volumes_matrix.values, 0, m_config.nozzle_diameter.values.size())));
-        const unsigned int number_of_extruders = (unsigned int)(sqrt(flush_matrix.size()) + EPSILON);
-        // Extract purging volumes for each extruder pair:
-        std::vector<std::vector<float>> wipe_volumes;
-        for (unsigned int i = 0; i < number_of_extruders; ++i)
-            wipe_volumes.push_back(std::vector<float>(flush_matrix.begin() + i * number_of_extruders, flush_matrix.begin() + (i + 1) * number_of_extruders));
-        unsigned int next_extruder = current_extruder;
-        float min_flush = std::numeric_limits<float>::max();
-        for (auto extruder_id : extruders) {
-            if (print.config().filament_soluble.get_at(extruder_id) || extruder_id == current_extruder)
-                continue;
-            if (wipe_volumes[current_extruder][extruder_id] < min_flush) {
-                next_extruder = extruder_id;
-                min_flush = wipe_volumes[current_extruder][extruder_id];
-            }
-        }
-        return next_extruder;
-    };
-    
-    for (const auto &layer_to_print : layers) {
-        if (layer_to_print.object_layer) {
-            const auto& regions = layer_to_print.object_layer->regions();
-            const bool  enable_overhang_speed = std::any_of(regions.begin(), regions.end(), [](const LayerRegion* r) {
-                return r->has_extrusions() && r->region().config().enable_overhang_speed;
-            });
-            if (enable_overhang_speed) {
-                m_extrusion_quality_estimator.prepare_for_new_layer(layer_to_print.original_object,
-                                                                    layer_to_print.object_layer);
-            }
-        }
-    }
-
-    // Group extrusions by an extruder, then by an object, an island and a region.
-    std::map<unsigned int, std::vector<ObjectByExtruder>> by_extruder;
-    bool is_anything_overridden = const_cast<LayerTools&>(layer_tools).wiping_extrusions().is_anything_overridden();
-    for (const LayerToPrint &layer_to_print : layers) {
-        if (layer_to_print.support_layer != nullptr) {
-            const SupportLayer &support_layer = *layer_to_print.support_layer;
-            const PrintObject& object = *layer_to_print.original_object;
-            if (! support_layer.support_fills.entities.empty()) {
-                ExtrusionRole   role               = support_layer.support_fills.role();
-                bool            has_support        = role == erMixed || role == erSupportMaterial || role == erSupportTransition;
-                bool            has_interface      = role == erMixed || role == erSupportMaterialInterface;
-                // Extruder ID of the support base. -1 if "don't care".
-                unsigned int    support_extruder   = object.config().support_filament.value - 1;
-                // Shall the support be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
-                bool            support_dontcare   = object.config().support_filament.value == 0;
-                // Extruder ID of the support interface. -1 if "don't care".
-                unsigned int    interface_extruder = object.config().support_interface_filament.value - 1;
-                // Shall the support interface be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
-                bool            interface_dontcare = object.config().support_interface_filament.value == 0;
-
-                // BBS: apply wiping overridden extruders
-                WipingExtrusions& wiping_extrusions = const_cast<LayerTools&>(layer_tools).wiping_extrusions();
-                if (support_dontcare) {
-                    int extruder_override = wiping_extrusions.get_support_extruder_overrides(&object);
-                    if (extruder_override >= 0) {
-                        support_extruder = extruder_override;
-                        support_dontcare = false;
-                    }
-                }
-
-                if (interface_dontcare) {
-                    int extruder_override = wiping_extrusions.get_support_interface_extruder_overrides(&object);
-                    if (extruder_override >= 0) {
-                        interface_extruder = extruder_override;
-                        interface_dontcare = false;
-                    }
-                }
-
-                // BBS: try to print support base with a filament other than interface filament
-                if (support_dontcare && !interface_dontcare) {
-                    unsigned int dontcare_extruder = first_extruder_id;
-                    for (unsigned int extruder_id : layer_tools.extruders) {
-                        if (print.config().filament_soluble.get_at(extruder_id))
-                            continue;
-
-                        //BBS: now we don't consider interface filament used in other object
-                        if (extruder_id == interface_extruder)
-                            continue;
-
-                        dontcare_extruder = extruder_id;
-                        break;
-                    }
-                #if 0
-                    //BBS: not found a suitable extruder in current layer ,dontcare_extruider==first_extruder_id==interface_extruder
-                    if (dontcare_extruder == interface_extruder && (object.config().support_interface_not_for_body && object.config().support_interface_filament.value!=0)) {
-                        // BBS : get a suitable extruder from other layer
-                        auto all_extruders = print.extruders();
-                        dontcare_extruder = get_next_extruder(dontcare_extruder, all_extruders);
-                    }
-                #endif
-
-                    if (support_dontcare)
-                        support_extruder = dontcare_extruder;
-                }
-                else if (support_dontcare || interface_dontcare) {
-                    // Some support will be printed with "don't care" material, preferably non-soluble.
-                    // Is the current extruder assigned a soluble filament?
-                    unsigned int dontcare_extruder = first_extruder_id;
-                    if (print.config().filament_soluble.get_at(dontcare_extruder)) {
-                        // The last extruder printed on the previous layer extrudes soluble filament.
-                        // Try to find a non-soluble extruder on the same layer.
-                        for (unsigned int extruder_id : layer_tools.extruders)
-                            if (! print.config().filament_soluble.get_at(extruder_id)) {
-                                dontcare_extruder = extruder_id;
-                                break;
-                            }
-                    }
-                    if (print.config().filament_is_support.get_at(dontcare_extruder)) {
-                        // The last extruder printed on the previous layer extrudes support filament.
-                        // Try to find a non-support extruder on the same layer.
-                        for (unsigned int extruder_id : layer_tools.extruders)
-                            if (!print.config().filament_is_support.get_at(extruder_id)) {
-                                dontcare_extruder = extruder_id;
-                                break;
-                            }
-                    }
-                    if (support_dontcare)
-                        support_extruder = dontcare_extruder;
-                    if (interface_dontcare)
-                        interface_extruder = dontcare_extruder;
-                }
-                // Both the support and the support interface are printed with the same extruder, therefore
-                // the interface may be interleaved with the support base.
-                bool single_extruder = ! has_support || support_extruder == interface_extruder;
-                // Assign an extruder to the base.
-                ObjectByExtruder &obj = object_by_extruder(by_extruder, has_support ? support_extruder : interface_extruder, &layer_to_print - layers.data(), layers.size());
-                obj.support = &support_layer.support_fills;
-                obj.support_extrusion_role = single_extruder ? erMixed : erSupportMaterial;
-                if (! single_extruder && has_interface) {
-                    ObjectByExtruder &obj_interface = object_by_extruder(by_extruder, interface_extruder, &layer_to_print - layers.data(), layers.size());
-                    obj_interface.support = &support_layer.support_fills;
-                    obj_interface.support_extrusion_role = erSupportMaterialInterface;
-                }
+            } else {
+                gcode += writer().set_jerk_xy(this->interpolate_value_across_layers(print.calib_params().start, print.calib_params().end));
             }
+            break;
         }
+    }
 
-        if (layer_to_print.object_layer != nullptr) {
-            const Layer &layer = *layer_to_print.object_layer;
-            // We now define a strategy for building perimeters and fills. The separation
-            // between regions doesn't matter in terms of printing order, as we follow
-            // another logic instead:
-            // - we group all extrusions by extruder so that we minimize toolchanges
-            // - we start from the last used extruder
-            // - for each extruder, we group extrusions by island
-            // - for each island, we extrude perimeters first, unless user set the infill_first
-            //   option
-            // (Still, we have to keep track of regions because we need to apply their config)
-            size_t n_slices = layer.lslices.size();
-            const std::vector<BoundingBox> &layer_surface_bboxes = layer.lslices_bboxes;
-            // Traverse the slices in an increasing order of bounding box size, so that the islands inside another islands are tested first,
-            // so we can just test a point inside ExPolygon::contour and we may skip testing the holes.
-            std::vector<size_t> slices_test_order;
-            slices_test_order.reserve(n_slices);
-            for (size_t i = 0; i < n_slices; ++ i)
-                slices_test_order.emplace_back(i);
-            std::sort(slices_test_order.begin(), slices_test_order.end(), [&layer_surface_bboxes](size_t i, size_t j) {
-                const Vec2d s1 = layer_surface_bboxes[i].size().cast<double>();
-                const Vec2d s2 = layer_surface_bboxes[j].size().cast<double>();
-                return s1.x() * s1.y() < s2.x() * s2.y();
-            });
-            auto point_inside_surface = [&layer, &layer_surface_bboxes](const size_t i, const Point &point) {
-                const BoundingBox &bbox = layer_surface_bboxes[i];
-                return point(0) >= bbox.min(0) && point(0) < bbox.max(0) &&
-                       point(1) >= bbox.min(1) && point(1) < bbox.max(1) &&
-                       layer.lslices[i].contour.contains(point);
-            };
-
-            for (size_t region_id = 0; region_id < layer.regions().size(); ++ region_id) {
-                const LayerRegion *layerm = layer.regions()[region_id];
-                if (layerm == nullptr)
-                    continue;
-                // PrintObjects own the PrintRegions, thus the pointer to PrintRegion would be unique to a PrintObject, they would not
-                // identify the content of PrintRegion accross the whole print uniquely. Translate to a Print specific PrintRegion.
-                const PrintRegion &region = print.get_print_region(layerm->region().print_region_id());
-
-                // Now we must process perimeters and infills and create islands of extrusions in by_region std::map.
-                // It is also necessary to save which extrusions are part of MM wiping and which are not.
-                // The process is almost the same for perimeters and infills - we will do it in a cycle that repeats twice:
-                std::vector<unsigned int> printing_extruders;
-                for (const ObjectByExtruder::Island::Region::Type entity_type : { ObjectByExtruder::Island::Region::INFILL, ObjectByExtruder::Island::Region::PERIMETERS }) {
-                    for (const ExtrusionEntity *ee : (entity_type == ObjectByExtruder::Island::Region::INFILL) ? layerm->fills.entities : layerm->perimeters.entities) {
-                        // extrusions represents infill or perimeter extrusions of a single island.
-                        assert(dynamic_cast<const ExtrusionEntityCollection*>(ee) != nullptr);
-                        const auto *extrusions = static_cast<const ExtrusionEntityCollection*>(ee);
-                        if (extrusions->entities.empty()) // This shouldn't happen but first_point() would fail.
-                            continue;
+    //BBS
+    if (first_layer) {
+        // Orca: we don't need to optimize the Klipper as only set once
+        if (m_config.default_acceleration.value > 0 && m_config.initial_layer_acceleration.value > 0) {
+            gcode += m_writer.set_print_acceleration((unsigned int)floor(m_config.initial_layer_acceleration.value + 0.5));
+        }
 
-                        // This extrusion is part of certain Region, which tells us which extruder should be used for it:
-                        int correct_extruder_id = layer_tools.extruder(*extrusions, region);
+        if (m_config.default_jerk.value > 0 && m_config.initial_layer_jerk.value > 0) {
+            gcode += m_writer.set_jerk_xy(m_config.initial_layer_jerk.value);
+        }
 
-                        // Let's recover vector of extruder overrides:
-                        const WipingExtrusions::ExtruderPerCopy *entity_overrides = nullptr;
-                        if (! layer_tools.has_extruder(correct_extruder_id)) {
-                            // this entity is not overridden, but its extruder is not in layer_tools - we'll print it
-                            // by last extruder on this layer (could happen e.g. when a wiping object is taller than others - dontcare extruders are eradicated from layer_tools)
-                            correct_extruder_id = layer_tools.extruders.back();
-                        }
-                        printing_extruders.clear();
-                        if (is_anything_overridden) {
-                            entity_overrides = const_cast<LayerTools&>(layer_tools).wiping_extrusions().get_extruder_overrides(extrusions, layer_to_print.original_object, correct_extruder_id, layer_to_print.object()->instances().size());
-                            if (entity_overrides == nullptr) {
-                                printing_extruders.emplace_back(correct_extruder_id);
-                            } else {
-                                printing_extruders.reserve(entity_overrides->size());
-                                for (int extruder : *entity_overrides)
-                                    printing_extruders.emplace_back(extruder >= 0 ?
-                                        // at least one copy is overridden to use this extruder
-                                        extruder :
-                                        // at least one copy would normally be printed with this extruder (see get_extruder_overrides function for explanation)
-                                        static_cast<unsigned int>(- extruder - 1));
-                                Slic3r::sort_remove_duplicates(printing_extruders);
-                            }
-                        } else
-                            printing_extruders.emplace_back(correct_extruder_id);
+        if (m_writer.get_gcode_flavor() == gcfMarlinFirmware && m_config.default_junction_deviation.value > 0) {
+            gcode += m_writer.set_junction_deviation(m_config.default_junction_deviation.value);
+        }
+    }
 
-                        // Now we must add this extrusion into the by_extruder map, once for each extruder that will print it:
-                        for (unsigned int extruder : printing_extruders)
-                        {
-                            std::vector<ObjectByExtruder::Island> &islands = object_islands_by_extruder(
-                                by_extruder,
-                                extruder,
-                                &layer_to_print - layers.data(),
-                                layers.size(), n_slices+1);
-                            for (size_t i = 0; i <= n_slices; ++ i) {
-                                bool   last = i == n_slices;
-                                size_t island_idx = last ? n_slices : slices_test_order[i];
-                                if (// extrusions->first_point does not fit inside any slice
-                                    last ||
-                                    // extrusions->first_point fits inside ith slice
-                                    point_inside_surface(island_idx, extrusions->first_point())) {
-                                    if (islands[island_idx].by_region.empty())
-                                        islands[island_idx].by_region.assign(print.num_print_regions(), ObjectByExtruder::Island::Region());
-                                    islands[island_idx].by_region[region.print_region_id()].append(entity_type, extrusions, entity_overrides);
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-            } // for regions
+    if (!first_layer && !m_second_layer_things_done) {
+        // Orca: start tracking power lost recovery
+        if (print.config().enable_power_loss_recovery.value == true) {
+            gcode += m_writer.enable_power_loss_recovery(true);
         }
-    } // for objects
 
-    std::map<unsigned int, std::vector<InstanceToPrint>> filament_to_print_instances;
-    {
-        for (unsigned int filament_id : layer_tools.extruders) {
-            auto objects_by_extruder_it = by_extruder.find(filament_id);
-            if (objects_by_extruder_it == by_extruder.end()) continue;
+        if (print.is_BBL_printer()) {
+            // BBS: open first layer inspection at second layer
+            if (print.config().scan_first_layer.value) {
+                // BBS: retract first to avoid droping when scan model
+                gcode += this->retract();
+                gcode += "M976 S1 P1 ; scan model before printing 2nd layer\n";
+                gcode += "M400 P100\n";
+                gcode += this->unretract();
+            }
+        }
+      // Reset acceleration at sencond layer
+      // Orca: only set once, don't need to call set_accel_and_jerk
+      if (m_config.default_acceleration.value > 0 && m_config.initial_layer_acceleration.value > 0) {
+        gcode += m_writer.set_print_acceleration((unsigned int) floor(m_config.default_acceleration.value + 0.5));
+      }
 
-            int   plate_idx = print.get_plate_index();
-            Point wt_pos(print.config().wipe_tower_x.get_at(plate_idx), print.config().wipe_tower_y.get_at(plate_idx));
+      if (m_config.default_jerk.value > 0 && m_config.initial_layer_jerk.value > 0) {
+        gcode += m_writer.set_jerk_xy(m_config.default_jerk.value);
+      }
 
-            std::vector<GCode::ObjectByExtruder> &objects_by_extruder = objects_by_extruder_it->second;
-            std::vector<const PrintObject *>      print_objects;
-            for (int obj_idx = 0; obj_idx < objects_by_extruder.size(); obj_idx++) {
-                auto &object_by_extruder = objects_by_extruder[obj_idx];
-                if (object_by_extruder.islands.empty() && (object_by_extruder.support == nullptr || object_by_extruder.support->empty())) continue;
+        // Transition from 1st to 2nd layer. Adjust nozzle temperatures as prescribed by the nozzle dependent
+        // nozzle_temperature_initial_layer vs. temperature settings.
+        for (const Extruder& extruder : m_writer.extruders()) {
+            if ((print.config().single_extruder_multi_material.value || m_ooze_prevention.enable) &&
+                extruder.id() != m_writer.filament()->id())
+                // In single extruder multi material mode, set the temperature for the current extruder only.
+                continue;
+            int temperature = print.config().nozzle_temperature.get_at(extruder.id());
+            if (temperature > 0 && temperature != print.config().nozzle_temperature_initial_layer.get_at(extruder.id()))
+                gcode += m_writer.set_temperature(temperature, false, extruder.id());
+        }
 
-                print_objects.push_back(print.get_object(obj_idx));
-            }
+        // BBS
+        int bed_temp = 0;
+        if (m_config.bed_temperature_formula == BedTempFormula::btfHighestTemp)
+            bed_temp = get_highest_bed_temperature(false,print);
+        else
+            bed_temp = get_bed_temperature(first_extruder_id, false, m_config.curr_bed_type);
+        gcode += m_writer.set_bed_temperature(bed_temp);
+        // Mark the temperature transition from 1st to 2nd layer to be finished.
+        m_second_layer_things_done = true;
+    }
 
-            std::vector<const PrintInstance *> new_ordering = chain_print_object_instances(print_objects, &wt_pos);
-            std::reverse(new_ordering.begin(), new_ordering.end());
+    if (single_object_instance_idx == size_t(-1)) {
+        // Normal (non-sequential) print.
+        gcode += ProcessLayer::emit_custom_gcode_per_print_z(*this, layer_tools.custom_gcode, m_writer.filament()->id(), first_extruder_id, print.config());
+    }
 
-            if (print.config().print_sequence == PrintSequence::ByObject) {
-                filament_to_print_instances[filament_id] = sort_print_object_instances(objects_by_extruder_it->second, layers, ordering, single_object_instance_idx);
-            } else {
-                filament_to_print_instances[filament_id] = sort_print_object_instances(objects_by_extruder_it->second, layers, &new_ordering, single_object_instance_idx);
+    // BBS: get next extruder according to flush and soluble
+    auto get_next_extruder = [&](int current_extruder,const std::vector<unsigned int>&extruders) {
+        std::vector<float> flush_matrix(cast<float>(get_flush_volumes_matrix(m_config.flush_volumes_matrix.values, 0, m_config.nozzle_diameter.values.size())));
+        const unsigned int number_of_extruders = (unsigned int)(sqrt(flush_matrix.size()) + EPSILON);
+        // Extract purging volumes for each extruder pair:
+        std::vector<std::vector<float>> wipe_volumes;
+        for (unsigned int i = 0; i < number_of_extruders; ++i)
+            wipe_volumes.push_back(std::vector<float>(flush_matrix.begin() + i * number_of_extruders, flush_matrix.begin() + (i + 1) * number_of_extruders));
+        unsigned int next_extruder = current_extruder;
+        float min_flush = std::numeric_limits<float>::max();
+        for (auto extruder_id : extruders) {
+            if (print.config().filament_soluble.get_at(extruder_id) || extruder_id == current_extruder)
+                continue;
+            if (wipe_volumes[current_extruder][extruder_id] < min_flush) {
+                next_extruder = extruder_id;
+                min_flush = wipe_volumes[current_extruder][extruder_id];
             }
         }
-    }
+        return next_extruder;
+    };
+    
+    PreparedLayer prepared_in_place = prepared_layer == nullptr ?
+        prepare_layer(print, layers, layer_tools, ordering, single_object_instance_idx) : PreparedLayer{};
+    if (prepared_layer == nullptr)
+        prepared_layer = &prepared_in_place;
+    assert(prepared_layer->overhang_boundaries.size() == layers.size());
+    for (size_t i = 0; i < layers.size(); ++ i)
+        if (prepared_layer->overhang_boundaries[i])
+            m_extrusion_quality_estimator.prepare_for_new_layer(layers[i].original_object, std::move(*prepared_layer->overhang_boundaries[i]));
+    std::vector<std::shared_ptr<const AvoidCrossingPerimeters::LayerBoundaries>> travel_boundaries = std::move(prepared_layer->travel_boundaries);
+    std::map<unsigned int, std::vector<ObjectByExtruder>> &by_extruder                 = prepared_layer->by_extruder;
+    std::map<unsigned int, std::vector<InstanceToPrint>>  &filament_to_print_instances = prepared_layer->filament_to_print_instances;
+    const bool                                             is_anything_overridden      = prepared_layer->is_anything_overridden;
 
     std::set<size_t> layer_object_label_ids;
     for (auto iter = filament_to_print_instances.begin(); iter != filament_to_print_instances.end(); ++iter) {
@@ -4948,7 +5150,7 @@ LayerResult GCode::process_layer(
                 m_layer = layer_to_print.layer();
                 m_object_layer_over_raft = object_layer_over_raft;
                 if (m_config.reduce_crossing_wall)
-                    m_avoid_crossing_perimeters.init_layer(*m_layer);
+                    m_avoid_crossing_perimeters.init_layer(*m_layer, travel_boundaries[instance_to_print.layer_id]);
 
                 if (this->config().gcode_label_objects) {
                     gcode += std::string("; printing object ") + instance_to_print.print_object.model_object()->name +
@@ -5165,7 +5367,7 @@ LayerResult GCode::process_layer(
         gcode += insert_timelapse_gcode();
     }
 
-    result.gcode = std::move(gcode);
+    result.gcode = GCodeLayerBuffer(std::move(gcode));
     result.cooling_buffer_flush = object_layer || raft_layer || last_layer;
     return result;
 }
@@ -5822,35 +6024,202 @@ std::string GCode::extrude_support(const ExtrusionEntityCollection &support_fill
     return gcode;
 }
 
+// Size of the blocks the G-code is collected into, both in memory and before being written into the file.
+static constexpr const size_t gcode_output_block_size = 4 * 1024 * 1024;
+
+// Writes blocks of G-code into the file on a dedicated thread, so that the G-code generator does not wait
+// for the disk. The blocks are handed over by move, the number of queued blocks is limited to bound the memory.
+class GCode::GCodeOutputStream::AsyncWriter
+{
+public:
+    AsyncWriter(FILE *f) : m_file(f)
+    {
+        m_thread = create_thread([this]() { this->thread_proc(); });
+    }
+    ~AsyncWriter() { this->finish(); }
+
+    void push(std::string &&block)
+    {
+        if (block.empty())
+            return;
+        std::unique_lock<std::mutex> lck(m_mutex);
+        m_condition.wait(lck, [this]() { return m_queue.size() < max_queued_blocks; });
+        m_queue.emplace_back(std::move(block));
+        lck.unlock();
+        m_condition.notify_all();
+    }
+
+    // Wait until all the queued blocks are written into the file.
+    void wait_empty()
+    {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        m_condition.wait(lck, [this]() { return m_queue.empty() && ! m_writing; });
+    }
+
+    // Write the queued blocks and stop the thread.
+    void finish()
+    {
+        if (! m_thread.joinable())
+            return;
+        {
+            std::scoped_lock<std::mutex> lck(m_mutex);
+            m_exit = true;
+        }
+        m_condition.notify_all();
+        m_thread.join();
+    }
+
+    bool is_error() const { return m_error; }
+
+private:
+    void thread_proc()
+    {
+        set_current_thread_name("slic3r_gcode_io");
+        std::unique_lock<std::mutex> lck(m_mutex);
+        for (;;) {
+            m_condition.wait(lck, [this]() { return m_exit || ! m_queue.empty(); });
+            if (m_queue.empty())
+                // m_exit was set and everything was written.
+                break;
+            std::string block = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_writing = true;
+            lck.unlock();
+            // Let the producer fill in the queue while writing.
+            m_condition.notify_all();
+            if (::fwrite(block.data(), 1, block.size(), m_file) != block.size())
+                m_error = true;
+            lck.lock();
+            m_writing = false;
+            m_condition.notify_all();
+        }
+    }
+
+    static constexpr const size_t max_queued_blocks = 4;
+
+    FILE                   *m_file;
+    boost::thread           m_thread;
+    std::mutex              m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::string> m_queue;
+    bool                    m_writing { false };
+    bool                    m_exit { false };
+    std::atomic<bool>       m_error { false };
+};
+
+GCode::GCodeOutputStream::GCodeOutputStream(FILE *f, GCodeProcessor &processor, size_t in_memory_limit) :
+    f(f), m_processor(processor), m_in_memory(in_memory_limit > 0), m_in_memory_limit(in_memory_limit)
+{
+    if (f != nullptr && ! m_in_memory)
+        m_async_writer = std::make_unique<AsyncWriter>(f);
+}
+
+GCode::GCodeOutputStream::~GCodeOutputStream()
+{
+    this->close();
+}
+
 bool GCode::GCodeOutputStream::is_error() const
 {
-    return ::ferror(this->f);
+    return ::ferror(this->f) || (m_async_writer && m_async_writer->is_error());
 }
 
 void GCode::GCodeOutputStream::flush()
 {
+    if (m_async_writer) {
+        this->push_write_block();
+        m_async_writer->wait_empty();
+    }
     ::fflush(this->f);
 }
 
 void GCode::GCodeOutputStream::close()
 {
     if (this->f) {
+        if (m_async_writer) {
+            this->push_write_block();
+            m_async_writer->finish();
+            m_async_writer.reset();
+        }
         ::fclose(this->f);
         this->f = nullptr;
     }
 }
 
+void GCode::GCodeOutputStream::write(const std::string &what)
+{
+    if (what.empty())
+        return;
+    this->append(what.data(), what.size());
+    m_processor.process_buffer(what);
+}
+
 void GCode::GCodeOutputStream::write(const char *what)
 {
-    if (what != nullptr) {
-        const char* gcode = what;
-        // writes string to file
-        fwrite(gcode, 1, ::strlen(gcode), this->f);
-        //FIXME don't allocate a string, maybe process a batch of lines?
-        m_processor.process_buffer(std::string(gcode));
+    if (what == nullptr || *what == 0)
+        return;
+    const size_t len = strlen(what);
+    this->append(what, len);
+    m_processor.process_buffer(what, what + len);
+}
+
+void GCode::GCodeOutputStream::write(std::string &&what)
+{
+    if (what.empty())
+        return;
+    if (m_in_memory && m_in_memory_size + what.size() > m_in_memory_limit)
+        this->spill_to_file();
+    if (m_in_memory || what.size() < gcode_output_block_size / 4) {
+        this->write(what);
+        return;
+    }
+    // A large string, typically the G-code of a whole layer: hand it over to the writing thread as a block of its own.
+    m_processor.process_buffer(what);
+    this->push_write_block();
+    m_async_writer->push(std::move(what));
+}
+
+void GCode::GCodeOutputStream::append(const char *data, size_t len)
+{
+    if (m_in_memory && m_in_memory_size + len > m_in_memory_limit)
+        this->spill_to_file();
+    if (m_in_memory) {
+        // Collect the G-code into blocks of a few megabytes to avoid reallocating a huge string.
+        if (m_in_memory_blocks.empty() || m_in_memory_blocks.back().size() + len > gcode_output_block_size) {
+            m_in_memory_blocks.emplace_back();
+            m_in_memory_blocks.back().reserve(std::max(gcode_output_block_size, len));
+        }
+        m_in_memory_blocks.back().append(data, len);
+        m_in_memory_size += len;
+    } else {
+        if (m_write_block.size() + len > gcode_output_block_size)
+            this->push_write_block();
+        if (m_write_block.capacity() == 0)
+            m_write_block.reserve(gcode_output_block_size);
+        m_write_block.append(data, len);
+    }
+}
+
+void GCode::GCodeOutputStream::push_write_block()
+{
+    if (! m_write_block.empty()) {
+        m_async_writer->push(std::move(m_write_block));
+        // Moved from string is valid, but unspecified.
+        m_write_block.clear();
     }
 }
 
+void GCode::GCodeOutputStream::spill_to_file()
+{
+    BOOST_LOG_TRIVIAL(debug) << "G-code exceeds the in-memory export limit of " << m_in_memory_limit << " bytes, writing it into the file";
+    m_async_writer = std::make_unique<AsyncWriter>(this->f);
+    for (std::string &block : m_in_memory_blocks)
+        m_async_writer->push(std::move(block));
+    m_in_memory_blocks.clear();
+    m_in_memory_size = 0;
+    m_in_memory      = false;
+}
+
 void GCode::GCodeOutputStream::writeln(const std::string &what)
 {
     if (! what.empty())
@@ -11,6 +11,7 @@
 #include "GCode/AvoidCrossingPerimeters.hpp"
 #include "GCode/CoolingBuffer.hpp"
 #include "GCode/FanMover.hpp"
+#include "GCode/GCodeLayerBuffer.hpp"
 #include "GCode/RetractWhenCrossingPerimeters.hpp"
 #include "GCode/SpiralVase.hpp"
 #include "GCode/ToolOrdering.hpp"
@@ -23,6 +24,7 @@
 #include "GCode/ExtrusionProcessor.hpp"
 
 #include "GCode/PressureEqualizer.hpp"
+#include "GCode/PipelineStats.hpp"
 #include "GCode/SmallAreaInfillFlowCompensator.hpp"
 // ORCA: post processor below used for Dynamic Pressure advance
 #include "GCode/AdaptivePAProcessor.hpp"
@@ -31,6 +33,7 @@
 
 #include <memory>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
 #include <cfloat>
@@ -165,7 +168,8 @@ public:
 };
 
 struct LayerResult {
-    std::string gcode;
+    // G-code of the layer parsed into lines, modified in place by the post-processing filters.
+    GCodeLayerBuffer gcode;
     size_t      layer_id;
     // Is spiral vase post processing enabled for this layer?
     bool        spiral_vase_enable { false };
@@ -175,7 +179,7 @@ struct LayerResult {
     // It is used for the pressure equalizer because it needs to buffer one layer back.
     bool        nop_layer_result { false };
 
-    static LayerResult make_nop_layer_result() { return {"", std::numeric_limits<coord_t>::max(), false, false, true}; }
+    static LayerResult make_nop_layer_result() { return {GCodeLayerBuffer(), std::numeric_limits<coord_t>::max(), false, false, true}; }
 };
 
 class GCode {
@@ -209,9 +213,16 @@ public:
         {}
     ~GCode() = default;
 
+    // G-code not exceeding in_memory_limit bytes is kept in memory until the G-code processor writes the final file,
+    // saving a write and a read back of the intermediate file. Zero always writes the intermediate file.
+    // On a network share or a removable drive, the G-code is always written by a background thread while being generated,
+    // as the final file may then be written for longer than it takes to generate the G-code.
+    static constexpr const size_t default_in_memory_export_limit = 256 * 1024 * 1024;
+
     // throws std::runtime_exception on error,
     // throws CanceledException through print->throw_if_canceled().
-    void            do_export(Print* print, const char* path, GCodeProcessorResult* result = nullptr, ThumbnailsGeneratorCallback thumbnail_cb = nullptr);
+    void            do_export(Print* print, const char* path, GCodeProcessorResult* result = nullptr, ThumbnailsGeneratorCallback thumbnail_cb = nullptr,
+                              size_t in_memory_limit = default_in_memory_export_limit);
     void            export_layer_filaments(GCodeProcessorResult* result);
     //BBS: set offset for gcode writer
     void set_gcode_offset(double x, double y) { m_writer.set_xy_offset(x, y); m_processor.set_xy_offset(x, y);}
@@ -302,17 +313,28 @@ public:
 private:
     class GCodeOutputStream {
     public:
-        GCodeOutputStream(FILE *f, GCodeProcessor &processor) : f(f), m_processor(processor) {}
-        ~GCodeOutputStream() { this->close(); }
+        // Up to in_memory_limit bytes of G-code are collected in memory instead of being written into the file.
+        GCodeOutputStream(FILE *f, GCodeProcessor &processor, size_t in_memory_limit = 0);
+        ~GCodeOutputStream();
 
         bool is_open() const { return f; }
+        // To be called after flush(), as the G-code is written into the file asynchronously.
         bool is_error() const;
 
+        // Wait until all the G-code is written into the file and flush the file.
         void flush();
         void close();
 
+        // Is all the G-code written so far collected in memory?
+        bool is_in_memory() const { return m_in_memory; }
+        // Hand over the G-code collected in memory, see GCodeProcessor::set_in_memory_gcode().
+        std::vector<std::string> extract_in_memory_gcode() { m_in_memory_size = 0; return std::move(m_in_memory_blocks); }
+
         // Write a string into a file.
-        void write(const std::string& what) { this->write(what.c_str()); }
+        void write(const std::string& what);
+        // Write a string into a file. Large strings (a layer of G-code) are handed over to the writing thread without copying.
+        void write(std::string&& what);
+        // Write a zero terminated string into a file without copying it into a temporary std::string.
         void write(const char* what);
 
         // Write a string into a file.
@@ -324,8 +346,25 @@ private:
         void write_format(const char* format, ...);
 
     private:
+        // Writes blocks of G-code into the file on a background thread.
+        class AsyncWriter;
+
+        // Append the G-code either to the G-code collected in memory or to the block to be written into the file.
+        void append(const char *data, size_t len);
+        // Pass the block being filled to the writing thread.
+        void push_write_block();
+        // Write the G-code collected in memory into the file and continue writing into the file.
+        void spill_to_file();
+
         FILE *f = nullptr;
         GCodeProcessor &m_processor;
+        bool                     m_in_memory;
+        size_t                   m_in_memory_limit;
+        size_t                   m_in_memory_size { 0 };
+        std::vector<std::string> m_in_memory_blocks;
+        // Block of G-code to be written into the file once filled.
+        std::string              m_write_block;
+        std::unique_ptr<AsyncWriter> m_async_writer;
     };
     void            _do_export(Print &print, GCodeOutputStream &file, ThumbnailsGeneratorCallback thumbnail_cb);
 
@@ -340,6 +379,7 @@ private:
         const Layer& layer,
         unsigned int extruder_id);
 
+    struct PreparedLayer;
     LayerResult process_layer(
         const Print                     &print,
         // Set of object & print layers of the same PrintObject and with the same print_z.
@@ -354,7 +394,9 @@ private:
         // Otherwise print a single copy of a single object.
         const size_t                     single_object_idx = size_t(-1),
         // BBS
-        const bool                       prime_extruder = false);
+        const bool                       prime_extruder = false,
+        // Output of prepare_layer() for this set of layers, calculated in place if not provided.
+        PreparedLayer                   *prepared_layer = nullptr);
     // Process all layers of all objects (non-sequential mode) with a parallel pipeline:
     // Generate G-code, run the filters (vase mode, cooling buffer), run the G-code analyser
     // and export G-code into file.
@@ -464,7 +506,7 @@ private:
         const size_t             label_object_id;
 	};
 
-	std::vector<InstanceToPrint> sort_print_object_instances(
+	static std::vector<InstanceToPrint> sort_print_object_instances(
 		std::vector<ObjectByExtruder> 					&objects_by_extruder,
 		// Object and Support layers for the current print_z, collected for a single object, or for possibly multiple objects with multiple instances.
 		const std::vector<LayerToPrint> 				&layers,
@@ -473,6 +515,30 @@ private:
 		// For sequential print, the instance of the object to be printing has to be defined.
 		const size_t                     				 single_object_instance_idx);
 
+    // Per-layer data, which does not depend on the state of the G-code generator.
+    // It is calculated for several layers in parallel by a pipeline stage running ahead of the serial process_layer(),
+    // which then only stitches it into its own state.
+    struct PreparedLayer
+    {
+        // One item per LayerToPrint, empty if the overhang speed is not enabled for the object layer.
+        std::vector<std::optional<ExtrusionQualityEstimator::LayerBoundaries>> overhang_boundaries;
+        // One item per LayerToPrint, null if reduce_crossing_wall is disabled.
+        std::vector<std::shared_ptr<const AvoidCrossingPerimeters::LayerBoundaries>> travel_boundaries;
+        // Extrusions of the layers grouped by an extruder, then by an object, an island and a region.
+        std::map<unsigned int, std::vector<ObjectByExtruder>>   by_extruder;
+        // Object instances to be printed by each extruder, referencing by_extruder.
+        std::map<unsigned int, std::vector<InstanceToPrint>>    filament_to_print_instances;
+        bool                                                    is_anything_overridden { false };
+    };
+    static PreparedLayer prepare_layer(
+        const Print                             &print,
+        const std::vector<LayerToPrint>         &layers,
+        const LayerTools                        &layer_tools,
+        // Ordering of the object instances for a normal (non-sequential) print.
+        const std::vector<const PrintInstance*> *ordering,
+        // For sequential print, the instance of the object to be printing.
+        const size_t                             single_object_instance_idx);
+
     std::string     extrude_perimeters(const Print& print, const std::vector<ObjectByExtruder::Island::Region>& by_region, bool is_first_layer, bool is_infill_first);
     std::string     extrude_infill(const Print& print, const std::vector<ObjectByExtruder::Island::Region>& by_region, bool ironing);
     std::string     extrude_support(const ExtrusionEntityCollection& support_fills, const ExtrusionRole support_extrusion_role);
@@ -624,6 +690,8 @@ private:
 
     //some post-processing on the file, with their data class
     std::unique_ptr<FanMover> m_fan_mover;
+    // Timing of the stages of the G-code export pipelines, handed over to PrintStatistics at the end of the export.
+    GCodePipelineStats        m_pipeline_stats;
 
     // BBS
     Print* m_curr_print = nullptr;
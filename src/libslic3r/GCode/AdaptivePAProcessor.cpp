@@ -5,6 +5,7 @@
 
 #include "../GCode.hpp"
 #include "AdaptivePAProcessor.hpp"
+#include <boost/algorithm/string/predicate.hpp>
 #include <sstream>
 #include <iostream>
 #include <cmath>
@@ -60,11 +61,10 @@ AdaptivePAInterpolator* AdaptivePAProcessor::getInterpolator(unsigned int tool_i
  * This method processes the G-code for a single layer, identifying the appropriate
  * pressure advance settings and applying them based on the current state and configurations.
  *
- * @param gcode A string containing the G-code for the layer.
- * @return A string containing the processed G-code with adaptive pressure advance applied.
+ * @param gcode A buffer containing the G-code lines for the layer.
+ * @return The buffer with adaptive pressure advance applied in place of the PA change tags.
  */
-std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
-    std::istringstream stream(gcode);
+GCodeLayerBuffer AdaptivePAProcessor::process_layer(GCodeLayerBuffer &&gcode) {
     std::string line;
     std::ostringstream output;
     double mm3mm_value = 0.0;
@@ -73,16 +73,18 @@ std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
     bool wipe_command = false;
 
     // Iterate through each line of the layer G-code
-    while (std::getline(stream, line)) {
+    const size_t num_lines = gcode.size();
+    for (size_t idx = 0; idx < num_lines; ++ idx) {
         
         // If a wipe start command is found, ignore all speed changes till the wipe end part is found
-        if (line.find("WIPE_START") != std::string::npos) {
+        if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_WIPE_START)) {
             wipe_command = true;
         }
                 
         // Update current feed rate (this is preceding an extrude or wipe command only). Ignore any speed changes that are emitted during a wipe move.
         // Travel feedrate is output as part of a G1 X Y (Z) F command
-        if ( (line.find("G1 F") == 0) && (!wipe_command) ) { // prune lines quickly before running pattern matching
+        if ( (boost::starts_with(gcode.text(idx), "G1 F")) && (!wipe_command) ) { // prune lines quickly before running pattern matching
+            line = gcode.text(idx);
             std::size_t pos = line.find('F');
             if (pos != std::string::npos){
                 m_current_feedrate = std::stod(line.substr(pos + 1)) / 60.0; // Convert from mm/min to mm/s
@@ -90,7 +92,7 @@ std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
         }
         
         // Wipe end found, continue searching for current feed rate.
-        if (line.find("WIPE_END") != std::string::npos) {
+        if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_WIPE_END)) {
             wipe_command = false;
         }
         
@@ -105,7 +107,11 @@ std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
         // as these are the only ones where the PA pattern is output
         // For a mixed extruder layer with both adaptive PA enabled and disabled when the new tool is selected
         // the PA for that material is set. As no tag below will be found for this extruder, the original PA is retained.
-        if (line.find("; PA_CHANGE") == 0) { // prune lines quickly before running regex check as regex is more expensive to run
+        if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_PA_CHANGE)) { // prune lines quickly before running regex check as regex is more expensive to run
+            // The tag is replaced by the pressure advance command.
+            gcode.remove(idx);
+            line = gcode.text(idx);
+            output.str(std::string());
             if (std::regex_search(line, m_match, m_pa_change_pattern)) {
                 int extruder_id = std::stoi(m_match[1].str());
                 mm3mm_value = std::stod(m_match[2].str());
@@ -122,8 +128,6 @@ std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
                 pa_change_line = line;
                 
                 // Look ahead for feedrate before any line containing both G and E commands
-                std::streampos current_pos = stream.tellg();
-                std::string next_line;
                 double temp_feed_rate = 0;
                 bool extrude_move_found = false;
                 int line_counter = 0;
@@ -132,7 +136,8 @@ std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
                 // If a G1 Fxxxx pattern is found, the new speed is identified
                 // Carry on searching for feedrates to find the maximum print speed
                 // until a feature change pattern or a wipe command is detected
-                while (std::getline(stream, next_line)) {
+                for (size_t next_idx = idx + 1; next_idx < num_lines; ++ next_idx) {
+                    const std::string_view next_line = gcode.text(next_idx);
                     line_counter++;
                     // Found an extrude move, set extrude move found flag and move to the next line
                     if ((!extrude_move_found) && next_line.find("G1 ") == 0 &&
@@ -159,7 +164,7 @@ std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
                     // If we have a wipe command, usually the wipe speed is different (larger) than the max print speed
                     // for that feature. So stop searching if a wipe command is found because we do not want to overwrite the
                     // speed used for PA calculation by the Wipe speed.
-                    if (next_line.find("WIPE") != std::string::npos) {
+                    if (gcode.has_tag(next_idx, GCodeLayerBuffer::TAG_WIPE_ANY)) {
                         break; // Stop searching if wipe command is found
                     }
                     
@@ -167,10 +172,10 @@ std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
                     // If RC = 1, it means we have a role change, so stop trying to find the max speed for the feature.
                     // This is possibly redundant as a new feature would always have a travel move preceding it
                     // but check anyway. However check last so to not invoke it without reason...
-                    if (next_line.find("; PA_CHANGE") == 0) { // prune lines quickly before running pattern matching
+                    if (gcode.has_tag(next_idx, GCodeLayerBuffer::TAG_PA_CHANGE)) { // prune lines quickly before running pattern matching
                         std::size_t rc_pos = next_line.rfind("RC:");
                         if (rc_pos != std::string::npos) {
-                            int rc_value = std::stoi(next_line.substr(rc_pos + 3));
+                            int rc_value = std::stoi(std::string(next_line.substr(rc_pos + 3)));
                             if (rc_value == 1) {
                                 break; // Role change found, stop searching
                             }
@@ -180,10 +185,10 @@ std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
                     // Found a Feedrate change command
                     // If the new feedrate is greater than any feedrate encountered so far after the PA change command, use that to calculate the PA value
                     // Also if this is the first feedrate we encounter, store it as the next feedrate.
-                    if (next_line.find("G1 F") == 0) { // prune lines quickly before running pattern matching
+                    if (boost::starts_with(next_line, "G1 F")) { // prune lines quickly before running pattern matching
                         std::size_t pos = next_line.find('F');
                         if (pos != std::string::npos) {
-                            double feedrate = std::stod(next_line.substr(pos + 1)) / 60.0; // Convert from mm/min to mm/s
+                            double feedrate = std::stod(std::string(next_line.substr(pos + 1))) / 60.0; // Convert from mm/min to mm/s
                             if(line_counter==1){ // this is the first command after the PA change pattern, and hence before any extrusion has happened. Reset
                                                 // the current speed to this one
                                 m_current_feedrate = feedrate;
@@ -205,10 +210,6 @@ std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
                 } else // If we didnt find a new feedrate at all after the PA change command, use the current feedrate.
                     m_max_next_feedrate = m_current_feedrate;
                 
-                // Restore stream position
-                stream.clear();
-                stream.seekg(current_pos);
-                
                 // Calculate the predicted PA using the upcomming feature maximum feedrate
                 // Get the interpolator for the active tool
                 AdaptivePAInterpolator* interpolator = getInterpolator(m_last_extruder_id);
@@ -272,14 +273,13 @@ std::string AdaptivePAProcessor::process_layer(std::string &&gcode) {
                     output << m_gcodegen.writer().set_pressure_advance(predicted_pa); // Use m_writer to set pressure advance
                     m_last_predicted_pa = predicted_pa; // Update the last predicted PA value
                 }
+                gcode.insert(idx, output.str());
             }
-        }else {
-            // Output the current line as this isn't a PA change tag
-            output << line << '\n';
         }
     }
 
-    return output.str();
+    gcode.commit();
+    return std::move(gcode);
 }
 
 } // namespace Slic3r
@@ -13,6 +13,7 @@
 #include <map>
 #include <vector>
 #include "AdaptivePAInterpolator.hpp"
+#include "GCodeLayerBuffer.hpp"
 
 namespace Slic3r {
 
@@ -41,10 +42,10 @@ public:
      * This method processes the G-code for a single layer, identifying the appropriate
      * pressure advance settings and applying them based on the current state and configurations.
      *
-     * @param gcode A string containing the G-code for the layer.
-     * @return A string containing the processed G-code with adaptive pressure advance applied.
+     * @param gcode A buffer containing the G-code lines for the layer.
+     * @return The buffer with adaptive pressure advance applied in place of the PA change tags.
      */
-    std::string process_layer(std::string &&gcode);
+    GCodeLayerBuffer process_layer(GCodeLayerBuffer &&gcode);
     
     /**
      * @brief Manually sets adaptive PA internal value.
@@ -1244,21 +1244,14 @@ Polyline AvoidCrossingPerimeters::travel_to(const GCode &gcodegen, const Point &
     Vec2d startf = start.cast<double>();
     Vec2d endf   = end  .cast<double>();
 
-    const ExPolygons               &lslices          = gcodegen.layer()->lslices;
-    const std::vector<BoundingBox> &lslices_bboxes   = gcodegen.layer()->lslices_bboxes;
+    static const LayerBoundaries    no_layer_boundaries {};
+    const LayerBoundaries          &layer_boundaries = m_layer_boundaries ? *m_layer_boundaries : no_layer_boundaries;
     bool                            is_support_layer = (dynamic_cast<const SupportLayer *>(gcodegen.layer()) != nullptr);
-    if (!use_external && (is_support_layer || (!m_lslices_offset.empty() && !any_expolygon_contains(m_lslices_offset, m_lslices_offset_bboxes, m_grid_lslice, travel)))) {
-        // Initialize m_internal only when it is necessary.
-        if (m_internal.boundaries.empty()) {
-            init_boundary(&m_internal, to_polygons(get_boundary(*gcodegen.layer(), get_perimeter_spacing(*gcodegen.layer()))), {start, end});
-        } else if (!(m_internal.bbox.contains(startf) && m_internal.bbox.contains(endf))) {
-            // check if start and end are in bbox, if not, merge start and end points to bbox
-            m_internal.clear();
-            init_boundary(&m_internal, to_polygons(get_boundary(*gcodegen.layer(), get_perimeter_spacing(*gcodegen.layer()))), {start, end});
-        }
-
-        if (!m_internal.boundaries.empty()) {
-            travel_intersection_count = avoid_perimeters(m_internal, start, end, *gcodegen.layer(), result_pl);
+    if (!use_external && (is_support_layer || (!layer_boundaries.lslices_offset.empty() &&
+        !any_expolygon_contains(layer_boundaries.lslices_offset, layer_boundaries.lslices_offset_bboxes, layer_boundaries.grid_lslice, travel)))) {
+        const Boundary &internal = this->internal_boundary(*gcodegen.layer(), start, end);
+        if (!internal.boundaries.empty()) {
+            travel_intersection_count = avoid_perimeters(internal, start, end, *gcodegen.layer(), result_pl);
             result_pl.points.front()  = start;
             result_pl.points.back()   = end;
         }
@@ -1308,33 +1301,102 @@ Polyline AvoidCrossingPerimeters::travel_to(const GCode &gcodegen, const Point &
     } else if (max_detour_length_exceeded) {
         *could_be_wipe_disabled = false;
     } else
-        *could_be_wipe_disabled = !need_wipe(gcodegen, m_lslices_offset, m_lslices_offset_bboxes, m_grid_lslice, travel, result_pl, travel_intersection_count);
+        *could_be_wipe_disabled = !need_wipe(gcodegen, layer_boundaries.lslices_offset, layer_boundaries.lslices_offset_bboxes, layer_boundaries.grid_lslice,
+                                             travel, result_pl, travel_intersection_count);
 
     return result_pl;
 }
 
+const AvoidCrossingPerimeters::Boundary& AvoidCrossingPerimeters::internal_boundary(const Layer &layer, const Point &start, const Point &end)
+{
+    const Vec2d startf = start.cast<double>();
+    const Vec2d endf   = end.cast<double>();
+    const bool  prebuilt = m_layer_boundaries && m_layer == &layer;
+    if (prebuilt && m_layer_boundaries->internal.bbox.contains(startf) && m_layer_boundaries->internal.bbox.contains(endf))
+        return m_layer_boundaries->internal;
+    // Initialize m_internal only when it is necessary.
+    if (m_internal.boundaries.empty() || !(m_internal.bbox.contains(startf) && m_internal.bbox.contains(endf))) {
+        // check if start and end are in bbox, if not, merge start and end points to bbox
+        m_internal.clear();
+        init_boundary(&m_internal, prebuilt ? Polygons(m_layer_boundaries->internal.boundaries) : to_polygons(get_boundary(layer, get_perimeter_spacing(layer))), {start, end});
+    }
+    return m_internal;
+}
+
 // ************************************* AvoidCrossingPerimeters::init_layer() *****************************************
 
-void AvoidCrossingPerimeters::init_layer(const Layer &layer)
+void AvoidCrossingPerimeters::init_layer(const Layer &layer, std::shared_ptr<const LayerBoundaries> boundaries)
 {
     m_internal.clear();
     m_external.clear();
 
-    m_lslices_offset.clear();
-    m_lslices_offset_bboxes.clear();
+    m_layer            = &layer;
+    m_layer_boundaries = boundaries ? std::move(boundaries) : build_layer_boundaries(layer);
+}
+
+std::shared_ptr<const AvoidCrossingPerimeters::LayerBoundaries> AvoidCrossingPerimeters::build_layer_boundaries(const Layer &layer)
+{
+    auto out = std::make_shared<LayerBoundaries>();
+
     for (auto coeff : {0.6f, 0.5f, 0.45f}) {
-        m_lslices_offset = offset_ex(layer.lslices, -get_external_perimeter_width(layer) * coeff);
-        if (!m_lslices_offset.empty()) break;
-    }    
-    m_lslices_offset_bboxes.reserve(m_lslices_offset.size());
-    for (const auto &ex_polygon : m_lslices_offset) m_lslices_offset_bboxes.emplace_back(get_extents(ex_polygon));
+        out->lslices_offset = offset_ex(layer.lslices, -get_external_perimeter_width(layer) * coeff);
+        if (!out->lslices_offset.empty()) break;
+    }
+    out->lslices_offset_bboxes.reserve(out->lslices_offset.size());
+    for (const auto &ex_polygon : out->lslices_offset) out->lslices_offset_bboxes.emplace_back(get_extents(ex_polygon));
 
     BoundingBox bbox_slice(get_extents(layer.lslices));
     bbox_slice.offset(SCALED_EPSILON);
 
-    m_grid_lslice.set_bbox(bbox_slice);
+    out->grid_lslice.set_bbox(bbox_slice);
     //FIXME 1mm grid?
-    m_grid_lslice.create(m_lslices_offset, coord_t(scale_(1.)));
+    out->grid_lslice.create(out->lslices_offset, coord_t(scale_(1.)));
+
+    // Grid of the internal boundary enlarged the same way as when built for a travel in travel_to(),
+    // travels leaving it get a boundary of their own.
+    if (Polygons boundaries = to_polygons(get_boundary(layer, get_perimeter_spacing(layer))); !boundaries.empty())
+        init_boundary(&out->internal, std::move(boundaries), {});
+    return out;
+}
+
+std::shared_ptr<const AvoidCrossingPerimeters::LayerBoundaries> AvoidCrossingPerimeters::LayerBoundariesCache::get(const Layer &layer)
+{
+    {
+        std::scoped_lock<std::mutex> lock(m_mutex);
+        if (auto it = m_entries.find(&layer); it != m_entries.end())
+            return it->second.boundaries;
+    }
+    // Build outside of the lock. If two threads build the same layer, the first one stored wins.
+    std::shared_ptr<const LayerBoundaries> boundaries = build_layer_boundaries(layer);
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    return m_entries.insert({ &layer, Entry{ std::move(boundaries), layer.slice_z, dynamic_cast<const SupportLayer*>(&layer) != nullptr } }).first->second.boundaries;
+}
+
+void AvoidCrossingPerimeters::LayerBoundariesCache::invalidate(coordf_t z_min, coordf_t z_max)
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+        // Same test as PrintObject::layers_to_process(), the boundaries of all the reprocessed layers are removed.
+        if (it->second.support_layer || (it->second.slice_z >= z_min - EPSILON && it->second.slice_z <= z_max + EPSILON))
+            it = m_entries.erase(it);
+        else
+            ++ it;
+}
+
+void AvoidCrossingPerimeters::LayerBoundariesCache::clear_support_layers()
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+        if (it->second.support_layer)
+            it = m_entries.erase(it);
+        else
+            ++ it;
+}
+
+void AvoidCrossingPerimeters::LayerBoundariesCache::clear()
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    m_entries.clear();
 }
 
 #if 0
@@ -5,6 +5,10 @@
 #include "../ExPolygon.hpp"
 #include "../EdgeGrid.hpp"
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 namespace Slic3r {
 
 // Forward declarations.
@@ -24,7 +28,9 @@ public:
     bool        disabled_once() const   { return m_disabled_once; }
     void        reset_once_modifiers()  { m_use_external_mp_once = false; m_disabled_once = false; }
 
-    void        init_layer(const Layer &layer);
+    struct LayerBoundaries;
+    // Initialize for the next layer. If the boundaries are not passed, they are built for the layer.
+    void        init_layer(const Layer &layer, std::shared_ptr<const LayerBoundaries> boundaries = nullptr);
 
     Polyline    travel_to(const GCode& gcodegen, const Point& point)
     {
@@ -51,7 +57,43 @@ public:
         }
     };
 
+    // Data of a single layer, which depends on the layer only, not on the travel being planned.
+    // They are built for many layers in parallel ahead of the G-code generation, see GCode::prepare_layer().
+    struct LayerBoundaries {
+        // Lslices offseted by half an external perimeter width.
+        ExPolygons               lslices_offset;
+        std::vector<BoundingBox> lslices_offset_bboxes;
+        EdgeGrid::Grid           grid_lslice;
+        // Boundary for travels inside the object with the grid covering the boundary enlarged by its radius.
+        // Travels outside of the grid use a boundary built for them.
+        Boundary                 internal;
+    };
+    static std::shared_ptr<const LayerBoundaries> build_layer_boundaries(const Layer &layer);
+
+    // LayerBoundaries of the layers of a single PrintObject, retained between G-code exports until the layers are reprocessed.
+    // Thread safe.
+    class LayerBoundariesCache {
+    public:
+        // Returns the cached boundaries of a layer, builds them if not cached.
+        std::shared_ptr<const LayerBoundaries> get(const Layer &layer);
+        // Remove the boundaries of the object layers with slice_z in [z_min, z_max] and of all the support layers.
+        void invalidate(coordf_t z_min, coordf_t z_max);
+        void clear_support_layers();
+        void clear();
+
+    private:
+        struct Entry {
+            std::shared_ptr<const LayerBoundaries> boundaries;
+            coordf_t                               slice_z;
+            bool                                   support_layer;
+        };
+        std::mutex                                m_mutex;
+        std::unordered_map<const Layer*, Entry>   m_entries;
+    };
+
 private:
+    const Boundary& internal_boundary(const Layer &layer, const Point &start, const Point &end);
+
     bool           m_use_external_mp { false };
     // just for the next travel move
     bool           m_use_external_mp_once { false };
@@ -59,12 +101,10 @@ private:
     // we enable it by default for the first travel move in print
     bool           m_disabled_once { true };
 
-    // Lslices offseted by half an external perimeter width. Used for detection if line or polyline is inside of any polygon.
-    ExPolygons               m_lslices_offset;
-    std::vector<BoundingBox> m_lslices_offset_bboxes;
-    // Used for detection of line or polyline is inside of any polygon.
-    EdgeGrid::Grid m_grid_lslice;
-    // Store all needed data for travels inside object
+    // Boundaries of the layer passed to init_layer().
+    const Layer                            *m_layer { nullptr };
+    std::shared_ptr<const LayerBoundaries>  m_layer_boundaries;
+    // Store all needed data for travels inside object, which are not covered by m_layer_boundaries->internal
     Boundary m_internal;
     // Store all needed data for travels outside object
     Boundary m_external;
@@ -73,8 +73,8 @@ struct CoolingLine
         TYPE_IRONING_FAN_END           = 1 << 20,
     };
 
-    CoolingLine(unsigned int type, size_t  line_start, size_t  line_end) :
-        type(type), line_start(line_start), line_end(line_end),
+    CoolingLine(unsigned int type, size_t line) :
+        type(type), line(line),
         length(0.f), feedrate(0.f), time(0.f), time_max(0.f), slowdown(false) {}
 
     bool adjustable(bool slowdown_external_perimeters) const {
@@ -88,10 +88,8 @@ struct CoolingLine
     }
 
     size_t  type;
-    // Start of this line at the G-code snippet.
-    size_t  line_start;
-    // End of this line at the G-code snippet.
-    size_t  line_end;
+    // Index of this line in the G-code buffer.
+    size_t  line;
     // XY Euclidian length of this segment.
     float   length;
     // Current feedrate, possibly adjusted.
@@ -313,29 +311,27 @@ finished:
 	return new_feedrate;
 }
 
-std::string CoolingBuffer::process_layer(std::string &&gcode, size_t layer_id, bool flush)
+GCodeLayerBuffer CoolingBuffer::process_layer(GCodeLayerBuffer &&gcode, size_t layer_id, bool flush)
 {
     // Cache the input G-code.
-    if (m_gcode.empty())
-        m_gcode = std::move(gcode);
-    else
-        m_gcode += gcode;
+    m_gcode.append(std::move(gcode));
 
-    std::string out;
+    GCodeLayerBuffer out;
     if (flush) {
         // This is either an object layer or the very last print layer. Calculate cool down over the collected support layers
         // and one object layer.
         std::vector<PerExtruderAdjustments> per_extruder_adjustments = this->parse_layer_gcode(m_gcode, m_current_pos);
         float layer_time_stretched = this->calculate_layer_slowdown(per_extruder_adjustments);
-        out = this->apply_layer_cooldown(m_gcode, layer_id, layer_time_stretched, per_extruder_adjustments);
-        m_gcode.clear();
+        this->apply_layer_cooldown(m_gcode, layer_id, layer_time_stretched, per_extruder_adjustments);
+        out = std::move(m_gcode);
+        m_gcode = GCodeLayerBuffer();
     }
     return out;
 }
 
 // Parse the layer G-code for the moves, which could be adjusted.
 // Return the list of parsed lines, bucketed by an extruder.
-std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::string &gcode, std::vector<float> &current_pos) const
+std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const GCodeLayerBuffer &gcode, std::vector<float> &current_pos) const
 {
     std::vector<PerExtruderAdjustments> per_extruder_adjustments(m_extruder_ids.size());
     std::vector<size_t>                 map_extruder_to_per_extruder_adjustment(m_num_extruders, 0);
@@ -353,8 +349,6 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
 
     unsigned int      current_extruder  = m_current_extruder;
     PerExtruderAdjustments *adjustment  = &per_extruder_adjustments[map_extruder_to_per_extruder_adjustment[current_extruder]];
-    const char       *line_start = gcode.c_str();
-    const char       *line_end   = line_start;
     // Index of an existing CoolingLine of the current adjustment, which holds the feedrate setting command
     // for a sequence of extrusion moves.
     size_t            active_speed_modifier = size_t(-1);
@@ -363,16 +357,11 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
     // Time of any other movements before the first extrusion will be excluded from the layer time.
     bool layer_had_extrusion = false;
 
-    for (; *line_start != 0; line_start = line_end)
+    for (size_t idx = 0; idx < gcode.size(); ++ idx)
     {
-        while (*line_end != '\n' && *line_end != 0)
-            ++ line_end;
-        // sline will not contain the trailing '\n'.
-        std::string sline(line_start, line_end);
-        // CoolingLine will contain the trailing '\n'.
-        if (*line_end == '\n')
-            ++ line_end;
-        CoolingLine line(0, line_start - gcode.c_str(), line_end - gcode.c_str());
+        // sline will not contain the trailing '\n', it is followed by the end of line in the buffer.
+        const std::string_view sline = gcode.text(idx);
+        CoolingLine line(0, idx);
         if (boost::starts_with(sline, "G0 "))
             line.type = CoolingLine::TYPE_G0;
         else if (boost::starts_with(sline, "G1 "))
@@ -385,22 +374,12 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
             line.type = CoolingLine::TYPE_G3;
         if (line.type) {
             // G0, G1 or G92
-            // Parse the G-code line.
+            // The G-code line was parsed by the buffer.
             std::vector<float> new_pos(current_pos);
-            const char *c = sline.data() + 3;
-            for (;;) {
-                // Skip whitespaces.
-                for (; *c == ' ' || *c == '\t'; ++ c);
-                if (*c == 0 || *c == ';')
-                    break;
-
-                assert(is_decimal_separator_point()); // for atof
-                //BBS: Parse the axis.
-                size_t axis = (*c >= 'X' && *c <= 'Z') ? (*c - 'X') :
-                              (*c == 'E') ? 3 : (*c == 'F') ? 4 :
-                              (*c == 'I') ? 5 : (*c == 'J') ? 6 : size_t(-1);
-                if (axis != size_t(-1)) {
-                    new_pos[axis] = float(atof(++c));
+            //BBS: X,Y,Z,E,F,I,J
+            for (size_t axis = 0; axis < 7; ++ axis)
+                if (gcode.has(idx, Axis(axis))) {
+                    new_pos[axis] = gcode.value(idx, Axis(axis));
                     if (axis == 4) {
                         // Convert mm/min to mm/sec.
                         new_pos[4] /= 60.f;
@@ -412,18 +391,15 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
                         new_pos[axis] += current_pos[axis - 5];
                     }
                 }
-                // Skip this word.
-                for (; *c != ' ' && *c != '\t' && *c != 0; ++ c);
-            }
-            bool external_perimeter = boost::contains(sline, ";_EXTERNAL_PERIMETER");
-            bool wipe               = boost::contains(sline, ";_WIPE");
+            bool external_perimeter = gcode.has_tag(idx, GCodeLayerBuffer::TAG_EXTERNAL_PERIMETER);
+            bool wipe               = gcode.has_tag(idx, GCodeLayerBuffer::TAG_WIPE);
             if (external_perimeter)
                 line.type |= CoolingLine::TYPE_EXTERNAL_PERIMETER;
             if (wipe)
                 line.type |= CoolingLine::TYPE_WIPE;
 
             // Orca: only slow down movements since the first extrusion
-            if (boost::contains(sline, ";_EXTRUDE_SET_SPEED"))
+            if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_EXTRUDE_SET_SPEED))
                 layer_had_extrusion = true;
             
             // ORCA: Dont slowdown external perimeters for layer time feature
@@ -433,7 +409,7 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
             
             // ORCA: Dont slowdown external perimeters for layer time works by not marking the external perimeter as adjustable, 
             // hence the slowdown algorithm ignores it.
-            if (boost::contains(sline, ";_EXTRUDE_SET_SPEED") && ! wipe && adjust_external) {
+            if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_EXTRUDE_SET_SPEED) && ! wipe && adjust_external) {
                 line.type |= CoolingLine::TYPE_ADJUSTABLE;
                 active_speed_modifier = adjustment->lines.size();
             }
@@ -493,7 +469,7 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
                 }
             }
             current_pos = std::move(new_pos);
-        } else if (boost::starts_with(sline, ";_EXTRUDE_END")) {
+        } else if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_EXTRUDE_END) && boost::starts_with(sline, ";_EXTRUDE_END")) {
             line.type = CoolingLine::TYPE_EXTRUDE_END;
             active_speed_modifier = size_t(-1);
         } else if (boost::starts_with(sline, m_toolchange_prefix)) {
@@ -515,21 +491,21 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
                         BOOST_LOG_TRIVIAL(error) << "CoolingBuffer encountered an invalid toolchange, maybe from a custom gcode: " << sline;
                 }
             }
-        } else if (boost::starts_with(sline, ";_OVERHANG_FAN_START")) {
+        } else if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_OVERHANG_FAN_START)) {
             line.type = CoolingLine::TYPE_OVERHANG_FAN_START;
-        } else if (boost::starts_with(sline, ";_OVERHANG_FAN_END")) {
+        } else if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_OVERHANG_FAN_END)) {
             line.type = CoolingLine::TYPE_OVERHANG_FAN_END;
-        } else if (boost::starts_with(sline, ";_INTERNAL_BRIDGE_FAN_START")) { // ORCA: Add support for separate internal bridge fan speed control
+        } else if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_INTERNAL_BRIDGE_FAN_START)) { // ORCA: Add support for separate internal bridge fan speed control
             line.type = CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_START;
-        } else if (boost::starts_with(sline, ";_INTERNAL_BRIDGE_FAN_END")) { // ORCA: Add support for separate internal bridge fan speed control
+        } else if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_INTERNAL_BRIDGE_FAN_END)) { // ORCA: Add support for separate internal bridge fan speed control
             line.type = CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_END;
-        } else if (boost::starts_with(sline, ";_SUPP_INTERFACE_FAN_START")) {
+        } else if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_SUPPORT_INTERFACE_FAN_START)) {
             line.type = CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_START;
-        } else if (boost::starts_with(sline, ";_SUPP_INTERFACE_FAN_END")) {
+        } else if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_SUPPORT_INTERFACE_FAN_END)) {
             line.type = CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_END;
-        } else if (boost::starts_with(sline, ";_IRONING_FAN_START")) { // ORCA: Add support for ironing fan speed control
+        } else if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_IRONING_FAN_START)) { // ORCA: Add support for ironing fan speed control
             line.type = CoolingLine::TYPE_IRONING_FAN_START;
-        } else if (boost::starts_with(sline, ";_IRONING_FAN_END")) { // ORCA: Add support for ironing fan speed control
+        } else if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_IRONING_FAN_END)) { // ORCA: Add support for ironing fan speed control
             line.type = CoolingLine::TYPE_IRONING_FAN_END;
         } else if (boost::starts_with(sline, "G4 ")) {
             // Parse the wait time.
@@ -538,9 +514,9 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
             size_t pos_P = sline.find('P', 3);
             assert(is_decimal_separator_point()); // for atof
             line.time = line.time_max = float(
-                (pos_S > 0) ? atof(sline.c_str() + pos_S + 1) :
-                (pos_P > 0) ? atof(sline.c_str() + pos_P + 1) * 0.001 : 0.);
-        } else if (boost::starts_with(sline, ";_FORCE_RESUME_FAN_SPEED")) {
+                (pos_S > 0) ? atof(sline.data() + pos_S + 1) :
+                (pos_P > 0) ? atof(sline.data() + pos_P + 1) * 0.001 : 0.);
+        } else if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_FORCE_RESUME_FAN_SPEED)) {
             line.type = CoolingLine::TYPE_FORCE_RESUME_FAN;
         }
 
@@ -693,10 +669,10 @@ float CoolingBuffer::calculate_layer_slowdown(std::vector<PerExtruderAdjustments
 }
 
 // Apply slow down over G-code lines stored in per_extruder_adjustments, enable fan if needed.
-// Returns the adjusted G-code.
-std::string CoolingBuffer::apply_layer_cooldown(
+// The G-code is adjusted in place.
+void CoolingBuffer::apply_layer_cooldown(
     // Source G-code for the current layer.
-    const std::string                      &gcode,
+    GCodeLayerBuffer                       &gcode,
     // ID of the current layer, used to disable fan for the first n layers.
     size_t                                  layer_id,
     // Total time of this layer after slow down, used to control the fan.
@@ -714,11 +690,10 @@ std::string CoolingBuffer::apply_layer_cooldown(
         for (const PerExtruderAdjustments &adj : per_extruder_adjustments)
             for (const CoolingLine &line : adj.lines)
                 lines.emplace_back(&line);
-        std::sort(lines.begin(), lines.end(), [](const CoolingLine *ln1, const CoolingLine *ln2) { return ln1->line_start < ln2->line_start; } );
+        std::sort(lines.begin(), lines.end(), [](const CoolingLine *ln1, const CoolingLine *ln2) { return ln1->line < ln2->line; } );
     }
-    // Second generate the adjusted G-code.
+    // Second adjust the G-code. G-code emitted in front of the current line.
     std::string new_gcode;
-    new_gcode.reserve(gcode.size() * 2);
     bool overhang_fan_control= false;
     int  overhang_fan_speed   = 0;
     bool internal_bridge_fan_control= false; // ORCA: Add support for separate internal bridge fan speed control
@@ -816,9 +791,9 @@ std::string CoolingBuffer::apply_layer_cooldown(
         }
     };
 
-    const char         *pos               = gcode.c_str();
     int                 current_feedrate  = 0;
     change_extruder_set_fan(true);
+    gcode.insert(0, new_gcode);
 
     // Orca: Reduce set fan commands by deferring the GCodeWriter::set_fan calls. Inspired by SuperSlicer
     // define fan_speed_change_requests and initialize it with all possible types fan speed change requests
@@ -830,61 +805,67 @@ std::string CoolingBuffer::apply_layer_cooldown(
     bool need_set_fan = false;
 
     for (const CoolingLine *line : lines) {
-        const char *line_start  = gcode.c_str() + line->line_start;
-        const char *line_end    = gcode.c_str() + line->line_end;
-        if (line_start > pos)
-            new_gcode.append(pos, line_start - pos);
+        new_gcode.clear();
         if (line->type & CoolingLine::TYPE_SET_TOOL) {
+            const std::string_view sline = gcode.text(line->line);
             unsigned int new_extruder = 0;
-            auto ret = std::from_chars(line_start + m_toolchange_prefix.size(), line_end, new_extruder);
+            auto ret = std::from_chars(sline.data() + m_toolchange_prefix.size(), sline.data() + sline.size(), new_extruder);
             if (std::errc::invalid_argument != ret.ec) {
                 if (new_extruder != m_current_extruder) {
                     m_current_extruder = new_extruder;
                     change_extruder_set_fan(true);
                 }
             }
-            new_gcode.append(line_start, line_end - line_start);
         } else if (line->type & CoolingLine::TYPE_OVERHANG_FAN_START) {
+            gcode.remove(line->line);
             if (overhang_fan_control && !fan_speed_change_requests[CoolingLine::TYPE_OVERHANG_FAN_START]) {
                 need_set_fan = true;
                 fan_speed_change_requests[CoolingLine::TYPE_OVERHANG_FAN_START] = true;
            }
         } else if (line->type & CoolingLine::TYPE_OVERHANG_FAN_END) {
+            gcode.remove(line->line);
             if (overhang_fan_control && fan_speed_change_requests[CoolingLine::TYPE_OVERHANG_FAN_START]) {
                 fan_speed_change_requests[CoolingLine::TYPE_OVERHANG_FAN_START] = false;
             }
             need_set_fan = true;
         } else if (line->type & CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_START) { // ORCA: Add support for separate internal bridge fan speed control
+            gcode.remove(line->line);
             if (internal_bridge_fan_control && !fan_speed_change_requests[CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_START]) {
                 need_set_fan = true;
                 fan_speed_change_requests[CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_START] = true;
            }
         } else if (line->type & CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_END) { // ORCA: Add support for separate internal bridge fan speed control
+            gcode.remove(line->line);
             if (internal_bridge_fan_control && fan_speed_change_requests[CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_START]) {
                 fan_speed_change_requests[CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_START] = false;
             }
             need_set_fan = true;
         } else if (line->type & CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_START) {
+            gcode.remove(line->line);
             if (supp_interface_fan_control && !fan_speed_change_requests[CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_START]) {
                 fan_speed_change_requests[CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_START] = true;
                 need_set_fan = true;
             }
         } else if (line->type & CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_END && fan_speed_change_requests[CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_START]) {
+            gcode.remove(line->line);
             if (supp_interface_fan_control) {
                 fan_speed_change_requests[CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_START] = false;
             }
             need_set_fan = true;
         } else if (line->type & CoolingLine::TYPE_IRONING_FAN_START) {
+            gcode.remove(line->line);
             if (ironing_fan_control && !fan_speed_change_requests[CoolingLine::TYPE_IRONING_FAN_START]) {
                 fan_speed_change_requests[CoolingLine::TYPE_IRONING_FAN_START] = true;
                 need_set_fan = true;
             }
         } else if (line->type & CoolingLine::TYPE_IRONING_FAN_END && fan_speed_change_requests[CoolingLine::TYPE_IRONING_FAN_START]) {
+            gcode.remove(line->line);
             if (ironing_fan_control) {
                 fan_speed_change_requests[CoolingLine::TYPE_IRONING_FAN_START] = false;
             }
             need_set_fan = true;
         } else if (line->type & CoolingLine::TYPE_FORCE_RESUME_FAN) {
+            gcode.remove(line->line);
             // check if any fan speed change request is active
             if (m_fan_speed != -1 && !std::any_of(fan_speed_change_requests.begin(), fan_speed_change_requests.end(), [](const std::pair<int, bool>& p) { return p.second; })){
                 fan_speed_change_requests[CoolingLine::TYPE_FORCE_RESUME_FAN] = true;
@@ -895,44 +876,56 @@ std::string CoolingBuffer::apply_layer_cooldown(
         }
         else if (line->type & CoolingLine::TYPE_EXTRUDE_END) {
             // Just remove this comment.
+            gcode.remove(line->line);
         } else if (line->type & (CoolingLine::TYPE_ADJUSTABLE | CoolingLine::TYPE_EXTERNAL_PERIMETER | CoolingLine::TYPE_WIPE | CoolingLine::TYPE_HAS_F)) {
+            // The source line including its end of line and the adjusted line.
+            const std::string source_line = std::string(gcode.text(line->line)) + '\n';
+            const char *line_start = source_line.c_str();
+            const char *line_end   = line_start + source_line.size();
+            std::string new_line;
             // Find the start of a comment, or roll to the end of line.
             const char *end = line_start;
             for (; end < line_end && *end != ';'; ++ end);
             // Find the 'F' word.
-            const char *fpos            = strstr(line_start + 2, " F") + 2;
+            const char *fpos            = strstr(line_start + 2, " F");
             int         new_feedrate    = current_feedrate;
             // Modify the F word of the current G-code line.
             bool        modify          = false;
             // Remove the F word from the current G-code line.
             bool        remove          = false;
-            assert(fpos != nullptr);
-            new_feedrate = line->slowdown ? int(floor(60. * line->feedrate + 0.5)) : atoi(fpos);
-            if (new_feedrate == current_feedrate) {
-                // No need to change the F value.
-                if ((line->type & (CoolingLine::TYPE_ADJUSTABLE | CoolingLine::TYPE_EXTERNAL_PERIMETER | CoolingLine::TYPE_WIPE)) || line->length == 0.)
-                    // Feedrate does not change and this line does not move the print head. Skip the complete G-code line including the G-code comment.
-                    end = line_end;
-                else
-                    // Remove the feedrate from the G0/G1 line. The G-code line may become empty!
-                    remove = true;
-            } else if (line->slowdown) {
-                // The F value will be overwritten.
-                modify = true;
+            if (fpos == nullptr) {
+                // The line does not set the feedrate, thus it is kept as it is.
+                new_line = source_line;
+                end      = line_end;
             } else {
-                // The F value is different from current_feedrate, but not slowed down, thus the G-code line will not be modified.
-                // Emit the line without the comment.
-                new_gcode.append(line_start, end - line_start);
-                current_feedrate = new_feedrate;
+                fpos += 2;
+                new_feedrate = line->slowdown ? int(floor(60. * line->feedrate + 0.5)) : atoi(fpos);
+                if (new_feedrate == current_feedrate) {
+                    // No need to change the F value.
+                    if ((line->type & (CoolingLine::TYPE_ADJUSTABLE | CoolingLine::TYPE_EXTERNAL_PERIMETER | CoolingLine::TYPE_WIPE)) || line->length == 0.)
+                        // Feedrate does not change and this line does not move the print head. Skip the complete G-code line including the G-code comment.
+                        end = line_end;
+                    else
+                        // Remove the feedrate from the G0/G1 line. The G-code line may become empty!
+                        remove = true;
+                } else if (line->slowdown) {
+                    // The F value will be overwritten.
+                    modify = true;
+                } else {
+                    // The F value is different from current_feedrate, but not slowed down, thus the G-code line will not be modified.
+                    // Emit the line without the comment.
+                    new_line.append(line_start, end - line_start);
+                    current_feedrate = new_feedrate;
+                }
             }
             if (modify || remove) {
                 if (modify) {
                     // Replace the feedrate.
-                    new_gcode.append(line_start, fpos - line_start);
+                    new_line.append(line_start, fpos - line_start);
                     current_feedrate = new_feedrate;
                     char buf[64];
                     sprintf(buf, "%d", int(current_feedrate));
-                    new_gcode += buf;
+                    new_line += buf;
                 } else {
                     // Remove the feedrate word.
                     const char *f = fpos;
@@ -943,7 +936,7 @@ std::string CoolingBuffer::apply_layer_cooldown(
                         // BBS: only remain "G1" or "G0" of this line after remove 'F' part, don't save
                     } else {
                         // Append up to the F word, without the trailing whitespace.
-                        new_gcode.append(line_start, f - line_start + 1);
+                        new_line.append(line_start, f - line_start + 1);
                     }
                 }
                 // Skip the non-whitespaces of the F parameter up the comment or end of line.
@@ -951,10 +944,10 @@ std::string CoolingBuffer::apply_layer_cooldown(
                 // Append the rest of the line without the comment.
                 if (fpos < end)
                     // The G-code line is not empty yet. Emit the rest of it.
-                    new_gcode.append(fpos, end - fpos);
-                else if (remove && new_gcode == "G1") {
+                    new_line.append(fpos, end - fpos);
+                else if (remove && new_line == "G1") {
                     // The G-code line only contained the F word, now it is empty. Remove it completely including the comments.
-                    new_gcode.resize(new_gcode.size() - 2);
+                    new_line.resize(new_line.size() - 2);
                     end = line_end;
                 }
             }
@@ -968,17 +961,26 @@ std::string CoolingBuffer::apply_layer_cooldown(
                         boost::replace_all(comment, ";_EXTERNAL_PERIMETER", "");
                     if (line->type & CoolingLine::TYPE_WIPE)
                         boost::replace_all(comment, ";_WIPE", "");
-                    new_gcode += comment;
+                    new_line += comment;
                 } else {
                     // Just attach the rest of the source line.
-                    new_gcode.append(end, line_end - end);
+                    new_line.append(end, line_end - end);
                 }
             }
-        } else {
-            new_gcode.append(line_start, line_end - line_start);
+            if (new_line.empty())
+                gcode.remove(line->line);
+            else if (new_line != source_line) {
+                // Replace the line, the adjusted line ends with the end of line of the source line.
+                assert(new_line.back() == '\n');
+                new_line.pop_back();
+                gcode.replace(line->line, new_line);
+            }
         }
 
+        // Emit the G-code in front of the line and the fan speed change behind it.
+        gcode.insert(line->line, new_gcode);
         if (need_set_fan) {
+            new_gcode.clear();
             if (fan_speed_change_requests[CoolingLine::TYPE_OVERHANG_FAN_START]){
                 new_gcode += GCodeWriter::set_fan(m_config.gcode_flavor, overhang_fan_speed);
                 m_current_fan_speed = overhang_fan_speed;
@@ -1000,15 +1002,11 @@ std::string CoolingBuffer::apply_layer_cooldown(
             }
             else
                 new_gcode += GCodeWriter::set_fan(m_config.gcode_flavor, m_fan_speed);
+            gcode.insert(line->line + 1, new_gcode);
             need_set_fan = false;
         }
-        pos = line_end;
     }
-    const char *gcode_end = gcode.c_str() + gcode.size();
-    if (pos < gcode_end)
-        new_gcode.append(pos, gcode_end - pos);
-
-    return new_gcode;
+    gcode.commit();
 }
 
 } // namespace Slic3r
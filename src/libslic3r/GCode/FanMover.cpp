@@ -1,7 +1,5 @@
 #include "FanMover.hpp"
 
-#include "GCodeReader.hpp"
-
 #include <iomanip>
 /*
 #include <memory.h>
@@ -19,26 +17,42 @@
 
 namespace Slic3r {
 
-const std::string& FanMover::process_gcode(const std::string& gcode, bool flush)
+GCodeLayerBuffer FanMover::process_gcode(GCodeLayerBuffer &&gcode, bool flush)
 {
-    m_process_output = "";
+    m_gcode = &gcode;
+    m_process_output.clear();
+    m_process_output.reserve(gcode.size());
 
     // recompute buffer time to recover from rounding
     m_buffer_time_size = 0;
     for (auto& data : m_buffer) m_buffer_time_size += data.time;
 
-    if(!gcode.empty())
-        m_parser.parse_buffer(gcode,
-            [this](GCodeReader& reader, const GCodeReader::GCodeLine& line) { /*m_process_output += line.raw() + "\n";*/ this->_process_gcode_line(reader, line); });
+    for (size_t idx = 0; idx < gcode.size(); ++ idx) {
+        m_position.start_line(gcode, idx);
+        // The position is updated by the line as it was parsed, not as it is modified by splitting.
+        GCodeLayerBuffer::Position next_position = m_position;
+        next_position.end_line(gcode, idx);
+        this->_process_gcode_line(idx);
+        m_position = next_position;
+    }
 
     if (flush) {
         while (!m_buffer.empty()) {
-            m_process_output += m_buffer.front().raw + "\n";
+            _output(m_buffer.front());
             remove_from_buffer(m_buffer.begin());
         }
+    } else {
+        // The lines kept in the buffer will be output with the next G-code.
+        for (BufferData& data : m_buffer)
+            if (data.line != BufferData::NO_LINE) {
+                data.raw  = std::string(gcode.text(data.line));
+                data.line = BufferData::NO_LINE;
+            }
     }
 
-    return m_process_output;
+    gcode.reorder(m_process_output);
+    m_gcode = nullptr;
+    return std::move(gcode);
 }
 
 bool is_end_of_word(char c) {
@@ -108,6 +122,29 @@ int16_t get_fan_speed(const std::string &line, GCodeFlavor flavor) {
 
 }
 
+void FanMover::_change_axis(BufferData& data, Axis axis, const float new_value, const int decimal_digits)
+{
+    if (data.line == BufferData::NO_LINE)
+        change_axis_value(data.raw, "XYZE"[axis], new_value, decimal_digits);
+    else
+        m_gcode->change_axis(data.line, axis, new_value, decimal_digits);
+}
+
+void FanMover::_output(const BufferData& data)
+{
+    if (data.line == BufferData::NO_LINE)
+        _output(data.raw + "\n");
+    else
+        m_process_output.emplace_back(data.line);
+}
+
+void FanMover::_output(const std::string& text)
+{
+    // The text is split into lines, an end of line is added to the last line if missing.
+    for (size_t idx = m_gcode->add(text); idx < m_gcode->size(); ++ idx)
+        m_process_output.emplace_back(idx);
+}
+
 void FanMover::_put_in_middle_G1(std::list<BufferData>::iterator item_to_split, float nb_sec_since_itemtosplit_start, BufferData &&line_to_write) {
     assert(item_to_split != m_buffer.end());
     if (nb_sec_since_itemtosplit_start > item_to_split->time * 0.9) {
@@ -117,41 +154,43 @@ void FanMover::_put_in_middle_G1(std::list<BufferData>::iterator item_to_split,
         // doesn't really need to be split, print it before
         //will also print before if line_to_split.time == 0
         m_buffer.insert(item_to_split, line_to_write);
-    } else if (item_to_split->raw.size() > 2
-        && item_to_split->raw[0] == 'G' && item_to_split->raw[1] == '1' && item_to_split->raw[2] == ' ') {
+    } else if (_text(*item_to_split).size() > 2
+        && _text(*item_to_split)[0] == 'G' && _text(*item_to_split)[1] == '1' && _text(*item_to_split)[2] == ' ') {
         float percent = nb_sec_since_itemtosplit_start / item_to_split->time;
         BufferData before = *item_to_split;
+        if (before.line != BufferData::NO_LINE)
+            before.line = m_gcode->add_copy(before.line);
         before.time *= percent;
         item_to_split->time *= (1-percent);
         if (item_to_split->dx != 0) {
             before.dx = item_to_split->dx * percent;
             item_to_split->x += before.dx;
             item_to_split->dx = item_to_split->dx * (1-percent);
-            change_axis_value(before.raw, 'X', before.x + before.dx, 3);
+            _change_axis(before, X, before.x + before.dx, 3);
         }
         if (item_to_split->dy != 0) {
             before.dy = item_to_split->dy * percent;
             item_to_split->y += before.dy;
             item_to_split->dy = item_to_split->dy * (1 - percent);
-            change_axis_value(before.raw, 'Y', before.y + before.dy, 3);
+            _change_axis(before, Y, before.y + before.dy, 3);
         }
         if (item_to_split->dz != 0) {
             before.dz = item_to_split->dz * percent;
             item_to_split->z += before.dz;
             item_to_split->dz = item_to_split->dz * (1 - percent);
-            change_axis_value(before.raw, 'Z', before.z + before.dz, 3);
+            _change_axis(before, Z, before.z + before.dz, 3);
         }
         if (item_to_split->de != 0) {
             if (relative_e) {
                 before.de = item_to_split->de * percent;
-                change_axis_value(before.raw, 'E', before.de, 5);
+                _change_axis(before, E, before.de, 5);
                 item_to_split->de = item_to_split->de * (1 - percent);
-                change_axis_value(item_to_split->raw, 'E', item_to_split->de, 5);
+                _change_axis(*item_to_split, E, item_to_split->de, 5);
             } else {
                 before.de = item_to_split->de * percent;
                 item_to_split->e += before.de;
                 item_to_split->de = item_to_split->de * (1 - percent);
-                change_axis_value(before.raw, 'E', before.e + before.de, 5);
+                _change_axis(before, E, before.e + before.de, 5);
             }
         }
         //add before then line_to_write, then there is the modified data.
@@ -167,43 +206,45 @@ void FanMover::_put_in_middle_G1(std::list<BufferData>::iterator item_to_split,
 void FanMover::_print_in_middle_G1(BufferData& line_to_split, float nb_sec, const std::string &line_to_write) {
     if (nb_sec < line_to_split.time * 0.1) {
         // doesn't really need to be split, print it after
-        m_process_output += line_to_split.raw + "\n";
-        m_process_output += line_to_write + (line_to_write.back() == '\n'?"":"\n");
+        _output(line_to_split);
+        _output(line_to_write);
     } else if (nb_sec > line_to_split.time * 0.9) {
         // doesn't really need to be split, print it before
         //will also print before if line_to_split.time == 0
-        m_process_output += line_to_write + (line_to_write.back() == '\n' ? "" : "\n");
-        m_process_output += line_to_split.raw + "\n";
-    }else if(line_to_split.raw.size() > 2
-        && line_to_split.raw[0] == 'G' && line_to_split.raw[1] == '1' && line_to_split.raw[2] == ' ') {
+        _output(line_to_write);
+        _output(line_to_split);
+    }else if(_text(line_to_split).size() > 2
+        && _text(line_to_split)[0] == 'G' && _text(line_to_split)[1] == '1' && _text(line_to_split)[2] == ' ') {
         float percent = nb_sec / line_to_split.time;
-        std::string before = line_to_split.raw;
-        std::string& after = line_to_split.raw;
+        BufferData before = line_to_split;
+        if (before.line != BufferData::NO_LINE)
+            before.line = m_gcode->add_copy(before.line);
+        BufferData& after = line_to_split;
         if (line_to_split.dx != 0) {
-            change_axis_value(before, 'X', line_to_split.x + line_to_split.dx * percent, 3);
+            _change_axis(before, X, line_to_split.x + line_to_split.dx * percent, 3);
         }
         if (line_to_split.dy != 0) {
-            change_axis_value(before, 'Y', line_to_split.y + line_to_split.dy * percent, 3);
+            _change_axis(before, Y, line_to_split.y + line_to_split.dy * percent, 3);
         }
         if (line_to_split.dz != 0) {
-            change_axis_value(before, 'Z', line_to_split.z + line_to_split.dz * percent, 3);
+            _change_axis(before, Z, line_to_split.z + line_to_split.dz * percent, 3);
         }
         if (line_to_split.de != 0) {
             if (relative_e) {
-                change_axis_value(before, 'E', line_to_split.de * percent, 5);
-                change_axis_value(after, 'E', line_to_split.de * (1 - percent), 5);
+                _change_axis(before, E, line_to_split.de * percent, 5);
+                _change_axis(after, E, line_to_split.de * (1 - percent), 5);
             } else {
-                change_axis_value(before, 'E', line_to_split.e + line_to_split.de * percent, 5);
+                _change_axis(before, E, line_to_split.e + line_to_split.de * percent, 5);
             }
         }
-        m_process_output += before + "\n";
-        m_process_output += line_to_write + (line_to_write.back() == '\n' ? "" : "\n");
-        m_process_output += line_to_split.raw + "\n";
+        _output(before);
+        _output(line_to_write);
+        _output(line_to_split);
 
     } else {
         //not a G1, print it before
-        m_process_output += line_to_write + (line_to_write.back() == '\n' ? "" : "\n");
-        m_process_output += line_to_split.raw + "\n";
+        _output(line_to_write);
+        _output(line_to_split);
     }
 }
 
@@ -269,16 +310,17 @@ void FanMover::_process_T(const std::string_view command)
     }
 }
 
-void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCodeLine& line)
+void FanMover::_process_gcode_line(const size_t idx)
 {
     // processes 'normal' gcode lines
+    const GCodeLayerBuffer &line = *m_gcode;
     bool need_flush = false;
-    std::string cmd(line.cmd());
+    std::string cmd(line.command_word(idx));
     double time = 0;
     int16_t fan_speed = -1;
     if (cmd.length() > 1) {
-        if (line.has_f())
-            m_current_speed = line.f() / 60.0f;
+        if (line.has(idx, F))
+            m_current_speed = line.value(idx, F) / 60.0f;
         switch (::toupper(cmd[0])) {
         case 'T':
         case 't':
@@ -287,9 +329,9 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
         case 'G':
         {
             if (::atoi(&cmd[1]) == 1 || ::atoi(&cmd[1]) == 0) {
-                double distx = line.dist_X(reader);
-                double disty = line.dist_Y(reader);
-                double distz = line.dist_Z(reader);
+                double distx = m_position.dist(line, idx, X);
+                double disty = m_position.dist(line, idx, Y);
+                double distz = m_position.dist(line, idx, Z);
                 double dist = distx * distx + disty * disty + distz * distz;
                 if (dist > 0) {
                     dist = std::sqrt(dist);
@@ -300,7 +342,8 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
         }
         case 'M':
         {
-            fan_speed = get_fan_speed(line.raw(), m_writer.config.gcode_flavor);
+            const std::string raw(line.text(idx));
+            fan_speed = get_fan_speed(raw, m_writer.config.gcode_flavor);
             if (fan_speed >= 0) {
                 const auto fan_baseline = 255.0;
                 fan_speed = 100 * fan_speed / fan_baseline;
@@ -330,7 +373,7 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
                                     _print_in_middle_G1(m_buffer.front(), m_buffer_time_size - nb_seconds_delay, _set_fan(100));//m_writer.set_fan(100, true)); //FIXME extruder id (or use the gcode writer, but then you have to disable the multi-thread thing
                                     remove_from_buffer(m_buffer.begin());
                                 } else {
-                                    m_process_output += _set_fan(100);//m_writer.set_fan(100, true)); //FIXME extruder id (or use the gcode writer, but then you have to disable the multi-thread thing
+                                    _output(_set_fan(100));//m_writer.set_fan(100, true)); //FIXME extruder id (or use the gcode writer, but then you have to disable the multi-thread thing
                                 }
                                 //write it in the queue if possible
                                 const float kickstart_duration = kickstart * float(fan_speed - m_front_buffer_fan_speed) / 100.f;
@@ -340,7 +383,7 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
                                     time_count -= it->time;
                                     if (time_count< 0) {
                                         //found something that is lower than us
-                                        _put_in_middle_G1(it, it->time + time_count, BufferData(std::string(line.raw()), 0, fan_speed, true));
+                                        _put_in_middle_G1(it, it->time + time_count, BufferData(raw, 0, fan_speed, true));
                                         //found, stop
                                         break;
                                     }
@@ -350,7 +393,7 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
                                     //can't place it in the buffer, use m_current_kickstart
                                     m_current_kickstart.fan_speed = fan_speed;
                                     m_current_kickstart.time = time_count;
-                                    m_current_kickstart.raw = line.raw();
+                                    m_current_kickstart.raw = raw;
                                 }
                                 m_front_buffer_fan_speed = fan_speed;
                             } else {
@@ -358,10 +401,10 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
                                 _remove_slow_fan(fan_speed, m_buffer_time_size + 1);
                                 // then write the fan command
                                 if (!m_buffer.empty() && (m_buffer_time_size - m_buffer.front().time * 0.1) > nb_seconds_delay) {
-                                    _print_in_middle_G1(m_buffer.front(), m_buffer_time_size - nb_seconds_delay, line.raw());
+                                    _print_in_middle_G1(m_buffer.front(), m_buffer_time_size - nb_seconds_delay, raw);
                                     remove_from_buffer(m_buffer.begin());
                                 } else {
-                                    m_process_output += line.raw() + "\n";
+                                    m_process_output.emplace_back(idx);
                                 }
                                 m_front_buffer_fan_speed = fan_speed;
                             }
@@ -380,7 +423,7 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
                                     float kickstart_duration = kickstart * float(fan_speed - m_back_buffer_fan_speed) / 100.f;
                                     m_current_kickstart.fan_speed = fan_speed;
                                     m_current_kickstart.time += kickstart_duration;
-                                    m_current_kickstart.raw = line.raw();
+                                    m_current_kickstart.raw = raw;
                                     //i'm printed by the m_current_kickstart
                                     time = -1;
                                 }
@@ -398,7 +441,7 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
                                 //add the normal speed line for the future
                                 m_current_kickstart.fan_speed = fan_speed;
                                 m_current_kickstart.time = kickstart_duration;
-                                m_current_kickstart.raw = line.raw();
+                                m_current_kickstart.raw = raw;
                             }
                         }
                     }
@@ -413,16 +456,16 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
         }
         }
     } else {
-        if(!line.raw().empty() && line.raw().front() == ';')
+        const std::string_view raw = line.text(idx);
+        if(!raw.empty() && raw.front() == ';')
         {
-            if (line.raw().size() > 10 && line.raw().rfind(";TYPE:", 0) == 0) {
+            if (raw.size() > 10 && line.has_tag(idx, GCodeLayerBuffer::TAG_TYPE)) {
                 // get the type of the next extrusions
-                std::string extrusion_string = line.raw().substr(6, line.raw().size() - 6);
-                current_role = ExtrusionEntity::string_to_role(extrusion_string);
+                current_role = line.role(idx);
             }
-            if (line.raw().size() > 16) {
-                if (line.raw().rfind("; custom gcode", 0) != std::string::npos) {
-                    if (line.raw().rfind("; custom gcode end", 0) != std::string::npos)
+            if (raw.size() > 16) {
+                if (line.has_tag(idx, GCodeLayerBuffer::TAG_CUSTOM_GCODE)) {
+                    if (raw.rfind("; custom gcode end", 0) != std::string::npos)
                         m_is_custom_gcode = false;
                     else
                         m_is_custom_gcode = true;
@@ -432,25 +475,25 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
     }
 
     if (time >= 0) {
-        BufferData& new_data = put_in_buffer(BufferData(line.raw(), time, fan_speed));
-        if (line.has(Axis::X)) {
-            new_data.x = reader.x();
-            new_data.dx = line.dist_X(reader);
+        BufferData& new_data = put_in_buffer(BufferData(idx, time, fan_speed));
+        if (line.has(idx, Axis::X)) {
+            new_data.x = m_position[X];
+            new_data.dx = m_position.dist(line, idx, X);
         }
-        if (line.has(Axis::Y)) {
-            new_data.y = reader.y();
-            new_data.dy = line.dist_Y(reader);
+        if (line.has(idx, Axis::Y)) {
+            new_data.y = m_position[Y];
+            new_data.dy = m_position.dist(line, idx, Y);
         }
-        if (line.has(Axis::Z)) {
-            new_data.z = reader.z();
-            new_data.dz = line.dist_Z(reader);
+        if (line.has(idx, Axis::Z)) {
+            new_data.z = m_position[Z];
+            new_data.dz = m_position.dist(line, idx, Z);
         }
-        if (line.has(Axis::E)) {
-            new_data.e = reader.e();
+        if (line.has(idx, Axis::E)) {
+            new_data.e = m_position[E];
             if (relative_e)
-                new_data.de = line.e();
+                new_data.de = line.value(idx, E);
             else
-                new_data.de = line.dist_E(reader);
+                new_data.de = m_position.dist(line, idx, E);
         }
 
         if (m_current_kickstart.time > 0 && time > 0) {
@@ -490,11 +533,11 @@ void FanMover::_process_gcode_line(GCodeReader& reader, const GCodeReader::GCode
             if (frontdata.fan_speed < 0 || frontdata.fan_speed != m_front_buffer_fan_speed || frontdata.is_kickstart) {
                 if (frontdata.is_kickstart && frontdata.fan_speed < m_front_buffer_fan_speed) {
                     //you have to slow down! not kickstart! rewrite the fan speed.
-                    m_process_output += _set_fan(frontdata.fan_speed);//m_writer.set_fan(frontdata.fan_speed,true); //FIXME extruder id (or use the gcode writer, but then you have to disable the multi-thread thing
+                    _output(_set_fan(frontdata.fan_speed));//m_writer.set_fan(frontdata.fan_speed,true); //FIXME extruder id (or use the gcode writer, but then you have to disable the multi-thread thing
                         
                     m_front_buffer_fan_speed = frontdata.fan_speed;
                 } else {
-                    m_process_output += frontdata.raw + "\n";
+                    _output(frontdata);
                     if (frontdata.fan_speed >= 0) {
                         //note that this is the only place where the fan_speed is set and we print from the buffer, as if the fan_speed >= 0 => time == 0
                         //and as this flush all time == 0 lines from the back of the queue...
@@ -7,14 +7,17 @@
 #include "../ExtrusionEntity.hpp"
 
 #include "../Point.hpp"
-#include "../GCodeReader.hpp"
 #include "../GCodeWriter.hpp"
+#include "GCodeLayerBuffer.hpp"
 #include <regex>
 
 namespace Slic3r {
 
 class BufferData {
 public:
+    // Line of the G-code buffer being processed, or NO_LINE if the line was generated and its text is stored in raw.
+    static constexpr const size_t NO_LINE = size_t(-1);
+    size_t line = NO_LINE;
     std::string raw;
     float time;
     int16_t fan_speed;
@@ -25,6 +28,7 @@ public:
         //avoid double \n
         if(!line.empty() && line.back() == '\n') line.pop_back();
     }
+    BufferData(size_t line, float time, int16_t fan_speed) : line(line), time(time), fan_speed(fan_speed), is_kickstart(false) {}
 };
 
 class FanMover
@@ -37,7 +41,8 @@ private:
     const bool only_overhangs;
     const float kickstart;
 
-    GCodeReader m_parser{};
+    // Position at the start of the line being processed.
+    GCodeLayerBuffer::Position m_position;
     const GCodeWriter& m_writer;
 
     //current value (at the back of the buffer), when parsing a new line
@@ -56,8 +61,9 @@ private:
     std::list<BufferData> m_buffer;
     double m_buffer_time_size = 0;
 
-    // The output of process_layer()
-    std::string m_process_output;
+    // The G-code being processed and the order of its lines in the output of process_gcode().
+    GCodeLayerBuffer *m_gcode = nullptr;
+    std::vector<size_t> m_process_output;
 
 public:
     FanMover(const GCodeWriter& writer, const float nb_seconds_delay, const bool with_D_option, const bool relative_e,
@@ -65,12 +71,12 @@ public:
         : regex_fan_speed("S[0-9]+"), 
         nb_seconds_delay(nb_seconds_delay>0 ? std::max(0.01f,nb_seconds_delay) : 0),
         with_D_option(with_D_option)
-        , relative_e(relative_e), only_overhangs(only_overhangs), kickstart(kickstart), m_writer(writer){
-        m_parser.apply_config(writer.config);
+        , relative_e(relative_e), only_overhangs(only_overhangs), kickstart(kickstart)
+        , m_position(writer.config.use_relative_e_distances.value), m_writer(writer){
     }
 
-    // Adds the gcode contained in the given string to the analysis and returns it after removing the workcodes
-    const std::string& process_gcode(const std::string& gcode, bool flush);
+    // Adds the gcode contained in the given buffer to the analysis and returns it after removing the workcodes
+    GCodeLayerBuffer process_gcode(GCodeLayerBuffer &&gcode, bool flush);
 
 private:
     BufferData& put_in_buffer(BufferData&& data) {
@@ -82,8 +88,14 @@ private:
         m_buffer_time_size -= data->time;
         return m_buffer.erase(data);
     }
+    // Text of the buffered line without the end of line.
+    std::string_view _text(const BufferData& data) const { return data.line == BufferData::NO_LINE ? std::string_view(data.raw) : m_gcode->text(data.line); }
+    void _change_axis(BufferData& data, Axis axis, float new_value, int decimal_digits);
+    // Put the line to the output, or the G-code text, which is split into lines.
+    void _output(const BufferData& data);
+    void _output(const std::string& text);
     // Processes the given gcode line
-    void _process_gcode_line(GCodeReader& reader, const GCodeReader::GCodeLine& line);
+    void _process_gcode_line(size_t idx);
     void _process_T(const std::string_view command);
     void _put_in_middle_G1(std::list<BufferData>::iterator item_to_split, float nb_sec, BufferData&& line_to_write);
     void _print_in_middle_G1(BufferData& line_to_split, float nb_sec, const std::string& line_to_write);
@@ -0,0 +1,378 @@
+#include "GCodeLayerBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <fast_float/fast_float.h>
+
+namespace Slic3r {
+
+static inline bool is_whitespace(char c) { return c == ' ' || c == '\t'; }
+static inline bool is_end_of_gcode_line(char c) { return c == ';' || c == '\r' || c == '\n' || c == 0; }
+static inline bool is_end_of_word(char c) { return is_whitespace(c) || is_end_of_gcode_line(c); }
+static inline bool starts_with(std::string_view line, std::string_view prefix) { return line.compare(0, prefix.size(), prefix) == 0; }
+
+static constexpr const char axis_names[NUM_AXES + 1] = "XYZEFIJP";
+
+GCodeLayerBuffer::GCodeLayerBuffer(std::string &&gcode) : m_text(std::move(gcode))
+{
+    this->tokenize(0);
+    m_num_placed = this->size();
+}
+
+void GCodeLayerBuffer::tokenize(size_t offset)
+{
+    // Each line is followed by an end of line, so that the lines could be copied to the output in runs.
+    if (! m_text.empty() && m_text.back() != '\n')
+        m_text += '\n';
+    const char *begin = m_text.data() + offset;
+    const char *end   = m_text.data() + m_text.size();
+    while (begin != end) {
+        const char *eol = static_cast<const char*>(memchr(begin, '\n', end - begin));
+        assert(eol != nullptr);
+        this->push_line(begin - m_text.data(), eol - begin);
+        begin = eol + 1;
+    }
+}
+
+void GCodeLayerBuffer::push_line(size_t offset, size_t length)
+{
+    m_offset.emplace_back(offset);
+    m_length.emplace_back(uint32_t(length));
+    m_command.emplace_back(Command::None);
+    m_flags.emplace_back(0);
+    m_mask.emplace_back(0);
+    for (std::vector<float> &values : m_values)
+        values.emplace_back(0.f);
+    m_tags.emplace_back(0);
+    m_role.emplace_back(erNone);
+    this->parse_line(m_offset.size() - 1);
+}
+
+void GCodeLayerBuffer::parse_line(size_t idx)
+{
+    // The line is followed by an end of line, thus the parser may look one character past its end.
+    const char *begin = m_text.data() + m_offset[idx];
+    const char *end   = begin + m_length[idx];
+
+    // Command, parsed the same way as by GCodeReader.
+    const char *c = begin;
+    for (; is_whitespace(*c); ++ c) ;
+    m_flags[idx] = (m_flags[idx] & FLAG_REMOVED) | (c != begin ? FLAG_INDENTED : 0);
+    const char *cmd = c;
+    for (; ! is_end_of_word(*c); ++ c) ;
+    const size_t cmd_len = c - cmd;
+    Command      command = cmd_len == 0 ? Command::None : Command::Other;
+    if (cmd[0] == 'G') {
+        if (cmd_len == 2 && cmd[1] >= '0' && cmd[1] <= '3')
+            command = Command(int(Command::G0) + cmd[1] - '0');
+        else if (cmd_len == 3 && cmd[1] == '9' && cmd[2] == '2')
+            command = Command::G92;
+    }
+    m_command[idx] = command;
+
+    // Axes up to the end of line or comment, the axes missing on the line read zero.
+    uint8_t mask = 0;
+    for (std::vector<float> &values : m_values)
+        values[idx] = 0.f;
+    while (! is_end_of_gcode_line(*c)) {
+        for (; is_whitespace(*c); ++ c) ;
+        if (is_end_of_gcode_line(*c))
+            break;
+        const char *axis = *c == 0 ? nullptr : static_cast<const char*>(memchr(axis_names, *c, NUM_AXES));
+        if (axis != nullptr || (*c >= 'A' && *c <= 'Z')) {
+            double v;
+            auto [pend, ec] = fast_float::from_chars(++ c, end, v);
+            if (pend != c && is_end_of_word(*pend)) {
+                if (axis != nullptr) {
+                    const int axis_idx = int(axis - axis_names);
+                    m_values[axis_idx][idx] = float(v);
+                    mask |= 1 << axis_idx;
+                }
+                c = pend;
+                continue;
+            }
+        }
+        for (; ! is_end_of_word(*c); ++ c) ;
+    }
+    m_mask[idx] = mask;
+
+    // Tags.
+    const std::string_view line(begin, end - begin);
+    uint32_t      tags = 0;
+    ExtrusionRole role = erNone;
+    if (! line.empty() && line.front() == ';') {
+        if (starts_with(line, ";_EXTRUSION_ROLE:")) {
+            tags |= TAG_EXTRUSION_ROLE;
+            role  = ExtrusionRole(atoi(begin + 17));
+        } else if (starts_with(line, ";TYPE:")) {
+            tags |= TAG_TYPE;
+            role  = ExtrusionEntity::string_to_role(line.substr(6));
+        } else if (starts_with(line, ";_OVERHANG_FAN_START"))
+            tags |= TAG_OVERHANG_FAN_START;
+        else if (starts_with(line, ";_OVERHANG_FAN_END"))
+            tags |= TAG_OVERHANG_FAN_END;
+        else if (starts_with(line, ";_INTERNAL_BRIDGE_FAN_START"))
+            tags |= TAG_INTERNAL_BRIDGE_FAN_START;
+        else if (starts_with(line, ";_INTERNAL_BRIDGE_FAN_END"))
+            tags |= TAG_INTERNAL_BRIDGE_FAN_END;
+        else if (starts_with(line, ";_SUPP_INTERFACE_FAN_START"))
+            tags |= TAG_SUPPORT_INTERFACE_FAN_START;
+        else if (starts_with(line, ";_SUPP_INTERFACE_FAN_END"))
+            tags |= TAG_SUPPORT_INTERFACE_FAN_END;
+        else if (starts_with(line, ";_IRONING_FAN_START"))
+            tags |= TAG_IRONING_FAN_START;
+        else if (starts_with(line, ";_IRONING_FAN_END"))
+            tags |= TAG_IRONING_FAN_END;
+        else if (starts_with(line, ";_FORCE_RESUME_FAN_SPEED"))
+            tags |= TAG_FORCE_RESUME_FAN_SPEED;
+        else if (starts_with(line, "; PA_CHANGE"))
+            tags |= TAG_PA_CHANGE;
+        else if (starts_with(line, "; custom gcode"))
+            tags |= TAG_CUSTOM_GCODE;
+    }
+    if (line.find(";_") != std::string_view::npos) {
+        if (line.find(";_EXTRUDE_SET_SPEED") != std::string_view::npos)
+            tags |= TAG_EXTRUDE_SET_SPEED;
+        if (line.find(";_EXTRUDE_END") != std::string_view::npos)
+            tags |= TAG_EXTRUDE_END;
+        if (line.find(";_EXTERNAL_PERIMETER") != std::string_view::npos)
+            tags |= TAG_EXTERNAL_PERIMETER;
+        if (line.find(";_WIPE") != std::string_view::npos)
+            tags |= TAG_WIPE;
+    }
+    if (size_t pos = line.find("WIPE"); pos != std::string_view::npos) {
+        tags |= TAG_WIPE_ANY;
+        if (line.find("WIPE_START", pos) != std::string_view::npos)
+            tags |= TAG_WIPE_START;
+        if (line.find("WIPE_END", pos) != std::string_view::npos)
+            tags |= TAG_WIPE_END;
+    }
+    m_tags[idx] = tags;
+    m_role[idx] = role;
+}
+
+size_t GCodeLayerBuffer::formatted_size() const
+{
+    size_t size = 0;
+    for (size_t i = 0; i < m_num_placed; ++ i)
+        if (! this->removed(i))
+            size += m_length[i] + 1;
+    return size;
+}
+
+std::string_view GCodeLayerBuffer::command_word(size_t idx) const
+{
+    const char *c = m_text.data() + m_offset[idx];
+    for (; is_whitespace(*c); ++ c) ;
+    const char *cmd = c;
+    for (; ! is_end_of_word(*c); ++ c) ;
+    return std::string_view(cmd, c - cmd);
+}
+
+void GCodeLayerBuffer::set_axis(size_t idx, Axis axis, float new_value, int decimal_digits)
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(decimal_digits) << new_value;
+
+    char match[3] = " X";
+    match[1] = axis_names[axis];
+
+    std::string raw(this->text(idx));
+    if (this->has(idx, axis)) {
+        size_t pos = raw.find(match) + 2;
+        size_t end = raw.find(' ', pos + 1);
+        raw.replace(pos, end - pos, ss.str());
+    } else {
+        size_t pos = raw.find(' ');
+        if (pos == std::string::npos)
+            raw += std::string(match) + ss.str();
+        else
+            raw.insert(pos, std::string(match) + ss.str());
+    }
+    this->replace(idx, raw);
+}
+
+void GCodeLayerBuffer::change_axis(size_t idx, Axis axis, float new_value, int decimal_digits)
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(decimal_digits) << new_value;
+
+    char match[3] = " X";
+    match[1] = axis_names[axis];
+
+    std::string raw(this->text(idx));
+    size_t pos = raw.find(match) + 2;
+    size_t end = std::min(raw.find(' ', pos + 1), raw.find(';', pos + 1));
+    raw.replace(pos, end - pos, ss.str());
+    this->replace(idx, raw);
+}
+
+void GCodeLayerBuffer::replace(size_t idx, std::string_view text)
+{
+    assert(text.find('\n') == std::string_view::npos);
+    if (text.data() >= m_text.data() && text.data() < m_text.data() + m_text.size()) {
+        // The new text is a part of the text buffer, which may be reallocated.
+        this->replace(idx, std::string(text));
+        return;
+    }
+    m_offset[idx] = m_text.size();
+    m_length[idx] = uint32_t(text.size());
+    m_text.append(text.data(), text.size());
+    m_text += '\n';
+    this->parse_line(idx);
+}
+
+size_t GCodeLayerBuffer::add(std::string_view gcode)
+{
+    const size_t first = this->size();
+    if (! gcode.empty()) {
+        if (gcode.data() >= m_text.data() && gcode.data() < m_text.data() + m_text.size())
+            return this->add(std::string(gcode));
+        const size_t offset = m_text.size();
+        m_text.append(gcode.data(), gcode.size());
+        this->tokenize(offset);
+    }
+    return first;
+}
+
+size_t GCodeLayerBuffer::add_copy(size_t idx)
+{
+    m_offset.emplace_back(m_offset[idx]);
+    m_length.emplace_back(m_length[idx]);
+    m_command.emplace_back(m_command[idx]);
+    m_flags.emplace_back(m_flags[idx] & ~FLAG_REMOVED);
+    m_mask.emplace_back(m_mask[idx]);
+    for (std::vector<float> &values : m_values)
+        values.emplace_back(values[idx]);
+    m_tags.emplace_back(m_tags[idx]);
+    m_role.emplace_back(m_role[idx]);
+    return this->size() - 1;
+}
+
+void GCodeLayerBuffer::insert(size_t pos, size_t first, size_t last)
+{
+    assert(pos <= m_num_placed);
+    assert(first >= m_num_placed && first <= last && last <= this->size());
+    if (first < last)
+        m_insertions.push_back({ pos, first, last });
+}
+
+void GCodeLayerBuffer::commit()
+{
+    if (m_insertions.empty() && m_num_removed == 0) {
+        // Just drop the added lines, which were not inserted.
+        if (this->size() > m_num_placed) {
+            m_offset.resize(m_num_placed);
+            m_length.resize(m_num_placed);
+            m_command.resize(m_num_placed);
+            m_flags.resize(m_num_placed);
+            m_mask.resize(m_num_placed);
+            for (std::vector<float> &values : m_values)
+                values.resize(m_num_placed);
+            m_tags.resize(m_num_placed);
+            m_role.resize(m_num_placed);
+        }
+        return;
+    }
+
+    std::stable_sort(m_insertions.begin(), m_insertions.end(), [](const Insertion &l, const Insertion &r) { return l.pos < r.pos; });
+    std::vector<size_t> order;
+    order.reserve(this->size() - m_num_removed);
+    auto it_insertion = m_insertions.begin();
+    for (size_t i = 0; i <= m_num_placed; ++ i) {
+        for (; it_insertion != m_insertions.end() && it_insertion->pos == i; ++ it_insertion)
+            for (size_t j = it_insertion->first; j < it_insertion->last; ++ j)
+                if (! this->removed(j))
+                    order.emplace_back(j);
+        if (i < m_num_placed && ! this->removed(i))
+            order.emplace_back(i);
+    }
+    this->reorder(order);
+}
+
+template<typename T>
+static void reorder_column(std::vector<T> &column, const std::vector<size_t> &order)
+{
+    std::vector<T> out;
+    out.reserve(order.size());
+    for (size_t idx : order)
+        out.emplace_back(column[idx]);
+    column = std::move(out);
+}
+
+void GCodeLayerBuffer::reorder(const std::vector<size_t> &order)
+{
+    reorder_column(m_offset, order);
+    reorder_column(m_length, order);
+    reorder_column(m_command, order);
+    reorder_column(m_flags, order);
+    for (uint8_t &flags : m_flags)
+        flags &= ~FLAG_REMOVED;
+    reorder_column(m_mask, order);
+    for (std::vector<float> &values : m_values)
+        reorder_column(values, order);
+    reorder_column(m_tags, order);
+    reorder_column(m_role, order);
+    m_num_placed  = order.size();
+    m_num_removed = 0;
+    m_insertions.clear();
+}
+
+void GCodeLayerBuffer::append(GCodeLayerBuffer &&rhs)
+{
+    assert(m_insertions.empty() && m_num_removed == 0 && m_num_placed == this->size());
+    assert(rhs.m_insertions.empty() && rhs.m_num_removed == 0 && rhs.m_num_placed == rhs.size());
+    if (this->empty()) {
+        *this = std::move(rhs);
+        return;
+    }
+    const size_t shift = m_text.size();
+    m_text += rhs.m_text;
+    for (size_t offset : rhs.m_offset)
+        m_offset.emplace_back(offset + shift);
+    m_length.insert(m_length.end(), rhs.m_length.begin(), rhs.m_length.end());
+    m_command.insert(m_command.end(), rhs.m_command.begin(), rhs.m_command.end());
+    m_flags.insert(m_flags.end(), rhs.m_flags.begin(), rhs.m_flags.end());
+    m_mask.insert(m_mask.end(), rhs.m_mask.begin(), rhs.m_mask.end());
+    for (size_t axis = 0; axis < NUM_AXES; ++ axis)
+        m_values[axis].insert(m_values[axis].end(), rhs.m_values[axis].begin(), rhs.m_values[axis].end());
+    m_tags.insert(m_tags.end(), rhs.m_tags.begin(), rhs.m_tags.end());
+    m_role.insert(m_role.end(), rhs.m_role.begin(), rhs.m_role.end());
+    m_num_placed = this->size();
+}
+
+std::string GCodeLayerBuffer::format() const
+{
+    assert(m_insertions.empty());
+    std::string out;
+    out.reserve(this->formatted_size());
+    for (size_t i = 0; i < m_num_placed;) {
+        if (this->removed(i)) {
+            ++ i;
+            continue;
+        }
+        // Copy a run of lines, which follow each other in the text buffer, at once.
+        const size_t begin = m_offset[i];
+        size_t       end   = begin + m_length[i] + 1;
+        for (++ i; i < m_num_placed && ! this->removed(i) && m_offset[i] == end; ++ i)
+            end += m_length[i] + 1;
+        out.append(m_text, begin, end - begin);
+    }
+    return out;
+}
+
+void GCodeLayerBuffer::Position::end_line(const GCodeLayerBuffer &buffer, size_t idx)
+{
+    const Command command = buffer.command(idx);
+    if (command == Command::G0 || command == Command::G1 || command == Command::G2 || command == Command::G3 || command == Command::G92)
+        for (size_t axis = 0; axis < NUM_AXES; ++ axis)
+            if (buffer.has(idx, Axis(axis)))
+                m_position[axis] = buffer.value(idx, Axis(axis));
+}
+
+} // namespace Slic3r
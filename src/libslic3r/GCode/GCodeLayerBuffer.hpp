@@ -0,0 +1,185 @@
+#ifndef slic3r_GCode_GCodeLayerBuffer_hpp_
+#define slic3r_GCode_GCodeLayerBuffer_hpp_
+
+#include "../libslic3r.h"
+#include "../ExtrusionEntity.hpp"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Slic3r {
+
+// G-code of a single layer split into lines and parsed once, to be passed from GCode::process_layer()
+// through the filters (SpiralVase, PressureEqualizer, CoolingBuffer, FanMover, AdaptivePAProcessor)
+// to the output. The filters inspect the parsed command, axes and tags of the lines and modify the layer
+// in place: they edit, remove and insert lines. The layer is formatted into G-code text just once
+// by format(), the lines not touched by any filter are copied verbatim.
+//
+// The lines are stored as a structure of arrays. The line text is a span of a single text buffer,
+// the edited and inserted lines are appended to that text buffer.
+// The string views returned by text() and command_word() are invalidated by any edit or insertion.
+class GCodeLayerBuffer
+{
+public:
+    // Command of a line, the first word after the leading whitespaces, matching GCodeReader::GCodeLine::cmd_is().
+    enum class Command : uint8_t {
+        // Empty line or a comment.
+        None,
+        G0,
+        G1,
+        G2,
+        G3,
+        G92,
+        Other,
+    };
+
+    // Marks found on the line, mostly emitted by GCode::process_layer() for the filters.
+    enum Tag : uint32_t {
+        // Found anywhere on the line.
+        TAG_EXTRUDE_SET_SPEED           = 1 << 0,   // ;_EXTRUDE_SET_SPEED
+        TAG_EXTRUDE_END                 = 1 << 1,   // ;_EXTRUDE_END
+        TAG_EXTERNAL_PERIMETER          = 1 << 2,   // ;_EXTERNAL_PERIMETER
+        TAG_WIPE                        = 1 << 3,   // ;_WIPE
+        TAG_WIPE_ANY                    = 1 << 4,   // WIPE
+        TAG_WIPE_START                  = 1 << 5,   // WIPE_START
+        TAG_WIPE_END                    = 1 << 6,   // WIPE_END
+        // Found at the start of the line.
+        TAG_EXTRUSION_ROLE              = 1 << 7,   // ;_EXTRUSION_ROLE:
+        TAG_TYPE                        = 1 << 8,   // ;TYPE:
+        TAG_OVERHANG_FAN_START          = 1 << 9,   // ;_OVERHANG_FAN_START
+        TAG_OVERHANG_FAN_END            = 1 << 10,  // ;_OVERHANG_FAN_END
+        TAG_INTERNAL_BRIDGE_FAN_START   = 1 << 11,  // ;_INTERNAL_BRIDGE_FAN_START
+        TAG_INTERNAL_BRIDGE_FAN_END     = 1 << 12,  // ;_INTERNAL_BRIDGE_FAN_END
+        TAG_SUPPORT_INTERFACE_FAN_START = 1 << 13,  // ;_SUPP_INTERFACE_FAN_START
+        TAG_SUPPORT_INTERFACE_FAN_END   = 1 << 14,  // ;_SUPP_INTERFACE_FAN_END
+        TAG_IRONING_FAN_START           = 1 << 15,  // ;_IRONING_FAN_START
+        TAG_IRONING_FAN_END             = 1 << 16,  // ;_IRONING_FAN_END
+        TAG_FORCE_RESUME_FAN_SPEED      = 1 << 17,  // ;_FORCE_RESUME_FAN_SPEED
+        TAG_PA_CHANGE                   = 1 << 18,  // ; PA_CHANGE
+        TAG_CUSTOM_GCODE                = 1 << 19,  // ; custom gcode
+    };
+
+    GCodeLayerBuffer() = default;
+    // Split the G-code text of a layer into lines and parse them. The text is taken over by the buffer.
+    explicit GCodeLayerBuffer(std::string &&gcode);
+
+    // Number of lines, including the lines added by add() or add_copy(), which were not committed yet.
+    size_t              size() const { return m_offset.size(); }
+    bool                empty() const { return m_offset.empty(); }
+    // Size of the G-code text returned by format().
+    size_t              formatted_size() const;
+
+    Command             command(size_t idx) const { return m_command[idx]; }
+    // Is there a whitespace before the command?
+    bool                indented(size_t idx) const { return (m_flags[idx] & FLAG_INDENTED) != 0; }
+    bool                has(size_t idx, Axis axis) const { return (m_mask[idx] & (1 << int(axis))) != 0; }
+    // Value of an axis, zero if the axis is missing on the line.
+    float               value(size_t idx, Axis axis) const { return m_values[axis][idx]; }
+    bool                has_tag(size_t idx, uint32_t tags) const { return (m_tags[idx] & tags) != 0; }
+    // Extrusion role set by a line tagged with TAG_EXTRUSION_ROLE or TAG_TYPE.
+    ExtrusionRole       role(size_t idx) const { return m_role[idx]; }
+    bool                removed(size_t idx) const { return (m_flags[idx] & FLAG_REMOVED) != 0; }
+    // Text of the line without the end of line.
+    std::string_view    text(size_t idx) const { return std::string_view(m_text.data() + m_offset[idx], m_length[idx]); }
+    // The first word of the line after the leading whitespaces, see GCodeReader::GCodeLine::cmd().
+    std::string_view    command_word(size_t idx) const;
+
+    // Edit a line in place, the line is parsed again.
+    // Set the value of an axis, or add the axis after the command, see GCodeReader::GCodeLine::set().
+    void                set_axis(size_t idx, Axis axis, float new_value, int decimal_digits = 3);
+    // Replace the value of an axis present on the line up to the next space or comment.
+    void                change_axis(size_t idx, Axis axis, float new_value, int decimal_digits);
+    // Replace the text of a line, which must not contain an end of line.
+    void                replace(size_t idx, std::string_view text);
+    // Make the line empty, it will be exported as an empty line.
+    void                clear(size_t idx) { this->replace(idx, std::string_view()); }
+    // Drop the line when the buffer is committed.
+    void                remove(size_t idx) { m_flags[idx] |= FLAG_REMOVED; ++ m_num_removed; }
+
+    // Add the lines of a G-code snippet behind the lines of the layer and return the index of the first of them.
+    // The lines are not placed into the layer until insert() is called for them and the buffer is committed.
+    size_t              add(std::string_view gcode);
+    // Add a copy of a line, to be placed by insert().
+    size_t              add_copy(size_t idx);
+    // Place the added lines <first, last) in front of line pos of the layer, or at the end of the layer
+    // if pos is the number of lines of the layer. Lines inserted at the same position keep the order of the calls.
+    void                insert(size_t pos, size_t first, size_t last);
+    // Add a G-code snippet and place it in front of line pos.
+    void                insert(size_t pos, std::string_view gcode) { size_t first = this->add(gcode); this->insert(pos, first, this->size()); }
+    // Apply the removals and insertions. Added lines, which were not inserted, are dropped.
+    void                commit();
+    // Replace the lines of the layer with the lines indexed by order, which may include the added lines.
+    void                reorder(const std::vector<size_t> &order);
+    // Append the lines of another committed layer.
+    void                append(GCodeLayerBuffer &&rhs);
+
+    // Format the committed layer into G-code text.
+    std::string         format() const;
+
+    // Position of the print head over the lines of a layer, updated the same way GCodeReader updates it.
+    class Position
+    {
+    public:
+        Position() = default;
+        explicit Position(bool relative_e) : m_relative_e(relative_e) {}
+
+        float   operator[](Axis axis) const { return m_position[axis]; }
+        float&  operator[](Axis axis) { return m_position[axis]; }
+
+        // To be called before a line is evaluated: relative extrusions are measured from zero.
+        void    start_line(const GCodeLayerBuffer &buffer, size_t idx)
+            { if (m_relative_e && buffer.has(idx, E)) m_position[E] = 0.f; }
+        // To be called after a line was evaluated, G0 to G3 and G92 update the position.
+        void    end_line(const GCodeLayerBuffer &buffer, size_t idx);
+
+        float   new_value(const GCodeLayerBuffer &buffer, size_t idx, Axis axis) const
+            { return buffer.has(idx, axis) ? buffer.value(idx, axis) : m_position[axis]; }
+        float   dist(const GCodeLayerBuffer &buffer, size_t idx, Axis axis) const
+            { return buffer.has(idx, axis) ? buffer.value(idx, axis) - m_position[axis] : 0.f; }
+        float   dist_xy(const GCodeLayerBuffer &buffer, size_t idx) const
+            { float x = this->dist(buffer, idx, X); float y = this->dist(buffer, idx, Y); return sqrt(x * x + y * y); }
+
+    private:
+        std::array<float, NUM_AXES> m_position {};
+        bool                        m_relative_e { false };
+    };
+
+private:
+    enum Flag : uint8_t {
+        FLAG_INDENTED = 1 << 0,
+        FLAG_REMOVED  = 1 << 1,
+    };
+
+    // Split text appended to m_text at offset into lines and parse them.
+    void                tokenize(size_t offset);
+    // Parse the line idx pointing to m_text.
+    void                parse_line(size_t idx);
+    void                push_line(size_t offset, size_t length);
+
+    std::string                                     m_text;
+    // Columns indexed by the line.
+    std::vector<size_t>                             m_offset;
+    std::vector<uint32_t>                           m_length;
+    std::vector<Command>                            m_command;
+    std::vector<uint8_t>                            m_flags;
+    std::vector<uint8_t>                            m_mask;
+    std::array<std::vector<float>, NUM_AXES>        m_values;
+    std::vector<uint32_t>                           m_tags;
+    std::vector<ExtrusionRole>                      m_role;
+
+    // Number of lines of the layer, the following lines were added and not committed yet.
+    size_t                                          m_num_placed { 0 };
+    size_t                                          m_num_removed { 0 };
+    struct Insertion {
+        size_t pos;
+        size_t first;
+        size_t last;
+    };
+    std::vector<Insertion>                          m_insertions;
+};
+
+} // namespace Slic3r
+
+#endif // slic3r_GCode_GCodeLayerBuffer_hpp_
@@ -7,6 +7,8 @@
 #include "libslic3r/ClipperUtils.hpp"
 #include "libslic3r/LocalesUtils.hpp"
 #include "libslic3r/format.hpp"
+#include "libslic3r/Format/BinaryGCode.hpp"
+#include "libslic3r_version.h"
 #include "GCodeProcessor.hpp"
 
 #include <boost/log/trivial.hpp>
@@ -15,6 +17,9 @@
 #include <boost/nowide/fstream.hpp>
 #include <boost/nowide/cstdio.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <tbb/task_group.h>
 
 #include <fast_float/fast_float.h>
 
@@ -306,8 +311,21 @@ void GCodeProcessor::TimeMachine::CustomGCodeTime::reset()
     times = std::vector<std::pair<CustomGCode::Type, float>>();
 }
 
+struct GCodeProcessor::TimeMachine::AsyncPlanner
+{
+    ~AsyncPlanner() {
+        try {
+            tasks.wait();
+        } catch (...) {
+        }
+    }
+
+    tbb::task_group tasks;
+};
+
 void GCodeProcessor::TimeMachine::reset()
 {
+    this->wait_planning();
     enabled = false;
     acceleration = 0.0f;
     max_acceleration = 0.0f;
@@ -327,6 +345,19 @@ void GCodeProcessor::TimeMachine::reset()
     std::fill(roles_time.begin(), roles_time.end(), 0.0f);
     layers_time = std::vector<float>();
     prepare_time = 0.0f;
+    batch = PlannerBatch();
+    num_queued_blocks = 0;
+    passes = PlannerPasses();
+}
+
+void GCodeProcessor::TimeMachine::queue_block(const TimeBlock &block)
+{
+    batch.blocks.push_back(block);
+    // Follows the size of the planner queue, see plan_batch().
+    if (++ num_queued_blocks > TimeProcessor::Planner::refresh_threshold)
+        num_queued_blocks = TimeProcessor::Planner::queue_size;
+    if (batch.blocks.size() >= PlannerBatch::max_blocks)
+        this->submit_batch();
 }
 
 void GCodeProcessor::TimeMachine::simulate_st_synchronize(float additional_time)
@@ -334,42 +365,92 @@ void GCodeProcessor::TimeMachine::simulate_st_synchronize(float additional_time)
     if (!enabled)
         return;
 
-    calculate_time(0, additional_time);
+    batch.commands.push_back({ PlannerCommand::Type::Synchronize, batch.blocks.size(), additional_time });
+    // calculate_time() keeps a queue of less than two blocks.
+    if (num_queued_blocks >= 2)
+        num_queued_blocks = 0;
 }
 
-static void planner_forward_pass_kernel(GCodeProcessor::TimeBlock& prev, GCodeProcessor::TimeBlock& curr)
+void GCodeProcessor::TimeMachine::process_custom_gcode_time(CustomGCode::Type code)
 {
-    // If the previous block is an acceleration block, but it is not long enough to complete the
-    // full speed change within the block, we need to adjust the entry speed accordingly. Entry
-    // speeds have already been reset, maximized, and reverse planned by reverse planner.
-    // If nominal length is true, max junction speed is guaranteed to be reached. No need to recheck.
-    if (!prev.flags.nominal_length) {
-        if (prev.feedrate_profile.entry < curr.feedrate_profile.entry) {
-            float entry_speed = std::min(curr.feedrate_profile.entry, max_allowable_speed(-prev.acceleration, prev.feedrate_profile.entry, prev.distance));
+    if (!enabled)
+        return;
 
-            // Check for junction speed change
-            if (curr.feedrate_profile.entry != entry_speed) {
-                curr.feedrate_profile.entry = entry_speed;
-                curr.flags.recalculate = true;
-            }
-        }
-    }
+    batch.commands.push_back({ PlannerCommand::Type::CustomGCodeTime, batch.blocks.size() });
+    batch.commands.back().code = code;
+    if (num_queued_blocks >= 2)
+        num_queued_blocks = 0;
 }
 
-void planner_reverse_pass_kernel(GCodeProcessor::TimeBlock& curr, GCodeProcessor::TimeBlock& next)
+void GCodeProcessor::TimeMachine::add_stop_time(unsigned int g1_line_id)
 {
-    // If entry speed is already at the maximum entry speed, no need to recheck. Block is cruising.
-    // If not, block in state of acceleration or deceleration. Reset entry speed to maximum and
-    // check for maximum allowable speed reductions to ensure maximum possible planned speed.
-    if (curr.feedrate_profile.entry != curr.max_entry_speed) {
-        // If nominal length true, max junction speed is guaranteed to be reached. Only compute
-        // for max allowable speed if block is decelerating and nominal length is false.
-        if (!curr.flags.nominal_length && curr.max_entry_speed > next.feedrate_profile.entry)
-            curr.feedrate_profile.entry = std::min(curr.max_entry_speed, max_allowable_speed(-curr.acceleration, next.feedrate_profile.entry, curr.distance));
-        else
-            curr.feedrate_profile.entry = curr.max_entry_speed;
+    if (!enabled)
+        return;
 
-        curr.flags.recalculate = true;
+    batch.commands.push_back({ PlannerCommand::Type::StopTime, batch.blocks.size() });
+    batch.commands.back().g1_line_id = g1_line_id;
+}
+
+void GCodeProcessor::TimeMachine::submit_batch(bool last)
+{
+    if (!last && batch.blocks.empty() && batch.commands.empty())
+        return;
+
+    if (!async_planner)
+        async_planner = std::make_shared<AsyncPlanner>();
+    // The batches are planned in order, one after the other.
+    async_planner->tasks.wait();
+    async_planner->tasks.run([this, planned = std::make_shared<PlannerBatch>(std::move(batch)), last]() {
+        this->plan_batch(*planned, last);
+    });
+    batch = PlannerBatch();
+    batch.blocks.reserve(PlannerBatch::max_blocks);
+}
+
+void GCodeProcessor::TimeMachine::wait_planning()
+{
+    if (async_planner)
+        async_planner->tasks.wait();
+}
+
+void GCodeProcessor::TimeMachine::plan_batch(const PlannerBatch &batch, bool last)
+{
+    size_t num_planned = 0;
+    auto queue_blocks = [this, &batch, &num_planned](size_t num_blocks) {
+        for (; num_planned < num_blocks; ++ num_planned) {
+            blocks.push_back(batch.blocks[num_planned]);
+            if (blocks.size() > TimeProcessor::Planner::refresh_threshold)
+                this->calculate_time(TimeProcessor::Planner::queue_size);
+        }
+    };
+
+    for (const PlannerCommand &command : batch.commands) {
+        queue_blocks(command.num_blocks);
+        switch (command.type) {
+        case PlannerCommand::Type::Synchronize:
+            this->calculate_time(0, command.additional_time);
+            break;
+        case PlannerCommand::Type::CustomGCodeTime:
+            gcode_time.needed = true;
+            //FIXME this simulates st_synchronize! is it correct?
+            // The estimated time may be longer than the real print time.
+            this->calculate_time();
+            if (gcode_time.cache != 0.0f) {
+                gcode_time.times.push_back({ command.code, gcode_time.cache });
+                gcode_time.cache = 0.0f;
+            }
+            break;
+        case PlannerCommand::Type::StopTime:
+            stop_times.push_back({ command.g1_line_id, 0.0f });
+            break;
+        }
+    }
+    queue_blocks(batch.blocks.size());
+
+    if (last) {
+        this->calculate_time();
+        if (gcode_time.needed && gcode_time.cache != 0.0f)
+            gcode_time.times.push_back({ CustomGCode::ColorChange, gcode_time.cache });
     }
 }
 
@@ -414,14 +495,66 @@ void GCodeProcessor::TimeMachine::calculate_time(size_t keep_last_n_blocks, floa
 
     assert(keep_last_n_blocks <= blocks.size());
 
+    // The passes run over flat arrays of the values they touch, the speed changes are computed up front in a vectorizable loop.
+    const size_t n = blocks.size();
+    passes.entry.resize(n);
+    passes.max_entry.resize(n);
+    passes.speed_change.resize(n);
+    passes.nominal_length.resize(n);
+    passes.recalculate.resize(n);
+    float         *entry          = passes.entry.data();
+    float         *max_entry      = passes.max_entry.data();
+    float         *speed_change   = passes.speed_change.data();
+    unsigned char *nominal_length = passes.nominal_length.data();
+    unsigned char *recalculate    = passes.recalculate.data();
+    for (size_t i = 0; i < n; ++i) {
+        const TimeBlock &block = blocks[i];
+        entry[i]          = block.feedrate_profile.entry;
+        max_entry[i]      = block.max_entry_speed;
+        speed_change[i]   = block.acceleration;
+        nominal_length[i] = block.flags.nominal_length;
+        recalculate[i]    = block.flags.recalculate;
+    }
+    // See max_allowable_speed(), called with the deceleration of the block.
+    for (size_t i = 0; i < n; ++i)
+        speed_change[i] = 2.0f * -speed_change[i] * blocks[i].distance;
+
     // forward_pass
-    for (size_t i = 0; i + 1 < blocks.size(); ++i) {
-        planner_forward_pass_kernel(blocks[i], blocks[i + 1]);
+    for (size_t i = 0; i + 1 < n; ++i) {
+        // If the previous block is an acceleration block, but it is not long enough to complete the
+        // full speed change within the block, we need to adjust the entry speed accordingly. Entry
+        // speeds have already been reset, maximized, and reverse planned by reverse planner.
+        // If nominal length is true, max junction speed is guaranteed to be reached. No need to recheck.
+        if (!nominal_length[i] && entry[i] < entry[i + 1]) {
+            const float entry_speed = std::min(entry[i + 1], std::sqrt(std::max(0.0f, sqr(entry[i]) - speed_change[i])));
+            // Check for junction speed change
+            if (entry[i + 1] != entry_speed) {
+                entry[i + 1] = entry_speed;
+                recalculate[i + 1] = true;
+            }
+        }
     }
 
     // reverse_pass
-    for (int i = static_cast<int>(blocks.size()) - 1; i > 0; --i)
-        planner_reverse_pass_kernel(blocks[i - 1], blocks[i]);
+    for (size_t i = n - 1; i > 0; --i) {
+        // If entry speed is already at the maximum entry speed, no need to recheck. Block is cruising.
+        // If not, block in state of acceleration or deceleration. Reset entry speed to maximum and
+        // check for maximum allowable speed reductions to ensure maximum possible planned speed.
+        if (entry[i - 1] != max_entry[i - 1]) {
+            // If nominal length true, max junction speed is guaranteed to be reached. Only compute
+            // for max allowable speed if block is decelerating and nominal length is false.
+            entry[i - 1] = !nominal_length[i - 1] && max_entry[i - 1] > entry[i] ?
+                std::min(max_entry[i - 1], std::sqrt(std::max(0.0f, sqr(entry[i]) - speed_change[i - 1]))) :
+                max_entry[i - 1];
+            recalculate[i - 1] = true;
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        TimeBlock &block = blocks[i];
+        block.feedrate_profile.entry = entry[i];
+        block.flags.recalculate      = recalculate[i];
+    }
 
     recalculate_trapezoids(blocks);
 
@@ -463,6 +596,15 @@ void GCodeProcessor::TimeMachine::calculate_time(size_t keep_last_n_blocks, floa
         blocks.clear();
 }
 
+void GCodeProcessor::TimeProcessor::finish_planning()
+{
+    for (TimeMachine &machine : machines)
+        if (machine.enabled)
+            machine.submit_batch(true);
+    for (TimeMachine &machine : machines)
+        machine.wait_planning();
+}
+
 void GCodeProcessor::TimeProcessor::reset()
 {
     extruder_unloaded = true;
@@ -826,12 +968,15 @@ private:
 
 void GCodeProcessor::run_post_process()
 {
-    FilePtr in{ boost::nowide::fopen(m_result.filename.c_str(), "rb") };
-    if (in.f == nullptr)
+    // If the exporter kept the G-code in memory, the final G-code is written into m_result.filename directly
+    // with a single pass, otherwise the G-code is read back from m_result.filename into a temporary file.
+    const bool in_memory = ! m_in_memory_gcode.empty();
+    FilePtr in{ in_memory ? nullptr : boost::nowide::fopen(m_result.filename.c_str(), "rb") };
+    if (! in_memory && in.f == nullptr)
         throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nCannot open file for reading.\n"));
 
     // temporary file to contain modified gcode
-    std::string out_path = m_result.filename + ".postprocess";
+    std::string out_path = in_memory ? m_result.filename : m_result.filename + ".postprocess";
     FilePtr out{ boost::nowide::fopen(out_path.c_str(), "wb") };
     if (out.f == nullptr)
         throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nCannot open file for writing.\n"));
@@ -1199,16 +1344,32 @@ void GCodeProcessor::run_post_process()
 
     {
         // Read the input stream 64kB at a time, extract lines and process them.
-        std::vector<char> buffer(65536 * 10, 0);
-        // Line buffer.
-        assert(gcode_line.empty());
-        for (;;) {
+        std::vector<char> buffer(in_memory ? 0 : 65536 * 10, 0);
+        // Index of the next in-memory G-code block to be processed.
+        size_t in_memory_block = 0;
+        // Returns the next block of the input G-code, empty at the end of the input.
+        auto read_block = [this, in_memory, &in, &buffer, &in_memory_block]() -> std::pair<const char*, size_t> {
+            if (in_memory) {
+                // Release the block processed last, the G-code may be huge.
+                if (in_memory_block > 0)
+                    std::string().swap(m_in_memory_gcode[in_memory_block - 1]);
+                if (in_memory_block == m_in_memory_gcode.size())
+                    return { nullptr, 0 };
+                const std::string &block = m_in_memory_gcode[in_memory_block ++];
+                return { block.data(), block.size() };
+            }
             size_t cnt_read = ::fread(buffer.data(), 1, buffer.size(), in.f);
             if (::ferror(in.f))
                 throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nError while reading from file.\n"));
+            return { buffer.data(), cnt_read };
+        };
+        // Line buffer.
+        assert(gcode_line.empty());
+        for (;;) {
+            auto [block, cnt_read] = read_block();
             bool eof       = cnt_read == 0;
-            auto it        = buffer.begin();
-            auto it_bufend = buffer.begin() + cnt_read;
+            auto it        = block;
+            auto it_bufend = block + cnt_read;
             while (it != it_bufend || (eof && ! gcode_line.empty())) {
                 // Find end of line.
                 bool eol    = false;
@@ -1275,11 +1436,12 @@ void GCodeProcessor::run_post_process()
 
     out.close();
     in.close();
+    m_in_memory_gcode.clear();
 
     const std::string result_filename = m_result.filename;
     export_line.synchronize_moves(m_result);
 
-    if (rename_file(out_path, result_filename))
+    if (! in_memory && rename_file(out_path, result_filename))
         throw Slic3r::RuntimeError(std::string("Failed to rename the output G-code file from ") + out_path + " to " + result_filename + '\n' +
             "Is " + out_path + " locked?" + '\n');
 }
@@ -1455,6 +1617,7 @@ void GCodeProcessorResult::reset() {
     custom_gcode_per_print_z = std::vector<CustomGCode::Item>();
     spiral_vase_layers = std::vector<std::pair<float, std::pair<size_t, size_t>>>();
     time = 0;
+    decoded_gcode_file.reset();
 
     //BBS: add mutex for protection of gcode result
     unlock();
@@ -1490,6 +1653,7 @@ void GCodeProcessorResult::reset() {
     layer_filaments.clear();
     filament_change_count_map.clear();
     warnings.clear();
+    decoded_gcode_file.reset();
 
     //BBS: add mutex for protection of gcode result
     unlock();
@@ -1515,7 +1679,7 @@ const std::vector<std::pair<GCodeProcessor::EProducer, std::string>> GCodeProces
     //{ EProducer::KissSlicer,  "KISSlicer" }
 };
 
-unsigned int GCodeProcessor::s_result_id = 0;
+std::atomic<unsigned int> GCodeProcessor::s_result_id { 0 };
 
 bool GCodeProcessor::contains_reserved_tag(const std::string& gcode, std::string& found_tag)
 {
@@ -2295,6 +2459,7 @@ void GCodeProcessor::enable_stealth_time_estimator(bool enabled)
 
 void GCodeProcessor::reset()
 {
+    m_in_memory_gcode.clear();
     m_units = EUnits::Millimeters;
     m_global_positioning_type = EPositioningType::Absolute;
     m_e_local_positioning_type = EPositioningType::Absolute;
@@ -2402,6 +2567,24 @@ DynamicConfig GCodeProcessor::export_config_for_render() const
 // throws CanceledException through print->throw_if_canceled() (sent by the caller as callback).
 void GCodeProcessor::process_file(const std::string& filename, std::function<void()> cancel_callback)
 {
+    if (BinaryGCode::is_binary_gcode_file(filename)) {
+        // The G-code viewer references the lines of the processed G-code file by their offsets,
+        // thus decode the binary G-code into a temporary ASCII G-code and process that one.
+        // The temporary file is named uniquely, as G-codes of the same name may be processed concurrently,
+        // and it is removed on failure or once the last result referencing it is released.
+        std::shared_ptr<const std::string> ascii_path(
+            new std::string((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path(SLIC3R_APP_KEY "_%%%%-%%%%-%%%%-%%%%.gcode")).string()),
+            [](const std::string *path) {
+                boost::system::error_code ec;
+                boost::filesystem::remove(*path, ec);
+                delete path;
+            });
+        BinaryGCode::convert_binary_to_ascii(filename, *ascii_path);
+        this->process_file(*ascii_path, cancel_callback);
+        m_result.decoded_gcode_file = std::move(ascii_path);
+        return;
+    }
+
     CNumericLocalesSetter locales_setter;
 
 #if ENABLE_GCODE_VIEWER_STATISTICS
@@ -2444,7 +2627,9 @@ void GCodeProcessor::process_file(const std::string& filename, std::function<voi
             auto printer_model_opt = config.opt<ConfigOptionString>("printer_model");
             if (printer_model_opt && !printer_model_opt->value.empty()) {
                 // TODO: Orca hack, proper vendor check?
-                GCodeProcessor::s_IsBBLPrinter = boost::starts_with(printer_model_opt->value, "Bambu Lab");
+                // Don't write the global flag if not changed, so that G-codes of the same vendor may be processed in parallel.
+                if (bool is_bbl_printer = boost::starts_with(printer_model_opt->value, "Bambu Lab"); GCodeProcessor::s_IsBBLPrinter != is_bbl_printer)
+                    GCodeProcessor::s_IsBBLPrinter = is_bbl_printer;
             }
 
             ConfigOptionStrings *filament_color = config.opt<ConfigOptionStrings>("filament_colour");
@@ -2467,7 +2652,8 @@ void GCodeProcessor::process_file(const std::string& filename, std::function<voi
     // 1st move must be a dummy move
     m_result.moves.emplace_back(GCodeProcessorResult::MoveVertex());
     size_t parse_line_callback_cntr = 10000;
-    m_parser.parse_file(filename, [this, cancel_callback, &parse_line_callback_cntr](GCodeReader& reader, const GCodeReader::GCodeLine& line) {
+    // The G-code is tokenized in parallel, while the lines are processed in order by this thread.
+    m_parser.parse_file_parallel(filename, [this, cancel_callback, &parse_line_callback_cntr](GCodeReader& reader, const GCodeReader::GCodeLine& line) {
         if (-- parse_line_callback_cntr == 0) {
             // Don't call the cancel_callback() too often, do it every at every 10000'th line.
             parse_line_callback_cntr = 10000;
@@ -2497,9 +2683,14 @@ void GCodeProcessor::initialize(const std::string& filename)
 }
 
 void GCodeProcessor::process_buffer(const std::string &buffer)
+{
+    this->process_buffer(buffer.c_str(), buffer.c_str() + buffer.size());
+}
+
+void GCodeProcessor::process_buffer(const char *begin, const char *end)
 {
     //FIXME maybe cache GCodeLine gline to be over multiple parse_buffer() invocations.
-    m_parser.parse_buffer(buffer, [this](GCodeReader&, const GCodeReader::GCodeLine& line) {
+    m_parser.parse_buffer(begin, end, [this](GCodeReader&, const GCodeReader::GCodeLine& line) {
         this->process_gcode_line(line, false);
     });
 }
@@ -2515,13 +2706,7 @@ void GCodeProcessor::finalize(bool post_process)
     }
 
     // process the time blocks
-    for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count); ++i) {
-        TimeMachine& machine = m_time_processor.machines[i];
-        TimeMachine::CustomGCodeTime& gcode_time = machine.gcode_time;
-        machine.calculate_time();
-        if (gcode_time.needed && gcode_time.cache != 0.0f)
-            gcode_time.times.push_back({ CustomGCode::ColorChange, gcode_time.cache });
-    }
+    m_time_processor.finish_planning();
 
     m_used_filaments.process_caches(this);
 
@@ -3860,7 +4045,6 @@ void GCodeProcessor::process_G1(const GCodeReader::GCodeLine& line, const std::o
 
         TimeMachine::State& curr = machine.curr;
         TimeMachine::State& prev = machine.prev;
-        std::vector<TimeBlock>& blocks = machine.blocks;
 
         curr.feedrate = (delta_pos[E] == 0.0f) ?
             minimum_travel_feedrate(static_cast<PrintEstimatedStatistics::ETimeMode>(i), m_feedrate) :
@@ -3901,8 +4085,9 @@ void GCodeProcessor::process_G1(const GCodeReader::GCodeLine& line, const std::o
                 //BBS: calculate angle
                 float dot = v1(0) * v2(0) + v1(1) * v2(1);
                 float cross = v1(0) * v2(1) - v1(1) * v2(0);
-                float angle = float(atan2(double(cross), double(dot)));
-                float sin_theta_2 = sqrt((1.0f - cos(angle)) * 0.5f);
+                // cos(atan2(cross, dot)) without the trigonometric functions, this is evaluated for each move and time mode.
+                float cos_angle = dot / std::sqrt(dot * dot + cross * cross);
+                float sin_theta_2 = sqrt((1.0f - cos_angle) * 0.5f);
                 float r = sqrt(sqr(delta_pos[X]) + sqr(delta_pos[Y])) * 0.5 / sin_theta_2;
                 float acc = get_acceleration(static_cast<PrintEstimatedStatistics::ETimeMode>(i));
                 curr.feedrate = std::min(curr.feedrate, sqrt(acc * r));
@@ -3964,7 +4149,7 @@ void GCodeProcessor::process_G1(const GCodeReader::GCodeLine& line, const std::o
 
         // calculates block entry feedrate
         float vmax_junction = curr.safe_feedrate;
-        if (!blocks.empty() && prev.feedrate > PREVIOUS_FEEDRATE_THRESHOLD) {
+        if (machine.has_queued_blocks() && prev.feedrate > PREVIOUS_FEEDRATE_THRESHOLD) {
             bool prev_speed_larger = prev.feedrate > block.feedrate_profile.cruise;
             float smaller_speed_factor = prev_speed_larger ? (block.feedrate_profile.cruise / prev.feedrate) : (prev.feedrate / block.feedrate_profile.cruise);
             // Pick the smaller of the nominal speeds. Higher speed shall not be achieved at the junction during coasting.
@@ -4058,10 +4243,7 @@ void GCodeProcessor::process_G1(const GCodeReader::GCodeLine& line, const std::o
         // updates previous
         prev = curr;
 
-        blocks.push_back(block);
-
-        if (blocks.size() > TimeProcessor::Planner::refresh_threshold)
-            machine.calculate_time(TimeProcessor::Planner::queue_size);
+        machine.queue_block(block);
     }
 
     const Vec3f plate_offset = {(float) m_x_offset, (float) m_y_offset, 0.0f};
@@ -4294,7 +4476,6 @@ void GCodeProcessor::process_VG1(const GCodeReader::GCodeLine& line)
 
         TimeMachine::State& curr = machine.curr;
         TimeMachine::State& prev = machine.prev;
-        std::vector<TimeBlock>& blocks = machine.blocks;
 
         curr.feedrate = (delta_pos[E] == 0.0f) ?
             minimum_travel_feedrate(static_cast<PrintEstimatedStatistics::ETimeMode>(i), m_feedrate) :
@@ -4334,8 +4515,8 @@ void GCodeProcessor::process_VG1(const GCodeReader::GCodeLine& line)
                 //BBS: calculate angle
                 float dot = v1(0) * v2(0) + v1(1) * v2(1);
                 float cross = v1(0) * v2(1) - v1(1) * v2(0);
-                float angle = float(atan2(double(cross), double(dot)));
-                float sin_theta_2 = sqrt((1.0f - cos(angle)) * 0.5f);
+                float cos_angle = dot / std::sqrt(dot * dot + cross * cross);
+                float sin_theta_2 = sqrt((1.0f - cos_angle) * 0.5f);
                 float r = sqrt(sqr(delta_pos[X]) + sqr(delta_pos[Y])) * 0.5 / sin_theta_2;
                 float acc = get_acceleration(static_cast<PrintEstimatedStatistics::ETimeMode>(i));
                 curr.feedrate = std::min(curr.feedrate, sqrt(acc * r));
@@ -4397,7 +4578,7 @@ void GCodeProcessor::process_VG1(const GCodeReader::GCodeLine& line)
 
         // calculates block entry feedrate
         float vmax_junction = curr.safe_feedrate;
-        if (!blocks.empty() && prev.feedrate > PREVIOUS_FEEDRATE_THRESHOLD) {
+        if (machine.has_queued_blocks() && prev.feedrate > PREVIOUS_FEEDRATE_THRESHOLD) {
             bool prev_speed_larger = prev.feedrate > block.feedrate_profile.cruise;
             float smaller_speed_factor = prev_speed_larger ? (block.feedrate_profile.cruise / prev.feedrate) : (prev.feedrate / block.feedrate_profile.cruise);
             // Pick the smaller of the nominal speeds. Higher speed shall not be achieved at the junction during coasting.
@@ -4491,10 +4672,7 @@ void GCodeProcessor::process_VG1(const GCodeReader::GCodeLine& line)
         // updates previous
         prev = curr;
 
-        blocks.push_back(block);
-
-        if (blocks.size() > TimeProcessor::Planner::refresh_threshold)
-            machine.calculate_time(TimeProcessor::Planner::queue_size);
+        machine.queue_block(block);
     }
 
     // do not save the move
@@ -4694,7 +4872,6 @@ void  GCodeProcessor::process_G2_G3(const GCodeReader::GCodeLine& line)
 
         TimeMachine::State& curr = machine.curr;
         TimeMachine::State& prev = machine.prev;
-        std::vector<TimeBlock>& blocks = machine.blocks;
 
         curr.feedrate = (type == EMoveType::Travel) ?
             minimum_travel_feedrate(static_cast<PrintEstimatedStatistics::ETimeMode>(i), m_feedrate) :
@@ -4776,7 +4953,7 @@ void  GCodeProcessor::process_G2_G3(const GCodeReader::GCodeLine& line)
         //BBS: calculates block entry feedrate
         static const float PREVIOUS_FEEDRATE_THRESHOLD = 0.0001f;
         float vmax_junction = curr.safe_feedrate;
-        if (!blocks.empty() && prev.feedrate > PREVIOUS_FEEDRATE_THRESHOLD) {
+        if (machine.has_queued_blocks() && prev.feedrate > PREVIOUS_FEEDRATE_THRESHOLD) {
             bool prev_speed_larger = prev.feedrate > block.feedrate_profile.cruise;
             float smaller_speed_factor = prev_speed_larger ? (block.feedrate_profile.cruise / prev.feedrate) : (prev.feedrate / block.feedrate_profile.cruise);
             //BBS: Pick the smaller of the nominal speeds. Higher speed shall not be achieved at the junction during coasting.
@@ -4869,10 +5046,7 @@ void  GCodeProcessor::process_G2_G3(const GCodeReader::GCodeLine& line)
         //BBS: updates previous
         prev = curr;
 
-        blocks.push_back(block);
-
-        if (blocks.size() > TimeProcessor::Planner::refresh_threshold)
-            machine.calculate_time(TimeProcessor::Planner::queue_size);
+        machine.queue_block(block);
     }
 
     //BBS: seam detector
@@ -5682,11 +5856,7 @@ void GCodeProcessor::store_move_vertex(EMoveType type, EMovePathType path_type)
     // stores stop time placeholders for later use
     if (type == EMoveType::Color_change || type == EMoveType::Pause_Print) {
         for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count); ++i) {
-            TimeMachine& machine = m_time_processor.machines[i];
-            if (!machine.enabled)
-                continue;
-
-            machine.stop_times.push_back({ m_g1_line_id, 0.0f });
+            m_time_processor.machines[i].add_stop_time(m_g1_line_id);
         }
     }
 }
@@ -5836,19 +6006,7 @@ int GCodeProcessor::get_filament_vitrification_temperature(size_t extrude_id)
 void GCodeProcessor::process_custom_gcode_time(CustomGCode::Type code)
 {
     for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count); ++i) {
-        TimeMachine& machine = m_time_processor.machines[i];
-        if (!machine.enabled)
-            continue;
-
-        TimeMachine::CustomGCodeTime& gcode_time = machine.gcode_time;
-        gcode_time.needed = true;
-        //FIXME this simulates st_synchronize! is it correct?
-        // The estimated time may be longer than the real print time.
-        machine.simulate_st_synchronize();
-        if (gcode_time.cache != 0.0f) {
-            gcode_time.times.push_back({ code, gcode_time.cache });
-            gcode_time.cache = 0.0f;
-        }
+        m_time_processor.machines[i].process_custom_gcode_time(code);
     }
 }
 
@@ -8,7 +8,9 @@
 #include "libslic3r/CustomGCode.hpp"
 
 #include <cstdint>
+#include <atomic>
 #include <array>
+#include <memory>
 #include <vector>
 #include <mutex>
 #include <string>
@@ -225,6 +227,9 @@ class Print;
         std::vector<MoveVertex> moves;
         // Positions of ends of lines of the final G-code this->filename after TimeProcessor::post_process() finalizes the G-code.
         std::vector<size_t> lines_ends;
+        // Temporary ASCII G-code of a binary G-code, either decoded from it or generated and converted to it by Print::export_gcode().
+        // this->filename points to it. The file is removed once the last result referencing it is reset or destroyed.
+        std::shared_ptr<const std::string> decoded_gcode_file;
         Pointfs printable_area;
         //BBS: add bed exclude area
         Pointfs bed_exclude_area;
@@ -277,6 +282,7 @@ class Print;
             id = other.id;
             moves = other.moves;
             lines_ends = other.lines_ends;
+            decoded_gcode_file = other.decoded_gcode_file;
             printable_area = other.printable_area;
             bed_exclude_area = other.bed_exclude_area;
             wrapping_exclude_area = other.wrapping_exclude_area;
@@ -532,10 +538,60 @@ class Print;
             //BBS: prepare stage time before print model, including start gcode time and mostly same with start gcode time
             float prepare_time;
 
+            // The parser builds the blocks and hands them over to a planner task of this machine in batches of
+            // PlannerBatch::max_blocks blocks, together with the commands issued while the batch was filled.
+            // The machines are thus planned concurrently with each other and with the parsing.
+            // blocks, time, stop_times, gcode_time.cache and gcode_time.times, g1_times_cache, moves_time,
+            // roles_time, layers_time and prepare_time belong to the planner task until wait_planning() returns.
+            struct PlannerCommand
+            {
+                enum class Type : unsigned char { Synchronize, CustomGCodeTime, StopTime };
+                Type              type;
+                // Number of the blocks of the batch queued before this command.
+                size_t            num_blocks;
+                float             additional_time{ 0.0f };
+                CustomGCode::Type code{ CustomGCode::ColorChange };
+                unsigned int      g1_line_id{ 0 };
+            };
+            struct PlannerBatch
+            {
+                static constexpr size_t max_blocks = 4096;
+                std::vector<TimeBlock>      blocks;
+                std::vector<PlannerCommand> commands;
+            };
+            // Values read and updated by the forward and reverse planner passes, one entry per block.
+            struct PlannerPasses
+            {
+                std::vector<float>         entry;
+                std::vector<float>         max_entry;
+                // Square of the speed, which is lost decelerating over the block.
+                std::vector<float>         speed_change;
+                std::vector<unsigned char> nominal_length;
+                std::vector<unsigned char> recalculate;
+            };
+            PlannerBatch batch;
+            // Size of the planner queue (blocks) once the batches handed over so far are planned.
+            size_t num_queued_blocks{ 0 };
+            PlannerPasses passes;
+            struct AsyncPlanner;
+            // Declared last, so that a running planner task is waited for before the state it works on is destroyed.
+            std::shared_ptr<AsyncPlanner> async_planner;
+
             void reset();
 
+            // Called by the parser.
+            void queue_block(const TimeBlock &block);
+            bool has_queued_blocks() const { return num_queued_blocks > 0; }
             // Simulates firmware st_synchronize() call
             void simulate_st_synchronize(float additional_time = 0.0f);
+            void process_custom_gcode_time(CustomGCode::Type code);
+            void add_stop_time(unsigned int g1_line_id);
+            // Hands over the batch to the planner task. If last, the planner queue is flushed after the batch.
+            void submit_batch(bool last = false);
+            void wait_planning();
+
+            // Called by the planner task.
+            void plan_batch(const PlannerBatch &batch, bool last);
             void calculate_time(size_t keep_last_n_blocks = 0, float additional_time = 0.0f);
         };
 
@@ -609,6 +665,8 @@ class Print;
             std::array<TimeMachine, static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count)> machines;
 
             void reset();
+            // Plans the blocks left in the batches and in the planner queues of the enabled machines.
+            void finish_planning();
         };
     public:
         class SeamsDetector
@@ -834,7 +892,9 @@ class Print;
         Print* m_print{ nullptr };
 
         GCodeProcessorResult m_result;
-        static unsigned int s_result_id;
+        static std::atomic<unsigned int> s_result_id;
+        // See set_in_memory_gcode().
+        std::vector<std::string> m_in_memory_gcode;
 
 #if ENABLE_GCODE_VIEWER_DATA_CHECKING
         DataChecker m_mm3_per_mm_compare{ "mm3_per_mm", 0.01f };
@@ -877,6 +937,12 @@ class Print;
         // Streaming interface, for processing G-codes just generated by PrusaSlicer in a pipelined fashion.
         void initialize(const std::string& filename);
         void process_buffer(const std::string& buffer);
+        // Process a zero terminated buffer, end points to the terminating zero.
+        void process_buffer(const char *begin, const char *end);
+        // G-code kept in memory by the exporter instead of being written into the file passed to initialize().
+        // finalize(true) then writes the final G-code into that file in a single pass instead of reading it back
+        // and rewriting it. The blocks are released while being written.
+        void set_in_memory_gcode(std::vector<std::string>&& gcode) { m_in_memory_gcode = std::move(gcode); }
         void finalize(bool post_process);
 
         float get_time(PrintEstimatedStatistics::ETimeMode mode) const;
@@ -0,0 +1,54 @@
+#include "PipelineStats.hpp"
+
+#include <algorithm>
+
+namespace Slic3r {
+
+GCodePipelineStats::Stage& GCodePipelineStats::stage(const std::string &name)
+{
+    auto it = std::find_if(stages.begin(), stages.end(), [&name](const Stage &s) { return s.name == name; });
+    if (it != stages.end())
+        return *it;
+    stages.emplace_back();
+    stages.back().name = name;
+    return stages.back();
+}
+
+const GCodePipelineStats::Stage* GCodePipelineStats::bottleneck() const
+{
+    auto it = std::max_element(stages.begin(), stages.end(), [](const Stage &l, const Stage &r) { return l.busy_time < r.busy_time; });
+    return it == stages.end() ? nullptr : &(*it);
+}
+
+nlohmann::json GCodePipelineStats::to_json() const
+{
+    nlohmann::json j;
+    j["wall_time"] = wall_time;
+    j["pipelines"] = pipelines;
+    size_t total_bytes = 0;
+    for (size_t bytes : layer_bytes)
+        total_bytes += bytes;
+    j["layers"]      = layer_bytes.size();
+    j["total_bytes"] = total_bytes;
+    if (const Stage *s = this->bottleneck(); s != nullptr)
+        j["bottleneck"] = s->name;
+    nlohmann::json j_stages = nlohmann::json::array();
+    for (const Stage &s : stages) {
+        nlohmann::json j_stage;
+        j_stage["name"]            = s.name;
+        j_stage["layers"]          = s.layers;
+        j_stage["busy_time"]       = s.busy_time;
+        j_stage["max_busy_time"]   = s.max_busy_time;
+        j_stage["wait_time"]       = s.wait_time;
+        j_stage["bytes_out"]       = s.bytes_out;
+        j_stage["max_layer_bytes"] = s.max_layer_bytes;
+        // Throughput in megabytes of G-code per second of processing.
+        j_stage["throughput"]      = s.busy_time > 0. ? double(s.bytes_out) / (s.busy_time * 1024. * 1024.) : 0.;
+        j_stages.push_back(std::move(j_stage));
+    }
+    j["stages"]      = std::move(j_stages);
+    j["layer_bytes"] = layer_bytes;
+    return j;
+}
+
+} // namespace Slic3r
@@ -0,0 +1,55 @@
+#ifndef slic3r_GCode_PipelineStats_hpp_
+#define slic3r_GCode_PipelineStats_hpp_
+
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace Slic3r {
+
+// Timing of the stages of the G-code export pipeline (GCode::process_layers()), accumulated over all the layers
+// of a G-code export. Collected for every export, as it costs just a few clock readings per layer and stage.
+struct GCodePipelineStats
+{
+    struct Stage
+    {
+        std::string name;
+        // Number of layers passed through the stage.
+        size_t      layers          { 0 };
+        // Time spent processing the layers, in seconds.
+        double      busy_time       { 0. };
+        // The longest time spent processing a single layer, in seconds.
+        double      max_busy_time   { 0. };
+        // Time the layers waited between leaving the previous stage and entering this one, in seconds.
+        // A stage with a high wait time is starved by the stage in front of it.
+        double      wait_time       { 0. };
+        // Size of the G-code produced by the stage, in bytes.
+        size_t      bytes_out       { 0 };
+        size_t      max_layer_bytes { 0 };
+    };
+
+    // Stages in the order of the pipeline. A stage is listed once, even if several pipelines were run
+    // (sequential printing runs one pipeline per object).
+    std::vector<Stage>  stages;
+    // Wall clock time of running the pipelines, in seconds.
+    double              wall_time { 0. };
+    // Number of pipelines run.
+    size_t              pipelines { 0 };
+    // Size of the G-code of each layer as written into the output stream, in bytes.
+    std::vector<size_t> layer_bytes;
+
+    bool   empty() const { return pipelines == 0; }
+    void   clear() { *this = GCodePipelineStats(); }
+
+    // Find a stage by name, add it at the end if not found.
+    Stage& stage(const std::string &name);
+    // The stage with the highest busy time, nullptr if empty.
+    const Stage* bottleneck() const;
+
+    nlohmann::json to_json() const;
+};
+
+} // namespace Slic3r
+
+#endif // slic3r_GCode_PipelineStats_hpp_
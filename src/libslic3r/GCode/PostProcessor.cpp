@@ -3,6 +3,7 @@
 #include "libslic3r/Utils.hpp"
 #include "libslic3r/format.hpp"
 #include "libslic3r/I18N.hpp"
+#include "libslic3r/Format/BinaryGCode.hpp"
 
 #include <boost/algorithm/string.hpp>
 #include <boost/log/trivial.hpp>
@@ -204,6 +205,9 @@ void gcode_add_line_number(const std::string& path, const DynamicPrintConfig& co
     auto gcode_file = boost::filesystem::path(path);
     if (!boost::filesystem::exists(gcode_file))
         return;
+    // The binary G-code is not a text file.
+    if (BinaryGCode::is_binary_gcode_file(path))
+        return;
 
     std::fstream fs;
     std::string new_gcode;
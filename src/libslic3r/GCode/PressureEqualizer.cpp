@@ -10,12 +10,12 @@
 #include "../GCode.hpp"
 
 #include "PressureEqualizer.hpp"
+#include "GCodeLayerBuffer.hpp"
 #include "fast_float/fast_float.h"
 #include "GCodeWriter.hpp"
 
 namespace Slic3r {
 
-static const std::string EXTRUSION_ROLE_TAG = ";_EXTRUSION_ROLE:";
 static const std::string EXTRUDE_END_TAG = ";_EXTRUDE_END";
 static const std::string EXTRUDE_SET_SPEED_TAG = ";_EXTRUDE_SET_SPEED";
 static const std::string EXTERNAL_PERIMETER_TAG = ";_EXTERNAL_PERIMETER";
@@ -33,10 +33,8 @@ static constexpr long max_ignored_gap_between_extruding_segments = 3;
 
 PressureEqualizer::PressureEqualizer(const Slic3r::GCodeConfig &config) : m_use_relative_e_distances(config.use_relative_e_distances.value)
 {
-    // Preallocate some data, so that output_buffer.data() will return an empty string.
-    output_buffer.assign(32, 0);
-    output_buffer_length      = 0;
-    output_buffer_prev_length = 0;
+    m_output           = nullptr;
+    m_output_last_line = size_t(-1);
 
     m_current_extruder = 0;
     // Zero the position of the XYZE axes + the current feed
@@ -87,24 +85,16 @@ PressureEqualizer::PressureEqualizer(const Slic3r::GCodeConfig &config) : m_use_
 #endif
 }
 
-void PressureEqualizer::process_layer(const std::string &gcode)
+void PressureEqualizer::process_layer(GCodeLayerBuffer &gcode)
 {
     if (!gcode.empty()) {
-        const char *gcode_begin = gcode.c_str();
-        while (*gcode_begin != 0) {
-            // Find end of the line.
-            const char *gcode_end = gcode_begin;
-            // Slic3r always generates end of lines in a Unix style.
-            for (; *gcode_end != 0 && *gcode_end != '\n'; ++gcode_end);
-
+        for (size_t idx = 0; idx < gcode.size(); ++idx) {
             m_gcode_lines.emplace_back();
-            if (!this->process_line(gcode_begin, gcode_end, m_gcode_lines.back())) {
+            if (!this->process_line(gcode, idx, m_gcode_lines.back())) {
                 // The line has to be forgotten. It contains comment marks, which shall be filtered out of the target g-code.
                 m_gcode_lines.pop_back();
+                gcode.remove(idx);
             }
-            gcode_begin = gcode_end;
-            if (*gcode_begin == '\n')
-                ++gcode_begin;
         }
         assert(!this->opened_extrude_set_speed_block);
     }
@@ -175,11 +165,12 @@ LayerResult PressureEqualizer::process_layer(LayerResult &&input)
 {
     const bool   is_first_layer       = m_layer_results.empty();
     const size_t next_layer_first_idx = m_gcode_lines.size();
+    const bool   nop_layer_result     = input.nop_layer_result;
 
-    if (!input.nop_layer_result) {
-        this->process_layer(input.gcode);
-        input.gcode.clear(); // GCode is already processed, so it isn't needed to store it.
-        m_layer_results.emplace(new LayerResult(input));
+    if (!nop_layer_result) {
+        // The lines refer to the G-code buffer of the layer, which is modified in place when the layer is exported.
+        m_layer_results.emplace(new LayerResult(std::move(input)));
+        this->process_layer(m_layer_results.back()->gcode);
     }
 
     if (is_first_layer) // Buffer previous input result and output NOP.
@@ -189,17 +180,17 @@ LayerResult PressureEqualizer::process_layer(LayerResult &&input)
     LayerResult *prev_layer_result = m_layer_results.front();
     m_layer_results.pop();
 
-    output_buffer_length      = 0;
-    output_buffer_prev_length = 0;
+    m_output           = &prev_layer_result->gcode;
+    m_output_last_line = size_t(-1);
+    m_output_empty_lines.clear();
     for (size_t line_idx = 0; line_idx < next_layer_first_idx; ++line_idx)
         output_gcode_line(line_idx);
+    m_output->commit();
+    m_output = nullptr;
     m_gcode_lines.erase(m_gcode_lines.begin(), m_gcode_lines.begin() + int(next_layer_first_idx));
 
-    if (output_buffer_length > 0)
-        prev_layer_result->gcode = std::string(output_buffer.data());
-
-    assert(!input.nop_layer_result || m_layer_results.empty());
-    LayerResult out = *prev_layer_result;
+    assert(!nop_layer_result || m_layer_results.empty());
+    LayerResult out = std::move(*prev_layer_result);
     delete prev_layer_result;
     return out;
 }
@@ -251,28 +242,20 @@ static inline float parse_float(const char *&line, const size_t line_length)
     return result;
 }
 
-bool PressureEqualizer::process_line(const char *line, const char *line_end, GCodeLine &buf)
+bool PressureEqualizer::process_line(const GCodeLayerBuffer &gcode, const size_t idx, GCodeLine &buf)
 {
-    const size_t len = line_end - line;
-    if (strncmp(line, EXTRUSION_ROLE_TAG.data(), EXTRUSION_ROLE_TAG.length()) == 0) {
-        line += EXTRUSION_ROLE_TAG.length();
-        int role = atoi(line);
-        m_current_extrusion_role = ExtrusionRole(role);
+    if (gcode.has_tag(idx, GCodeLayerBuffer::TAG_EXTRUSION_ROLE)) {
+        m_current_extrusion_role = gcode.role(idx);
 #ifdef PRESSURE_EQUALIZER_DEBUG
         ++line_idx;
 #endif
         return false;
     }
 
-    // Set the type, copy the line to the buffer.
+    // Set the type, remember the line of the buffer.
     buf.type = GCODELINETYPE_OTHER;
     buf.modified = false;
-    if (buf.raw.size() < len + 1)
-        buf.raw.assign(line, line + len + 1);
-    else
-        memcpy(buf.raw.data(), line, len);
-    buf.raw[len] = 0;
-    buf.raw_length = len;
+    buf.line = idx;
 
     memcpy(buf.pos_start, m_current_pos, sizeof(float)*5);
     memcpy(buf.pos_end, m_current_pos, sizeof(float)*5);
@@ -285,9 +268,8 @@ bool PressureEqualizer::process_line(const char *line, const char *line_end, GCo
     buf.max_volumetric_extrusion_rate_slope_negative = 0.f;
 	buf.extrusion_role = m_current_extrusion_role;
 
-    std::string str_line(line, line_end);
-    const bool found_extrude_set_speed_tag = boost::contains(str_line, EXTRUDE_SET_SPEED_TAG);
-    const bool found_extrude_end_tag = boost::contains(str_line, EXTRUDE_END_TAG);
+    const bool found_extrude_set_speed_tag = gcode.has_tag(idx, GCodeLayerBuffer::TAG_EXTRUDE_SET_SPEED);
+    const bool found_extrude_end_tag = gcode.has_tag(idx, GCodeLayerBuffer::TAG_EXTRUDE_END);
     assert(!found_extrude_set_speed_tag || !found_extrude_end_tag);
 
     if (found_extrude_set_speed_tag)
@@ -295,21 +277,21 @@ bool PressureEqualizer::process_line(const char *line, const char *line_end, GCo
     else if (found_extrude_end_tag)
         this->opened_extrude_set_speed_block = false;
 
-    // Parse the G-code line, store the result into the buf.
+    // The text of the line is followed by an end of line in the buffer.
+    const char *line = gcode.text(idx).data();
+    // Parse the G-code line, store the result into the buf. The axes were already parsed by the buffer.
     switch (toupper(*line ++)) {
     case 'G': {
-        int gcode = -1;
+        int gcode_id = -1;
         try {
-            gcode = parse_int(line);
+            gcode_id = parse_int(line);
         } catch (Slic3r::InvalidArgument &) {
             // Ignore invalid GCodes.
-            eatws(line);
             break;
         }
 
-        assert(gcode != -1);
-        eatws(line);
-        switch (gcode) {
+        assert(gcode_id != -1);
+        switch (gcode_id) {
         case 0:
         case 1:
         {
@@ -320,33 +302,14 @@ bool PressureEqualizer::process_line(const char *line, const char *line_end, GCo
             float new_pos[5];
             memcpy(new_pos, m_current_pos, sizeof(float)*5);
             bool  changed[5] = { false, false, false, false, false };
-            while (!is_eol(*line)) {
-                const char axis = toupper(*line++);
-                int  i = -1;
-                switch (axis) {
-                case 'X':
-                case 'Y':
-                case 'Z':
-                    i = axis - 'X';
-                    break;
-                case 'E':
-                    i = 3;
-                    break;
-                case 'F':
-                    i = 4;
-                    break;
-                default:
-                    break;
-                }
-                if (i != -1) {
+            for (size_t i = 0; i < 5; ++ i)
+                if (gcode.has(idx, Axis(i))) {
                     buf.pos_provided[i] = true;
-                    new_pos[i] = parse_float(line, line_end - line);
+                    new_pos[i] = gcode.value(idx, Axis(i));
                     if (i == 3 && m_use_relative_e_distances)
                         new_pos[i] += m_current_pos[i];
                     changed[i] = new_pos[i] != m_current_pos[i];
-                    eatws(line);
                 }
-            }
             if (changed[3]) {
                 // Extrusion, retract or unretract.
                 float diff = new_pos[3] - m_current_pos[3];
@@ -395,22 +358,9 @@ bool PressureEqualizer::process_line(const char *line, const char *line_end, GCo
             // G92 : Set Position
             // Set a logical coordinate position to a new value without actually moving the machine motors.
             // Which axes to set?
-            while (!is_eol(*line)) {
-                const char axis = toupper(*line++);
-                switch (axis) {
-                case 'X':
-                case 'Y':
-                case 'Z':
-                    m_current_pos[axis - 'X'] = (!is_ws_or_eol(*line)) ? parse_float(line, line_end - line) : 0.f;
-                    break;
-                case 'E':
-                    m_current_pos[3] = (!is_ws_or_eol(*line)) ? parse_float(line, line_end - line) : 0.f;
-                    break;
-                default:
-                    break;
-                }
-                eatws(line);
-            }
+            for (size_t i = 0; i < 4; ++ i)
+                if (gcode.has(idx, Axis(i)))
+                    m_current_pos[i] = gcode.value(idx, Axis(i));
             break;
         }
         case 10:
@@ -432,7 +382,6 @@ bool PressureEqualizer::process_line(const char *line, const char *line_end, GCo
         break;
     }
     case 'M': {
-        eatws(line);
         // Ignore the rest of the M-codes.
         break;
     }
@@ -444,7 +393,6 @@ bool PressureEqualizer::process_line(const char *line, const char *line_end, GCo
             new_extruder = parse_int(line);
         } catch (Slic3r::InvalidArgument &) {
             // Ignore invalid GCodes starting with T.
-            eatws(line);
             break;
         }
         assert(new_extruder != -1);
@@ -472,16 +420,17 @@ void PressureEqualizer::output_gcode_line(const size_t line_idx)
 {
     GCodeLine &line = m_gcode_lines[line_idx];
     if (!line.modified) {
-        push_to_output(line.raw.data(), line.raw_length, true);
+        push_to_output(line.line);
         return;
     }
 
-    // The line was modified.
+    // The line was modified, it is replaced by the lines pushed below.
+    m_output->remove(line.line);
     // Find the comment.
-    const char *comment = line.raw.data();
-    while (*comment != ';' && *comment != 0) ++comment;
-    if (*comment != ';')
-        comment = nullptr;
+    const std::string_view text          = m_output->text(line.line);
+    const size_t           comment_start = text.find(';');
+    const std::string      comment_str   = comment_start == std::string_view::npos ? std::string() : std::string(text.substr(comment_start));
+    const char            *comment       = comment_start == std::string_view::npos ? nullptr : comment_str.c_str();
 
     // get the gcode line length
     float l = line.dist_xyz();
@@ -846,47 +795,21 @@ void PressureEqualizer::adjust_volumetric_rate(const size_t first_line_idx, cons
     }
 }
 
-inline void PressureEqualizer::push_to_output(GCodeG1Formatter &formatter)
-{
-    return this->push_to_output(formatter.string(), false);
-}
-
-inline void PressureEqualizer::push_to_output(const std::string &text, bool add_eol)
+inline void PressureEqualizer::push_to_output(const size_t line)
 {
-    return this->push_to_output(text.data(), text.size(), add_eol);
+    if (m_output_last_line == size_t(-1) || !m_output->text(line).empty()) {
+        m_output_last_line = line;
+        m_output_empty_lines.clear();
+    } else
+        m_output_empty_lines.emplace_back(line);
 }
 
-inline void PressureEqualizer::push_to_output(const char *text, const size_t len, bool add_eol)
+inline void PressureEqualizer::push_to_output(const size_t pos, const std::string &text)
 {
-    // New length of the output buffer content.
-    size_t len_new = output_buffer_length + len + 1;
-    if (add_eol)
-        ++len_new;
-
-    // Resize the output buffer to a power of 2 higher than the required memory.
-    if (output_buffer.size() < len_new) {
-        size_t v = len_new;
-        // Compute the next highest power of 2 of 32-bit v
-        // http://graphics.stanford.edu/~seander/bithacks.html
-        v--;
-        v |= v >> 1;
-        v |= v >> 2;
-        v |= v >> 4;
-        v |= v >> 8;
-        v |= v >> 16;
-        v++;
-        output_buffer.resize(v);
-    }
-
-    // Copy the text to the output.
-    if (len != 0) {
-        memcpy(output_buffer.data() + output_buffer_length, text, len);
-        this->output_buffer_prev_length = this->output_buffer_length;
-        output_buffer_length += len;
-    }
-    if (add_eol)
-        output_buffer[output_buffer_length++] = '\n';
-    output_buffer[output_buffer_length] = 0;
+    const size_t first = m_output->add(text);
+    m_output->insert(pos, first, m_output->size());
+    m_output_last_line = first;
+    m_output_empty_lines.clear();
 }
 
 inline bool is_just_line_with_extrude_set_speed_tag(const std::string &line)
@@ -916,22 +839,29 @@ void PressureEqualizer::push_line_to_output(const size_t line_idx, float new_fee
     // Quantize speed changes to a minimum of 1mm/sec, to reduce gcode volume for trivial speed changes.
     new_feedrate = std::round(new_feedrate / 60.0) * 60.0;
     const GCodeLine &line = m_gcode_lines[line_idx];
-    if (line_idx > 0 && output_buffer_length > 0) {
-        const std::string prev_line_str = std::string(output_buffer.begin() + int(this->output_buffer_prev_length),
-                                                      output_buffer.begin() + int(this->output_buffer_length) + 1);
-        if (is_just_line_with_extrude_set_speed_tag(prev_line_str))
-            this->output_buffer_length = this->output_buffer_prev_length; // Remove the last line because it only sets the speed for an empty block of g-code lines, so it is useless.
-        else
-            push_to_output(EXTRUDE_END_TAG.data(), EXTRUDE_END_TAG.length(), true);
+    if (line_idx > 0 && m_output_last_line != size_t(-1)) {
+        // The last line pushed to the output followed by the empty lines pushed after it.
+        std::string prev_line_str(m_output->text(m_output_last_line));
+        prev_line_str.append(m_output_empty_lines.size() + 1, '\n');
+        prev_line_str += '\0';
+        if (is_just_line_with_extrude_set_speed_tag(prev_line_str)) {
+            // Remove the last line because it only sets the speed for an empty block of g-code lines, so it is useless.
+            m_output->remove(m_output_last_line);
+            for (size_t empty_line : m_output_empty_lines)
+                m_output->remove(empty_line);
+            m_output_last_line = size_t(-1);
+            m_output_empty_lines.clear();
+        } else
+            push_to_output(line.line, EXTRUDE_END_TAG);
     } else
-        push_to_output(EXTRUDE_END_TAG.data(), EXTRUDE_END_TAG.length(), true);
+        push_to_output(line.line, EXTRUDE_END_TAG);
 
     GCodeG1Formatter feedrate_formatter;
     feedrate_formatter.emit_f(new_feedrate);
     feedrate_formatter.emit_string(std::string(EXTRUDE_SET_SPEED_TAG.data(), EXTRUDE_SET_SPEED_TAG.length()));
     if (line.extrusion_role == ExtrusionRole::erExternalPerimeter)
         feedrate_formatter.emit_string(std::string(EXTERNAL_PERIMETER_TAG.data(), EXTERNAL_PERIMETER_TAG.length()));
-    push_to_output(feedrate_formatter);
+    push_to_output(line.line, feedrate_formatter.string());
 
     GCodeG1Formatter extrusion_formatter;
     for (size_t axis_idx = 0; axis_idx < 3; ++axis_idx)
@@ -942,7 +872,7 @@ void PressureEqualizer::push_line_to_output(const size_t line_idx, float new_fee
     if (comment != nullptr)
         extrusion_formatter.emit_string(std::string(comment));
 
-    push_to_output(extrusion_formatter);
+    push_to_output(line.line, extrusion_formatter.string());
 }
 
 } // namespace Slic3r
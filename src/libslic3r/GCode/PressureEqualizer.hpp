@@ -11,6 +11,7 @@ namespace Slic3r {
 struct LayerResult;
 
 class GCodeG1Formatter;
+class GCodeLayerBuffer;
 
 //#define PRESSURE_EQUALIZER_STATISTIC
 //#define PRESSURE_EQUALIZER_DEBUG
@@ -30,7 +31,7 @@ public:
     LayerResult process_layer(LayerResult &&input);
 private:
 
-    void process_layer(const std::string &gcode);
+    void process_layer(GCodeLayerBuffer &gcode);
 
 #ifdef PRESSURE_EQUALIZER_STATISTIC
     struct Statistics
@@ -106,7 +107,7 @@ private:
     {
         GCodeLine() : 
             type(GCODELINETYPE_INVALID),
-            raw_length(0),
+            line(0),
             modified(false),
             extruder_id(0), 
             volumetric_extrusion_rate(0.f), 
@@ -139,10 +140,9 @@ private:
 
         GCodeLineType type;
 
-        // We try to keep the string buffer once it has been allocated, so it will not be reallocated over and over.
-        std::vector<char>   raw;
-        size_t              raw_length;
-        // If modified, the raw text has to be adapted by the new extrusion rate,
+        // Index of the line in the G-code buffer of its layer.
+        size_t              line;
+        // If modified, the line has to be replaced by a line with the new extrusion rate,
         // or maybe the line needs to be split into multiple lines.
         bool                modified;
 
@@ -175,17 +175,19 @@ private:
         bool        extrude_end_tag       = false;
     };
 
-    // Output buffer will only grow. It will not be reallocated over and over.
-    std::vector<char>               output_buffer;
-    size_t                          output_buffer_length;
-    size_t                          output_buffer_prev_length;
+    // G-code buffer of the layer being exported, the modified lines are replaced in place.
+    GCodeLayerBuffer               *m_output;
+    // The last non-empty line pushed to the output (or the first line if all of them are empty)
+    // and the empty lines pushed after it.
+    size_t                          m_output_last_line;
+    std::vector<size_t>             m_output_empty_lines;
 
 #ifdef PRESSURE_EQUALIZER_DEBUG
     // For debugging purposes. Index of the G-code line processed.
     size_t                          line_idx;
 #endif
 
-    bool process_line(const char *line, const char *line_end, GCodeLine &buf);
+    bool process_line(const GCodeLayerBuffer &gcode, size_t idx, GCodeLine &buf);
     long advance_segment_beyond_small_gap(long idx_cur_pos);
     void output_gcode_line(size_t line_idx);
 
@@ -193,10 +195,10 @@ private:
     // Then go forward and adjust the feedrate to decrease the slope of the extrusion rate changes.
     void adjust_volumetric_rate(size_t first_line_idx, size_t last_line_idx);
 
-    // Push the text to the end of the output_buffer.
-    inline void push_to_output(GCodeG1Formatter &formatter);
-    inline void push_to_output(const std::string &text, bool add_eol);
-    inline void push_to_output(const char *text, size_t len, bool add_eol = true);
+    // Push a line of the G-code buffer to the output unmodified.
+    inline void push_to_output(size_t line);
+    // Push a new line to the output in front of the line pos of the G-code buffer.
+    inline void push_to_output(size_t pos, const std::string &text);
     // Push a G-code line to the output.
     void push_line_to_output(size_t line_idx, float new_feedrate, const char *comment);
 
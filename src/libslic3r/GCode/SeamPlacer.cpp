@@ -11,6 +11,7 @@
 #include <queue>
 
 #include "libslic3r/AABBTreeLines.hpp"
+#include "libslic3r/AABBTreeWide.hpp"
 #include "libslic3r/KDTreeIndirect.hpp"
 #include "libslic3r/ExtrusionEntity.hpp"
 #include "libslic3r/Print.hpp"
@@ -20,6 +21,7 @@
 
 #include "libslic3r/Geometry/Curves.hpp"
 #include "libslic3r/ShortEdgeCollapse.hpp"
+#include "libslic3r/SlicingCache.hpp"
 #include "libslic3r/TriangleSetSampling.hpp"
 
 #include "libslic3r/Utils.hpp"
@@ -125,11 +127,10 @@ Vec3f sample_power_cosine_hemisphere(const Vec2f &samples, float power) {
   return Vec3f(cos(term1) * term3, sin(term1) * term3, term2);
 }
 
-std::vector<float> raycast_visibility(const AABBTreeIndirect::Tree<3, float> &raycasting_tree,
+std::vector<float> raycast_visibility(const AABBTreeIndirect::WideTree4f &raycasting_tree,
                                       const indexed_triangle_set &triangles,
                                       const TriangleSetSamples &samples,
-                                      size_t negative_volumes_start_index,
-                                      SeamPosition seam_position = spAligned) {
+                                      size_t negative_volumes_start_index) {
   BOOST_LOG_TRIVIAL(debug)
       << "SeamPlacer: raycast visibility of " << samples.positions.size() << " samples over " << triangles.indices.size()
       << " triangles: end";
@@ -152,9 +153,13 @@ std::vector<float> raycast_visibility(const AABBTreeIndirect::Tree<3, float> &ra
   std::vector<float> result(samples.positions.size());
   tbb::parallel_for(tbb::blocked_range<size_t>(0, result.size()),
                     [&triangles, &precomputed_sample_directions, model_contains_negative_parts, negative_volumes_start_index,
-                     &raycasting_tree, &result, &samples, seam_position](tbb::blocked_range<size_t> r) {
-                      // Maintaining hits memory outside of the loop, so it does not have to be reallocated for each query.
-                      std::vector<igl::Hit> hits;
+                     &raycasting_tree, &result, &samples](tbb::blocked_range<size_t> r) {
+                      // Maintaining rays and hits memory outside of the loop, so it does not have to be reallocated for each query.
+                      // All the rays of a sample point start at the same point, thus they are traced as a single coherent batch.
+                      std::vector<Vec3d> ray_origins(precomputed_sample_directions.size());
+                      std::vector<Vec3d> ray_dirs(precomputed_sample_directions.size());
+                      std::vector<igl::Hit> first_hits;
+                      std::vector<std::vector<igl::Hit>> all_hits;
                       for (size_t s_idx = r.begin(); s_idx < r.end(); ++s_idx) {
                         result[s_idx] = 1.0f;
                         constexpr float decrease_step = 1.0f
@@ -162,42 +167,43 @@ std::vector<float> raycast_visibility(const AABBTreeIndirect::Tree<3, float> &ra
 
                         const Vec3f &center = samples.positions[s_idx];
                         const Vec3f &normal = samples.normals[s_idx];
-                        if (seam_position == spAlignedBack) {
-                            const float front_adjustment = std::clamp((normal.dot(Vec3f(0.0f, -1.0f, 0.0f)) + 1.2f) * 0.5f, 0.0f, 1.0f);
-                            result[s_idx] += front_adjustment;
-                        }
 
                         // apply the local direction via Frame struct - the local_dir is with respect to +Z being forward
                         Frame f;
                         f.set_from_z(normal);
 
-                        for (const auto &dir : precomputed_sample_directions) {
-                          Vec3f final_ray_dir = (f.to_world(dir));
-                          if (!model_contains_negative_parts) {
-                            igl::Hit hitpoint;
-                            // FIXME: This AABBTTreeIndirect query will not compile for float ray origin and
-                            // direction.
-                            Vec3d final_ray_dir_d = final_ray_dir.cast<double>();
-                            Vec3d ray_origin_d = (center + normal * 0.01f).cast<double>(); // start above surface.
-                            bool hit = AABBTreeIndirect::intersect_ray_first_hit(triangles.vertices,
-                                                                                 triangles.indices, raycasting_tree, ray_origin_d, final_ray_dir_d, hitpoint);
-                            if (hit && its_face_normal(triangles, hitpoint.id).dot(final_ray_dir) <= 0) {
+                        //TODO improve logic for order based boolean operations - consider order of volumes
+                        bool casting_from_negative_volume = model_contains_negative_parts
+                                                            && samples.triangle_indices[s_idx] >= negative_volumes_start_index;
+                        Vec3d ray_origin_d = (center + normal * 0.01f).cast<double>(); // start above surface.
+                        if (casting_from_negative_volume) { // if casting from negative volume face, invert direction, change start pos
+                          ray_origin_d = (center - normal * 0.01f).cast<double>();
+                        }
+                        for (size_t dir_idx = 0; dir_idx < precomputed_sample_directions.size(); ++dir_idx) {
+                          Vec3f final_ray_dir = f.to_world(precomputed_sample_directions[dir_idx]);
+                          if (casting_from_negative_volume) {
+                            final_ray_dir = -1.0 * final_ray_dir;
+                          }
+                          ray_origins[dir_idx] = ray_origin_d;
+                          ray_dirs[dir_idx]    = final_ray_dir.cast<double>();
+                        }
+
+                        if (!model_contains_negative_parts) {
+                          AABBTreeIndirect::intersect_rays_first_hit(triangles.vertices, triangles.indices, raycasting_tree,
+                                                                     ray_origins, ray_dirs, first_hits);
+                          for (size_t dir_idx = 0; dir_idx < first_hits.size(); ++dir_idx) {
+                            const igl::Hit &hitpoint = first_hits[dir_idx];
+                            if (hitpoint.id != -1 && its_face_normal(triangles, hitpoint.id).dot(ray_dirs[dir_idx].cast<float>()) <= 0) {
                               result[s_idx] -= decrease_step;
                             }
-                          } else { //TODO improve logic for order based boolean operations - consider order of volumes
-                            bool casting_from_negative_volume = samples.triangle_indices[s_idx]
-                                                                >= negative_volumes_start_index;
-
-                            Vec3d ray_origin_d = (center + normal * 0.01f).cast<double>(); // start above surface.
-                            if (casting_from_negative_volume) { // if casting from negative volume face, invert direction, change start pos
-                              final_ray_dir = -1.0 * final_ray_dir;
-                              ray_origin_d = (center - normal * 0.01f).cast<double>();
-                            }
-                            Vec3d final_ray_dir_d = final_ray_dir.cast<double>();
-                            bool some_hit = AABBTreeIndirect::intersect_ray_all_hits(triangles.vertices,
-                                                                                     triangles.indices, raycasting_tree,
-                                                                                     ray_origin_d, final_ray_dir_d, hits);
-                            if (some_hit) {
+                          }
+                        } else {
+                          AABBTreeIndirect::intersect_rays_all_hits(triangles.vertices, triangles.indices, raycasting_tree,
+                                                                    ray_origins, ray_dirs, all_hits);
+                          for (size_t dir_idx = 0; dir_idx < all_hits.size(); ++dir_idx) {
+                            const std::vector<igl::Hit> &hits = all_hits[dir_idx];
+                            if (!hits.empty()) {
+                              const Vec3f final_ray_dir = ray_dirs[dir_idx].cast<float>();
                               int counter = 0;
                               // NOTE: iterating in reverse, from the last hit for one simple reason: We know the state of the ray at that point;
                               //  It cannot be inside model, and it cannot be inside negative volume
@@ -292,11 +298,12 @@ struct CoordinateFunctor {
 
 // structure to store global information about the model - occlusion hits, enforcers, blockers
 struct GlobalModelInfo {
-  TriangleSetSamples mesh_samples;
-  std::vector<float> mesh_samples_visibility;
+  // Shared with the PrintObject, which retains it for the next G-code export.
+  std::shared_ptr<const MeshVisibility> mesh_visibility;
+  // spAlignedBack: Samples facing the front are considered more visible.
+  bool prefer_back { false };
   CoordinateFunctor mesh_samples_coordinate_functor;
   KDTreeIndirect<3, float, CoordinateFunctor> mesh_samples_tree { CoordinateFunctor { } };
-  float mesh_samples_radius;
 
   indexed_triangle_set enforcers;
   indexed_triangle_set blockers;
@@ -321,7 +328,25 @@ struct GlobalModelInfo {
                                                        blockers_tree, position, radius_sqr);
   }
 
+  void set_mesh_visibility(std::shared_ptr<const MeshVisibility> visibility, bool back) {
+    mesh_visibility = std::move(visibility);
+    prefer_back = back;
+    mesh_samples_coordinate_functor = CoordinateFunctor(&mesh_visibility->samples.positions);
+    mesh_samples_tree = KDTreeIndirect<3, float, CoordinateFunctor>(mesh_samples_coordinate_functor,
+                                                                    mesh_visibility->samples.positions.size());
+  }
+
+  float sample_visibility(size_t sample_idx) const {
+    float visibility = mesh_visibility->visibility[sample_idx];
+    if (prefer_back) {
+      const float front_adjustment = std::clamp((mesh_visibility->samples.normals[sample_idx].dot(Vec3f(0.0f, -1.0f, 0.0f)) + 1.2f) * 0.5f, 0.0f, 1.0f);
+      visibility += front_adjustment;
+    }
+    return visibility;
+  }
+
   float calculate_point_visibility(const Vec3f &position) const {
+    const float mesh_samples_radius = mesh_visibility->samples_radius;
     std::vector<size_t> points = find_nearby_points(mesh_samples_tree, position, mesh_samples_radius);
     if (points.empty()) {
       return 1.0f;
@@ -337,12 +362,12 @@ struct GlobalModelInfo {
     for (size_t i = 0; i < points.size(); ++i) {
       size_t sample_idx = points[i];
 
-      Vec3f sample_point = this->mesh_samples.positions[sample_idx];
-      Vec3f sample_normal = this->mesh_samples.normals[sample_idx];
+      Vec3f sample_point = mesh_visibility->samples.positions[sample_idx];
+      Vec3f sample_normal = mesh_visibility->samples.normals[sample_idx];
 
       float weight = mesh_samples_radius - compute_dist_to_plane(position, sample_point, sample_normal);
       weight += (mesh_samples_radius - (position - sample_point).norm());
-      total_visibility += weight * mesh_samples_visibility[sample_idx];
+      total_visibility += weight * sample_visibility(sample_idx);
       total_weight += weight;
     }
 
@@ -387,8 +412,9 @@ struct GlobalModelInfo {
         return;
       }
 
+      const TriangleSetSamples &mesh_samples = mesh_visibility->samples;
       for (size_t i = 0; i < mesh_samples.positions.size(); ++i) {
-        float visibility = mesh_samples_visibility[i];
+        float visibility = sample_visibility(i);
         Vec3f color = value_to_rgbf(0.0f, 1.0f, visibility);
         fprintf(fp, "v %f %f %f  %f %f %f\n",
                 mesh_samples.positions[i](0), mesh_samples.positions[i](1), mesh_samples.positions[i](2),
@@ -621,10 +647,29 @@ std::pair<size_t, size_t> find_previous_and_next_perimeter_point(const std::vect
   return {size_t(prev),size_t(next)};
 }
 
-// Computes all global model info - transforms object, performs raycasting
-void compute_global_occlusion(GlobalModelInfo &result, const PrintObject *po,
-                              std::function<void(void)> throw_if_canceled,
-                              SeamPosition seam_position = spAligned) {
+// Key of the MeshVisibility of a PrintObject: Hash of the meshes of its parts and negative volumes and of their transformations.
+std::string mesh_visibility_key(const PrintObject *po) {
+  SlicingCacheKey key;
+  key.update(SeamPlacer::raycasting_visibility_samples_count);
+  key.update(SeamPlacer::fast_decimation_triangle_count_target);
+  key.update(SeamPlacer::sqr_rays_per_sample_point);
+  key.update(po->trafo_centered().data(), 16 * sizeof(double));
+  for (const ModelVolume *model_volume : po->model_object()->volumes) {
+    if (model_volume->type() == ModelVolumeType::MODEL_PART
+        || model_volume->type() == ModelVolumeType::NEGATIVE_VOLUME) {
+      key.update(int(model_volume->type()));
+      key.update(model_volume->get_matrix().data(), 16 * sizeof(double));
+      key.update(model_volume->mesh().its.vertices);
+      key.update(model_volume->mesh().its.indices);
+    }
+  }
+  return key.digest();
+}
+
+// Computes the visibility of the object surface - transforms object, performs raycasting
+std::shared_ptr<MeshVisibility> compute_global_occlusion(const PrintObject *po,
+                                                         std::function<void(void)> throw_if_canceled) {
+  auto result = std::make_shared<MeshVisibility>();
   BOOST_LOG_TRIVIAL(debug)
       << "SeamPlacer: gather occlusion meshes: start";
   auto obj_transform = po->trafo_centered();
@@ -663,11 +708,8 @@ void compute_global_occlusion(GlobalModelInfo &result, const PrintObject *po,
   BOOST_LOG_TRIVIAL(debug)
       << "SeamPlacer: Compute visibility sample points: start";
 
-  result.mesh_samples = sample_its_uniform_parallel(SeamPlacer::raycasting_visibility_samples_count,
-                                                    triangle_set);
-  result.mesh_samples_coordinate_functor = CoordinateFunctor(&result.mesh_samples.positions);
-  result.mesh_samples_tree = KDTreeIndirect<3, float, CoordinateFunctor>(result.mesh_samples_coordinate_functor,
-                                                                         result.mesh_samples.positions.size());
+  result->samples = sample_its_uniform_parallel(SeamPlacer::raycasting_visibility_samples_count,
+                                                triangle_set);
 
   // The following code determines search area for random visibility samples on the mesh when calculating visibility of each perimeter point
   // number of random samples in the given radius (area) is approximately poisson distribution
@@ -675,35 +717,33 @@ void compute_global_occlusion(GlobalModelInfo &result, const PrintObject *po,
   // parameters of exponential distribution to compute area that will have with probability="probability" more than given number of samples="samples"
   float probability = 0.9f;
   float samples = 4;
-  float density = SeamPlacer::raycasting_visibility_samples_count / result.mesh_samples.total_area;
+  float density = SeamPlacer::raycasting_visibility_samples_count / result->samples.total_area;
   // exponential probability distrubtion function is : f(x) = P(X > x) = e^(l*x) where l is the rate parameter (computed as 1/u where u is mean value)
   // probability that sampled area A with S samples contains more than samples count:
   //  P(S > samples in A) = e^-(samples/(density*A));   express A:
   float search_area = samples / (-logf(probability) * density);
   float search_radius = sqrt(search_area / PI);
-  result.mesh_samples_radius = search_radius;
+  result->samples_radius = search_radius;
 
   BOOST_LOG_TRIVIAL(debug)
       << "SeamPlacer: Compute visiblity sample points: end";
   throw_if_canceled();
 
   BOOST_LOG_TRIVIAL(debug)
-      << "SeamPlacer: Mesh sample raidus: " << result.mesh_samples_radius;
+      << "SeamPlacer: Mesh sample raidus: " << result->samples_radius;
 
   BOOST_LOG_TRIVIAL(debug)
       << "SeamPlacer: build AABB tree: start";
-  auto raycasting_tree = AABBTreeIndirect::build_aabb_tree_over_indexed_triangle_set(triangle_set.vertices,
-                                                                                     triangle_set.indices);
+  auto raycasting_tree = AABBTreeIndirect::build_wide_aabb_tree_over_indexed_triangle_set<4>(triangle_set.vertices,
+                                                                                             triangle_set.indices);
 
   throw_if_canceled();
   BOOST_LOG_TRIVIAL(debug)
       << "SeamPlacer: build AABB tree: end";
-  result.mesh_samples_visibility = raycast_visibility(raycasting_tree, triangle_set, result.mesh_samples,
-                                                      negative_volumes_start_index, seam_position);
+  result->visibility = raycast_visibility(raycasting_tree, triangle_set, result->samples,
+                                          negative_volumes_start_index);
   throw_if_canceled();
-#ifdef DEBUG_FILES
-  result.debug_export(triangle_set);
-#endif
+  return result;
 }
 
 void gather_enforcers_blockers(GlobalModelInfo &result, const PrintObject *po) {
@@ -1006,10 +1046,10 @@ void pick_random_seam_point(const std::vector<SeamCandidate> &perimeter_points,
 
 // Parallel process and extract each perimeter polygon of the given print object.
 // Gather SeamCandidates of each layer into vector and build KDtree over them
-// Store results in the SeamPlacer variables m_seam_per_object
-void SeamPlacer::gather_seam_candidates(const PrintObject *po, const SeamPlacerImpl::GlobalModelInfo &global_model_info) {
+// Store results into seam_data
+void SeamPlacer::gather_seam_candidates(const PrintObject *po, PrintObjectSeamData &seam_data,
+                                        const SeamPlacerImpl::GlobalModelInfo &global_model_info) {
   using namespace SeamPlacerImpl;
-  PrintObjectSeamData &seam_data = m_seam_per_object.emplace(po, PrintObjectSeamData { }).first->second;
   seam_data.layers.resize(po->layer_count());
 
   tbb::parallel_for(tbb::blocked_range<size_t>(0, po->layers().size()),
@@ -1035,11 +1075,11 @@ void SeamPlacer::gather_seam_candidates(const PrintObject *po, const SeamPlacerI
   );
 }
 
-void SeamPlacer::calculate_candidates_visibility(const PrintObject *po,
+void SeamPlacer::calculate_candidates_visibility(PrintObjectSeamData &seam_data,
                                                  const SeamPlacerImpl::GlobalModelInfo &global_model_info) {
   using namespace SeamPlacerImpl;
 
-  std::vector<PrintObjectSeamData::LayerSeams> &layers = m_seam_per_object[po].layers;
+  std::vector<PrintObjectSeamData::LayerSeams> &layers = seam_data.layers;
   tbb::parallel_for(tbb::blocked_range<size_t>(0, layers.size()),
                     [&layers, &global_model_info](tbb::blocked_range<size_t> r) {
                       for (size_t layer_idx = r.begin(); layer_idx < r.end(); ++layer_idx) {
@@ -1051,11 +1091,11 @@ void SeamPlacer::calculate_candidates_visibility(const PrintObject *po,
                     });
 }
 
-void SeamPlacer::calculate_overhangs_and_layer_embedding(const PrintObject *po) {
+void SeamPlacer::calculate_overhangs_and_layer_embedding(const PrintObject *po, PrintObjectSeamData &seam_data) {
   using namespace SeamPlacerImpl;
   using PerimeterDistancer = AABBTreeLines::LinesDistancer<Linef>;
 
-  std::vector<PrintObjectSeamData::LayerSeams> &layers = m_seam_per_object[po].layers;
+  std::vector<PrintObjectSeamData::LayerSeams> &layers = seam_data.layers;
   tbb::parallel_for(tbb::blocked_range<size_t>(0, layers.size()),
                     [po, &layers](tbb::blocked_range<size_t> r) {
                       std::unique_ptr<PerimeterDistancer> prev_layer_distancer;
@@ -1171,9 +1211,9 @@ std::optional<std::pair<size_t, size_t>> SeamPlacer::find_next_seam_in_layer(
   return {};
 }
 
-std::vector<std::pair<size_t, size_t>> SeamPlacer::find_seam_string(const PrintObject *po,
+std::vector<std::pair<size_t, size_t>> SeamPlacer::find_seam_string(const PrintObject *po, const PrintObjectSeamData &seam_data,
                                                                     std::pair<size_t, size_t> start_seam, const SeamPlacerImpl::SeamComparator &comparator) const {
-  const std::vector<PrintObjectSeamData::LayerSeams> &layers = m_seam_per_object.find(po)->second.layers;
+  const std::vector<PrintObjectSeamData::LayerSeams> &layers = seam_data.layers;
   int layer_idx = start_seam.first;
 
   //initialize searching for seam string - cluster of nearby seams on previous and next layers
@@ -1230,7 +1270,7 @@ std::vector<std::pair<size_t, size_t>> SeamPlacer::find_seam_string(const PrintO
 // Does not change the positions of the SeamCandidates themselves, instead stores
 // the new aligned position into the shared Perimeter structure of each perimeter
 // Note that this position does not necesarilly lay on the perimeter.
-void SeamPlacer::align_seam_points(const PrintObject *po, const SeamPlacerImpl::SeamComparator &comparator) {
+void SeamPlacer::align_seam_points(const PrintObject *po, PrintObjectSeamData &seam_data, const SeamPlacerImpl::SeamComparator &comparator) {
   using namespace SeamPlacerImpl;
 
   // Prepares Debug files for writing.
@@ -1253,7 +1293,7 @@ void SeamPlacer::align_seam_points(const PrintObject *po, const SeamPlacerImpl::
 #endif
 
   //gather vector of all seams on the print_object - pair of layer_index and seam__index within that layer
-  const std::vector<PrintObjectSeamData::LayerSeams> &layers = m_seam_per_object[po].layers;
+  const std::vector<PrintObjectSeamData::LayerSeams> &layers = seam_data.layers;
   std::vector<std::pair<size_t, size_t>> seams;
   for (size_t layer_idx = 0; layer_idx < layers.size(); ++layer_idx) {
     const std::vector<SeamCandidate> &layer_perimeter_points = layers[layer_idx].points;
@@ -1291,13 +1331,13 @@ void SeamPlacer::align_seam_points(const PrintObject *po, const SeamPlacerImpl::
       // This perimeter is already aligned, skip seam
       continue;
     } else {
-      seam_string = this->find_seam_string(po, { layer_idx, seam_index }, comparator);
+      seam_string = this->find_seam_string(po, seam_data, { layer_idx, seam_index }, comparator);
       size_t step_size = 1 + seam_string.size() / 20;
       for (size_t alternative_start = 0; alternative_start < seam_string.size(); alternative_start += step_size) {
         size_t start_layer_idx = seam_string[alternative_start].first;
         size_t seam_idx =
             layers[start_layer_idx].points[seam_string[alternative_start].second].perimeter.seam_index;
-        alternative_seam_string = this->find_seam_string(po,
+        alternative_seam_string = this->find_seam_string(po, seam_data,
                                                          std::pair<size_t, size_t>(start_layer_idx, seam_idx), comparator);
         if (alternative_seam_string.size() > seam_string.size()) {
           seam_string = std::move(alternative_seam_string);
@@ -1420,6 +1460,18 @@ void SeamPlacer::align_seam_points(const PrintObject *po, const SeamPlacerImpl::
 
 }
 
+// Key of the seam placement of a PrintObject: The seam options and the seam painting.
+// The perimeters are not part of the key, PrintObject drops the retained seam placement when they are invalidated.
+std::string seam_data_key(const PrintObject *po) {
+  SlicingCacheKey key;
+  key.update(po->config().seam_position.value);
+  for (const ModelVolume *model_volume : po->model_object()->volumes) {
+    key.update(model_volume->id().id);
+    key.update(model_volume->seam_facets.timestamp());
+  }
+  return key.digest();
+}
+
 void SeamPlacer::init(const Print &print, std::function<void(void)> throw_if_canceled_func) {
   using namespace SeamPlacerImpl;
   m_seam_per_object.clear();
@@ -1429,24 +1481,49 @@ void SeamPlacer::init(const Print &print, std::function<void(void)> throw_if_can
     SeamPosition configured_seam_preference = po->config().seam_position.value;
     SeamComparator comparator { configured_seam_preference };
 
+    // The seam placement of the previous G-code export is reused if the perimeters and the seam options did not change.
+    std::string seam_key = seam_data_key(po);
+    if (std::shared_ptr<const PrintObjectSeamData> retained = po->seam_data(seam_key); retained) {
+      BOOST_LOG_TRIVIAL(debug)
+          << "SeamPlacer: reusing the seam placement of " << po->model_object()->name;
+      m_seam_per_object.emplace(po, std::move(retained));
+      continue;
+    }
+    auto seam_data = std::make_shared<PrintObjectSeamData>();
+
     {
       GlobalModelInfo global_model_info { };
       gather_enforcers_blockers(global_model_info, po);
       throw_if_canceled_func();
       if (configured_seam_preference == spAligned || configured_seam_preference == spNearest || configured_seam_preference == spAlignedBack) {
-        compute_global_occlusion(global_model_info, po, throw_if_canceled_func, configured_seam_preference);
+        // The visibility depends on the object mesh only, thus it is reused if just the G-code options changed.
+        std::string key = mesh_visibility_key(po);
+        std::shared_ptr<const MeshVisibility> mesh_visibility = po->seam_visibility(key);
+        if (! mesh_visibility) {
+          mesh_visibility = compute_global_occlusion(po, throw_if_canceled_func);
+          po->set_seam_visibility(std::move(key), mesh_visibility);
+        } else {
+          BOOST_LOG_TRIVIAL(debug)
+              << "SeamPlacer: reusing the visibility of " << po->model_object()->name;
+        }
+        global_model_info.set_mesh_visibility(std::move(mesh_visibility), configured_seam_preference == spAlignedBack);
+#ifdef DEBUG_FILES
+        indexed_triangle_set its = po->model_object()->raw_indexed_triangle_set();
+        its_transform(its, po->trafo_centered());
+        global_model_info.debug_export(its);
+#endif
       }
       throw_if_canceled_func();
       BOOST_LOG_TRIVIAL(debug)
           << "SeamPlacer: gather_seam_candidates: start";
-      gather_seam_candidates(po, global_model_info);
+      gather_seam_candidates(po, *seam_data, global_model_info);
       BOOST_LOG_TRIVIAL(debug)
           << "SeamPlacer: gather_seam_candidates: end";
       throw_if_canceled_func();
       if (configured_seam_preference == spAligned || configured_seam_preference == spNearest || configured_seam_preference == spAlignedBack) {
         BOOST_LOG_TRIVIAL(debug)
             << "SeamPlacer: calculate_candidates_visibility : start";
-        calculate_candidates_visibility(po, global_model_info);
+        calculate_candidates_visibility(*seam_data, global_model_info);
         BOOST_LOG_TRIVIAL(debug)
             << "SeamPlacer: calculate_candidates_visibility : end";
       }
@@ -1454,7 +1531,7 @@ void SeamPlacer::init(const Print &print, std::function<void(void)> throw_if_can
     throw_if_canceled_func();
     BOOST_LOG_TRIVIAL(debug)
         << "SeamPlacer: calculate_overhangs and layer embdedding : start";
-    calculate_overhangs_and_layer_embedding(po);
+    calculate_overhangs_and_layer_embedding(po, *seam_data);
     BOOST_LOG_TRIVIAL(debug)
         << "SeamPlacer: calculate_overhangs and layer embdedding: end";
     throw_if_canceled_func();
@@ -1462,7 +1539,7 @@ void SeamPlacer::init(const Print &print, std::function<void(void)> throw_if_can
       BOOST_LOG_TRIVIAL(debug)
           << "SeamPlacer: pick_seam_point : start";
       //pick seam point
-      std::vector<PrintObjectSeamData::LayerSeams> &layers = m_seam_per_object[po].layers;
+      std::vector<PrintObjectSeamData::LayerSeams> &layers = seam_data->layers;
       tbb::parallel_for(tbb::blocked_range<size_t>(0, layers.size()),
                         [&layers, configured_seam_preference, comparator](tbb::blocked_range<size_t> r) {
                           for (size_t layer_idx = r.begin(); layer_idx < r.end(); ++layer_idx) {
@@ -1482,14 +1559,16 @@ void SeamPlacer::init(const Print &print, std::function<void(void)> throw_if_can
     if (configured_seam_preference == spAligned || configured_seam_preference == spRear || configured_seam_preference == spAlignedBack) {
       BOOST_LOG_TRIVIAL(debug)
           << "SeamPlacer: align_seam_points : start";
-      align_seam_points(po, comparator);
+      align_seam_points(po, *seam_data, comparator);
       BOOST_LOG_TRIVIAL(debug)
           << "SeamPlacer: align_seam_points : end";
     }
 
 #ifdef DEBUG_FILES
-    debug_export_points(m_seam_per_object[po].layers, po->bounding_box(), comparator);
+    debug_export_points(seam_data->layers, po->bounding_box(), comparator);
 #endif
+    po->set_seam_data(std::move(seam_key), seam_data);
+    m_seam_per_object.emplace(po, std::move(seam_data));
   }
 }
 
@@ -1515,7 +1594,7 @@ void SeamPlacer::place_seam(const Layer *layer, ExtrusionLoop &loop,
   };
 
   const PrintObjectSeamData::LayerSeams &layer_perimeters =
-      m_seam_per_object.find(layer->object())->second.layers[layer_index];
+      m_seam_per_object.find(layer->object())->second->layers[layer_index];
 
   // Find the closest perimeter in the SeamPlacer to this loop.
   // Repeat search until two consecutive points of the loop are found, that result in the same closest_perimeter
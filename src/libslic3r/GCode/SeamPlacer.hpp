@@ -14,6 +14,7 @@
 #include "libslic3r/BoundingBox.hpp"
 #include "libslic3r/AABBTreeIndirect.hpp"
 #include "libslic3r/KDTreeIndirect.hpp"
+#include "libslic3r/TriangleSetSampling.hpp"
 
 namespace Slic3r {
 
@@ -32,6 +33,17 @@ namespace SeamPlacerImpl {
 struct GlobalModelInfo;
 struct SeamComparator;
 
+// Visibility of uniform samples of the object surface, raycasted over the decimated object mesh.
+// It depends on the object mesh and transformation only, thus it is retained by the PrintObject
+// between G-code exports, see PrintObject::seam_visibility().
+struct MeshVisibility {
+  TriangleSetSamples samples;
+  // Visibility of each sample, without the spAlignedBack preference of the samples facing the front.
+  std::vector<float> visibility;
+  // Search radius for the samples around a perimeter point.
+  float samples_radius { 0.f };
+};
+
 enum class EnforcedBlockedSeamPoint {
   Blocked = 0,
   Neutral = 1,
@@ -139,18 +151,20 @@ public:
   static constexpr size_t seam_align_mm_per_segment = 4.0f;
 
   //The following data structures hold all perimeter points for all PrintObject.
-  std::unordered_map<const PrintObject*, PrintObjectSeamData> m_seam_per_object;
+  //They are shared with the PrintObjects, which retain them for the next G-code export, see PrintObject::seam_data().
+  std::unordered_map<const PrintObject*, std::shared_ptr<const PrintObjectSeamData>> m_seam_per_object;
 
   void init(const Print &print, std::function<void(void)> throw_if_canceled_func);
 
   void place_seam(const Layer *layer, ExtrusionLoop &loop, const Point &last_pos, float& overhang) const;
 private:
-  void gather_seam_candidates(const PrintObject *po, const SeamPlacerImpl::GlobalModelInfo &global_model_info);
-  void calculate_candidates_visibility(const PrintObject *po,
+  void gather_seam_candidates(const PrintObject *po, PrintObjectSeamData &seam_data,
+                              const SeamPlacerImpl::GlobalModelInfo &global_model_info);
+  void calculate_candidates_visibility(PrintObjectSeamData &seam_data,
                                        const SeamPlacerImpl::GlobalModelInfo &global_model_info);
-  void calculate_overhangs_and_layer_embedding(const PrintObject *po);
-  void align_seam_points(const PrintObject *po, const SeamPlacerImpl::SeamComparator &comparator);
-  std::vector<std::pair<size_t, size_t>> find_seam_string(const PrintObject *po,
+  void calculate_overhangs_and_layer_embedding(const PrintObject *po, PrintObjectSeamData &seam_data);
+  void align_seam_points(const PrintObject *po, PrintObjectSeamData &seam_data, const SeamPlacerImpl::SeamComparator &comparator);
+  std::vector<std::pair<size_t, size_t>> find_seam_string(const PrintObject *po, const PrintObjectSeamData &seam_data,
                                                           std::pair<size_t, size_t> start_seam,
                                                           const SeamPlacerImpl::SeamComparator &comparator) const;
   std::optional<std::pair<size_t, size_t>> find_next_seam_in_layer(
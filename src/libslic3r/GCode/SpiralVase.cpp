@@ -63,7 +63,7 @@ SpiralVase::SpiralPoint nearest_point_on_lines(SpiralVase::SpiralPoint
 }
 } // namespace SpiralVase
 
-std::string SpiralVase::process_layer(const std::string &gcode, bool last_layer)
+void SpiralVase::process_layer(GCodeLayerBuffer &gcode, bool last_layer)
 {
     /*  This post-processor relies on several assumptions:
         - all layers are processed through it, including those that are not supposed
@@ -73,47 +73,48 @@ std::string SpiralVase::process_layer(const std::string &gcode, bool last_layer)
         - each layer is composed by suitable geometry (i.e. a single complete loop)
         - loops were not clipped before calling this method  */
     
-    // If we're not going to modify G-code, just feed it to the reader
+    // If we're not going to modify G-code, just follow the lines
     // in order to update positions.
     if (! m_enabled) {
-        m_reader.parse_buffer(gcode);
-        return gcode;
+        for (size_t i = 0; i < gcode.size(); ++ i) {
+            m_position.start_line(gcode, i);
+            m_position.end_line(gcode, i);
+        }
+        return;
     }
     
     // Get total XY length for this layer by summing all extrusion moves.
     float total_layer_length = 0;
     float layer_height = 0;
     float z = 0.f;
-    
+
     {
-        //FIXME Performance warning: This copies the GCodeConfig of the reader.
-        GCodeReader r = m_reader;  // clone
         bool set_z = false;
-        r.parse_buffer(gcode, [&total_layer_length, &layer_height, &z, &set_z]
-            (GCodeReader &reader, const GCodeReader::GCodeLine &line) {
-            if (line.cmd_is("G1")) {
-                if (line.extruding(reader)) {
-                    total_layer_length += line.dist_XY(reader);
-                } else if (line.has(Z)) {
-                    layer_height += line.dist_Z(reader);
+        GCodeLayerBuffer::Position position = m_position;
+        for (size_t i = 0; i < gcode.size(); ++ i) {
+            position.start_line(gcode, i);
+            if (gcode.command(i) == GCodeLayerBuffer::Command::G1) {
+                if (position.dist(gcode, i, E) > 0) {
+                    total_layer_length += position.dist_xy(gcode, i);
+                } else if (gcode.has(i, Z)) {
+                    layer_height += position.dist(gcode, i, Z);
                     if (!set_z) {
-                        z = line.new_Z(reader);
+                        z = gcode.value(i, Z);
                         set_z = true;
                     }
                 }
             }
-        });
+            position.end_line(gcode, i);
+        }
     }
 
-    // Remove layer height from initial Z.
+    // Remove layer height from initial Z.
     z -= layer_height;
 
     std::vector<SpiralVase::SpiralPoint>* current_layer = new std::vector<SpiralVase::SpiralPoint>();
     std::vector<SpiralVase::SpiralPoint>* previous_layer = m_previous_layer;
 
     bool smooth_spiral = m_smooth_spiral;
-    std::string new_gcode;
-    std::string transition_gcode;
     float max_xy_dist_for_smoothing = m_max_xy_smoothing;
     //FIXME Tapering of the transition layer only works reliably with relative extruder distances.
     // For absolute extruder distances it will be switched off.
@@ -127,71 +128,82 @@ std::string SpiralVase::process_layer(const std::string &gcode, bool last_layer)
 
     float len = 0.f;
     SpiralVase::SpiralPoint last_point = previous_layer != NULL && previous_layer->size() >0? previous_layer->at(previous_layer->size()-1): SpiralVase::SpiralPoint(0,0);
-    m_reader.parse_buffer(gcode, [&new_gcode, &z, total_layer_length, layer_height, transition_in, &len, &current_layer, &previous_layer, &transition_gcode, transition_out, smooth_spiral, &max_xy_dist_for_smoothing, &last_point, starting_flowrate, finishing_flowrate]
-        (GCodeReader &reader, GCodeReader::GCodeLine line) {
-        if (line.cmd_is("G1")) {
+    // The lines of the transition layer are copies of the lines of this layer, which are placed at the end of the layer.
+    const size_t num_lines        = gcode.size();
+    const size_t first_transition = num_lines;
+    for (size_t i = 0; i < num_lines; ++ i) {
+        m_position.start_line(gcode, i);
+        // The position is updated from the line as it was generated, not as it is modified below.
+        GCodeLayerBuffer::Position next_position = m_position;
+        next_position.end_line(gcode, i);
+        if (gcode.command(i) == GCodeLayerBuffer::Command::G1) {
+            const float dist_E  = m_position.dist(gcode, i, E);
+            const bool  has_xy  = gcode.has(i, X) || gcode.has(i, Y);
             // Orca: Filter out retractions at layer change
-            if (line.retracting(reader) || (line.extruding(reader) && line.dist_XY(reader) < EPSILON)) return;
-            if (line.has_z() && !(line.has_x() || line.has_y())) {
+            if (dist_E < 0 || (dist_E > 0 && m_position.dist_xy(gcode, i) < EPSILON)) {
+                gcode.remove(i);
+                m_position = next_position;
+                continue;
+            }
+            if (gcode.has(i, Z) && ! has_xy) {
                 // If this is the initial Z move of the layer, replace it with a
                 // (redundant) move to the last Z of previous layer.
-                line.set(Z, z);
-                new_gcode += line.raw() + '\n';
-                return;
-            } else {
-                float dist_XY = line.dist_XY(reader);
-                if (line.has_x() || line.has_y()) { // Sometimes lines have X/Y but the move is to the last position
-                    if (dist_XY > 0 && line.extruding(reader)) { // Exclude wipe and retract
-                        len += dist_XY;
-                        float factor = len / total_layer_length;
-                        if (transition_in){
-                            // Transition layer, interpolate the amount of extrusion starting from spiral_vase_starting_flow_rate to 100%.
-                            float starting_e_factor = starting_flowrate + (factor * (1.f - starting_flowrate));
-                            line.set(E, line.e() * starting_e_factor, 5 /*decimal_digits*/);
-                        } else if (transition_out) {
-                            // We want the last layer to ramp down extrusion, but without changing z height!
-                            // So clone the line before we mess with its Z and duplicate it into a new layer that ramps down E
-                            // We add this new layer at the very end
-                            // As with transition_in, the amount is ramped down from 100% to spiral_vase_finishing_flow_rate
-                            GCodeReader::GCodeLine transitionLine(line);
-                            float finishing_e_factor = finishing_flowrate + ((1.f -factor) * (1.f - finishing_flowrate));
-                            transitionLine.set(E, line.e() * finishing_e_factor, 5 /*decimal_digits*/);
-                            transition_gcode += transitionLine.raw() + '\n';
-                        }
-                        // This line is the core of Spiral Vase mode, ramp up the Z smoothly
-                        line.set(Z, z + factor * layer_height);
-                        if (smooth_spiral) {
-                            // Now we also need to try to interpolate X and Y
-                            SpiralVase::SpiralPoint p(line.x(), line.y()); // Get current x/y coordinates
-                            current_layer->push_back(p);       // Store that point for later use on the next layer
-                            if (previous_layer != NULL) {
-                                bool        found    = false;
-                                float       dist     = 0;
-                                SpiralVase::SpiralPoint nearestp = SpiralVaseHelpers::nearest_point_on_lines(p, previous_layer, found, dist);
-                                if (found && dist < max_xy_dist_for_smoothing) {
-                                    // Interpolate between the point on this layer and the point on the previous layer
-                                    SpiralVase::SpiralPoint target = SpiralVaseHelpers::add(SpiralVaseHelpers::scale(nearestp, 1 - factor), SpiralVaseHelpers::scale(p, factor));
-
-                                    // Remove tiny movement
-                                    // We need to figure out the distance of this new line!
-                                    float modified_dist_XY = SpiralVaseHelpers::distance(last_point, target);
-                                    if (modified_dist_XY < 0.001)
-                                        line.clear();
-                                    else {
-                                        line.set(X, target.x);
-                                        line.set(Y, target.y);
-                                        // Scale the extrusion amount according to change in length
-                                        line.set(E, line.e() * modified_dist_XY / dist_XY, 5 /*decimal_digits*/);
-                                        last_point = target;
-                                    }
-                                } else {
-                                    last_point = p;
+                gcode.set_axis(i, Z, z);
+                m_position = next_position;
+                continue;
+            } else if (has_xy) { // Sometimes lines have X/Y but the move is to the last position
+                float dist_XY = m_position.dist_xy(gcode, i);
+                if (dist_XY > 0 && dist_E > 0) { // Exclude wipe and retract
+                    // Extrusion of the line, the rounded value written to the line is not read back.
+                    float e = gcode.value(i, E);
+                    const SpiralVase::SpiralPoint p(gcode.value(i, X), gcode.value(i, Y)); // Get current x/y coordinates
+                    len += dist_XY;
+                    float factor = len / total_layer_length;
+                    if (transition_in) {
+                        // Transition layer, interpolate the amount of extrusion starting from spiral_vase_starting_flow_rate to 100%.
+                        float starting_e_factor = starting_flowrate + (factor * (1.f - starting_flowrate));
+                        e *= starting_e_factor;
+                        gcode.set_axis(i, E, e, 5 /*decimal_digits*/);
+                    } else if (transition_out) {
+                        // We want the last layer to ramp down extrusion, but without changing z height!
+                        // So clone the line before we mess with its Z and duplicate it into a new layer that ramps down E
+                        // We add this new layer at the very end
+                        // As with transition_in, the amount is ramped down from 100% to spiral_vase_finishing_flow_rate
+                        size_t transition_line = gcode.add_copy(i);
+                        float finishing_e_factor = finishing_flowrate + ((1.f -factor) * (1.f - finishing_flowrate));
+                        gcode.set_axis(transition_line, E, e * finishing_e_factor, 5 /*decimal_digits*/);
+                    }
+                    // This line is the core of Spiral Vase mode, ramp up the Z smoothly
+                    gcode.set_axis(i, Z, z + factor * layer_height);
+                    if (smooth_spiral) {
+                        // Now we also need to try to interpolate X and Y
+                        current_layer->push_back(p);       // Store that point for later use on the next layer
+                        if (previous_layer != NULL) {
+                            bool        found    = false;
+                            float       dist     = 0;
+                            SpiralVase::SpiralPoint nearestp = SpiralVaseHelpers::nearest_point_on_lines(p, previous_layer, found, dist);
+                            if (found && dist < max_xy_dist_for_smoothing) {
+                                // Interpolate between the point on this layer and the point on the previous layer
+                                SpiralVase::SpiralPoint target = SpiralVaseHelpers::add(SpiralVaseHelpers::scale(nearestp, 1 - factor), SpiralVaseHelpers::scale(p, factor));
+
+                                // Remove tiny movement
+                                // We need to figure out the distance of this new line!
+                                float modified_dist_XY = SpiralVaseHelpers::distance(last_point, target);
+                                if (modified_dist_XY < 0.001)
+                                    gcode.clear(i);
+                                else {
+                                    gcode.set_axis(i, X, target.x);
+                                    gcode.set_axis(i, Y, target.y);
+                                    // Scale the extrusion amount according to change in length
+                                    gcode.set_axis(i, E, e * modified_dist_XY / dist_XY, 5 /*decimal_digits*/);
+                                    last_point = target;
                                 }
+                            } else {
+                                last_point = p;
                             }
                         }
-                        new_gcode += line.raw() + '\n';
                     }
-                    return;
+                } else
                     /*  Skip travel moves: the move to first perimeter point will
                         cause a visible seam when loops are not aligned in XY; by skipping
                         it we blend the first loop move in the XY plane (although the smoothness
@@ -199,19 +211,20 @@ std::string SpiralVase::process_layer(const std::string &gcode, bool last_layer)
                         enforce some minimum length?).
                         When smooth_spiral is enabled, we're gonna end up exactly where the next layer should
                         start anyway, so we don't need the travel move */
-                }
+                    gcode.remove(i);
+                m_position = next_position;
+                continue;
             }
         }
-        new_gcode += line.raw() + '\n';
-        if(transition_out) {
-            transition_gcode += line.raw() + '\n';
-        }
-    });
+        if (transition_out)
+            gcode.add_copy(i);
+        m_position = next_position;
+    }
+    gcode.insert(num_lines, first_transition, gcode.size());
+    gcode.commit();
 
     delete m_previous_layer;
     m_previous_layer = current_layer;
-    
-    return new_gcode + transition_gcode;
 }
 
 }
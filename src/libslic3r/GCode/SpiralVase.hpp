@@ -2,7 +2,8 @@
 #define slic3r_SpiralVase_hpp_
 
 #include "../libslic3r.h"
-#include "../GCodeReader.hpp"
+#include "../PrintConfig.hpp"
+#include "GCodeLayerBuffer.hpp"
 
 namespace Slic3r {
 
@@ -17,10 +18,9 @@ public:
     public:
         float x, y;
     };
-    SpiralVase(const PrintConfig &config) : m_config(config)
+    SpiralVase(const PrintConfig &config) : m_config(config), m_position(config.use_relative_e_distances.value)
     {
-        m_reader.z() = (float)m_config.z_offset;
-        m_reader.apply_config(m_config);
+        m_position[Z] = (float)m_config.z_offset;
         m_previous_layer = NULL;
         m_smooth_spiral = config.spiral_mode_smooth;
     };
@@ -30,13 +30,15 @@ public:
     	m_enabled 		   = en;
     }
 
-    std::string process_layer(const std::string &gcode, bool last_layer);
+    // Modify the layer in place.
+    void process_layer(GCodeLayerBuffer &gcode, bool last_layer);
     void set_max_xy_smoothing(float max) {
         m_max_xy_smoothing = max;
     }
 private:
     const PrintConfig  &m_config;
-    GCodeReader 		m_reader;
+    // Position of the print head at the end of the layers processed so far.
+    GCodeLayerBuffer::Position m_position;
     float               m_max_xy_smoothing = 0.f;
 
     bool 				m_enabled = false;
@@ -1,9 +1,14 @@
 #include "ToolOrderUtils.hpp"
+#include <algorithm>
+#include <cassert>
 #include <queue>
 #include <set>
 #include <map>
 #include <cmath>
-#include <boost/multiprecision/cpp_int.hpp>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
 
 namespace Slic3r
 {
@@ -378,11 +383,11 @@ namespace Slic3r
     }
 
     //solve the problem by searching the least flush of current filament
-    static std::vector<unsigned int> solve_extruder_order_with_greedy(const std::vector<std::vector<float>>& wipe_volumes,
-        const std::vector<unsigned int> curr_layer_extruders,
+    std::vector<unsigned int> ExtruderOrderSolver::solve_greedy(const std::vector<unsigned int>& curr_layer_extruders,
         const std::optional<unsigned int>& start_extruder_id,
-        float* min_cost)
+        float* min_cost) const
     {
+        const std::vector<std::vector<float>>& wipe_volumes = m_wipe_volumes;
         float cost = 0;
         std::vector<unsigned int> best_seq;
         std::vector<bool>is_visited(curr_layer_extruders.size(), false);
@@ -418,31 +423,26 @@ namespace Slic3r
     }
 
     //solve the problem by forcasting one layer
-    static std::vector<unsigned int> solve_extruder_order_with_forcast(const std::vector<std::vector<float>>& wipe_volumes,
-        std::vector<unsigned int> curr_layer_extruders,
+    std::vector<unsigned int> ExtruderOrderSolver::solve_with_forcast(std::vector<unsigned int> curr_layer_extruders,
         std::vector<unsigned int> next_layer_extruders,
         const std::optional<unsigned int>& start_extruder_id,
-        float* min_cost)
+        float* min_cost) const
     {
+        const std::vector<std::vector<float>>& wipe_volumes = m_wipe_volumes;
         std::sort(curr_layer_extruders.begin(), curr_layer_extruders.end());
         std::sort(next_layer_extruders.begin(), next_layer_extruders.end());
         float best_cost = std::numeric_limits<float>::max();
         int best_change = std::numeric_limits<int>::max(); // add filament change check in case flush volume between different filament is 0
         std::vector<unsigned int>best_seq;
 
+        // The filaments of a layer are unique, thus the filament changes only depend on the first and the last filaments of the layers.
         auto get_filament_change_count = [](const std::vector<unsigned int>& curr_seq, const std::vector<unsigned int>& next_seq,const std::optional<unsigned int>& start_extruder_id) {
-            int count = 0;
-            auto prev_extruder_id = start_extruder_id;
-            for (auto seq : { curr_seq,next_seq }) {
-                for (auto eid : seq) {
-                    if (prev_extruder_id && prev_extruder_id != eid) {
-                        count += 1;
-                    }
-                    prev_extruder_id = eid;
-                }
-            }
+            int count = int(curr_seq.size()) - 1;
+            if (start_extruder_id && *start_extruder_id != curr_seq.front())
+                count += 1;
+            if (!next_seq.empty())
+                count += int(next_seq.size()) - (curr_seq.back() == next_seq.front() ? 1 : 0);
             return count;
-
             };
 
         do {
@@ -487,9 +487,82 @@ namespace Slic3r
         return best_seq;
     }
 
+    static inline int lowest_bit_index(uint32_t mask)
+    {
+        assert(mask != 0);
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward(&idx, mask);
+        return int(idx);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    // Number of the extruders visited by the path, the start extruder is prepended if it is not one of the extruders.
+    static size_t num_path_extruders(const std::vector<unsigned int>& extruders, const std::optional<unsigned int>& start_extruder_id)
+    {
+        return extruders.size() + (start_extruder_id && std::find(extruders.begin(), extruders.end(), *start_extruder_id) == extruders.end() ? 1 : 0);
+    }
+
+    void ExtruderOrderSolver::held_karp(const std::vector<unsigned int>& extruders)
+    {
+        const size_t n = extruders.size();
+        assert(n <= MaxExactExtruders);
+        const size_t iterations = size_t(1) << n;
+
+        // Local copy of the flush volumes between the extruders, indexed by the target first to access them in a cache friendly way.
+        m_dp_wipe_volumes.resize(n * n);
+        for (size_t from = 0; from < n; ++from)
+            for (size_t to = 0; to < n; ++to)
+                m_dp_wipe_volumes[to * n + from] = m_wipe_volumes[extruders[from]][extruders[to]];
+
+        // The tables are reused between the calls, assign() only reallocates if a larger table is needed.
+        m_dp_cost.assign(iterations * n, float(0x7fffffff));
+        m_dp_prev.assign(iterations * n, int8_t(-1));
+        m_dp_cost[1 * n + 0] = 0.;
+        // Only the subsets containing the start extruder are reachable. The members of the subsets are visited in ascending order.
+        for (uint32_t state = 1; state < iterations; state += 2) {
+            for (uint32_t targets = state; targets != 0; targets &= targets - 1) {
+                const int      target     = lowest_bit_index(targets);
+                const uint32_t prev_state = state - (uint32_t(1) << target);
+                const float   *prev_costs = m_dp_cost.data() + prev_state * n;
+                const float   *wipe_to    = m_dp_wipe_volumes.data() + target * n;
+                float          cost       = m_dp_cost[state * n + target];
+                int8_t         prev       = -1;
+                for (uint32_t mid_points = prev_state; mid_points != 0; mid_points &= mid_points - 1) {
+                    const int mid_point = lowest_bit_index(mid_points);
+                    auto tmp = prev_costs[mid_point] + wipe_to[mid_point];
+                    if (cost > tmp) {
+                        cost = tmp;
+                        prev = int8_t(mid_point);
+                    }
+                }
+                m_dp_cost[state * n + target] = cost;
+                m_dp_prev[state * n + target] = prev;
+            }
+        }
+    }
+
+    std::vector<unsigned int> ExtruderOrderSolver::held_karp_path(const std::vector<unsigned int>& extruders, size_t last) const
+    {
+        const size_t n = extruders.size();
+        std::vector<unsigned int>path;
+        path.reserve(n);
+        size_t curr_state = (size_t(1) << n) - 1;
+        int curr_point = int(last);
+        while (curr_point != -1) {
+            path.emplace_back(extruders[curr_point]);
+            auto mid_point = m_dp_prev[curr_state * n + curr_point];
+            curr_state -= (size_t(1) << curr_point);
+            curr_point = mid_point;
+        };
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
     // Shortest hamilton path problem
-    static std::vector<unsigned int> solve_extruder_order(const std::vector<std::vector<float>>& wipe_volumes,
-        std::vector<unsigned int> all_extruders,
+    std::vector<unsigned int> ExtruderOrderSolver::solve_exact(std::vector<unsigned int> all_extruders,
         std::optional<unsigned int> start_extruder_id,
         float* min_cost)
     {
@@ -506,58 +579,210 @@ namespace Slic3r
             start_extruder_id = all_extruders.front();
         }
 
-        unsigned int iterations = (1 << all_extruders.size());
-        unsigned int final_state = iterations - 1;
-        std::vector<std::vector<float>>cache(iterations, std::vector<float>(all_extruders.size(), 0x7fffffff));
-        std::vector<std::vector<int>>prev(iterations, std::vector<int>(all_extruders.size(), -1));
-        cache[1][0] = 0.;
-        for (unsigned int state = 0; state < iterations; ++state) {
-            if (state & 1) {
-                for (unsigned int target = 0; target < all_extruders.size(); ++target) {
-                    if (state >> target & 1) {
-                        for (unsigned int mid_point = 0; mid_point < all_extruders.size(); ++mid_point) {
-                            if (state >> mid_point & 1) {
-                                auto tmp = cache[state - (1 << target)][mid_point] + wipe_volumes[all_extruders[mid_point]][all_extruders[target]];
-                                if (cache[state][target] > tmp) {
-                                    cache[state][target] = tmp;
-                                    prev[state][target] = mid_point;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        this->held_karp(all_extruders);
 
         //get res
+        const size_t n = all_extruders.size();
+        const size_t final_state = (size_t(1) << n) - 1;
         float cost = std::numeric_limits<float>::max();
-        int final_dst = 0;
-        for (unsigned int dst = 0; dst < all_extruders.size(); ++dst) {
-            if (all_extruders[dst] != start_extruder_id && cost > cache[final_state][dst]) {
-                cost = cache[final_state][dst];
+        size_t final_dst = 0;
+        for (size_t dst = 0; dst < n; ++dst) {
+            if (all_extruders[dst] != start_extruder_id && cost > m_dp_cost[final_state * n + dst]) {
+                cost = m_dp_cost[final_state * n + dst];
                 if (min_cost)
                     *min_cost = cost;
                 final_dst = dst;
             }
         }
 
-        std::vector<unsigned int>path;
-        unsigned int curr_state = final_state;
-        int curr_point = final_dst;
-        while (curr_point != -1) {
-            path.emplace_back(all_extruders[curr_point]);
-            auto mid_point = prev[curr_state][curr_point];
-            curr_state -= (1 << curr_point);
-            curr_point = mid_point;
-        };
-
+        std::vector<unsigned int>path = this->held_karp_path(all_extruders, final_dst);
         if (add_start_extruder_flag)
-            path.pop_back();
-
-        std::reverse(path.begin(), path.end());
+            path.erase(path.begin());
         return path;
     }
 
+    std::vector<unsigned int> ExtruderOrderSolver::solve(const std::vector<unsigned int>& curr_layer_extruders,
+        const std::vector<unsigned int>& next_layer_extruders,
+        const std::optional<unsigned int>& start_extruder_id,
+        bool use_forcast,
+        float* cost)
+    {
+        if (curr_layer_extruders.empty()) {
+            if (cost)
+                *cost = 0;
+            return curr_layer_extruders;
+        }
+        if (curr_layer_extruders.size() == 1) {
+            if (cost) {
+                *cost = 0;
+                if (start_extruder_id)
+                    *cost = m_wipe_volumes[*start_extruder_id][curr_layer_extruders[0]];
+            }
+            return curr_layer_extruders;
+        }
+
+        std::vector<unsigned int> key;
+        key.reserve(curr_layer_extruders.size() + next_layer_extruders.size() + 3);
+        key.emplace_back(use_forcast);
+        key.emplace_back(start_extruder_id ? *start_extruder_id + 1 : 0);
+        key.emplace_back(curr_layer_extruders.size());
+        // The order of the filaments of a layer does not matter, the filaments are sorted to share the entries between the permutations.
+        key.insert(key.end(), curr_layer_extruders.begin(), curr_layer_extruders.end());
+        std::sort(key.end() - curr_layer_extruders.size(), key.end());
+        if (use_forcast) {
+            key.insert(key.end(), next_layer_extruders.begin(), next_layer_extruders.end());
+            std::sort(key.end() - next_layer_extruders.size(), key.end());
+        }
+        if (auto iter = m_cache.find(key); iter != m_cache.end()) {
+            ++m_cache_hits;
+            if (cost)
+                *cost = iter->second.first;
+            return iter->second.second;
+        }
+        ++m_cache_misses;
+
+        float tmp_cost = 0;
+        std::vector<unsigned int> sequence;
+        if (use_forcast)
+            sequence = this->solve_with_forcast(curr_layer_extruders, next_layer_extruders, start_extruder_id, &tmp_cost);
+        else if (num_path_extruders(curr_layer_extruders, start_extruder_id) <= MaxExactExtruders)
+            sequence = this->solve_exact(curr_layer_extruders, start_extruder_id, &tmp_cost);
+        else
+            sequence = this->solve_greedy(curr_layer_extruders, start_extruder_id, &tmp_cost);
+        if (cost)
+            *cost = tmp_cost;
+        return m_cache.emplace(std::move(key), std::make_pair(tmp_cost, std::move(sequence))).first->second.second;
+    }
+
+    const ExtruderOrderSolver::ShortestPaths& ExtruderOrderSolver::shortest_paths(const std::vector<unsigned int>& extruders, unsigned int start_extruder_id)
+    {
+        std::vector<unsigned int> key;
+        key.reserve(extruders.size() + 1);
+        key.emplace_back(start_extruder_id);
+        key.insert(key.end(), extruders.begin(), extruders.end());
+        std::sort(key.begin() + 1, key.end());
+        if (auto iter = m_paths_cache.find(key); iter != m_paths_cache.end()) {
+            ++m_cache_hits;
+            return iter->second;
+        }
+        ++m_cache_misses;
+
+        ShortestPaths out;
+        if (extruders.size() == 1) {
+            out.costs.emplace_back(m_wipe_volumes[start_extruder_id][extruders.front()]);
+            out.sequences.emplace_back(extruders);
+        } else if (num_path_extruders(extruders, start_extruder_id) > MaxExactExtruders) {
+            // Too many extruders to consider all of the paths, only the greedy one is considered.
+            float cost = 0;
+            out.sequences.emplace_back(this->solve_greedy(extruders, start_extruder_id, &cost));
+            out.costs.emplace_back(cost);
+        } else {
+            std::vector<unsigned int> all_extruders = extruders;
+            bool add_start_extruder_flag = false;
+            if (auto start_iter = std::find(all_extruders.begin(), all_extruders.end(), start_extruder_id); start_iter == all_extruders.end())
+                all_extruders.insert(all_extruders.begin(), start_extruder_id), add_start_extruder_flag = true;
+            else
+                std::swap(*all_extruders.begin(), *start_iter);
+
+            this->held_karp(all_extruders);
+
+            // One path for each extruder the path may end with.
+            const size_t n = all_extruders.size();
+            const size_t final_state = (size_t(1) << n) - 1;
+            for (size_t dst = 1; dst < n; ++dst) {
+                std::vector<unsigned int> path = this->held_karp_path(all_extruders, dst);
+                if (add_start_extruder_flag)
+                    path.erase(path.begin());
+                out.costs.emplace_back(m_dp_cost[final_state * n + dst]);
+                out.sequences.emplace_back(std::move(path));
+            }
+        }
+        return m_paths_cache.emplace(std::move(key), std::move(out)).first->second;
+    }
+
+    std::vector<std::vector<unsigned int>> ExtruderOrderSolver::solve_layers(const std::vector<std::vector<unsigned int>>& layer_extruders,
+        const std::vector<bool>& fixed_layers,
+        const std::optional<unsigned int>& start_extruder_id,
+        float* cost)
+    {
+        assert(fixed_layers.empty() || fixed_layers.size() == layer_extruders.size());
+
+        // Shortest path through the layers, the states of a layer being the extruders the layer may end with.
+        struct State
+        {
+            std::optional<unsigned int> extruder;
+            float                       cost;
+            // Index of the state of the previous layer.
+            int                         prev;
+            // Sequence of the layer ending with this state.
+            const std::vector<unsigned int>* sequence;
+        };
+        std::vector<std::vector<State>> layer_states;
+        layer_states.reserve(layer_extruders.size() + 1);
+        layer_states.push_back({ State{ start_extruder_id, 0.f, -1, nullptr } });
+
+        static const std::vector<unsigned int> empty_sequence;
+        for (size_t layer = 0; layer < layer_extruders.size(); ++layer) {
+            const std::vector<unsigned int>& extruders = layer_extruders[layer];
+            const std::vector<State>& prev_states = layer_states.back();
+            std::vector<State> states;
+            if (extruders.empty()) {
+                // Nothing printed, the layer keeps the states of the previous layer.
+                for (size_t i = 0; i < prev_states.size(); ++i)
+                    states.push_back({ prev_states[i].extruder, prev_states[i].cost, int(i), &empty_sequence });
+            } else if (!fixed_layers.empty() && fixed_layers[layer]) {
+                State best{ extruders.back(), std::numeric_limits<float>::max(), -1, &extruders };
+                for (size_t i = 0; i < prev_states.size(); ++i) {
+                    float c = prev_states[i].cost;
+                    std::optional<unsigned int> prev = prev_states[i].extruder;
+                    for (unsigned int extruder : extruders) {
+                        if (prev)
+                            c += m_wipe_volumes[*prev][extruder];
+                        prev = extruder;
+                    }
+                    if (c < best.cost) {
+                        best.cost = c;
+                        best.prev = int(i);
+                    }
+                }
+                states.push_back(best);
+            } else {
+                auto add_paths = [&states](const ShortestPaths& paths, float prev_cost, int prev_state) {
+                    for (size_t j = 0; j < paths.sequences.size(); ++j) {
+                        const float c = prev_cost + paths.costs[j];
+                        const unsigned int last = paths.sequences[j].back();
+                        auto it = std::find_if(states.begin(), states.end(), [last](const State& s) { return s.extruder == last; });
+                        if (it == states.end())
+                            states.push_back({ last, c, prev_state, &paths.sequences[j] });
+                        else if (c < it->cost)
+                            *it = State{ last, c, prev_state, &paths.sequences[j] };
+                    }
+                };
+                for (size_t i = 0; i < prev_states.size(); ++i) {
+                    if (prev_states[i].extruder)
+                        add_paths(this->shortest_paths(extruders, *prev_states[i].extruder), prev_states[i].cost, int(i));
+                    else
+                        // No filament loaded yet, the layer may start with any of its filaments.
+                        for (unsigned int start : extruders)
+                            add_paths(this->shortest_paths(extruders, start), prev_states[i].cost, int(i));
+                }
+            }
+            layer_states.emplace_back(std::move(states));
+        }
+
+        // Trace back the best path.
+        const std::vector<State>& last_states = layer_states.back();
+        int state_idx = int(std::min_element(last_states.begin(), last_states.end(), [](const State& l, const State& r) { return l.cost < r.cost; }) - last_states.begin());
+        if (cost)
+            *cost = last_states[state_idx].cost;
+        std::vector<std::vector<unsigned int>> out(layer_extruders.size());
+        for (size_t layer = layer_extruders.size(); layer > 0; --layer) {
+            const State& state = layer_states[layer][state_idx];
+            out[layer - 1] = *state.sequence;
+            state_idx = state.prev;
+        }
+        return out;
+    }
 
 
     template<class T>
@@ -579,26 +804,7 @@ namespace Slic3r
         bool use_forcast,
         float* cost)
     {
-        if (curr_layer_extruders.empty()) {
-            if (cost)
-                *cost = 0;
-            return curr_layer_extruders;
-        }
-        if (curr_layer_extruders.size() == 1) {
-            if (cost) {
-                *cost = 0;
-                if (start_extruder_id)
-                    *cost = wipe_volumes[*start_extruder_id][curr_layer_extruders[0]];
-            }
-            return curr_layer_extruders;
-        }
-
-        if (use_forcast)
-            return solve_extruder_order_with_forcast(wipe_volumes, curr_layer_extruders, next_layer_extruders, start_extruder_id, cost);
-        else if (curr_layer_extruders.size() <= 20)
-            return solve_extruder_order(wipe_volumes, curr_layer_extruders, start_extruder_id, cost);
-        else
-            return solve_extruder_order_with_greedy(wipe_volumes, curr_layer_extruders, start_extruder_id, cost);
+        return ExtruderOrderSolver(wipe_volumes).solve(curr_layer_extruders, next_layer_extruders, start_extruder_id, use_forcast, cost);
     }
 
 
@@ -607,7 +813,8 @@ namespace Slic3r
         const std::vector<std::vector<unsigned int>>& layer_filaments,
         const std::vector<FlushMatrix>& flush_matrix,
         std::optional<std::function<bool(int, std::vector<int>&)>> get_custom_seq,
-        std::vector<std::vector<unsigned int>>* filament_sequences)
+        std::vector<std::vector<unsigned int>>* filament_sequences,
+        bool optimize_whole_print)
     {
         //only when layer filament num <= 5,we do forcast
         constexpr int max_n_with_forcast = 5;
@@ -642,28 +849,6 @@ namespace Slic3r
                 custom_layer_sequence_map[layer] = unsign_custom_extruder_seq;
             }
         }
-        using uint128_t = boost::multiprecision::uint128_t;
-        auto extruders_to_hash_key = [](const std::vector<unsigned int>& curr_layer_extruders,
-           const std::vector<unsigned int>& next_layer_extruders,
-           const std::optional<unsigned int>& prev_extruder,
-           bool use_forcast)->uint128_t
-           {
-               uint128_t hash_key = 0;
-               //31-0 bit define current layer extruder,63-32 bit define next layer extruder,95~64 define prev extruder
-               if (prev_extruder)
-                   hash_key |= (uint128_t(1) << (64 + *prev_extruder));
-
-               if (use_forcast) {
-                   for (auto item : next_layer_extruders)
-                       hash_key |= (uint128_t(1) << (32 + item));
-               }
-
-               for (auto item : curr_layer_extruders)
-                   hash_key |= (uint128_t(1) << item);
-               return hash_key;
-           };
-
-
         // get best layer sequence by group
         for (size_t idx = 0; idx < groups.size(); ++idx) {
             // case with one group
@@ -671,7 +856,31 @@ namespace Slic3r
                 continue;
             std::optional<unsigned int>current_extruder_id;
 
-            std::unordered_map<uint128_t, std::pair<float, std::vector<unsigned int>>> caches;
+            // The solver memoizes the sequences of the layers with the same filaments.
+            ExtruderOrderSolver solver(flush_matrix[idx]);
+
+            if (optimize_whole_print) {
+                std::vector<std::vector<unsigned int>> filaments_in_group(layer_filaments.size());
+                std::vector<bool> fixed_layers(layer_filaments.size(), false);
+                for (size_t layer = 0; layer < layer_filaments.size(); ++layer) {
+                    if (auto iter = custom_layer_sequence_map.find(layer); iter != custom_layer_sequence_map.end()) {
+                        filaments_in_group[layer] = collect_filaments_in_groups<unsigned int>(groups[idx], iter->second);
+                        fixed_layers[layer] = true;
+                    } else
+                        filaments_in_group[layer] = collect_filaments_in_groups<unsigned int>(groups[idx], layer_filaments[layer]);
+                }
+                float total_cost = 0;
+                std::vector<std::vector<unsigned int>> sequences = solver.solve_layers(filaments_in_group, fixed_layers, current_extruder_id, &total_cost);
+                cost += int(total_cost);
+                if (filament_sequences) {
+                    // custom layers are assembled from custom_layer_sequence_map below
+                    for (size_t layer = 0; layer < layer_filaments.size(); ++layer)
+                        if (fixed_layers[layer])
+                            sequences[layer].clear();
+                    layer_sequences[idx] = std::move(sequences);
+                }
+                continue;
+            }
 
             for (size_t layer = 0; layer < layer_filaments.size(); ++layer) {
                 const auto& curr_lf = layer_filaments[layer];
@@ -705,16 +914,7 @@ namespace Slic3r
 
                 bool use_forcast = (filament_used_in_group.size() <= max_n_with_forcast && filament_used_in_group_next_layer.size() <= max_n_with_forcast);
                 float tmp_cost = 0;
-                std::vector<unsigned int>sequence;
-                uint128_t hash_key = extruders_to_hash_key(filament_used_in_group, filament_used_in_group_next_layer, current_extruder_id, use_forcast);
-                if (auto iter = caches.find(hash_key); iter != caches.end()) {
-                    tmp_cost = iter->second.first;
-                    sequence = iter->second.second;
-                }
-                else {
-                    sequence = get_extruders_order(flush_matrix[idx], filament_used_in_group, filament_used_in_group_next_layer, current_extruder_id, use_forcast, &tmp_cost);
-                    caches[hash_key] = { tmp_cost,sequence };
-                }
+                std::vector<unsigned int>sequence = solver.solve(filament_used_in_group, filament_used_in_group_next_layer, current_extruder_id, use_forcast, &tmp_cost);
 
                 assert(sequence.size() == filament_used_in_group.size());
 
@@ -3,9 +3,12 @@
 
 #include <vector>
 #include <optional>
+#include <cstdint>
 #include <functional>
 #include <limits>
+#include <map>
 #include <memory>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace Slic3r {
@@ -96,6 +99,67 @@ private:
 };
 
 
+// Orders the filaments printed by a single nozzle to minimize the flush volume.
+// The solver is meant to be reused for all the layers of a print: The tables of the dynamic programming are allocated once
+// and the results are memoized by the filaments of a layer and by the start filament, as the same sets of filaments
+// usually repeat over many layers.
+class ExtruderOrderSolver
+{
+public:
+    // Layers with up to this number of filaments are ordered optimally, larger layers are ordered greedily.
+    // The start filament counts if it is not printed by the layer.
+    static constexpr size_t MaxExactExtruders = 20;
+
+    explicit ExtruderOrderSolver(const FlushMatrix &wipe_volumes) : m_wipe_volumes(wipe_volumes) {}
+
+    // Order of the filaments of a single layer, see get_extruders_order().
+    std::vector<unsigned int> solve(const std::vector<unsigned int> &curr_layer_extruders,
+                                    const std::vector<unsigned int> &next_layer_extruders,
+                                    const std::optional<unsigned int> &start_extruder_id,
+                                    bool use_forcast = false,
+                                    float *cost = nullptr);
+
+    // Whole print optimization: Orders the filaments of all the layers jointly, minimizing the total flush volume including
+    // the filament changes between the layers, while solve() looks ahead one layer at most.
+    // The filaments of the layers marked by fixed_layers are printed in the order given.
+    std::vector<std::vector<unsigned int>> solve_layers(const std::vector<std::vector<unsigned int>> &layer_extruders,
+                                                        const std::vector<bool> &fixed_layers,
+                                                        const std::optional<unsigned int> &start_extruder_id,
+                                                        float *cost = nullptr);
+
+    size_t cache_hits() const { return m_cache_hits; }
+    size_t cache_misses() const { return m_cache_misses; }
+
+private:
+    // Minimum flush paths through a set of filaments from a start filament, one for each filament the path may end with.
+    struct ShortestPaths
+    {
+        std::vector<float>                      costs;
+        std::vector<std::vector<unsigned int>>  sequences;
+    };
+
+    // Held-Karp dynamic programming over the subsets of the extruders, the path starting with extruders.front().
+    void                       held_karp(const std::vector<unsigned int> &extruders);
+    std::vector<unsigned int>  held_karp_path(const std::vector<unsigned int> &extruders, size_t last) const;
+    std::vector<unsigned int>  solve_exact(std::vector<unsigned int> extruders, std::optional<unsigned int> start_extruder_id, float *cost);
+    std::vector<unsigned int>  solve_greedy(const std::vector<unsigned int> &extruders, const std::optional<unsigned int> &start_extruder_id, float *cost) const;
+    std::vector<unsigned int>  solve_with_forcast(std::vector<unsigned int> curr_layer_extruders, std::vector<unsigned int> next_layer_extruders,
+                                                  const std::optional<unsigned int> &start_extruder_id, float *cost) const;
+    const ShortestPaths&       shortest_paths(const std::vector<unsigned int> &extruders, unsigned int start_extruder_id);
+
+    const FlushMatrix                                                                  &m_wipe_volumes;
+    // Tables of the Held-Karp algorithm, indexed by subset * number of extruders + last extruder.
+    std::vector<float>                                                                  m_dp_cost;
+    std::vector<int8_t>                                                                 m_dp_prev;
+    std::vector<float>                                                                  m_dp_wipe_volumes;
+    // Memoized results of solve(), keyed by use_forcast, start extruder, sorted current and next layer extruders.
+    std::map<std::vector<unsigned int>, std::pair<float, std::vector<unsigned int>>>   m_cache;
+    // Memoized results of shortest_paths(), keyed by the start extruder and the sorted extruders.
+    std::map<std::vector<unsigned int>, ShortestPaths>                                  m_paths_cache;
+    size_t                                                                              m_cache_hits { 0 };
+    size_t                                                                              m_cache_misses { 0 };
+};
+
 std::vector<unsigned int> get_extruders_order(const std::vector<std::vector<float>> &wipe_volumes,
                                               const std::vector<unsigned int> &curr_layer_extruders,
                                               const std::vector<unsigned int> &next_layer_extruders,
@@ -108,7 +172,8 @@ int reorder_filaments_for_minimum_flush_volume(const std::vector<unsigned int> &
                                                const std::vector<std::vector<unsigned int>> &layer_filaments,
                                                const std::vector<FlushMatrix> &flush_matrix,
                                                std::optional<std::function<bool(int, std::vector<int> &)>> get_custom_seq,
-                                               std::vector<std::vector<unsigned int>> *filament_sequences);
+                                               std::vector<std::vector<unsigned int>> *filament_sequences,
+                                               bool optimize_whole_print = false);
 
 }
 #endif // !TOOL_ORDER_UTILS_HPP
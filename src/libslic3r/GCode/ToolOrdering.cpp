@@ -1300,7 +1300,8 @@ void ToolOrdering::reorder_extruders_for_minimum_flush_volume(bool reorder_first
         layer_filaments,
         nozzle_flush_mtx,
         get_custom_seq,
-        &filament_sequences
+        &filament_sequences,
+        print_config->optimize_filament_order.value
     );
     } else {
         // For non-bbl multi-extruder printers we don't support filament group yet, so we keep the layer sequence because we don't flush based on order
@@ -1330,7 +1331,8 @@ void ToolOrdering::reorder_extruders_for_minimum_flush_volume(bool reorder_first
                 layer_filaments,
                 nozzle_flush_mtx,
                 get_custom_seq,
-                &filament_sequences_one_extruder
+                &filament_sequences_one_extruder,
+                print_config->optimize_filament_order.value
             );
             m_stats_by_single_extruder = calc_filament_change_info_by_toolorder(print_config, maps_without_group, nozzle_flush_mtx, filament_sequences_one_extruder);
         }
@@ -1345,7 +1347,8 @@ void ToolOrdering::reorder_extruders_for_minimum_flush_volume(bool reorder_first
                 layer_filaments,
                 nozzle_flush_mtx,
                 get_custom_seq,
-                &filament_sequences_one_extruder
+                &filament_sequences_one_extruder,
+                print_config->optimize_filament_order.value
             );
             m_stats_by_multi_extruder_best = calc_filament_change_info_by_toolorder(print_config, filament_maps_auto, nozzle_flush_mtx, filament_sequences_one_extruder);
         }
@@ -1,9 +1,12 @@
 #include "GCodeReader.hpp"
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/log/trivial.hpp>
 #include <boost/nowide/fstream.hpp>
 #include <boost/nowide/cstdio.hpp>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
@@ -14,8 +17,85 @@
 #include <Shiny/Shiny.h>
 #include <fast_float/fast_float.h>
 
+// Intel redesigned some TBB interface considerably when merging TBB with their oneAPI set of libraries, see GH #7332.
+// We are using quite an old TBB 2017 U7. Before we update our build servers, let's use the old API, which is deprecated in up to date TBB.
+#if ! defined(TBB_VERSION_MAJOR)
+    #include <tbb/version.h>
+#endif
+#if ! defined(TBB_VERSION_MAJOR)
+    static_assert(false, "TBB_VERSION_MAJOR not defined");
+#endif
+#if TBB_VERSION_MAJOR >= 2021
+    #include <tbb/parallel_pipeline.h>
+    using slic3r_tbb_filtermode = tbb::filter_mode;
+#else
+    #include <tbb/pipeline.h>
+    using slic3r_tbb_filtermode = tbb::filter;
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SLIC3R_GCODEREADER_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define SLIC3R_GCODEREADER_NEON
+#endif
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
 namespace Slic3r {
 
+static inline unsigned int count_trailing_zeros(uint64_t mask)
+{
+    assert(mask != 0);
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, mask);
+    return (unsigned int)idx;
+#else
+    return (unsigned int)__builtin_ctzll(mask);
+#endif
+}
+
+// Find the first '\r' or '\n' (or '\0' if StopAtNull) in <begin, end), return end if there is none.
+// Most of the bytes of a G-code are spent in the long lines of extrusion moves and comments,
+// thus the line end is searched for 16 bytes at a time.
+template<bool StopAtNull>
+static inline const char* find_end_of_line(const char *begin, const char *end)
+{
+    const char *c = begin;
+#if defined(SLIC3R_GCODEREADER_SSE2)
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; end - c >= 16; c += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(c));
+        __m128i eol   = _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf));
+        if constexpr (StopAtNull)
+            eol = _mm_or_si128(eol, _mm_cmpeq_epi8(chunk, _mm_setzero_si128()));
+        if (int mask = _mm_movemask_epi8(eol); mask != 0)
+            return c + count_trailing_zeros(uint64_t(mask));
+    }
+#elif defined(SLIC3R_GCODEREADER_NEON)
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    const uint8x16_t lf = vdupq_n_u8('\n');
+    for (; end - c >= 16; c += 16) {
+        uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(c));
+        uint8x16_t eol   = vorrq_u8(vceqq_u8(chunk, cr), vceqq_u8(chunk, lf));
+        if constexpr (StopAtNull)
+            eol = vorrq_u8(eol, vceqq_u8(chunk, vdupq_n_u8(0)));
+        // Narrow the byte mask to 4 bits per byte.
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eol), 4)), 0);
+        if (mask != 0)
+            return c + (count_trailing_zeros(mask) >> 2);
+    }
+#endif
+    for (; c < end && ! (*c == '\r' || *c == '\n' || (StopAtNull && *c == 0)); ++ c)
+        ; // silence -Wempty-body
+    return c;
+}
+
 void GCodeReader::apply_config(const GCodeConfig &config)
 {
     m_config = config;
@@ -83,11 +163,8 @@ const char* GCodeReader::parse_line_internal(const char *ptr, const char *end, G
         }
     }
     
-    if (gline.has(E) && m_config.use_relative_e_distances)
-        m_position[E] = 0;
-
     // Skip the rest of the line.
-    for (; ! is_end_of_line(*c); ++ c);
+    c = find_end_of_line<true>(c, end);
 
     // Copy the raw string including the comment, without the trailing newlines.
     if (c > ptr) {
@@ -107,7 +184,7 @@ const char* GCodeReader::parse_line_internal(const char *ptr, const char *end, G
     return c;
 }
 
-void GCodeReader::update_coordinates(GCodeLine &gline, std::pair<const char*, const char*> &command)
+void GCodeReader::update_coordinates(const GCodeLine &gline, const std::pair<const char*, const char*> &command)
 {
     PROFILE_FUNC();
     if (*command.first == 'G') {
@@ -142,11 +219,9 @@ bool GCodeReader::parse_file_raw_internal(const std::string &filename, ParseLine
         auto it_bufend = buffer.begin() + cnt_read;
         while (it != it_bufend || (eof && ! gcode_line.empty())) {
             // Find end of line.
-            bool eol    = false;
-            auto it_end = it;
-            for (; it_end != it_bufend && ! (eol = *it_end == '\r' || *it_end == '\n'); ++ it_end)
-                if (*it_end == '\n')
-                    line_end_callback(file_pos + (it_end - buffer.begin()) + 1);
+            const char *line_begin = buffer.data() + (it - buffer.begin());
+            auto        it_end     = it + (find_end_of_line<false>(line_begin, buffer.data() + cnt_read) - line_begin);
+            bool        eol        = it_end != it_bufend;
             // End of line is indicated also if end of file was reached.
             eol |= eof && it_end == it_bufend;
             if (eol) {
@@ -215,6 +290,99 @@ bool GCodeReader::parse_file(const std::string &file, callback_t callback, std::
     return ret;
 }
 
+bool GCodeReader::parse_file_parallel(const std::string &file, callback_t callback, std::vector<size_t> &lines_ends)
+{
+    lines_ends.clear();
+
+    boost::iostreams::mapped_file_source mapped;
+    try {
+        mapped.open(boost::filesystem::path(file));
+    } catch (...) {
+        // Empty files cannot be mapped.
+        BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << ": unable to map file " << file << ", parsing it sequentially.";
+        return this->parse_file(file, callback, lines_ends);
+    }
+    BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(":  before parse_file_parallel %1%") % file.c_str();
+
+    // Range of lines of the mapped file, tokenized by a worker thread.
+    struct Chunk {
+        size_t                 begin { 0 };
+        size_t                 end   { 0 };
+        std::vector<GCodeLine> lines;
+        // Positions of the line ends, see parse_file().
+        std::vector<size_t>    lines_ends;
+    };
+    // Size of the chunks in bytes. Together with the number of chunks in flight, it limits the memory
+    // used by the tokenized lines while the chunks wait to be processed.
+    static constexpr const size_t chunk_size = 2 * 1024 * 1024;
+    const char   *data      = mapped.data();
+    const size_t  data_size = mapped.size();
+    size_t        chunk_begin = 0;
+    // Set once the callback called quit_parsing().
+    std::atomic<bool> quit { false };
+
+    const auto chunk_source = tbb::make_filter<void, Chunk>(slic3r_tbb_filtermode::serial_in_order,
+        [data, data_size, &chunk_begin, &quit](tbb::flow_control &fc) -> Chunk {
+            if (chunk_begin == data_size || quit) {
+                fc.stop();
+                return {};
+            }
+            // Split the file after a '\n' character, so that a "\r\n" line end is never split.
+            Chunk chunk;
+            chunk.begin = chunk_begin;
+            chunk.end   = data_size;
+            if (data_size - chunk_begin > chunk_size)
+                if (const void *eol = memchr(data + chunk_begin + chunk_size, '\n', data_size - chunk_begin - chunk_size); eol != nullptr)
+                    chunk.end = static_cast<const char*>(eol) - data + 1;
+            chunk_begin = chunk.end;
+            return chunk;
+        });
+    // Tokenize the lines of several chunks in parallel.
+    const auto tokenizer = tbb::make_filter<Chunk, Chunk>(slic3r_tbb_filtermode::parallel,
+        [this, data, data_size](Chunk chunk) -> Chunk {
+            chunk.lines.reserve((chunk.end - chunk.begin) / 24);
+            chunk.lines_ends.reserve((chunk.end - chunk.begin) / 24);
+            std::pair<const char*, const char*> cmd;
+            // The mapped file is not zero terminated, the last line is parsed from a copy.
+            std::string last_line;
+            for (const char *c = data + chunk.begin, *chunk_end = data + chunk.end; c != chunk_end;) {
+                const char *eol      = find_end_of_line<false>(c, chunk_end);
+                const char *line_end = eol;
+                if (eol + 1 >= data + data_size) {
+                    last_line.assign(c, eol);
+                    c        = last_line.c_str();
+                    line_end = c + last_line.size();
+                }
+                // Skip the line number, see parse_file_internal().
+                const char *begin = skip_whitespaces(c);
+                if (std::toupper(*begin) == 'N')
+                    begin = skip_word(begin);
+                begin = skip_whitespaces(begin);
+                this->parse_line_internal(begin, line_end, chunk.lines.emplace_back(), cmd);
+                // Skip EOL.
+                c = eol;
+                if (c != chunk_end && *c == '\r')
+                    ++ c;
+                if (c != chunk_end && *c == '\n')
+                    chunk.lines_ends.emplace_back(++ c - data);
+            }
+            return chunk;
+        });
+    // Update the reader position and call the callback in the order of the lines in the file.
+    const auto processor = tbb::make_filter<Chunk, void>(slic3r_tbb_filtermode::serial_in_order,
+        [this, &callback, &lines_ends, &quit](Chunk chunk) {
+            if (! quit) {
+                this->process_lines(chunk.lines, callback);
+                lines_ends.insert(lines_ends.end(), chunk.lines_ends.begin(), chunk.lines_ends.end());
+                quit = ! m_parsing;
+            }
+        });
+    tbb::parallel_pipeline(12, chunk_source & tokenizer & processor);
+
+    BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(":  finished parse_file_parallel %1%") % file.c_str();
+    return true;
+}
+
 bool GCodeReader::parse_file_raw(const std::string &filename, raw_line_callback_t line_callback)
 {
     return this->parse_file_raw_internal(filename,
@@ -7,6 +7,7 @@
 #include <functional>
 #include <string>
 #include <string_view>
+#include <vector>
 #include "PrintConfig.hpp"
 
 namespace Slic3r {
@@ -107,9 +108,13 @@ public:
 
     template<typename Callback>
     void parse_buffer(const std::string &buffer, Callback callback)
+        { this->parse_buffer(buffer.c_str(), buffer.c_str() + buffer.size(), callback); }
+
+    // Parse a zero terminated buffer, end points to the terminating zero.
+    template<typename Callback>
+    void parse_buffer(const char *ptr, const char *end, Callback callback)
     {
-        const char *ptr = buffer.c_str();
-        const char *end = ptr + buffer.size();
+        assert(*end == 0);
         GCodeLine gline;
         m_parsing = true;
         while (m_parsing && *ptr != 0) {
@@ -126,11 +131,29 @@ public:
     {
         std::pair<const char*, const char*> cmd;
         const char *line_end = parse_line_internal(ptr, end, gline, cmd);
+        if (gline.has(E) && m_config.use_relative_e_distances)
+            m_position[E] = 0;
         callback(*this, gline);
         update_coordinates(gline, cmd);
         return line_end;
     }
 
+    // Process lines parsed in advance, see parse_file_parallel(), as if they were parsed by parse_buffer(): the callback sees
+    // the reader position before each line, which is updated after the callback returns.
+    template<typename Lines, typename Callback>
+    void process_lines(Lines &lines, Callback callback)
+    {
+        m_parsing = true;
+        for (auto it = lines.begin(); m_parsing && it != lines.end(); ++ it) {
+            const GCodeLine &gline = *it;
+            if (gline.has(E) && m_config.use_relative_e_distances)
+                m_position[E] = 0;
+            callback(*this, *it);
+            const std::string_view cmd = gline.cmd();
+            update_coordinates(gline, std::make_pair(cmd.data(), cmd.data() + cmd.size()));
+        }
+    }
+
     template<typename Callback>
     void parse_line(const std::string &line, Callback callback)
         { GCodeLine gline; this->parse_line(line.c_str(), line.c_str() + line.size(), gline, callback); }
@@ -140,6 +163,9 @@ public:
     // Collect positions of line ends in the binary G-code to be used by the G-code viewer when memory mapping and displaying section of G-code
     // as an overlay in the 3D scene.
     bool parse_file(const std::string &file, callback_t callback, std::vector<size_t> &lines_ends);
+    // Same as above, but the file is memory mapped and split into chunks, which are tokenized in parallel.
+    // The callback is called from a single thread at a time, in the order of the lines in the file.
+    bool parse_file_parallel(const std::string &file, callback_t callback, std::vector<size_t> &lines_ends);
     // Just read the G-code file line by line, calls callback (const char *begin, const char *end). Returns false if reading the file failed.
     bool parse_file_raw(const std::string &file, raw_line_callback_t callback);
 
@@ -174,7 +200,7 @@ private:
     bool        parse_file_internal(const std::string &filename, ParseLineCallback parse_line_callback, LineEndCallback line_end_callback);
 
     const char* parse_line_internal(const char *ptr, const char *end, GCodeLine &gline, std::pair<const char*, const char*> &command);
-    void        update_coordinates(GCodeLine &gline, std::pair<const char*, const char*> &command);
+    void        update_coordinates(const GCodeLine &gline, const std::pair<const char*, const char*> &command);
 
     static bool         is_whitespace(char c)           { return c == ' ' || c == '\t'; }
     static bool         is_end_of_line(char c)          { return c == '\r' || c == '\n' || c == 0; }
@@ -14,24 +14,32 @@
 #include "GCode.hpp"
 #include "GCode/WipeTower.hpp"
 #include "GCode/WipeTower2.hpp"
+#include "Format/BinaryGCode.hpp"
 #include "Utils.hpp"
 #include "PrintConfig.hpp"
 #include "MaterialType.hpp"
 #include "Model.hpp"
+#include "SlicingCache.hpp"
 #include "format.hpp"
+#include "libslic3r_version.h"
 #include <float.h>
 
 #include <algorithm>
 #include <limits>
 #include <unordered_set>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/format.hpp>
 #include <boost/log/trivial.hpp>
 #include <boost/regex.hpp>
+#include <boost/nowide/cstdio.hpp>
 #include <boost/nowide/fstream.hpp>
 
 #include <tbb/blocked_range.h>
+#include <tbb/flow_graph.h>
 #include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 
 //BBS: add json support
 #include "nlohmann/json.hpp"
@@ -89,13 +97,10 @@ bool Print::has_tpu_filament() const
     return false;
 }
 
-// Called by Print::apply().
-// This method only accepts PrintConfig option keys.
-bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* new_config */, const std::vector<t_config_option_key> &opt_keys)
+// Collect the Print and PrintObject steps invalidated by a change of the PrintConfig options.
+// Returns false if any of the options is not known to influence a limited set of steps, thus all steps are to be invalidated.
+static bool print_config_options_steps(const std::vector<t_config_option_key> &opt_keys, std::vector<PrintStep> &steps, std::vector<PrintObjectStep> &osteps)
 {
-    if (opt_keys.empty())
-        return false;
-
     // Cache the plenty of parameters, which influence the G-code generator only,
     // or they are only notes not influencing the generated G-code.
     static std::unordered_set<std::string> steps_gcode = {
@@ -224,6 +229,7 @@ bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* n
         "activate_chamber_temp_control",
         "manual_filament_change",
         "disable_m73",
+        "binary_gcode",
         "use_firmware_retraction",
         "enable_long_retraction_when_cut",
         "long_retractions_when_cut",
@@ -239,10 +245,7 @@ bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* n
 
     static std::unordered_set<std::string> steps_ignore;
 
-    std::vector<PrintStep> steps;
-    std::vector<PrintObjectStep> osteps;
-    bool invalidated = false;
-
+    bool limited = true;
     for (const t_config_option_key &opt_key : opt_keys) {
         if (steps_gcode.find(opt_key) != steps_gcode.end()) {
             // These options only affect G-code export or they are just notes without influence on the generated G-code,
@@ -388,10 +391,25 @@ bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* n
         } else {
             // for legacy, if we can't handle this option let's invalidate all steps
             //FIXME invalidate all steps of all objects as well?
-            invalidated |= this->invalidate_all_steps();
+            limited = false;
             // Continue with the other opt_keys to possibly invalidate any object specific steps.
         }
     }
+    return limited;
+}
+
+// Called by Print::apply().
+// This method only accepts PrintConfig option keys.
+bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* new_config */, const std::vector<t_config_option_key> &opt_keys)
+{
+    if (opt_keys.empty())
+        return false;
+
+    std::vector<PrintStep> steps;
+    std::vector<PrintObjectStep> osteps;
+    bool invalidated = false;
+    if (! print_config_options_steps(opt_keys, steps, osteps))
+        invalidated |= this->invalidate_all_steps();
 
     sort_remove_duplicates(steps);
     for (PrintStep step : steps)
@@ -1904,6 +1922,7 @@ void  PrintObject::clear_shared_object()
         m_shared_object = nullptr;
 
         invalidate_all_steps_without_cancel();
+        m_invalid_z_ranges.fill({ 0., DBL_MAX });
     }
 }
 
@@ -1988,6 +2007,49 @@ std::map<ObjectID, unsigned int> getObjectExtruderMap(const Print& print) {
     return objectExtruderMap;
 }
 
+// Process the steps of the objects in a flow graph, which chains the steps of each object, while different objects run
+// concurrently and they don't wait for each other between the steps. The tails of the parallel loops inside the steps
+// of one object are thus filled in with work on other objects, which scales much better than a barrier after each step
+// of each object when printing many small objects.
+// The first step slices the object. The step first_step_after_all_sliced and the following steps of any object start only
+// after all objects are sliced, as the support generator reads the layers of the other objects.
+// Each step runs in an isolated region of the task arena: A thread waiting for a parallel loop of a step only helps
+// with that loop, it does not start processing another object on top of its stack.
+// An exception thrown by a step, for example on cancellation, cancels the graph and it is rethrown.
+static void process_objects_concurrently(std::vector<PrintObject*> objects, const std::vector<std::function<void(PrintObject*)>> &steps, size_t first_step_after_all_sliced)
+{
+    using namespace tbb::flow;
+    if (objects.empty() || steps.empty())
+        return;
+    assert(first_step_after_all_sliced > 0 && first_step_after_all_sliced <= steps.size());
+
+    // Start with the largest objects, which likely take the longest.
+    std::stable_sort(objects.begin(), objects.end(), [](const PrintObject *l, const PrintObject *r) {
+        return double(l->size().x()) * double(l->size().y()) * double(l->size().z()) > double(r->size().x()) * double(r->size().y()) * double(r->size().z());
+    });
+
+    graph                                              g;
+    continue_node<continue_msg>                        all_sliced(g, [](const continue_msg&) { return continue_msg(); });
+    std::vector<std::unique_ptr<continue_node<continue_msg>>> nodes;
+    nodes.reserve(objects.size() * steps.size());
+    for (PrintObject *obj : objects)
+        for (size_t i = 0; i < steps.size(); ++ i) {
+            nodes.emplace_back(std::make_unique<continue_node<continue_msg>>(g, [obj, &step = steps[i]](const continue_msg&) {
+                tbb::this_task_arena::isolate([obj, &step]() { step(obj); });
+                return continue_msg();
+            }));
+            if (i == 0)
+                make_edge(*nodes.back(), all_sliced);
+            else
+                make_edge(*nodes[nodes.size() - 2], *nodes.back());
+            if (i == first_step_after_all_sliced)
+                make_edge(all_sliced, *nodes.back());
+        }
+    for (size_t i = 0; i < objects.size(); ++ i)
+        nodes[i * steps.size()]->try_put(continue_msg());
+    g.wait_for_all();
+}
+
 // Slicing process, running at a background thread.
 void Print::process(long long *time_cost_with_cache, bool use_cache)
 {
@@ -2103,100 +2165,60 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
 
     BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": total object counts %1% in current print, need to slice %2%")%m_objects.size()%need_slicing_objects.size();
     BOOST_LOG_TRIVIAL(info) << "Starting the slicing process." << log_memory_info();
+    // Objects loaded from the slicing cache and objects to be stored into the slicing cache once processed.
+    std::set<PrintObject*>                            slicing_cache_loaded;
+    std::vector<std::pair<PrintObject*, std::string>> slicing_cache_to_store;
     if (!use_cache) {
+        std::vector<PrintObject*> objects_to_process;
         for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->make_perimeters();
-            }
-            else {
-                if (obj->set_started(posSlice))
-                    obj->set_done(posSlice);
-                if (obj->set_started(posPerimeters))
-                    obj->set_done(posPerimeters);
-            }
-        }
-        for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->estimate_curled_extrusions();
-            }
-            else {
-                if (obj->set_started(posEstimateCurledExtrusions))
-                    obj->set_done(posEstimateCurledExtrusions);
-            }
-        }
-        for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->infill();
-            }
-            else {
-                if (obj->set_started(posPrepareInfill))
-                    obj->set_done(posPrepareInfill);
-                if (obj->set_started(posInfill))
-                    obj->set_done(posInfill);
-            }
-        }
-        for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->ironing();
-            }
-            else {
-                if (obj->set_started(posIroning))
-                    obj->set_done(posIroning);
-            }
-        }
-
-        tbb::parallel_for(tbb::blocked_range<int>(0, int(m_objects.size())),
-            [this, need_slicing_objects](const tbb::blocked_range<int>& range) {
-                for (int i = range.begin(); i < range.end(); i++) {
-                    PrintObject* obj = m_objects[i];
-                    if (need_slicing_objects.count(obj) != 0) {
-                        obj->generate_support_material();
-                    }
-                    else {
-                        if (obj->set_started(posSupportMaterial))
-                            obj->set_done(posSupportMaterial);
-                    }
+            if (need_slicing_objects.count(obj) != 0 && m_slicing_cache && ! obj->is_step_done(posSlice)) {
+                std::string key = this->slicing_cache_key(*obj);
+                if (this->load_from_slicing_cache(*obj, key)) {
+                    slicing_cache_loaded.insert(obj);
+                    for (PrintObjectStep step : { posSlice, posPerimeters, posEstimateCurledExtrusions, posPrepareInfill, posInfill, posIroning, posSupportMaterial, posDetectOverhangsForLift })
+                        if (obj->set_started(step))
+                            obj->set_done(step);
+                    continue;
                 }
+                slicing_cache_to_store.emplace_back(obj, std::move(key));
             }
-        );
-
-        for (PrintObject* obj : m_objects) {
             if (need_slicing_objects.count(obj) != 0) {
-                obj->detect_overhangs_for_lift();
+                objects_to_process.emplace_back(obj);
             }
             else {
-                if (obj->set_started(posDetectOverhangsForLift))
-                    obj->set_done(posDetectOverhangsForLift);
+                for (PrintObjectStep step : { posSlice, posPerimeters, posEstimateCurledExtrusions, posPrepareInfill, posInfill, posIroning, posSupportMaterial, posDetectOverhangsForLift })
+                    if (obj->set_started(step))
+                        obj->set_done(step);
             }
         }
+        process_objects_concurrently(objects_to_process, {
+            [](PrintObject *obj) { obj->make_perimeters(); },
+            [](PrintObject *obj) { obj->estimate_curled_extrusions(); },
+            [](PrintObject *obj) { obj->infill(); },
+            [](PrintObject *obj) { obj->ironing(); },
+            [](PrintObject *obj) { obj->generate_support_material(); },
+            [](PrintObject *obj) { obj->detect_overhangs_for_lift(); }
+        }, 4);
     }
     else {
+        std::vector<PrintObject*> objects_to_process;
         for (PrintObject *obj : m_objects) {
             if (re_slicing_objects.count(obj) == 0) {
-                if (obj->set_started(posSlice))
-                    obj->set_done(posSlice);
-                if (obj->set_started(posPerimeters))
-                    obj->set_done(posPerimeters);
-                if (obj->set_started(posPrepareInfill))
-                    obj->set_done(posPrepareInfill);
-                if (obj->set_started(posInfill))
-                    obj->set_done(posInfill);
-                if (obj->set_started(posIroning))
-                    obj->set_done(posIroning);
-                if (obj->set_started(posSupportMaterial))
-                    obj->set_done(posSupportMaterial);
-                if (obj->set_started(posDetectOverhangsForLift))
-                    obj->set_done(posDetectOverhangsForLift);
-            }
-            else {
-                obj->make_perimeters();
-                obj->infill();
-                obj->ironing();
-                obj->generate_support_material();
-                obj->detect_overhangs_for_lift();
-                obj->estimate_curled_extrusions();
+                for (PrintObjectStep step : { posSlice, posPerimeters, posPrepareInfill, posInfill, posIroning, posSupportMaterial, posDetectOverhangsForLift })
+                    if (obj->set_started(step))
+                        obj->set_done(step);
             }
+            else
+                objects_to_process.emplace_back(obj);
         }
+        process_objects_concurrently(objects_to_process, {
+            [](PrintObject *obj) { obj->make_perimeters(); },
+            [](PrintObject *obj) { obj->infill(); },
+            [](PrintObject *obj) { obj->ironing(); },
+            [](PrintObject *obj) { obj->generate_support_material(); },
+            [](PrintObject *obj) { obj->detect_overhangs_for_lift(); },
+            [](PrintObject *obj) { obj->estimate_curled_extrusions(); }
+        }, 3);
     }
 
     for (PrintObject *obj : m_objects)
@@ -2369,7 +2391,7 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
     }
     //BBS
     for (PrintObject *obj : m_objects) {
-        if (((!use_cache)&&(need_slicing_objects.count(obj) != 0))
+        if (((!use_cache)&&(need_slicing_objects.count(obj) != 0)&&(slicing_cache_loaded.count(obj) == 0))
             || (use_cache &&(re_slicing_objects.count(obj) != 0))){
             obj->simplify_extrusion_path();
         }
@@ -2382,6 +2404,13 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
                 obj->set_done(posSimplifySupportPath);
         }
     }
+    if (m_slicing_cache) {
+        for (const auto &[obj, key] : slicing_cache_to_store)
+            this->store_to_slicing_cache(*obj, key);
+        SlicingCache::Statistics stats = m_slicing_cache->statistics();
+        BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": slicing cache %1%, hits %2%, misses %3%, stores %4%, evicted %5%")
+            % m_slicing_cache->directory() % stats.hits % stats.misses % stats.stores % stats.evicted;
+    }
 
     // BBS
     bool has_adaptive_layer_height = false;
@@ -2418,7 +2447,7 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
 // The export_gcode may die for various reasons (fails to process filename_format,
 // write error into the G-code, cannot execute post-processing scripts).
 // It is up to the caller to show an error message.
-std::string Print::export_gcode(const std::string& path_template, GCodeProcessorResult* result, ThumbnailsGeneratorCallback thumbnail_cb)
+std::string Print::export_gcode(const std::string& path_template, GCodeProcessorResult* result, ThumbnailsGeneratorCallback thumbnail_cb, bool keep_ascii)
 {
     // output everything to a G-code file
     // The following call may die if the filename_format template substitution fails.
@@ -2438,10 +2467,34 @@ std::string Print::export_gcode(const std::string& path_template, GCodeProcessor
     //BBS: compute plate offset for gcode-generator
     const Vec3d origin = this->get_plate_origin();
     gcode.set_gcode_offset(origin(0), origin(1));
-    gcode.do_export(this, path.c_str(), result, thumbnail_cb);
+    // The G-code is always generated and processed as ASCII, the binary G-code is converted from it.
+    // result->lines_ends and the moves index the lines of the ASCII G-code, thus result->filename keeps pointing
+    // to the ASCII G-code, which is generated into a temporary file removed once the last result referencing it is released.
+    const bool binary = m_config.binary_gcode.value && ! keep_ascii;
+    std::shared_ptr<const std::string> ascii_path;
+    if (binary)
+        ascii_path.reset(
+            new std::string((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path(SLIC3R_APP_KEY "_%%%%-%%%%-%%%%-%%%%.gcode")).string()),
+            [](const std::string *path) {
+                boost::system::error_code ec;
+                boost::filesystem::remove(*path, ec);
+                delete path;
+            });
+    gcode.do_export(this, binary ? ascii_path->c_str() : path.c_str(), result, thumbnail_cb);
     gcode.export_layer_filaments(result);
+    if (binary) {
+        try {
+            BinaryGCode::convert_ascii_to_binary(*ascii_path, path);
+        } catch (const std::exception &ex) {
+            boost::nowide::remove(path.c_str());
+            throw Slic3r::ExportError(ex.what());
+        }
+        if (result != nullptr)
+            result->decoded_gcode_file = std::move(ascii_path);
+    }
     //BBS
-    result->conflict_result = m_conflict_result;
+    if (result != nullptr)
+        result->conflict_result = m_conflict_result;
     return path.c_str();
 }
 
@@ -3378,7 +3431,11 @@ std::string Print::output_filename(const std::string &filename_base) const
     config.set_key_value("plate_number", new ConfigOptionString(get_plate_number_formatted()));
     config.set_key_value("model_name", new ConfigOptionString(get_model_name()));
 
-    return this->PrintBase::output_filename(m_config.filename_format.value, ".gcode", filename_base, &config);
+    std::string filename = this->PrintBase::output_filename(m_config.filename_format.value, m_config.binary_gcode.value ? ".bgcode" : ".gcode", filename_base, &config);
+    // The filename_format templates usually end with an explicit ".gcode" extension.
+    if (m_config.binary_gcode.value && boost::iends_with(filename, ".gcode"))
+        filename.insert(filename.size() - 5, "b");
+    return filename;
 }
 
 std::string Print::get_model_name() const
@@ -4306,6 +4363,12 @@ static void from_json(const json& j, groupedVolumeSlices& firstlayer_group)
 }
 
 int Print::export_cached_data(const std::string& directory, bool with_space)
+{
+    return this->export_cached_data(m_objects, directory, with_space, nullptr);
+}
+
+// With objects_json set, the JSONs of the objects are returned instead of being written into the directory.
+int Print::export_cached_data(const PrintObjectPtrs &objects, const std::string& directory, bool with_space, std::vector<json> *objects_json)
 {
     int ret = 0;
     boost::filesystem::path directory_path(directory);
@@ -4355,11 +4418,11 @@ int Print::export_cached_data(const std::string& directory, bool with_space)
     };
 
     //firstly clear this directory
-    if (fs::exists(directory_path)) {
+    if (! objects_json && fs::exists(directory_path)) {
         fs::remove_all(directory_path);
     }
     try {
-        if (!fs::create_directory(directory_path)) {
+        if (! objects_json && ! fs::create_directory(directory_path)) {
             BOOST_LOG_TRIVIAL(error) << boost::format("create directory %1% failed")%directory;
             return CLI_EXPORT_CACHE_DIRECTORY_CREATE_FAILED;
         }
@@ -4373,7 +4436,7 @@ int Print::export_cached_data(const std::string& directory, bool with_space)
     int count = 0;
     std::vector<std::string> filename_vector;
     std::vector<json> json_vector;
-    for (PrintObject *obj : m_objects) {
+    for (PrintObject *obj : objects) {
         const ModelObject* model_obj = obj->model_object();
         if (obj->get_shared_object()) {
             BOOST_LOG_TRIVIAL(info) << boost::format("shared object %1%, skip directly")%model_obj->name;
@@ -4545,6 +4608,11 @@ int Print::export_cached_data(const std::string& directory, bool with_space)
         }
     }
 
+    if (objects_json) {
+        *objects_json = std::move(json_vector);
+        return ret;
+    }
+
     boost::mutex mutex;
     tbb::parallel_for(
         tbb::blocked_range<size_t>(0, filename_vector.size()),
@@ -4583,19 +4651,6 @@ int Print::load_cached_data(const std::string& directory)
         return CLI_IMPORT_CACHE_NOT_FOUND;
     }
 
-    auto find_region = [this](PrintObject* object, size_t config_hash) -> const PrintRegion* {
-        int regions_count = object->num_printing_regions();
-        for (int index = 0; index < regions_count; index++ )
-        {
-            const PrintRegion&  print_region = object->printing_region(index);
-            if (print_region.config_hash() == config_hash ) {
-                return &print_region;
-            }
-        }
-        return NULL;
-    };
-
-    int count = 0;
     std::vector<std::pair<std::string, PrintObject*>> object_filenames;
     for (PrintObject *obj : m_objects) {
         const ModelObject* model_obj = obj->model_object();
@@ -4647,6 +4702,26 @@ int Print::load_cached_data(const std::string& directory)
         return ret;
     }
 
+    return this->load_cached_data(object_filenames, object_jsons);
+}
+
+// Load the objects from their JSONs exported by export_cached_data().
+int Print::load_cached_data(std::vector<std::pair<std::string, PrintObject*>> &object_filenames, std::vector<json> &object_jsons)
+{
+    int ret = 0;
+    auto find_region = [this](PrintObject* object, size_t config_hash) -> const PrintRegion* {
+        int regions_count = object->num_printing_regions();
+        for (int index = 0; index < regions_count; index++ )
+        {
+            const PrintRegion&  print_region = object->printing_region(index);
+            if (print_region.config_hash() == config_hash ) {
+                return &print_region;
+            }
+        }
+        return NULL;
+    };
+
+    int count = 0;
     for (int obj_index = 0; obj_index < object_jsons.size(); obj_index++) {
         json& root_json = object_jsons[obj_index];
         PrintObject *obj = object_filenames[obj_index].second;
@@ -4789,6 +4864,137 @@ int Print::load_cached_data(const std::string& directory)
     return ret;
 }
 
+std::string Print::slicing_cache_key(const PrintObject &obj) const
+{
+    SlicingCacheKey key;
+    key.update(std::string(SLIC3R_VERSION));
+    key.update(SlicingCache::VERSION);
+
+    auto update_config = [&key](const ConfigBase &config) {
+        for (const t_config_option_key &opt_key : config.keys()) {
+            key.update(opt_key);
+            key.update(config.opt_serialize(opt_key));
+        }
+    };
+    auto update_bits = [&key](const std::vector<bool> &bits) {
+        std::vector<uint8_t> bytes((bits.size() + 7) / 8, 0);
+        for (size_t i = 0; i < bits.size(); ++ i)
+            if (bits[i])
+                bytes[i / 8] |= uint8_t(1 << (i % 8));
+        key.update(uint64_t(bits.size()));
+        key.update(bytes);
+    };
+    auto update_facets = [&key, &update_bits](const FacetsAnnotation &facets) {
+        const TriangleSelector::TriangleSplittingData &data = facets.get_data();
+        key.update(uint64_t(data.triangles_to_split.size()));
+        for (const TriangleSelector::TriangleBitStreamMapping &mapping : data.triangles_to_split) {
+            key.update(mapping.triangle_idx);
+            key.update(mapping.bitstream_start_idx);
+        }
+        update_bits(data.bitstream);
+        update_bits(data.used_states);
+    };
+
+    const ModelObject &model_object = *obj.model_object();
+    key.update(uint64_t(model_object.volumes.size()));
+    for (const ModelVolume *volume : model_object.volumes) {
+        key.update(int(volume->type()));
+        key.update(volume->mesh().its.vertices);
+        key.update(volume->mesh().its.indices);
+        key.update(volume->get_matrix().data(), 16 * sizeof(double));
+        update_config(volume->config.get());
+        update_facets(volume->supported_facets);
+        update_facets(volume->seam_facets);
+        update_facets(volume->mmu_segmentation_facets);
+        update_facets(volume->fuzzy_skin_facets);
+    }
+    update_config(model_object.config.get());
+    key.update(model_object.layer_height_profile.get());
+    key.update(uint64_t(model_object.layer_config_ranges.size()));
+    for (const auto &[z_range, config] : model_object.layer_config_ranges) {
+        key.update(z_range.first);
+        key.update(z_range.second);
+        update_config(config.get());
+    }
+
+    key.update(obj.trafo().data(), 16 * sizeof(double));
+    key.update(obj.center_offset().x());
+    key.update(obj.center_offset().y());
+    // Tree supports are clipped by the bed shape, placed by the plate origin and the shift of the first instance.
+    const Vec3d plate_origin = this->get_plate_origin();
+    key.update(plate_origin.x());
+    key.update(plate_origin.y());
+    key.update(uint64_t(obj.instances().size()));
+    for (const PrintInstance &instance : obj.instances()) {
+        key.update(instance.shift.x());
+        key.update(instance.shift.y());
+    }
+    // Tree supports generate the layer islands up to the skirt and brim height, which depends on the layer counts of all the objects.
+    key.update(uint64_t(m_objects.size()));
+    for (const PrintObject *object : m_objects) {
+        key.update(object->height());
+        update_config(object->config());
+        key.update(object->model_object()->layer_height_profile.get());
+        key.update(uint64_t(object->model_object()->layer_config_ranges.size()));
+        for (const auto &[z_range, config] : object->model_object()->layer_config_ranges) {
+            key.update(z_range.first);
+            key.update(z_range.second);
+            update_config(config.get());
+        }
+    }
+    update_config(obj.config());
+    key.update(uint64_t(obj.num_printing_regions()));
+    for (size_t region_id = 0; region_id < obj.num_printing_regions(); ++ region_id)
+        update_config(obj.printing_region(region_id).config());
+    // Only the print options, which may influence the PrintObject steps.
+    std::vector<PrintStep>       steps;
+    std::vector<PrintObjectStep> osteps;
+    for (const t_config_option_key &opt_key : m_config.keys()) {
+        osteps.clear();
+        if (! print_config_options_steps({ opt_key }, steps, osteps) || ! osteps.empty()) {
+            key.update(opt_key);
+            key.update(m_config.opt_serialize(opt_key));
+        }
+    }
+    return key.digest();
+}
+
+bool Print::load_from_slicing_cache(PrintObject &obj, const std::string &key)
+{
+    std::vector<uint8_t> payload;
+    if (! m_slicing_cache->load(key, payload))
+        return false;
+    try {
+        json root_json = json::from_cbor(payload);
+        payload = std::vector<uint8_t>();
+        obj.clear_layers();
+        obj.clear_support_layers();
+        obj.firstLayerObjGroupsMod().clear();
+        std::vector<std::pair<std::string, PrintObject*>> object_filenames { { key, &obj } };
+        std::vector<json>                                  object_jsons(1, std::move(root_json));
+        if (this->load_cached_data(object_filenames, object_jsons) == 0)
+            return true;
+    } catch (std::exception &err) {
+        BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << ": loading " << key << " from the slicing cache failed, reason = " << err.what();
+    }
+    // Don't leave a partially loaded object behind.
+    obj.clear_layers();
+    obj.clear_support_layers();
+    obj.firstLayerObjGroupsMod().clear();
+    return false;
+}
+
+void Print::store_to_slicing_cache(PrintObject &obj, const std::string &key)
+{
+    try {
+        std::vector<json> objects_json;
+        if (this->export_cached_data({ &obj }, std::string(), false, &objects_json) == 0 && objects_json.size() == 1)
+            m_slicing_cache->store(key, json::to_cbor(objects_json.front()));
+    } catch (std::exception &err) {
+        BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << ": storing " << key << " to the slicing cache failed, reason = " << err.what();
+    }
+}
+
 BoundingBoxf3 PrintInstance::get_bounding_box() const {
     return print_object->model_object()->instance_bounding_box(*model_instance, false);
 }
@@ -11,11 +11,13 @@
 #include "Point.hpp"
 #include "Slicing.hpp"
 #include "TriangleMeshSlicer.hpp"
+#include "GCode/AvoidCrossingPerimeters.hpp"
 #include "GCode/ToolOrdering.hpp"
 #include "GCode/WipeTower.hpp"
 #include "GCode/WipeTower2.hpp"
 #include "GCode/ThumbnailData.hpp"
 #include "GCode/GCodeProcessor.hpp"
+#include "GCode/PipelineStats.hpp"
 #include "MultiMaterialSegmentation.hpp"
 #include "libslic3r.h"
 
@@ -36,6 +38,9 @@ class PrintObject;
 class SupportLayer;
 // BBS
 class TreeSupportData;
+namespace SeamPlacerImpl { struct MeshVisibility; }
+struct PrintObjectSeamData;
+class SlicingCache;
 class TreeSupport;
 class ExtrusionLayers;
 
@@ -399,6 +404,18 @@ public:
     SupportLayer* add_tree_support_layer(int id, coordf_t height, coordf_t print_z, coordf_t slice_z);
     std::shared_ptr<TreeSupportData> alloc_tree_support_preview_cache();
     void clear_tree_support_preview_cache() { m_tree_support_preview_cache.reset(); }
+    // Travel boundaries of the layers for reduce_crossing_wall, built by the G-code export and retained until the layers change.
+    AvoidCrossingPerimeters::LayerBoundariesCache& travel_boundaries_cache() const { return m_travel_boundaries_cache; }
+    // Visibility of the object surface for the seam placement computed by the last G-code export, if computed for the same key.
+    std::shared_ptr<const SeamPlacerImpl::MeshVisibility> seam_visibility(const std::string &key) const
+        { return key == m_seam_visibility_key ? m_seam_visibility : nullptr; }
+    void set_seam_visibility(std::string key, std::shared_ptr<const SeamPlacerImpl::MeshVisibility> visibility) const
+        { m_seam_visibility_key = std::move(key); m_seam_visibility = std::move(visibility); }
+    // Seam placement computed by the last G-code export, if computed for the same key. Dropped when the perimeters are invalidated.
+    std::shared_ptr<const PrintObjectSeamData> seam_data(const std::string &key) const
+        { return key == m_seam_data_key ? m_seam_data : nullptr; }
+    void set_seam_data(std::string key, std::shared_ptr<const PrintObjectSeamData> seam_data) const
+        { m_seam_data_key = std::move(key); m_seam_data = std::move(seam_data); }
 
     size_t          support_layer_count() const { return m_support_layers.size(); }
     void            clear_support_layers();
@@ -482,10 +499,16 @@ public:
     bool                    invalidate_step(PrintObjectStep step);
     // Invalidates all PrintObject and Print steps.
     bool                    invalidate_all_steps();
+    // Invalidates the step for the layers with Layer::slice_z inside z_range, and its depending steps for the layers depending on them.
+    // Only the layer local steps (see layers_to_process()) are invalidated partially, the other steps are invalidated as a whole.
+    bool                    invalidate_step_in_z_range(PrintObjectStep step, const t_layer_height_range &z_range);
     // Invalidate steps based on a set of parameters changed.
     // It may be called for both the PrintObjectConfig and PrintRegionConfig.
+    // If the parameters are applied to a z range of the object only (configuration of a layer range modifier),
+    // the layer local steps are invalidated in that z range only.
     bool                    invalidate_state_by_config_options(
-        const ConfigOptionResolver &old_config, const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys);
+        const ConfigOptionResolver &old_config, const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys,
+        const t_layer_height_range &z_range = { 0., DBL_MAX });
     // If ! m_slicing_params.valid, recalculate.
     void                    update_slicing_parameters();
 
@@ -531,6 +554,13 @@ private:
     void _generate_support_material();
     std::pair<FillAdaptive::OctreePtr, FillAdaptive::OctreePtr> prepare_adaptive_infill_data(
         const std::vector<std::pair<const Surface*, float>>& surfaces_w_bottom_z) const;
+    // Range of indices of the layers to be recalculated by a layer local step: All layers, or the layers invalidated
+    // by invalidate_step_in_z_range() only. Layer local steps are posPerimeters, posPrepareInfill, posInfill, posIroning,
+    // posSimplifyPath and posSimplifyInfill. posPrepareInfill is always recalculated for all layers, its z range
+    // is only passed to posInfill.
+    std::pair<size_t, size_t> layers_to_process(PrintObjectStep step) const;
+    // Expand a z range by num_layers and at least by height below and above the layers inside z_range.
+    t_layer_height_range    expand_z_range(const t_layer_height_range &z_range, size_t num_layers, coordf_t height) const;
     FillLightning::GeneratorPtr prepare_lightning_infill_data();
 
     // BBS
@@ -562,7 +592,17 @@ private:
     // so that next call to make_perimeters() performs a union() before computing loops
     bool                    				m_typed_slices = false;
 
+    // Ranges of Layer::slice_z of the layers to be recalculated by the layer local steps, see layers_to_process().
+    // Valid while the step is not done: Set by every invalidation of the step, { 0, DBL_MAX } for all layers.
+    std::array<t_layer_height_range, posCount> m_invalid_z_ranges;
+
     std::pair<FillAdaptive::OctreePtr, FillAdaptive::OctreePtr> m_adaptive_fill_octrees;
+    mutable AvoidCrossingPerimeters::LayerBoundariesCache m_travel_boundaries_cache;
+    // Accessed by the G-code export only, see seam_visibility().
+    mutable std::string                                           m_seam_visibility_key;
+    mutable std::shared_ptr<const SeamPlacerImpl::MeshVisibility> m_seam_visibility;
+    mutable std::string                                           m_seam_data_key;
+    mutable std::shared_ptr<const PrintObjectSeamData>            m_seam_data;
     FillLightning::GeneratorPtr m_lightning_generator;
 
     std::vector < VolumeSlices >            firstLayerObjSliceByVolume;
@@ -797,6 +837,8 @@ struct PrintStatistics
     double                          total_wipe_tower_filament;
     unsigned int                    initial_tool;
     std::map<size_t, double>        filament_stats;
+    // Timing of the G-code export pipeline of the last G-code export.
+    GCodePipelineStats              gcode_pipeline;
 
     // Config with the filled in print statistics.
     DynamicConfig           config() const;
@@ -815,6 +857,7 @@ struct PrintStatistics
         total_wipe_tower_filament = 0.;
         initial_tool           = 0;
         filament_stats.clear();
+        gcode_pipeline.clear();
     }
     static const std::string FilamentUsedG;
     static const std::string FilamentUsedGMask;
@@ -907,10 +950,15 @@ public:
     void                process(long long *time_cost_with_cache = nullptr, bool use_cache = false) override;
     // Exports G-code into a file name based on the path_template, returns the file path of the generated G-code file.
     // If preview_data is not null, the preview_data is filled in for the G-code visualization (not used by the command line Slic3r).
-    std::string         export_gcode(const std::string& path_template, GCodeProcessorResult* result, ThumbnailsGeneratorCallback thumbnail_cb = nullptr);
+    // If binary_gcode is enabled, the file is converted to binary G-code unless keep_ascii is set
+    // (the GUI keeps the ASCII G-code for the preview and converts it when exporting).
+    std::string         export_gcode(const std::string& path_template, GCodeProcessorResult* result, ThumbnailsGeneratorCallback thumbnail_cb = nullptr, bool keep_ascii = false);
     //return 0 means successful
     int                 export_cached_data(const std::string& dir_path, bool with_space=false);
     int                 load_cached_data(const std::string& directory);
+    // Opt-in persistent cache of the processed PrintObjects, see SlicingCache. Null to disable.
+    void                set_slicing_cache(std::shared_ptr<SlicingCache> cache) { m_slicing_cache = std::move(cache); }
+    const std::shared_ptr<SlicingCache>& slicing_cache() const { return m_slicing_cache; }
 
     // methods for handling state
     bool                is_step_done(PrintStep step) const { return Inherited::is_step_done(step); }
@@ -1126,6 +1174,16 @@ private:
     // Islands of objects and their supports extruded at the 1st layer.
     Polygons            first_layer_islands() const;
 
+    // Layers, support layers and first layer groups of the objects for export_cached_data() and the slicing cache.
+    int                 export_cached_data(const PrintObjectPtrs &objects, const std::string &directory, bool with_space, std::vector<nlohmann::json> *objects_json);
+    // Returns 0 on success or one of the CLI_IMPORT_CACHE_* error codes.
+    int                 load_cached_data(std::vector<std::pair<std::string, PrintObject*>> &object_filenames, std::vector<nlohmann::json> &object_jsons);
+    // Key of a PrintObject in the slicing cache: Hash of its meshes, painting, transformation and of the configuration
+    // of the object, of its regions and of the print options influencing the PrintObject steps.
+    std::string         slicing_cache_key(const PrintObject &obj) const;
+    bool                load_from_slicing_cache(PrintObject &obj, const std::string &key);
+    void                store_to_slicing_cache(PrintObject &obj, const std::string &key);
+
     PrintConfig                             m_config;
     PrintObjectConfig                       m_default_object_config;
     PrintRegionConfig                       m_default_region_config;
@@ -1179,6 +1237,8 @@ private:
 
     bool m_need_check_multi_filaments_compatibility{true};
 
+    std::shared_ptr<SlicingCache>           m_slicing_cache;
+
     // To allow GCode to set the Print's GCodeExport step status.
     friend class GCode;
     // Allow PrintObject to access m_mutex and m_cancel_callback.
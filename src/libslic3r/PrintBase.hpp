@@ -7,6 +7,7 @@
 #include <string>
 #include <functional>
 #include <atomic>
+#include <chrono>
 #include <mutex>
 
 #include "ObjectID.hpp"
@@ -70,9 +71,11 @@ public:
     // A new unique timestamp is being assigned to the step every time the step changes its state.
     struct StateWithTimeStamp
     {
-        StateWithTimeStamp() : state(INVALID), timestamp(0) {}
+        StateWithTimeStamp() : state(INVALID), timestamp(0), duration(0.) {}
         State       state;
         TimeStamp   timestamp;
+        // Wall clock time in seconds spent between entering the STARTED and the DONE state. Valid if DONE.
+        double      duration;
     };
 
     struct Warning
@@ -170,8 +173,10 @@ public:
         PrintStateBase::StateWithWarnings &state = m_state[step];
         state.state = STARTED;
         state.timestamp = ++ g_last_timestamp;
+        state.duration = 0.;
         state.mark_warnings_non_current();
         m_step_active = static_cast<int>(step);
+        m_time_started[step] = std::chrono::steady_clock::now();
         return true;
     }
 
@@ -190,6 +195,7 @@ public:
         PrintStateBase::StateWithWarnings &state = m_state[step];
         state.state = DONE;
         state.timestamp = ++ g_last_timestamp;
+        state.duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_time_started[step]).count();
         m_step_active = -1;
         // Remove all non-current warnings.
     	auto it = std::remove_if(state.warnings.begin(), state.warnings.end(), [](const auto &w) { return ! w.current; });
@@ -327,6 +333,8 @@ private:
     // If the background processing is canceled, m_step_active may not be resetted
     // to -1, see the comment in this->set_started().
     int                 m_step_active = -1;
+    // When the steps entered the STARTED state, to measure StateWithTimeStamp::duration.
+    std::chrono::steady_clock::time_point m_time_started[COUNT];
 };
 
 class PrintBase;
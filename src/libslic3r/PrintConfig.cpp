@@ -4925,6 +4925,13 @@ void PrintConfigDef::init_fff_params()
     def->mode = comAdvanced;
     def->set_default_value(new ConfigOptionBool(false));
 
+    def = this->add("binary_gcode", coBool);
+    def->label = L("Export as binary G-code");
+    def->tooltip = L("Export the G-code in the binary G-code (.bgcode) format. The G-code is stored compressed "
+                     "together with the print statistics and the thumbnails. The printer firmware has to support this format.");
+    def->mode = comAdvanced;
+    def->set_default_value(new ConfigOptionBool(false));
+
     def = this->add("seam_position", coEnum);
     def->label = L("Seam position");
     def->category = L("Quality");
@@ -5381,6 +5388,14 @@ void PrintConfigDef::init_fff_params()
     def->mode = comAdvanced;
     def->set_default_value(new ConfigOptionBool(false));
 
+    def = this->add("optimize_filament_order", coBool);
+    def->label = L("Optimize filament order over the whole print");
+    def->tooltip = L("If enabled, the filament order of all the layers is optimized together for the minimum flush volume, "
+                    "instead of choosing the order of each layer based on the next layer only. "
+                    "This may take longer to slice for prints with many filaments and many layers.");
+    def->mode = comAdvanced;
+    def->set_default_value(new ConfigOptionBool(false));
+
     def = this->add("single_extruder_multi_material_priming", coBool);
     def->label = L("Prime all printing extruders");
     def->tooltip = L("If enabled, all printing extruders will be primed at the front edge of the print bed at the start of the print.");
@@ -9639,6 +9654,13 @@ CLIActionsConfigDef::CLIActionsConfigDef()
     def->cli = "gcodeviewer";
     def->set_default_value(new ConfigOptionBool(false));*/
 
+    def = this->add("estimate_gcode", coString);
+    def->label = L("Estimate G-code");
+    def->tooltip = L("Estimate the print time and the filament usage of the input G-code files and save the results as JSON. "
+                     "The files are processed in parallel without loading the presets or starting the GUI.");
+    def->cli_params = "result.json";
+    def->set_default_value(new ConfigOptionString("estimate.json"));
+
     def = this->add("slice", coInt);
     def->label = L("Slice");
     def->tooltip = L("Slice the plates: 0-all plates, i-plate i, others-invalid");
@@ -9959,6 +9981,28 @@ CLIMiscConfigDef::CLIMiscConfigDef()
     def->cli_params = "dir";
     def->set_default_value(new ConfigOptionString());
 
+    def = this->add("gcode_pipeline_stats", coString);
+    def->label = L("G-code pipeline statistics");
+    def->tooltip = L("Save the time spent and the amount of G-code produced by each stage of the G-code export "
+                     "of each sliced plate into the given JSON file.");
+    def->cli_params = "stats.json";
+    def->set_default_value(new ConfigOptionString());
+
+    def = this->add("slicing_cache", coString);
+    def->label = L("Slicing cache directory");
+    def->tooltip = L("Keep the sliced objects in the given directory and reuse them when the same object is sliced "
+                     "again with the same settings, also by another run.");
+    def->cli_params = "directory";
+    def->set_default_value(new ConfigOptionString());
+
+    def = this->add("slicing_cache_size", coInt);
+    def->label = L("Slicing cache size");
+    def->tooltip = L("Maximum size of the slicing cache directory. The least recently used objects are removed when exceeded.");
+    def->sidetext = L("MB");
+    def->min = 0;
+    def->cli_params = "size";
+    def->set_default_value(new ConfigOptionInt(4096));
+
     def = this->add("debug", coInt);
     def->label = L("Debug level");
     def->tooltip = L("Sets debug logging level. 0:fatal, 1:error, 2:warning, 3:info, 4:debug, 5:trace\n");
@@ -105,6 +105,8 @@ PrintObject::PrintObject(Print* print, ModelObject* model_object, const Transfor
     m_size = (bbox.size() * (1. / SCALING_FACTOR)).cast<coord_t>();
     m_max_z = scaled(model_object->instance_bounding_box(0).max(2));
 
+    m_invalid_z_ranges.fill({ 0., DBL_MAX });
+
     this->set_instances(std::move(instances));
 }
 
@@ -505,9 +507,10 @@ void PrintObject::make_perimeters()
         BOOST_LOG_TRIVIAL(debug) << "Generating extra perimeters for region " << region_id << " in parallel - end";
     }
 
-    BOOST_LOG_TRIVIAL(debug) << "Generating perimeters in parallel - start";
+    auto [first_layer, last_layer] = this->layers_to_process(posPerimeters);
+    BOOST_LOG_TRIVIAL(debug) << "Generating perimeters of layers " << first_layer << " to " << last_layer << " of " << m_layers.size() << " in parallel - start";
     tbb::parallel_for(
-        tbb::blocked_range<size_t>(0, m_layers.size()),
+        tbb::blocked_range<size_t>(first_layer, last_layer),
         [this](const tbb::blocked_range<size_t>& range) {
             for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
                 m_print->throw_if_canceled();
@@ -670,9 +673,10 @@ void PrintObject::infill()
         const auto& adaptive_fill_octree = this->m_adaptive_fill_octrees.first;
         const auto& support_fill_octree = this->m_adaptive_fill_octrees.second;
 
-        BOOST_LOG_TRIVIAL(debug) << "Filling layers in parallel - start";
+        auto [first_layer, last_layer] = this->layers_to_process(posInfill);
+        BOOST_LOG_TRIVIAL(debug) << "Filling layers " << first_layer << " to " << last_layer << " of " << m_layers.size() << " in parallel - start";
         tbb::parallel_for(
-            tbb::blocked_range<size_t>(0, m_layers.size()),
+            tbb::blocked_range<size_t>(first_layer, last_layer),
             [this, &adaptive_fill_octree = adaptive_fill_octree, &support_fill_octree = support_fill_octree](const tbb::blocked_range<size_t>& range) {
                 for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
                     m_print->throw_if_canceled();
@@ -693,9 +697,10 @@ void PrintObject::ironing()
 {
     if (this->set_started(posIroning)) {
         BOOST_LOG_TRIVIAL(debug) << "Ironing in parallel - start";
+        auto [first_layer, last_layer] = this->layers_to_process(posIroning);
         tbb::parallel_for(
             // Ironing starting with layer 0 to support ironing all surfaces.
-            tbb::blocked_range<size_t>(0, m_layers.size()),
+            tbb::blocked_range<size_t>(first_layer, last_layer),
             [this](const tbb::blocked_range<size_t>& range) {
                 for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
                     m_print->throw_if_canceled();
@@ -824,8 +829,9 @@ void PrintObject::simplify_extrusion_path()
         m_print->set_status(75, L("Optimizing toolpath"));
         BOOST_LOG_TRIVIAL(debug) << "Simplify extrusion path of object in parallel - start";
         //BBS: infill and walls
+        auto [first_layer, last_layer] = this->layers_to_process(posSimplifyPath);
         tbb::parallel_for(
-            tbb::blocked_range<size_t>(0, m_layers.size()),
+            tbb::blocked_range<size_t>(first_layer, last_layer),
             [this](const tbb::blocked_range<size_t>& range) {
                 for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
                     m_print->throw_if_canceled();
@@ -842,8 +848,9 @@ void PrintObject::simplify_extrusion_path()
         m_print->set_status(75, L("Optimizing toolpath"));
         BOOST_LOG_TRIVIAL(debug) << "Simplify infill extrusion path of object in parallel - start";
         //BBS: infills
+        auto [first_layer, last_layer] = this->layers_to_process(posSimplifyInfill);
         tbb::parallel_for(
-            tbb::blocked_range<size_t>(0, m_layers.size()),
+            tbb::blocked_range<size_t>(first_layer, last_layer),
             [this](const tbb::blocked_range<size_t>& range) {
                 for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++layer_idx) {
                     m_print->throw_if_canceled();
@@ -927,6 +934,8 @@ FillLightning::GeneratorPtr PrintObject::prepare_lightning_infill_data()
 void PrintObject::clear_layers()
 {
     if (!m_shared_object) {
+        m_travel_boundaries_cache.clear();
+        this->set_seam_data({}, nullptr);
         for (Layer *l : m_layers)
             delete l;
         m_layers.clear();
@@ -954,6 +963,7 @@ SupportLayer* PrintObject::get_support_layer_at_printz(coordf_t print_z, coordf_
 void PrintObject::clear_support_layers()
 {
     if (!m_shared_object) {
+        m_travel_boundaries_cache.clear_support_layers();
         for (SupportLayer* l : m_support_layers)
             delete l;
         m_support_layers.clear();
@@ -996,7 +1006,8 @@ SupportLayerPtrs::iterator PrintObject::insert_support_layer(SupportLayerPtrs::i
 // Called by Print::apply().
 // This method only accepts PrintObjectConfig and PrintRegionConfig option keys.
 bool PrintObject::invalidate_state_by_config_options(
-    const ConfigOptionResolver &old_config, const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys)
+    const ConfigOptionResolver &old_config, const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys,
+    const t_layer_height_range &z_range)
 {
     if (opt_keys.empty())
         return false;
@@ -1340,29 +1351,83 @@ bool PrintObject::invalidate_state_by_config_options(
 
     sort_remove_duplicates(steps);
     for (PrintObjectStep step : steps)
-        invalidated |= this->invalidate_step(step);
+        invalidated |= this->invalidate_step_in_z_range(step, z_range);
     return invalidated;
 }
 
 bool PrintObject::invalidate_step(PrintObjectStep step)
 {
+    return this->invalidate_step_in_z_range(step, { 0., DBL_MAX });
+}
+
+bool PrintObject::invalidate_step_in_z_range(PrintObjectStep step, const t_layer_height_range &step_z_range)
+{
+    auto layer_local = [](PrintObjectStep step) {
+        return step == posPerimeters || step == posPrepareInfill || step == posInfill || step == posIroning || step == posSimplifyPath || step == posSimplifyInfill;
+    };
+    // Perimeters of a layer are influenced by the layer below (overhangs) and above (top surfaces).
+    const t_layer_height_range z_range = ! layer_local(step) ? t_layer_height_range(0., DBL_MAX) :
+        step == posPerimeters ? this->expand_z_range(step_z_range, 1, 0.) : step_z_range;
+    // Merge z_range with the layers not yet recalculated by an unfinished step. Print::apply() holds the state mutex.
+    auto update_z_range = [this, &layer_local](PrintObjectStep step, const t_layer_height_range &z_range) {
+        t_layer_height_range &dst = m_invalid_z_ranges[step];
+        if (! layer_local(step))
+            dst = { 0., DBL_MAX };
+        else if (this->is_step_done_unguarded(step))
+            dst = z_range;
+        else
+            dst = { std::min(dst.first, z_range.first), std::max(dst.second, z_range.second) };
+    };
+    auto invalidate_steps = [this, &update_z_range](std::initializer_list<PrintObjectStep> steps, const t_layer_height_range &z_range) {
+        for (PrintObjectStep step : steps)
+            update_z_range(step, z_range);
+        return Inherited::invalidate_steps(steps);
+    };
+
+    update_z_range(step, z_range);
 	bool invalidated = Inherited::invalidate_step(step);
+    // The travel boundaries are built from the slices, the perimeter flows, the top fill surfaces and the support layers.
+    if (step == posSlice || step == posPerimeters || step == posSupportMaterial)
+        m_travel_boundaries_cache.invalidate(z_range.first, z_range.second);
+    // The seam placement is calculated from the simplified perimeters of all layers.
+    if (step == posSlice || step == posPerimeters || step == posPrepareInfill || step == posSimplifyPath)
+        this->set_seam_data({}, nullptr);
 
     // propagate to dependent steps
     if (step == posPerimeters) {
-		invalidated |= this->invalidate_steps({ posPrepareInfill, posInfill, posIroning, posSimplifyPath, posSimplifyInfill });
+        invalidated |= invalidate_steps({ posSimplifyPath }, z_range);
+        // Perimeters feed into the fill surfaces, which are classified against the neighbor layers by prepare_infill(),
+        // thus the infill z range is expanded below.
+        invalidated |= this->invalidate_step_in_z_range(posPrepareInfill, z_range);
         invalidated |= m_print->invalidate_steps({ psSkirtBrim });
     } else if (step == posPrepareInfill) {
-        invalidated |= this->invalidate_steps({ posInfill, posIroning, posSimplifyPath, posSimplifyInfill });
+        // prepare_infill() is always recalculated for all layers. Its results (the fill surfaces) only change
+        // in the top / bottom shells around the changed layers and in the internal bridges above them.
+        // Adaptive cubic and lightning infills are generated from the overhangs of the whole object,
+        // infill_combination merges sparse infill over many layers.
+        bool whole_object = z_range.first <= 0. && z_range.second == DBL_MAX;
+        size_t   num_layers = 1;
+        coordf_t height     = 0.;
+        for (size_t region_id = 0; ! whole_object && region_id < this->num_printing_regions(); ++ region_id) {
+            const PrintRegionConfig &config = this->printing_region(region_id).config();
+            if (config.infill_combination ||
+                (config.sparse_infill_density > 0 && (config.sparse_infill_pattern == ipAdaptiveCubic || config.sparse_infill_pattern == ipSupportCubic || config.sparse_infill_pattern == ipLightning)))
+                whole_object = true;
+            num_layers = std::max(num_layers, size_t(std::max(config.top_shell_layers.value, config.bottom_shell_layers.value)) + 1);
+            height     = std::max(height, std::max(config.top_shell_thickness.value, config.bottom_shell_thickness.value));
+        }
+        t_layer_height_range infill_z_range = whole_object ? t_layer_height_range(0., DBL_MAX) : this->expand_z_range(z_range, num_layers, height);
+        m_travel_boundaries_cache.invalidate(infill_z_range.first, infill_z_range.second);
+        invalidated |= invalidate_steps({ posInfill, posIroning, posSimplifyPath, posSimplifyInfill }, infill_z_range);
     } else if (step == posInfill) {
-        invalidated |= this->invalidate_steps({ posIroning, posSimplifyInfill });
+        invalidated |= invalidate_steps({ posIroning, posSimplifyInfill }, z_range);
         invalidated |= m_print->invalidate_steps({ psSkirtBrim });
     } else if (step == posSlice) {
-		invalidated |= this->invalidate_steps({ posPerimeters, posPrepareInfill, posInfill, posIroning, posSupportMaterial, posSimplifyPath, posSimplifyInfill });
+		invalidated |= invalidate_steps({ posPerimeters, posPrepareInfill, posInfill, posIroning, posSupportMaterial, posSimplifyPath, posSimplifyInfill }, z_range);
         invalidated |= m_print->invalidate_steps({ psSkirtBrim });
         m_slicing_params.valid = false;
     } else if (step == posSupportMaterial) {
-        invalidated |= this->invalidate_steps({ posSimplifySupportPath });
+        invalidated |= invalidate_steps({ posSimplifySupportPath }, z_range);
         invalidated |= m_print->invalidate_steps({ psSkirtBrim });
         m_slicing_params.valid = false;
     }
@@ -1382,9 +1447,37 @@ bool PrintObject::invalidate_all_steps()
     bool result = Inherited::invalidate_all_steps() | m_print->invalidate_all_steps();
 	// Then reset some of the depending values.
 	m_slicing_params.valid = false;
+    m_invalid_z_ranges.fill({ 0., DBL_MAX });
+    this->set_seam_data({}, nullptr);
 	return result;
 }
 
+std::pair<size_t, size_t> PrintObject::layers_to_process(PrintObjectStep step) const
+{
+    const t_layer_height_range &z_range = m_invalid_z_ranges[step];
+    auto first = std::lower_bound(m_layers.begin(), m_layers.end(), z_range.first - EPSILON, [](const Layer *l, coordf_t z) { return l->slice_z < z; });
+    auto last  = std::upper_bound(first, m_layers.end(), z_range.second + EPSILON, [](coordf_t z, const Layer *l) { return z < l->slice_z; });
+    return { size_t(first - m_layers.begin()), size_t(last - m_layers.begin()) };
+}
+
+t_layer_height_range PrintObject::expand_z_range(const t_layer_height_range &z_range, size_t num_layers, coordf_t height) const
+{
+    auto first = std::lower_bound(m_layers.begin(), m_layers.end(), z_range.first - EPSILON, [](const Layer *l, coordf_t z) { return l->slice_z < z; });
+    auto last  = std::upper_bound(first, m_layers.end(), z_range.second + EPSILON, [](coordf_t z, const Layer *l) { return z < l->slice_z; });
+    if (first == last)
+        // No layer inside z_range.
+        return z_range;
+    coordf_t h = 0.;
+    for (auto it = first; first != m_layers.begin() && (size_t(it - first) < num_layers || h < height); ) {
+        -- first;
+        h += (*first)->height;
+    }
+    h = 0.;
+    for (auto it = last; last != m_layers.end() && (size_t(last - it) < num_layers || h < height); ++ last)
+        h += (*last)->height;
+    return { first == m_layers.begin() ? 0. : (*first)->slice_z, last == m_layers.end() ? DBL_MAX : (*std::prev(last))->slice_z };
+}
+
 // This function analyzes slices of a region (SurfaceCollection slices).
 // Each region slice (instance of Surface) is analyzed, whether it is supported or whether it is the top surface.
 // Initially all slices are of type stInternal.
@@ -0,0 +1,232 @@
+#include "SlicingCache.hpp"
+#include "Utils.hpp"
+#include "Exception.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <random>
+
+#include <boost/filesystem.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/nowide/fstream.hpp>
+
+#include <openssl/evp.h>
+
+namespace Slic3r {
+
+namespace fs = boost::filesystem;
+
+SlicingCacheKey::SlicingCacheKey() : m_ctx(EVP_MD_CTX_new())
+{
+    if (! m_ctx || EVP_DigestInit_ex(m_ctx.get(), EVP_sha256(), nullptr) != 1)
+        throw RuntimeError("SlicingCache: cannot initialize SHA-256");
+}
+
+SlicingCacheKey::~SlicingCacheKey() = default;
+
+void SlicingCacheKey::ContextDeleter::operator()(evp_md_ctx_st *ctx) const
+{
+    EVP_MD_CTX_free(ctx);
+}
+
+void SlicingCacheKey::update(const void *data, size_t size)
+{
+    assert(m_ctx);
+    EVP_DigestUpdate(m_ctx.get(), data, size);
+}
+
+std::string SlicingCacheKey::digest()
+{
+    assert(m_ctx);
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int  md_size = 0;
+    EVP_DigestFinal_ex(m_ctx.get(), md, &md_size);
+    m_ctx.reset();
+    static constexpr const char *hex = "0123456789abcdef";
+    std::string out(2 * md_size, '0');
+    for (unsigned int i = 0; i < md_size; ++ i) {
+        out[2 * i]     = hex[md[i] >> 4];
+        out[2 * i + 1] = hex[md[i] & 0x0f];
+    }
+    return out;
+}
+
+// Header of a cache file: Magic, format version, payload size.
+static constexpr const char  CACHE_FILE_MAGIC[8] = { 'O', 'R', 'C', 'A', 'S', 'L', 'C', 'C' };
+static constexpr const char *CACHE_FILE_EXTENSION = ".slc";
+static constexpr size_t      CACHE_FILE_HEADER_SIZE = sizeof(CACHE_FILE_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t);
+// Suffix of the temporary files written by store(), followed by a random number.
+static constexpr const char *TEMP_FILE_SUFFIX = ".slc.tmp";
+// Temporary files older than that were left behind by a crashed process.
+static constexpr std::time_t TEMP_FILE_STALE_AGE = 60 * 60;
+
+SlicingCache::SlicingCache(const std::string &directory, size_t max_size) : m_directory(directory), m_max_size(max_size)
+{
+    boost::system::error_code ec;
+    fs::create_directories(fs::path(m_directory), ec);
+    if (ec)
+        BOOST_LOG_TRIVIAL(error) << "SlicingCache: cannot create directory " << m_directory << ": " << ec.message();
+}
+
+std::string SlicingCache::path(const std::string &key) const
+{
+    return (fs::path(m_directory) / (key + CACHE_FILE_EXTENSION)).string();
+}
+
+bool SlicingCache::load(const std::string &key, std::vector<uint8_t> &payload) const
+{
+    const std::string file = this->path(key);
+    boost::nowide::ifstream ifs(file, std::ios::binary);
+    if (! ifs) {
+        ++ m_misses;
+        return false;
+    }
+    char     magic[sizeof(CACHE_FILE_MAGIC)];
+    uint32_t version = 0;
+    uint64_t size    = 0;
+    ifs.read(magic, sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&version), sizeof(version));
+    ifs.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (! ifs || memcmp(magic, CACHE_FILE_MAGIC, sizeof(magic)) != 0 || version != VERSION) {
+        BOOST_LOG_TRIVIAL(warning) << "SlicingCache: ignoring invalid cache file " << file;
+        ++ m_misses;
+        return false;
+    }
+    // Don't trust the payload size of a damaged file: It has to match the file size, which is limited by the cache size.
+    boost::system::error_code ec;
+    const uintmax_t file_size = fs::file_size(fs::path(file), ec);
+    if (ec || file_size != CACHE_FILE_HEADER_SIZE + size || size > m_max_size) {
+        BOOST_LOG_TRIVIAL(warning) << "SlicingCache: ignoring cache file " << file << " of invalid size";
+        ++ m_misses;
+        return false;
+    }
+    payload.resize(size);
+    ifs.read(reinterpret_cast<char*>(payload.data()), std::streamsize(size));
+    if (! ifs || ifs.gcount() != std::streamsize(size)) {
+        BOOST_LOG_TRIVIAL(warning) << "SlicingCache: ignoring truncated cache file " << file;
+        payload.clear();
+        ++ m_misses;
+        return false;
+    }
+    // Mark as the most recently used.
+    fs::last_write_time(fs::path(file), std::time(nullptr), ec);
+    ++ m_hits;
+    return true;
+}
+
+bool SlicingCache::store(const std::string &key, const std::vector<uint8_t> &payload)
+{
+    const uintmax_t file_size = CACHE_FILE_HEADER_SIZE + payload.size();
+    if (file_size > m_max_size) {
+        // It would be evicted right away.
+        BOOST_LOG_TRIVIAL(warning) << "SlicingCache: entry " << key << " of " << file_size << " bytes exceeds the cache size limit of " << m_max_size << " bytes";
+        return false;
+    }
+    const std::string file = this->path(key);
+    // Unique temporary file name, so that multiple processes may store the same entry concurrently.
+    std::string tmp_file;
+    {
+        std::random_device rd;
+        tmp_file = (fs::path(m_directory) / (key + TEMP_FILE_SUFFIX + std::to_string(rd()) + std::to_string(rd()))).string();
+    }
+    {
+        boost::nowide::ofstream ofs(tmp_file, std::ios::binary | std::ios::trunc);
+        const uint32_t version = VERSION;
+        const uint64_t size    = payload.size();
+        ofs.write(CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC));
+        ofs.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        ofs.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        ofs.write(reinterpret_cast<const char*>(payload.data()), std::streamsize(payload.size()));
+        ofs.close();
+        if (! ofs) {
+            BOOST_LOG_TRIVIAL(error) << "SlicingCache: cannot write " << tmp_file;
+            boost::system::error_code ec;
+            fs::remove(fs::path(tmp_file), ec);
+            return false;
+        }
+    }
+    // Size of the entry being replaced, if any.
+    boost::system::error_code ec_replaced;
+    uintmax_t replaced_size = fs::file_size(fs::path(file), ec_replaced);
+    if (ec_replaced)
+        replaced_size = 0;
+    if (std::error_code ec = rename_file(tmp_file, file); ec) {
+        BOOST_LOG_TRIVIAL(error) << "SlicingCache: cannot rename " << tmp_file << " to " << file << ": " << ec.message();
+        boost::system::error_code ec2;
+        fs::remove(fs::path(tmp_file), ec2);
+        return false;
+    }
+    ++ m_stores;
+    bool full;
+    {
+        std::scoped_lock<std::mutex> lock(m_mutex);
+        m_size = m_size + file_size - std::min(replaced_size, m_size);
+        full   = ! m_size_valid || m_size > m_max_size;
+    }
+    if (full)
+        this->evict(m_max_size);
+    return true;
+}
+
+void SlicingCache::evict(size_t max_size)
+{
+    std::scoped_lock<std::mutex> lock(m_mutex);
+
+    struct Entry {
+        fs::path    path;
+        std::time_t last_used;
+        uintmax_t   size;
+    };
+    std::vector<Entry> entries;
+    uintmax_t          total_size = 0;
+    const std::time_t  now        = std::time(nullptr);
+    boost::system::error_code ec;
+    for (fs::directory_iterator it(fs::path(m_directory), ec), end; ! ec && it != end; it.increment(ec)) {
+        const fs::path &p = it->path();
+        if (p.filename().string().find(TEMP_FILE_SUFFIX) != std::string::npos) {
+            boost::system::error_code ec2;
+            if (std::time_t t = fs::last_write_time(p, ec2); ! ec2 && t + TEMP_FILE_STALE_AGE < now && fs::remove(p, ec2))
+                BOOST_LOG_TRIVIAL(debug) << "SlicingCache: removed stale temporary file " << p.string();
+            continue;
+        }
+        if (p.extension() != CACHE_FILE_EXTENSION)
+            continue;
+        boost::system::error_code ec2;
+        Entry entry { p, fs::last_write_time(p, ec2), fs::file_size(p, ec2) };
+        if (ec2)
+            // Removed by another process in the meantime.
+            continue;
+        total_size += entry.size;
+        entries.emplace_back(std::move(entry));
+    }
+    m_size       = total_size;
+    m_size_valid = true;
+    if (total_size <= max_size)
+        return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &l, const Entry &r) { return l.last_used < r.last_used; });
+    for (const Entry &entry : entries) {
+        if (total_size <= max_size)
+            break;
+        boost::system::error_code ec2;
+        if (fs::remove(entry.path, ec2)) {
+            total_size -= entry.size;
+            ++ m_evicted;
+        }
+    }
+    m_size = total_size;
+    BOOST_LOG_TRIVIAL(debug) << "SlicingCache: evicted entries, cache size " << total_size << " bytes, limit " << max_size << " bytes";
+}
+
+SlicingCache::Statistics SlicingCache::statistics() const
+{
+    Statistics out;
+    out.hits    = m_hits;
+    out.misses  = m_misses;
+    out.stores  = m_stores;
+    out.evicted = m_evicted;
+    return out;
+}
+
+} // namespace Slic3r
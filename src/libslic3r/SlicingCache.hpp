@@ -0,0 +1,91 @@
+#ifndef slic3r_SlicingCache_hpp_
+#define slic3r_SlicingCache_hpp_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct evp_md_ctx_st;
+
+namespace Slic3r {
+
+// Incremental hash of the inputs of a cached computation, naming the cache entry.
+class SlicingCacheKey
+{
+public:
+    SlicingCacheKey();
+    ~SlicingCacheKey();
+
+    void        update(const void *data, size_t size);
+    void        update(const std::string &str) { this->update(uint64_t(str.size())); this->update(str.data(), str.size()); }
+    template<typename T>
+    void        update(const std::vector<T> &v) { this->update(uint64_t(v.size())); if (! v.empty()) this->update(v.data(), v.size() * sizeof(T)); }
+    template<typename T, typename = std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>>
+    void        update(T value) { this->update(&value, sizeof(T)); }
+
+    // Hex encoded SHA-256 of the data passed to update(). The key may not be updated afterwards.
+    std::string digest();
+
+private:
+    struct ContextDeleter { void operator()(evp_md_ctx_st *ctx) const; };
+    std::unique_ptr<evp_md_ctx_st, ContextDeleter> m_ctx;
+};
+
+// Content addressed cache of the results of processing PrintObjects, persisted in a directory, thus shared between
+// application runs and processes slicing the same objects with the same settings.
+// Each entry is a single file named by its key with a short header and an opaque payload.
+// Entries are written into a temporary file first and renamed, thus a reader never sees a partially written entry.
+// The least recently used entries are removed when the size of the directory exceeds the limit. The size of the directory
+// is scanned once and then tracked by store(), the directory is only scanned again when the tracked size exceeds the limit.
+class SlicingCache
+{
+public:
+    // Format version of the cache files. Bump it if the payload format changes.
+    static constexpr uint32_t VERSION = 1;
+
+    SlicingCache(const std::string &directory, size_t max_size);
+
+    const std::string&  directory() const { return m_directory; }
+    size_t              max_size() const { return m_max_size; }
+
+    // Load an entry, mark it as the most recently used. Returns false if the entry does not exist or it is damaged.
+    bool                load(const std::string &key, std::vector<uint8_t> &payload) const;
+    // Store an entry, then evict the least recently used entries to fit the size limit.
+    // Returns false if the entry could not be written or if it alone exceeds the size limit.
+    bool                store(const std::string &key, const std::vector<uint8_t> &payload);
+    // Remove the least recently used entries until the size of the cache is not above max_size.
+    // Also removes the temporary files left behind by processes, which crashed while storing an entry.
+    void                evict(size_t max_size);
+
+    struct Statistics {
+        size_t hits    { 0 };
+        size_t misses  { 0 };
+        size_t stores  { 0 };
+        size_t evicted { 0 };
+    };
+    Statistics          statistics() const;
+
+private:
+    std::string         path(const std::string &key) const;
+
+    std::string                 m_directory;
+    size_t                      m_max_size;
+    // Serializes eviction and the update of m_size within this process. Other processes sharing the directory may evict
+    // concurrently, which is harmless as entries are only ever removed or replaced as a whole.
+    std::mutex                  m_mutex;
+    // Size of the cache files in the directory as of the last scan plus the size of the entries stored since then.
+    // Entries stored or evicted by other processes are only accounted for by the next scan.
+    uintmax_t                   m_size { 0 };
+    bool                        m_size_valid { false };
+    mutable std::atomic<size_t> m_hits    { 0 };
+    mutable std::atomic<size_t> m_misses  { 0 };
+    std::atomic<size_t>         m_stores  { 0 };
+    std::atomic<size_t>         m_evicted { 0 };
+};
+
+} // namespace Slic3r
+
+#endif // slic3r_SlicingCache_hpp_
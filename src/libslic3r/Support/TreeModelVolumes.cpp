@@ -19,11 +19,15 @@
 #include "../Utils.hpp"
 #include "../format.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <string_view>
 
 #include <boost/log/trivial.hpp>
 
 #include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 #include <tbb/task_group.h>
 
 namespace Slic3r::TreeSupport3D
@@ -67,6 +71,7 @@ TreeModelVolumes::TreeModelVolumes(
     m_machine_border{ calculateMachineBorderCollision(build_volume.polygon()) }
 {
     m_bed_area = build_volume.polygon();
+    m_cache_memory_budget = total_physical_memory() / 2;
 #if 0
     std::unordered_map<size_t, size_t> mesh_to_layeroutline_idx;
     for (size_t mesh_idx = 0; mesh_idx < storage.meshes.size(); ++ mesh_idx) {
@@ -861,26 +866,441 @@ coord_t TreeModelVolumes::ceilRadius(const coord_t radius) const
     return out;
 }
 
-void TreeModelVolumes::RadiusLayerPolygonCache::allocate_layers(size_t num_layers)
+struct TreeModelVolumes::RadiusLayerPolygonCache::Storage
 {
-    if (num_layers > m_data.size()) {
-        if (num_layers > m_data.capacity())
-            reserve_power_of_2(m_data, num_layers);
-        m_data.resize(num_layers, {});
+    struct Entry {
+        Polygons polygons;
+        size_t   bytes;
+    };
+    // Radii are stored in blocks growing geometrically, the i-th block holds radii_per_block << i radii.
+    // Thus the number of radii is not limited in practice, while a layer holds only max_radius_blocks pointers.
+    static constexpr size_t radii_per_block   = 16;
+    static constexpr size_t max_radius_blocks = 24;
+    static size_t radius_block_size(size_t block) { return radii_per_block << block; }
+    // Block of a radius and the index of the radius in the block.
+    static std::pair<size_t, size_t> radius_block(size_t radius_idx) {
+        const size_t n     = radius_idx / radii_per_block + 1;
+        size_t       block = 0;
+        while (n >> (block + 1))
+            ++ block;
+        return { block, radius_idx - radii_per_block * ((size_t(1) << block) - 1) };
+    }
+    struct RadiusBlock {
+        explicit RadiusBlock(size_t size) : slots(new std::atomic<Entry*>[size]), size(size) {
+            for (size_t i = 0; i < size; ++ i)
+                slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+        std::unique_ptr<std::atomic<Entry*>[]>                  slots;
+        size_t                                                  size;
+    };
+    struct Layer {
+        std::array<std::atomic<RadiusBlock*>, max_radius_blocks> blocks {};
+    };
+    static constexpr size_t layers_per_chunk = 64;
+    static constexpr size_t max_layer_chunks = 4096;
+    struct LayerChunk {
+        std::array<Layer, layers_per_chunk>                     layers;
+    };
+    struct Radius {
+        std::atomic<coord_t>    radius    { 0 };
+        // Highest layer with an area of this radius.
+        std::atomic<LayerIndex> max_layer { -1 };
+        // Epoch of the last lookup hit.
+        std::atomic<uint32_t>   last_used { 0 };
+    };
+    // Counters updated by concurrent lookups are sharded by the worker thread to avoid contention on a single cache line.
+    struct alignas(64) Counter {
+        std::atomic<size_t>     value { 0 };
+    };
+    static constexpr size_t num_counter_shards = 16;
+
+    std::array<std::atomic<LayerChunk*>, max_layer_chunks>   chunks {};
+    // Blocks of radii_per_block << i radii, see radius_block().
+    std::array<std::atomic<Radius*>, max_radius_blocks>       radii;
+    std::atomic<size_t>                                       num_radii { 0 };
+    // Only guards registration of new radii by writers.
+    std::mutex                                                radii_mutex;
+    // Radii sorted ascending with their indices, binary searched by the lock free readers.
+    // A new snapshot is published for each registered radius. The old snapshots may still be read concurrently,
+    // they are kept until clear().
+    using SortedRadii = std::vector<std::pair<coord_t, size_t>>;
+    std::atomic<const SortedRadii*>                           sorted_radii { nullptr };
+    std::vector<std::unique_ptr<SortedRadii>>                 sorted_radii_snapshots;
+
+    std::array<Counter, num_counter_shards>                   hits;
+    std::array<Counter, num_counter_shards>                   misses;
+    std::atomic<size_t>                                       resident_bytes { 0 };
+    size_t                                                    evicted_bytes  { 0 };
+    size_t                                                    evicted_areas  { 0 };
+    std::atomic<uint32_t>                                     epoch          { 1 };
+
+    ~Storage() {
+        this->clear();
+        for (std::atomic<Radius*> &block : radii)
+            delete[] block.load(std::memory_order_relaxed);
+    }
+
+    static size_t counter_shard() { return size_t(tbb::this_task_arena::current_thread_index()) % num_counter_shards; }
+    static size_t sum(const std::array<Counter, num_counter_shards> &counters) {
+        size_t out = 0;
+        for (const Counter &c : counters)
+            out += c.value.load(std::memory_order_relaxed);
+        return out;
+    }
+
+    static size_t memory_used(const Polygons &polygons) {
+        size_t out = sizeof(Entry) + polygons.capacity() * sizeof(Polygon);
+        for (const Polygon &polygon : polygons)
+            out += polygon.points.capacity() * sizeof(Point);
+        return out;
+    }
+
+    // Lock free for the radii registered already.
+    Radius& radius_info(size_t radius_idx) const {
+        auto [block, idx] = radius_block(radius_idx);
+        return radii[block].load(std::memory_order_acquire)[idx];
+    }
+
+    // Lock free, the registered radii sorted ascending.
+    const SortedRadii& sorted() const {
+        static const SortedRadii empty;
+        const SortedRadii *out = sorted_radii.load(std::memory_order_acquire);
+        return out ? *out : empty;
+    }
+    // Lock free, returns -1 if the radius was never inserted.
+    int find_radius(coord_t radius) const {
+        const SortedRadii &radii = this->sorted();
+        auto it = std::lower_bound(radii.begin(), radii.end(), radius, [](const std::pair<coord_t, size_t> &l, coord_t r) { return l.first < r; });
+        return it != radii.end() && it->first == radius ? int(it->second) : -1;
+    }
+    size_t find_or_register_radius(coord_t radius) {
+        if (int idx = this->find_radius(radius); idx != -1)
+            return size_t(idx);
+        std::lock_guard<std::mutex> guard(radii_mutex);
+        // Another thread may have registered the radius in the meantime.
+        if (int idx = this->find_radius(radius); idx != -1)
+            return size_t(idx);
+        const size_t idx = num_radii.load(std::memory_order_relaxed);
+        if (auto [block, block_idx] = radius_block(idx); block_idx == 0 && radii[block].load(std::memory_order_relaxed) == nullptr)
+            // The block is published before num_radii, thus before any reader may access it.
+            radii[block].store(new Radius[radius_block_size(block)], std::memory_order_release);
+        radius_info(idx).radius.store(radius, std::memory_order_relaxed);
+        radius_info(idx).max_layer.store(-1, std::memory_order_relaxed);
+        radius_info(idx).last_used.store(0, std::memory_order_relaxed);
+        // Publish the new radius to the lock free readers.
+        num_radii.store(idx + 1, std::memory_order_release);
+        auto new_sorted = std::make_unique<SortedRadii>(this->sorted());
+        new_sorted->insert(std::upper_bound(new_sorted->begin(), new_sorted->end(), std::make_pair(radius, idx)), std::make_pair(radius, idx));
+        sorted_radii.store(new_sorted.get(), std::memory_order_release);
+        sorted_radii_snapshots.emplace_back(std::move(new_sorted));
+        return idx;
+    }
+
+    // Lock free, nullptr if the layer was not allocated yet.
+    Layer* layer(LayerIndex layer_idx) const {
+        if (layer_idx < 0 || size_t(layer_idx) >= layers_per_chunk * max_layer_chunks)
+            return nullptr;
+        LayerChunk *chunk = chunks[size_t(layer_idx) / layers_per_chunk].load(std::memory_order_acquire);
+        return chunk ? &chunk->layers[size_t(layer_idx) % layers_per_chunk] : nullptr;
+    }
+    // Allocate the chunk of a layer if it does not exist yet, lock free.
+    Layer& allocate_layer(LayerIndex layer_idx) {
+        if (layer_idx < 0 || size_t(layer_idx) >= layers_per_chunk * max_layer_chunks)
+            throw RuntimeError("Tree support: Layer index out of range of a polygon cache");
+        std::atomic<LayerChunk*> &chunk_ptr = chunks[size_t(layer_idx) / layers_per_chunk];
+        LayerChunk *chunk = chunk_ptr.load(std::memory_order_acquire);
+        if (chunk == nullptr) {
+            auto *new_chunk = new LayerChunk();
+            if (chunk_ptr.compare_exchange_strong(chunk, new_chunk, std::memory_order_acq_rel, std::memory_order_acquire))
+                chunk = new_chunk;
+            else
+                delete new_chunk;
+        }
+        return chunk->layers[size_t(layer_idx) % layers_per_chunk];
+    }
+
+    // Lock free, nullptr if the slot was not allocated yet.
+    std::atomic<Entry*>* slot(const Layer &layer, size_t radius_idx) const {
+        auto [iblock, idx] = radius_block(radius_idx);
+        RadiusBlock *block = layer.blocks[iblock].load(std::memory_order_acquire);
+        return block ? &block->slots[idx] : nullptr;
+    }
+    std::atomic<Entry*>& allocate_slot(Layer &layer, size_t radius_idx) {
+        auto [iblock, idx] = radius_block(radius_idx);
+        std::atomic<RadiusBlock*> &block_ptr = layer.blocks[iblock];
+        RadiusBlock *block = block_ptr.load(std::memory_order_acquire);
+        if (block == nullptr) {
+            auto *new_block = new RadiusBlock(radius_block_size(iblock));
+            if (block_ptr.compare_exchange_strong(block, new_block, std::memory_order_acq_rel, std::memory_order_acquire))
+                block = new_block;
+            else
+                delete new_block;
+        }
+        return block->slots[idx];
+    }
+
+    const Entry* find(size_t radius_idx, LayerIndex layer_idx) const {
+        if (const Layer *l = this->layer(layer_idx); l)
+            if (const std::atomic<Entry*> *s = this->slot(*l, radius_idx); s)
+                return s->load(std::memory_order_acquire);
+        return nullptr;
+    }
+
+    // Not thread safe.
+    size_t release(std::atomic<Entry*> &slot) {
+        Entry *entry = slot.exchange(nullptr, std::memory_order_relaxed);
+        if (entry == nullptr)
+            return 0;
+        const size_t bytes = entry->bytes;
+        resident_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        delete entry;
+        return bytes;
+    }
+    // Not thread safe. Update max_layer of a radius after some of its areas were released.
+    void update_max_layer(size_t radius_idx) {
+        LayerIndex layer_idx = radius_info(radius_idx).max_layer.load(std::memory_order_relaxed);
+        while (layer_idx >= 0 && this->find(radius_idx, layer_idx) == nullptr)
+            -- layer_idx;
+        radius_info(radius_idx).max_layer.store(layer_idx, std::memory_order_relaxed);
+    }
+    // Not thread safe.
+    void clear() {
+        for (std::atomic<LayerChunk*> &chunk_ptr : chunks)
+            if (LayerChunk *chunk = chunk_ptr.exchange(nullptr, std::memory_order_relaxed); chunk) {
+                for (Layer &layer : chunk->layers)
+                    for (std::atomic<RadiusBlock*> &block_ptr : layer.blocks)
+                        if (RadiusBlock *block = block_ptr.exchange(nullptr, std::memory_order_relaxed); block) {
+                            for (size_t i = 0; i < block->size; ++ i)
+                                this->release(block->slots[i]);
+                            delete block;
+                        }
+                delete chunk;
+            }
+        num_radii.store(0, std::memory_order_relaxed);
+        sorted_radii.store(nullptr, std::memory_order_relaxed);
+        sorted_radii_snapshots.clear();
+        assert(resident_bytes.load() == 0);
+    }
+    // Call fn(layer_idx, layer) for all allocated layers.
+    template<typename Fn>
+    void for_each_layer(Fn &&fn) const {
+        for (size_t ichunk = 0; ichunk < max_layer_chunks; ++ ichunk)
+            if (LayerChunk *chunk = chunks[ichunk].load(std::memory_order_acquire); chunk)
+                for (size_t i = 0; i < layers_per_chunk; ++ i)
+                    fn(LayerIndex(ichunk * layers_per_chunk + i), chunk->layers[i]);
+    }
+};
+
+TreeModelVolumes::RadiusLayerPolygonCache::RadiusLayerPolygonCache() : m_storage(std::make_unique<Storage>()) {}
+TreeModelVolumes::RadiusLayerPolygonCache::~RadiusLayerPolygonCache() = default;
+TreeModelVolumes::RadiusLayerPolygonCache::RadiusLayerPolygonCache(RadiusLayerPolygonCache &&rhs) = default;
+TreeModelVolumes::RadiusLayerPolygonCache& TreeModelVolumes::RadiusLayerPolygonCache::operator=(RadiusLayerPolygonCache &&rhs) = default;
+
+void TreeModelVolumes::RadiusLayerPolygonCache::emplace(coord_t radius, LayerIndex layer_idx, Polygons &&polygons)
+{
+    Storage                      &storage    = *m_storage;
+    const size_t                  radius_idx = storage.find_or_register_radius(radius);
+    std::atomic<Storage::Entry*> &slot       = storage.allocate_slot(storage.allocate_layer(layer_idx), radius_idx);
+    if (slot.load(std::memory_order_acquire) != nullptr)
+        // Already calculated, keep the existing areas, they may be referenced.
+        return;
+    const size_t bytes = Storage::memory_used(polygons);
+    auto        *entry = new Storage::Entry{ std::move(polygons), bytes };
+    Storage::Entry *expected = nullptr;
+    if (slot.compare_exchange_strong(expected, entry, std::memory_order_release, std::memory_order_relaxed)) {
+        storage.resident_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        std::atomic<LayerIndex> &max_layer = storage.radius_info(radius_idx).max_layer;
+        for (LayerIndex old = max_layer.load(std::memory_order_relaxed);
+             old < layer_idx && ! max_layer.compare_exchange_weak(old, layer_idx, std::memory_order_relaxed);) ;
+    } else
+        delete entry;
+}
+
+std::optional<std::reference_wrapper<const Polygons>> TreeModelVolumes::RadiusLayerPolygonCache::getArea(const TreeModelVolumes::RadiusLayerPair &key) const
+{
+    Storage              &storage    = *m_storage;
+    const int             radius_idx = storage.find_radius(key.first);
+    const Storage::Entry *entry      = radius_idx == -1 ? nullptr : storage.find(size_t(radius_idx), key.second);
+    const size_t          shard      = Storage::counter_shard();
+    if (entry == nullptr) {
+        storage.misses[shard].value.fetch_add(1, std::memory_order_relaxed);
+        return std::optional<std::reference_wrapper<const Polygons>>{};
     }
+    storage.hits[shard].value.fetch_add(1, std::memory_order_relaxed);
+    // Only write the shared cache line once per epoch.
+    std::atomic<uint32_t> &last_used = storage.radius_info(radius_idx).last_used;
+    if (const uint32_t epoch = storage.epoch.load(std::memory_order_relaxed); last_used.load(std::memory_order_relaxed) != epoch)
+        last_used.store(epoch, std::memory_order_relaxed);
+    return std::optional<std::reference_wrapper<const Polygons>>{ entry->polygons };
+}
+
+std::optional<std::pair<coord_t, std::reference_wrapper<const Polygons>>> TreeModelVolumes::RadiusLayerPolygonCache::get_lower_bound_area(const TreeModelVolumes::RadiusLayerPair &key) const
+{
+    const Storage              &storage = *m_storage;
+    const Storage::SortedRadii &radii   = storage.sorted();
+    // The largest radius not above the key radius, which has an area at the layer.
+    for (auto it = std::upper_bound(radii.begin(), radii.end(), key.first, [](coord_t r, const std::pair<coord_t, size_t> &l) { return r < l.first; });
+         it != radii.begin();) {
+        -- it;
+        if (const Storage::Entry *entry = storage.find(it->second, key.second); entry)
+            return std::make_pair(it->first, std::reference_wrapper<const Polygons>(entry->polygons));
+    }
+    return {};
+}
+
+LayerIndex TreeModelVolumes::RadiusLayerPolygonCache::getMaxCalculatedLayer(coord_t radius) const
+{
+    const int        radius_idx = m_storage->find_radius(radius);
+    const LayerIndex layer_idx  = radius_idx == -1 ? -1 : m_storage->radius_info(radius_idx).max_layer.load(std::memory_order_relaxed);
+    // The placeable on model areas do not exist on layer 0, as there can not be model below it. As such it may be possible that layer 1 is available, but layer 0 does not exist.
+    return layer_idx <= 0 ? -1 : layer_idx;
 }
 
 // For debugging purposes, sorted by layer index, then by radius.
 std::vector<std::pair<TreeModelVolumes::RadiusLayerPair, std::reference_wrapper<const Polygons>>> TreeModelVolumes::RadiusLayerPolygonCache::sorted() const
 {
     std::vector<std::pair<RadiusLayerPair, std::reference_wrapper<const Polygons>>> out;
-    for (auto &layer : m_data) {
-        auto layer_idx = LayerIndex(&layer - m_data.data());
-        for (auto &radius_polygons : layer)
-            out.emplace_back(std::make_pair(radius_polygons.first, layer_idx), radius_polygons.second);
+    const Storage &storage = *m_storage;
+    const size_t   n       = storage.num_radii.load(std::memory_order_acquire);
+    storage.for_each_layer([&storage, &out, n](LayerIndex layer_idx, const Storage::Layer &layer) {
+        const size_t first = out.size();
+        for (size_t i = 0; i < n; ++ i)
+            if (const std::atomic<Storage::Entry*> *slot = storage.slot(layer, i); slot)
+                if (const Storage::Entry *entry = slot->load(std::memory_order_acquire); entry)
+                    out.emplace_back(std::make_pair(storage.radius_info(i).radius.load(std::memory_order_relaxed), layer_idx), entry->polygons);
+        std::sort(out.begin() + first, out.end(), [](auto &l, auto &r) { return l.first.first < r.first.first; });
+    });
+    return out;
+}
+
+void TreeModelVolumes::RadiusLayerPolygonCache::clear()
+{
+    m_storage->clear();
+}
+
+void TreeModelVolumes::RadiusLayerPolygonCache::clear_all_but_radius0()
+{
+    // Keep the smallest radius of each layer.
+    Storage     &storage = *m_storage;
+    const size_t n       = storage.num_radii.load(std::memory_order_relaxed);
+    storage.for_each_layer([&storage, n](LayerIndex layer_idx, Storage::Layer &layer) {
+        int smallest = -1;
+        for (size_t i = 0; i < n; ++ i)
+            if (const Storage::Entry *entry = storage.find(i, layer_idx); entry &&
+                (smallest == -1 || storage.radius_info(i).radius.load(std::memory_order_relaxed) < storage.radius_info(smallest).radius.load(std::memory_order_relaxed)))
+                smallest = int(i);
+        for (size_t i = 0; i < n; ++ i)
+            if (int(i) != smallest)
+                if (std::atomic<Storage::Entry*> *slot = storage.slot(layer, i); slot)
+                    storage.release(*slot);
+    });
+    for (size_t i = 0; i < n; ++ i)
+        storage.update_max_layer(i);
+}
+
+TreeModelVolumes::CacheStatistics TreeModelVolumes::RadiusLayerPolygonCache::statistics() const
+{
+    const Storage  &storage = *m_storage;
+    CacheStatistics out;
+    out.hits           = Storage::sum(storage.hits);
+    out.misses         = Storage::sum(storage.misses);
+    out.resident_bytes = storage.resident_bytes.load(std::memory_order_relaxed);
+    out.evicted_bytes  = storage.evicted_bytes;
+    out.evicted_areas  = storage.evicted_areas;
+    return out;
+}
+
+void     TreeModelVolumes::RadiusLayerPolygonCache::next_epoch() { m_storage->epoch.fetch_add(1, std::memory_order_relaxed); }
+uint32_t TreeModelVolumes::RadiusLayerPolygonCache::epoch() const { return m_storage->epoch.load(std::memory_order_relaxed); }
+size_t   TreeModelVolumes::RadiusLayerPolygonCache::num_radii() const { return m_storage->num_radii.load(std::memory_order_acquire); }
+uint32_t TreeModelVolumes::RadiusLayerPolygonCache::radius_last_used(size_t radius_idx) const { return m_storage->radius_info(radius_idx).last_used.load(std::memory_order_relaxed); }
+
+size_t TreeModelVolumes::RadiusLayerPolygonCache::radius_bytes_above(size_t radius_idx, LayerIndex layer_idx) const
+{
+    const Storage &storage = *m_storage;
+    size_t         out     = 0;
+    for (LayerIndex i = storage.radius_info(radius_idx).max_layer.load(std::memory_order_relaxed); i > layer_idx; -- i)
+        if (const Storage::Entry *entry = storage.find(radius_idx, i); entry)
+            out += entry->bytes;
+    return out;
+}
+
+size_t TreeModelVolumes::RadiusLayerPolygonCache::evict(size_t radius_idx, LayerIndex layer_idx)
+{
+    Storage &storage = *m_storage;
+    size_t   out     = 0;
+    for (LayerIndex i = storage.radius_info(radius_idx).max_layer.load(std::memory_order_relaxed); i > layer_idx; -- i)
+        if (const Storage::Layer *layer = storage.layer(i); layer)
+            if (std::atomic<Storage::Entry*> *slot = storage.slot(*layer, radius_idx); slot)
+                if (size_t bytes = storage.release(*slot); bytes > 0) {
+                    out += bytes;
+                    ++ storage.evicted_areas;
+                }
+    storage.evicted_bytes += out;
+    storage.update_max_layer(radius_idx);
+    return out;
+}
+
+TreeModelVolumes::CacheStatistics TreeModelVolumes::cache_statistics() const
+{
+    CacheStatistics out;
+    for (const RadiusLayerPolygonCache *cache : {
+            &m_collision_cache, &m_collision_cache_holefree,
+            &m_avoidance_cache, &m_avoidance_cache_slow, &m_avoidance_cache_to_model, &m_avoidance_cache_to_model_slow,
+            &m_placeable_areas_cache, &m_avoidance_cache_holefree, &m_avoidance_cache_holefree_to_model,
+            &m_wall_restrictions_cache, &m_wall_restrictions_cache_min }) {
+        CacheStatistics stats = cache->statistics();
+        out.hits           += stats.hits;
+        out.misses         += stats.misses;
+        out.resident_bytes += stats.resident_bytes;
+        out.evicted_bytes  += stats.evicted_bytes;
+        out.evicted_areas  += stats.evicted_areas;
     }
-    assert(std::is_sorted(out.begin(), out.end(), [](auto &l, auto &r){ return l.first.second < r.first.second || (l.first.second == r.first.second) && l.first.first < r.first.first; }));
+    out.peak_bytes = std::max(m_cache_peak_bytes, out.resident_bytes);
     return out;
 }
 
+void TreeModelVolumes::enforce_cache_memory_budget(LayerIndex layer_idx)
+{
+    // Caches recalculated on demand from the collision cache. The collision and placeable areas are kept,
+    // as they are not recalculated once they are evicted.
+    RadiusLayerPolygonCache *evictable[] = {
+        &m_collision_cache_holefree,
+        &m_avoidance_cache, &m_avoidance_cache_slow, &m_avoidance_cache_to_model, &m_avoidance_cache_to_model_slow,
+        &m_avoidance_cache_holefree, &m_avoidance_cache_holefree_to_model,
+        &m_wall_restrictions_cache, &m_wall_restrictions_cache_min
+    };
+
+    size_t resident = this->cache_statistics().resident_bytes;
+    m_cache_peak_bytes = std::max(m_cache_peak_bytes, resident);
+    if (m_cache_memory_budget > 0 && resident > m_cache_memory_budget) {
+        // Collect the radii not used during the current epoch, evict the least recently used ones first.
+        struct ColdRadius {
+            RadiusLayerPolygonCache *cache;
+            size_t                   radius_idx;
+            uint32_t                 last_used;
+            size_t                   bytes;
+        };
+        std::vector<ColdRadius> cold;
+        for (RadiusLayerPolygonCache *cache : evictable)
+            for (size_t i = 0; i < cache->num_radii(); ++ i)
+                if (uint32_t last_used = cache->radius_last_used(i); last_used != cache->epoch())
+                    if (size_t bytes = cache->radius_bytes_above(i, layer_idx); bytes > 0)
+                        cold.push_back({ cache, i, last_used, bytes });
+        std::sort(cold.begin(), cold.end(), [](const ColdRadius &l, const ColdRadius &r) {
+            return l.last_used < r.last_used || (l.last_used == r.last_used && l.bytes > r.bytes);
+        });
+        size_t released = 0;
+        for (const ColdRadius &c : cold) {
+            released += c.cache->evict(c.radius_idx, layer_idx);
+            if (resident - released <= m_cache_memory_budget)
+                break;
+        }
+        BOOST_LOG_TRIVIAL(debug) << "Tree support cache over budget at layer " << layer_idx << ", released " << released << " of " << resident << " bytes";
+    }
+
+    for (RadiusLayerPolygonCache *cache : evictable)
+        cache->next_epoch();
+}
+
 } // namespace Slic3r::TreeSupport3D
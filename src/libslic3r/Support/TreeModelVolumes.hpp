@@ -9,7 +9,9 @@
 #ifndef slic3r_TreeModelVolumes_hpp
 #define slic3r_TreeModelVolumes_hpp
 
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <unordered_map>
 
 #include <boost/functional/hash.hpp>
@@ -70,6 +72,29 @@ public:
         m_wall_restrictions_cache_min.clear();
     }
 
+    // Total of the statistics of the polygon caches, see RadiusLayerPolygonCache.
+    struct CacheStatistics {
+        size_t hits           { 0 };
+        size_t misses         { 0 };
+        size_t resident_bytes { 0 };
+        // Highest resident_bytes seen by enforce_cache_memory_budget().
+        size_t peak_bytes     { 0 };
+        size_t evicted_bytes  { 0 };
+        size_t evicted_areas  { 0 };
+
+        double hit_rate() const { return hits + misses == 0 ? 0. : double(hits) / double(hits + misses); }
+    };
+    CacheStatistics cache_statistics() const;
+
+    // Limit of the memory held by the polygon caches, zero for no limit. By default half of the physical memory.
+    void   set_cache_memory_budget(size_t bytes) { m_cache_memory_budget = bytes; }
+    size_t cache_memory_budget() const { return m_cache_memory_budget; }
+    // If the caches exceed the memory budget, release the cached areas above layer_idx of the radii not used
+    // since the previous call, least recently used first. Released areas are recalculated on demand.
+    // To be called between the layers of the top down propagation of the tree branches, as it is not thread safe
+    // and it invalidates the references to the cached areas.
+    void   enforce_cache_memory_budget(LayerIndex layer_idx);
+
     enum class AvoidanceType : int8_t
     {
         Slow,
@@ -197,74 +222,47 @@ private:
      * \brief Convenience typedef for the keys to the caches
      */
     using RadiusLayerPair             = std::pair<coord_t, LayerIndex>;
+    // Cache of polygons indexed by a radius and a layer index.
+    // Lookups are lock free: Once a polygon set is published for a radius and a layer, it is never modified,
+    // and a reference to it stays valid until the cache is cleared or the entry is evicted.
+    // Layers are stored in lazily allocated chunks, each layer holds a flat table of radius slots indexed by the order
+    // of first insertion of a radius. Inserting an already present key keeps the existing polygons.
     class RadiusLayerPolygonCache {
-        // Map from radius to Polygons. Cache of one layer collision regions.
-        using LayerData = std::map<coord_t, Polygons>;
-        // Vector of layers, at each layer map of radius to Polygons.
-        // Reference to Polygons returned shall be stable to insertion.
-        using Layers = std::vector<LayerData>;
     public:
-        RadiusLayerPolygonCache() = default;
-        RadiusLayerPolygonCache(RadiusLayerPolygonCache &&rhs) : m_data(std::move(rhs.m_data)) {}
-        RadiusLayerPolygonCache& operator=(RadiusLayerPolygonCache &&rhs) { m_data = std::move(rhs.m_data); return *this; }
+        RadiusLayerPolygonCache();
+        ~RadiusLayerPolygonCache();
+        RadiusLayerPolygonCache(RadiusLayerPolygonCache &&rhs);
+        RadiusLayerPolygonCache& operator=(RadiusLayerPolygonCache &&rhs);
 
         RadiusLayerPolygonCache(const RadiusLayerPolygonCache&) = delete;
         RadiusLayerPolygonCache& operator=(const RadiusLayerPolygonCache&) = delete;
 
         void insert(std::vector<std::pair<RadiusLayerPair, Polygons>> &&in) {
-            std::lock_guard<std::mutex> guard(m_mutex);
             for (auto &d : in)
-                this->get_allocate_layer_data(d.first.second).emplace(d.first.first, std::move(d.second));
+                this->emplace(d.first.first, d.first.second, std::move(d.second));
         }
         // by layer
         void insert(std::vector<std::pair<coord_t, Polygons>> &&in, coord_t radius) {
-            std::lock_guard<std::mutex> guard(m_mutex);
             for (auto &d : in)
-                this->get_allocate_layer_data(d.first).emplace(radius, std::move(d.second));
+                this->emplace(radius, LayerIndex(d.first), std::move(d.second));
         }
         void insert(std::vector<Polygons> &&in, coord_t first_layer_idx, coord_t radius) {
-            std::lock_guard<std::mutex> guard(m_mutex);
-            allocate_layers(first_layer_idx + in.size());
             for (auto &d : in)
-                m_data[first_layer_idx ++].emplace(radius, std::move(d));
+                this->emplace(radius, LayerIndex(first_layer_idx ++), std::move(d));
         }
         void insert(LayerPolygonCache &&in, coord_t radius) {
-            std::lock_guard<std::mutex> guard(m_mutex);
             LayerIndex i = in.begin();
-            allocate_layers(i + LayerIndex(in.size()));
             for (auto &d : in.polygons_mutable())
-                m_data[i ++].emplace(radius, std::move(d));
+                this->emplace(radius, i ++, std::move(d));
         }
         /*!
          * \brief Checks a cache for a given RadiusLayerPair and returns it if it is found
          * \param key RadiusLayerPair of the requested areas. The radius will be calculated up to the provided layer.
          * \return A wrapped optional reference of the requested area (if it was found, an empty optional if nothing was found)
          */
-        std::optional<std::reference_wrapper<const Polygons>> getArea(const TreeModelVolumes::RadiusLayerPair &key) const {
-            std::lock_guard<std::mutex> guard(m_mutex);
-            if (key.second >= LayerIndex(m_data.size()))
-                return std::optional<std::reference_wrapper<const Polygons>>{};
-            const auto &layer = m_data[key.second];
-            auto it = layer.find(key.first);
-            return it == layer.end() ? 
-                std::optional<std::reference_wrapper<const Polygons>>{} : std::optional<std::reference_wrapper<const Polygons>>{ it->second };
-        }
+        std::optional<std::reference_wrapper<const Polygons>> getArea(const TreeModelVolumes::RadiusLayerPair &key) const;
         // Get a collision area at a given layer for a radius that is a lower or equial to the key radius.
-        std::optional<std::pair<coord_t, std::reference_wrapper<const Polygons>>> get_lower_bound_area(const TreeModelVolumes::RadiusLayerPair &key) const {
-            std::lock_guard<std::mutex> guard(m_mutex);
-            if (key.second >= LayerIndex(m_data.size()))
-                return {};
-            const auto &layer = m_data[key.second];
-            if (layer.empty())
-                return {};
-            auto it = layer.lower_bound(key.first);
-            if (it == layer.end() || it->first != key.first) {
-                if (it == layer.begin())
-                    return {};
-                -- it;
-            }
-            return std::make_pair(it->first, std::reference_wrapper<const Polygons>(it->second));
-        }
+        std::optional<std::pair<coord_t, std::reference_wrapper<const Polygons>>> get_lower_bound_area(const TreeModelVolumes::RadiusLayerPair &key) const;
         /*!
          * \brief Get the highest already calculated layer in the cache.
          * \param radius The radius for which the highest already calculated layer has to be found.
@@ -272,40 +270,40 @@ private:
          *
          * \return A wrapped optional reference of the requested area (if it was found, an empty optional if nothing was found)
          */
-        LayerIndex getMaxCalculatedLayer(coord_t radius) const {
-            std::lock_guard<std::mutex> guard(m_mutex);
-            auto layer_idx = LayerIndex(m_data.size()) - 1;
-            for (; layer_idx > 0; -- layer_idx)
-                if (const auto &layer = m_data[layer_idx]; layer.find(radius) != layer.end())
-                    break;
-            // The placeable on model areas do not exist on layer 0, as there can not be model below it. As such it may be possible that layer 1 is available, but layer 0 does not exist.
-            return layer_idx == 0 ? -1 : layer_idx;
-        }
+        LayerIndex getMaxCalculatedLayer(coord_t radius) const;
 
         // For debugging purposes, sorted by layer index, then by radius.
         [[nodiscard]] std::vector<std::pair<RadiusLayerPair, std::reference_wrapper<const Polygons>>> sorted() const;
 
-        void clear() { m_data.clear(); }
-        void clear_all_but_radius0() { 
-            for (LayerData &l : m_data) {
-                auto begin = l.begin();
-                auto end = l.end();
-                if (begin != end && ++ begin != end)
-                    l.erase(begin, end);
-            }
-        }
+        // Neither clear() nor the eviction methods below are thread safe: They shall not be called concurrently
+        // with any other access to the cache, as they invalidate the references returned by the cache.
+        void clear();
+        void clear_all_but_radius0();
+
+        // Hits, misses and memory of this cache, peak_bytes is not filled in.
+        CacheStatistics statistics() const;
+
+        // Radii are tracked for their last use in terms of epochs, a new epoch is started by next_epoch().
+        void            next_epoch();
+        uint32_t        epoch() const;
+        size_t          num_radii() const;
+        // Epoch of the last getArea() hit of the idx-th radius.
+        uint32_t        radius_last_used(size_t radius_idx) const;
+        // Memory held by the areas of the idx-th radius above a given layer.
+        size_t          radius_bytes_above(size_t radius_idx, LayerIndex layer_idx) const;
+        // Release the areas of the idx-th radius above a given layer, returns the memory released.
+        // The areas are recalculated on demand, as getMaxCalculatedLayer() drops below the released layers.
+        size_t          evict(size_t radius_idx, LayerIndex layer_idx);
 
     private:
-        LayerData&          get_allocate_layer_data(LayerIndex layer_idx) {
-            allocate_layers(layer_idx + 1);
-            return m_data[layer_idx];
-        }
-        void                allocate_layers(size_t num_layers);
+        struct Storage;
+        void            emplace(coord_t radius, LayerIndex layer_idx, Polygons &&polygons);
 
-        Layers              m_data;
-        mutable std::mutex  m_mutex;
+        std::unique_ptr<Storage> m_storage;
     };
 
+    // Unit tests access the polygon caches.
+    friend struct TreeModelVolumesTest;
 
     /*!
      * \brief Provides the areas that have to be avoided by the tree's branches to prevent collision with the model on this layer. Holes are removed.
@@ -545,6 +543,9 @@ private:
     // restriction would be slower.    
     RadiusLayerPolygonCache     m_wall_restrictions_cache_min;
 
+    size_t                      m_cache_memory_budget { 0 };
+    size_t                      m_cache_peak_bytes { 0 };
+
 #ifdef SLIC3R_TREESUPPORTS_PROGRESS
     std::unique_ptr<std::mutex> m_critical_progress { std::make_unique<std::mutex>() };
 #endif // SLIC3R_TREESUPPORTS_PROGRESS
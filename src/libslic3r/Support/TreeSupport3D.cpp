@@ -2447,7 +2447,7 @@ static void merge_influence_areas(
  *
  * \param move_bounds[in,out] All currently existing influence areas
  */
-static void create_layer_pathing(const TreeModelVolumes &volumes, const TreeSupportSettings &config, std::vector<SupportElements> &move_bounds, std::function<void()> throw_on_cancel)
+static void create_layer_pathing(TreeModelVolumes &volumes, const TreeSupportSettings &config, std::vector<SupportElements> &move_bounds, std::function<void()> throw_on_cancel)
 {
 #ifdef SLIC3R_TREESUPPORTS_PROGRESS
     const double data_size_inverse = 1 / double(move_bounds.size());
@@ -2468,6 +2468,8 @@ static void create_layer_pathing(const TreeModelVolumes &volumes, const TreeSupp
     // This is done by first increasing the influence area by the allowed movement distance, and merging them with other influence areas if possible
     for (int layer_idx = int(move_bounds.size()) - 1; layer_idx > 0; -- layer_idx)
         if (SupportElements &prev_layer = move_bounds[layer_idx]; ! prev_layer.empty()) {
+            // The layers above are done, release the cached areas there if the caches grew too large.
+            volumes.enforce_cache_memory_budget(layer_idx);
             // merging is expensive and only parallelized to a max speedup of 2. As such it may be useful in some cases to only merge every few layers to improve performance.
             bool had_new_element = new_element;
             const bool merge_this_layer = had_new_element || size_t(last_merge_layer_idx - layer_idx) >= merge_every_x_layers;
@@ -3530,6 +3532,12 @@ static void generate_support_areas(Print &print, TreeSupport* tree_support, cons
                 "Influence area creation: " << dur_path << "ms "
                 "Placement of Points in InfluenceAreas: " << dur_place << "ms "
                 "Drawing result as support " << dur_draw << " ms";
+            {
+                const TreeModelVolumes::CacheStatistics stats = volumes.cache_statistics();
+                BOOST_LOG_TRIVIAL(info) << "Tree support caches: hit rate " << 100. * stats.hit_rate() << "% of " << stats.hits + stats.misses << " lookups, "
+                    "resident " << stats.resident_bytes / (1024 * 1024) << " MB, peak " << stats.peak_bytes / (1024 * 1024) << " MB, "
+                    "evicted " << stats.evicted_areas << " areas, " << stats.evicted_bytes / (1024 * 1024) << " MB";
+            }
     //        if (config.branch_radius==2121)
     //            BOOST_LOG_TRIVIAL(error) << "Why ask questions when you already know the answer twice.\n (This is not a real bug, please dont report it.)";
             
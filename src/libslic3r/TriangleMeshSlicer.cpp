@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <deque>
 #include <queue>
 #include <mutex>
@@ -16,7 +17,10 @@
 
 #include <boost/log/trivial.hpp>
 
+#include <ankerl/unordered_dense.h>
+
 #include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 
 #ifndef NDEBUG
 //    #define EXPENSIVE_DEBUG_CHECKS
@@ -472,62 +476,145 @@ static FacetSliceType slice_facet_for_cut_mesh(
     return FacetSliceType::NoSlice;
 }
 
-template<typename TransformVertex>
-void slice_facet_at_zs(
-    // Scaled or unscaled vertices. transform_vertex_fn may scale zs.
-    const std::vector<Vec3f>                         &mesh_vertices,
-    const TransformVertex                            &transform_vertex_fn,
-    const stl_triangle_vertex_indices                &indices,
-    const Vec3i32                                      &edge_ids,
-    // Scaled or unscaled zs. If vertices have their zs scaled or transform_vertex_fn scales them, then zs have to be scaled as well.
-    const std::vector<float>                         &zs,
-    std::vector<IntersectionLines>                   &lines,
-    std::array<std::mutex, 64>                       &lines_mutex)
-{
-    stl_vertex vertices[3] { transform_vertex_fn(mesh_vertices[indices(0)]), transform_vertex_fn(mesh_vertices[indices(1)]), transform_vertex_fn(mesh_vertices[indices(2)]) };
-
-    // find facet extents
-    const float min_z = fminf(vertices[0].z(), fminf(vertices[1].z(), vertices[2].z()));
-    const float max_z = fmaxf(vertices[0].z(), fmaxf(vertices[1].z(), vertices[2].z()));
-
-    // find layer extents
-    auto min_layer = std::lower_bound(zs.begin(), zs.end(), min_z); // first layer whose slice_z is >= min_z
-    auto max_layer = std::upper_bound(min_layer, zs.end(), max_z); // first layer whose slice_z is > max_z
-    int  idx_vertex_lowest = (vertices[1].z() == min_z) ? 1 : ((vertices[2].z() == min_z) ? 2 : 0);
-
-    for (auto it = min_layer; it != max_layer; ++ it) {
-        IntersectionLine il;
-        // Ignore horizontal triangles. Any valid horizontal triangle must have a vertical triangle connected, otherwise the part has zero volume.
-        if (min_z != max_z && slice_facet(*it, vertices, indices, edge_ids, idx_vertex_lowest, false, il) == FacetSliceType::Slicing) {
-            assert(il.edge_type != IntersectionLine::FacetEdgeType::Horizontal);
-            size_t slice_id = it - zs.begin();
-            boost::lock_guard<std::mutex> l(lines_mutex[slice_id % lines_mutex.size()]);
-            lines[slice_id].emplace_back(il);
-        }
-    }
-}
-
+// Slicing a mesh with many planes: The facets are distributed into bands of consecutive layers by their Z extent
+// and the bands are sliced in parallel. Each band owns the IntersectionLines of its layers, thus no locking is needed.
+//
+// Instead of the mesh edge identifiers calculated by its_face_edge_ids() for the whole mesh, the intersection points
+// are identified by the sorted pair of indices of the vertices of the intersected edge. Once a band is sliced,
+// the vertex pairs crossed by each layer are mapped to edge identifiers unique to that layer, which is sufficient
+// for chaining the lines of a layer into loops by make_loops().
 template<typename TransformVertex, typename ThrowOnCancel>
 static inline std::vector<IntersectionLines> slice_make_lines(
     const std::vector<stl_vertex>                   &vertices,
     const TransformVertex                           &transform_vertex_fn,
     const std::vector<stl_triangle_vertex_indices>  &indices,
-    const std::vector<Vec3i32>                        &face_edge_ids,
     const std::vector<float>                        &zs,
     const ThrowOnCancel                              throw_on_cancel_fn)
 {
-    std::vector<IntersectionLines>  lines(zs.size(), IntersectionLines());
-    std::array<std::mutex, 64>      lines_mutex;
-    tbb::parallel_for(
-        tbb::blocked_range<int>(0, int(indices.size())),
-        [&vertices, &transform_vertex_fn, &indices, &face_edge_ids, &zs, &lines, &lines_mutex, throw_on_cancel_fn](const tbb::blocked_range<int> &range) {
-            for (int face_idx = range.begin(); face_idx < range.end(); ++ face_idx) {
-                if ((face_idx & 0x0ffff) == 0)
-                    throw_on_cancel_fn();
-                slice_facet_at_zs(vertices, transform_vertex_fn, indices[face_idx], face_edge_ids[face_idx], zs, lines, lines_mutex);
+    std::vector<IntersectionLines> lines(zs.size(), IntersectionLines());
+    if (zs.empty() || indices.empty())
+        return lines;
+
+    // Range of layers [first, last) sliced by each facet, empty for horizontal facets and for facets outside of zs.
+    struct FacetLayers {
+        int first;
+        int last;
+    };
+    std::vector<FacetLayers> facet_layers(indices.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, indices.size()),
+        [&vertices, &transform_vertex_fn, &indices, &zs, &facet_layers, throw_on_cancel_fn](const tbb::blocked_range<size_t> &range) {
+            throw_on_cancel_fn();
+            for (size_t face_idx = range.begin(); face_idx < range.end(); ++ face_idx) {
+                const stl_triangle_vertex_indices &face = indices[face_idx];
+                const float z0    = transform_vertex_fn(vertices[face(0)]).z();
+                const float z1    = transform_vertex_fn(vertices[face(1)]).z();
+                const float z2    = transform_vertex_fn(vertices[face(2)]).z();
+                const float min_z = fminf(z0, fminf(z1, z2));
+                const float max_z = fmaxf(z0, fmaxf(z1, z2));
+                FacetLayers &out = facet_layers[face_idx];
+                // Ignore horizontal triangles. Any valid horizontal triangle must have a vertical triangle connected, otherwise the part has zero volume.
+                if (min_z == max_z) {
+                    out.first = out.last = 0;
+                } else {
+                    auto min_layer = std::lower_bound(zs.begin(), zs.end(), min_z); // first layer whose slice_z is >= min_z
+                    auto max_layer = std::upper_bound(min_layer, zs.end(), max_z);  // first layer whose slice_z is > max_z
+                    out.first = int(min_layer - zs.begin());
+                    out.last  = int(max_layer - zs.begin());
+                }
             }
-        }
-    );
+        });
+
+    // Split the layers into bands, several bands per thread to balance the load.
+    const size_t     num_bands = std::min(zs.size(), size_t(tbb::this_task_arena::max_concurrency()) * 8);
+    std::vector<int> band_first_layer(num_bands + 1);
+    for (size_t band_idx = 0; band_idx <= num_bands; ++ band_idx)
+        band_first_layer[band_idx] = int(band_idx * zs.size() / num_bands);
+    std::vector<int> layer_band(zs.size());
+    for (size_t band_idx = 0; band_idx < num_bands; ++ band_idx)
+        std::fill(layer_band.begin() + band_first_layer[band_idx], layer_band.begin() + band_first_layer[band_idx + 1], int(band_idx));
+
+    // Bucket the facets into the bands they intersect, in the order of the facets.
+    std::vector<size_t> band_facets_begin(num_bands + 1, 0);
+    for (const FacetLayers &fl : facet_layers)
+        if (fl.first < fl.last)
+            for (int band_idx = layer_band[fl.first]; band_idx <= layer_band[fl.last - 1]; ++ band_idx)
+                ++ band_facets_begin[band_idx + 1];
+    for (size_t band_idx = 0; band_idx < num_bands; ++ band_idx)
+        band_facets_begin[band_idx + 1] += band_facets_begin[band_idx];
+    std::vector<int> band_facets(band_facets_begin.back());
+    {
+        std::vector<size_t> band_facets_end(band_facets_begin.begin(), band_facets_begin.end() - 1);
+        for (int face_idx = 0; face_idx < int(facet_layers.size()); ++ face_idx)
+            if (const FacetLayers &fl = facet_layers[face_idx]; fl.first < fl.last)
+                for (int band_idx = layer_band[fl.first]; band_idx <= layer_band[fl.last - 1]; ++ band_idx)
+                    band_facets[band_facets_end[band_idx] ++] = face_idx;
+    }
+
+    throw_on_cancel_fn();
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, num_bands, 1),
+        [&vertices, &transform_vertex_fn, &indices, &zs, &facet_layers, &band_first_layer, &band_facets_begin, &band_facets, &lines, throw_on_cancel_fn]
+        (const tbb::blocked_range<size_t> &range) {
+            std::vector<size_t>                         layer_lines;
+            ankerl::unordered_dense::map<uint64_t, int> layer_edge_ids;
+            for (size_t band_idx = range.begin(); band_idx < range.end(); ++ band_idx) {
+                const int band_begin = band_first_layer[band_idx];
+                const int band_end   = band_first_layer[band_idx + 1];
+                auto      it_begin   = band_facets.begin() + band_facets_begin[band_idx];
+                auto      it_end     = band_facets.begin() + band_facets_begin[band_idx + 1];
+                // Each facet produces at most one line per layer.
+                layer_lines.assign(band_end - band_begin, 0);
+                for (auto it = it_begin; it != it_end; ++ it) {
+                    const FacetLayers &fl = facet_layers[*it];
+                    for (int layer_idx = std::max(fl.first, band_begin); layer_idx < std::min(fl.last, band_end); ++ layer_idx)
+                        ++ layer_lines[layer_idx - band_begin];
+                }
+                for (int layer_idx = band_begin; layer_idx < band_end; ++ layer_idx)
+                    lines[layer_idx].reserve(layer_lines[layer_idx - band_begin]);
+                for (auto it = it_begin; it != it_end; ++ it) {
+                    if (((it - it_begin) & 0x0ffff) == 0)
+                        throw_on_cancel_fn();
+                    const int                          face_idx = *it;
+                    const stl_triangle_vertex_indices &face     = indices[face_idx];
+                    const stl_vertex  facet_vertices[3] { transform_vertex_fn(vertices[face(0)]), transform_vertex_fn(vertices[face(1)]), transform_vertex_fn(vertices[face(2)]) };
+                    const float       min_z             = fminf(facet_vertices[0].z(), fminf(facet_vertices[1].z(), facet_vertices[2].z()));
+                    const int         idx_vertex_lowest = (facet_vertices[1].z() == min_z) ? 1 : ((facet_vertices[2].z() == min_z) ? 2 : 0);
+                    const FacetLayers &fl               = facet_layers[face_idx];
+                    for (int layer_idx = std::max(fl.first, band_begin); layer_idx < std::min(fl.last, band_end); ++ layer_idx) {
+                        IntersectionLine il;
+                        // Pass the indices of the facet edges as edge IDs.
+                        if (slice_facet(zs[layer_idx], facet_vertices, face, Vec3i32(0, 1, 2), idx_vertex_lowest, false, il) == FacetSliceType::Slicing) {
+                            assert(il.edge_type != IntersectionLine::FacetEdgeType::Horizontal);
+                            // Until the edges of the layer are numbered, an end point on a mesh edge stores the lower vertex index
+                            // of the edge in edge_{a,b}_id and the higher vertex index in {a,b}_id.
+                            if (il.edge_a_id != -1) {
+                                assert(il.a_id == -1);
+                                std::tie(il.edge_a_id, il.a_id) = std::minmax(face(il.edge_a_id), face((il.edge_a_id + 1) % 3));
+                            }
+                            if (il.edge_b_id != -1) {
+                                assert(il.b_id == -1);
+                                std::tie(il.edge_b_id, il.b_id) = std::minmax(face(il.edge_b_id), face((il.edge_b_id + 1) % 3));
+                            }
+                            lines[layer_idx].emplace_back(il);
+                        }
+                    }
+                }
+                // Number the mesh edges crossed by each layer.
+                for (int layer_idx = band_begin; layer_idx < band_end; ++ layer_idx) {
+                    layer_edge_ids.clear();
+                    auto edge_id = [&layer_edge_ids](int &vertex_low, int &vertex_high) {
+                        if (vertex_low != -1) {
+                            vertex_low  = layer_edge_ids.try_emplace((uint64_t(vertex_low) << 32) | uint64_t(vertex_high), int(layer_edge_ids.size())).first->second;
+                            vertex_high = -1;
+                        }
+                    };
+                    for (IntersectionLine &il : lines[layer_idx]) {
+                        edge_id(il.edge_a_id, il.a_id);
+                        edge_id(il.edge_b_id, il.b_id);
+                    }
+                }
+            }
+        });
     return lines;
 }
 
@@ -1873,27 +1960,22 @@ std::vector<Polygons> slice_mesh(
     std::vector<IntersectionLines> lines;
 
     {
-        //FIXME facets_edges is likely not needed and quite costly to calculate.
-        // Instead of edge identifiers, one shall use a sorted pair of edge vertex indices.
-        // However facets_edges assigns a single edge ID to two triangles only, thus when factoring facets_edges out, one will have
-        // to make sure that no code relies on it.
-        std::vector<Vec3i32> face_edge_ids = its_face_edge_ids(mesh);
         if (zs.size() <= 1) {
             // It likely is not worthwile to copy the vertices. Apply the transformation in place.
             if (is_identity(params.trafo)) {
                 lines = slice_make_lines(
                     mesh.vertices, [](const Vec3f &p) { return Vec3f(scaled<float>(p.x()), scaled<float>(p.y()), p.z()); }, 
-                    mesh.indices, face_edge_ids, zs, throw_on_cancel);
+                    mesh.indices, zs, throw_on_cancel);
             } else {
                 // Transform the vertices, scale up in XY, not in Z.
                 Transform3f tf = make_trafo_for_slicing(params.trafo);
-                lines = slice_make_lines(mesh.vertices, [tf](const Vec3f &p) { return tf * p; }, mesh.indices, face_edge_ids, zs, throw_on_cancel);
+                lines = slice_make_lines(mesh.vertices, [tf](const Vec3f &p) { return tf * p; }, mesh.indices, zs, throw_on_cancel);
             }
         } else {
             // Copy and scale vertices in XY, don't scale in Z. Possibly apply the transformation.
             lines = slice_make_lines(
                 transform_mesh_vertices_for_slicing(mesh, params.trafo), 
-                [](const Vec3f &p) { return p; },  mesh.indices, face_edge_ids, zs, throw_on_cancel);
+                [](const Vec3f &p) { return p; },  mesh.indices, zs, throw_on_cancel);
         }
     }
 
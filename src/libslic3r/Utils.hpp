@@ -212,6 +212,10 @@ extern std::vector<std::string> split_string(const std::string &str, char delimi
 // for a short while, so the file may not be movable. Retry while we see recoverable errors.
 extern std::error_code rename_file(const std::string &from, const std::string &to);
 
+// Is the file or directory on a network share or on a removable drive, where writing is slow?
+// The path does not need to exist, its nearest existing parent directory is checked then.
+extern bool is_on_slow_filesystem(const std::string &path);
+
 enum CopyFileResult {
 	SUCCESS = 0,
 	FAIL_COPY_FILE,
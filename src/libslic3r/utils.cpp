@@ -36,11 +36,15 @@
 	#endif
 	#ifdef __linux__
 		#include <sys/stat.h>
+		#include <sys/vfs.h>
 		#include <fcntl.h>
 		#include <sys/sendfile.h>
 		#include <dirent.h>
 		#include <stdio.h>
 	#endif
+	#ifdef __APPLE__
+		#include <sys/mount.h>
+	#endif
 #endif
 
 #include <boost/log/core.hpp>
@@ -632,6 +636,44 @@ std::error_code rename_file(const std::string &from, const std::string &to)
 #endif
 }
 
+bool is_on_slow_filesystem(const std::string &path)
+{
+    boost::system::error_code ec;
+    boost::filesystem::path   p(path);
+    while (! p.empty() && ! boost::filesystem::exists(p, ec))
+        p = p.parent_path();
+    if (p.empty())
+        return false;
+#ifdef _WIN32
+    boost::filesystem::path root = boost::filesystem::absolute(p, ec).root_path();
+    if (ec || root.empty())
+        return false;
+    const UINT drive_type = ::GetDriveTypeW(root.wstring().c_str());
+    return drive_type == DRIVE_REMOTE || drive_type == DRIVE_REMOVABLE;
+#elif defined(__APPLE__)
+    struct statfs buf;
+    return ::statfs(p.string().c_str(), &buf) == 0 && (buf.f_flags & MNT_LOCAL) == 0;
+#elif defined(__linux__)
+    struct statfs buf;
+    if (::statfs(p.string().c_str(), &buf) != 0)
+        return false;
+    switch (uint32_t(buf.f_type)) {
+    case 0x6969:        // NFS
+    case 0x517B:        // SMB
+    case 0xFF534D42:    // CIFS
+    case 0xFE534D42:    // SMB2
+    case 0x65735546:    // FUSE, for example sshfs or a NTFS formatted USB drive
+    case 0x4d44:        // FAT, SD cards and USB drives
+    case 0x2011BAB0:    // exFAT, SD cards and USB drives
+        return true;
+    default:
+        return false;
+    }
+#else
+    return false;
+#endif
+}
+
 #ifdef __linux__
 // Copied from boost::filesystem.
 // Called by copy_file_linux() in case linux sendfile() API is not supported.
@@ -1002,7 +1044,7 @@ bool is_idx_file(const boost::filesystem::directory_entry &dir_entry)
 //BBS: refine gcode appendix
 bool is_gcode_file(const std::string &path)
 {
-	return boost::iends_with(path, ".gcode"); // || boost::iends_with(path, ".g");
+	return boost::iends_with(path, ".gcode") || boost::iends_with(path, ".bgcode"); // || boost::iends_with(path, ".g");
 }
 
 //BBS: add json support
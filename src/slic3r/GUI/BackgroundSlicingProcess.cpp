@@ -21,6 +21,7 @@
 #include "libslic3r/Utils.hpp"
 #include "libslic3r/GCode/PostProcessor.hpp"
 #include "libslic3r/Format/SL1.hpp"
+#include "libslic3r/Format/BinaryGCode.hpp"
 #include "libslic3r/Thread.hpp"
 #include "libslic3r/libslic3r.h"
 
@@ -241,7 +242,7 @@ void BackgroundSlicingProcess::process_fff()
 
 		//BBS: add plate index into render params
 		m_temp_output_path = this->get_current_plate()->get_tmp_gcode_path();
-		m_fff_print->export_gcode(m_temp_output_path, m_gcode_result, [this](const ThumbnailsParams& params) { return this->render_thumbnails(params); });
+		m_fff_print->export_gcode(m_temp_output_path, m_gcode_result, [this](const ThumbnailsParams& params) { return this->render_thumbnails(params); }, true);
 		if(m_fff_print->is_BBL_printer())
 			run_post_process_scripts(m_temp_output_path, false, "File", m_temp_output_path, m_fff_print->full_print_config());
 
@@ -787,6 +788,23 @@ bool BackgroundSlicingProcess::invalidate_all_steps()
 	return m_step_state.invalidate_all([this](){ this->stop_internal(); });
 }
 
+// If the printer asks for the binary G-code, convert a copy of the ASCII G-code at output_path, which is memory mapped by the G-code viewer.
+// Returns true and replaces output_path with the path of the temporary binary G-code if converted.
+static bool convert_to_binary_gcode(std::string &output_path, const PrintConfig &config)
+{
+	if (! config.binary_gcode.value)
+		return false;
+	std::string binary_path = output_path + ".bgcode";
+	try {
+		BinaryGCode::convert_ascii_to_binary(output_path, binary_path);
+	} catch (const std::exception &ex) {
+		boost::nowide::remove(binary_path.c_str());
+		throw Slic3r::ExportError(ex.what());
+	}
+	output_path = std::move(binary_path);
+	return true;
+}
+
 // G-code is generated in m_temp_output_path.
 // Optionally run a post-processing script on a copy of m_temp_output_path.
 // Copy the final G-code to target location (possibly a SD card, if it is a removable media, then verify that the file was written without an error).
@@ -803,7 +821,7 @@ void BackgroundSlicingProcess::finalize_gcode()
 	// is calculated for the unprocessed G-code and it references lines in the memory mapped G-code file by line numbers.
 	// export_path may be changed by the post-processing script as well if the post processing script decides so, see GH #6042.
 	bool post_processed = run_post_process_scripts(output_path, true, "File", export_path, m_fff_print->full_print_config());
-	auto remove_post_processed_temp_file = [post_processed, &output_path]() {
+	auto remove_post_processed_temp_file = [&post_processed, &output_path]() {
 		if (post_processed)
 			try {
 				boost::filesystem::remove(output_path);
@@ -813,6 +831,16 @@ void BackgroundSlicingProcess::finalize_gcode()
 	};
     m_print->set_status(99, _utf8(L("Successfully executed post-processing script")));
 
+	{
+		std::string ascii_path = output_path;
+		if (convert_to_binary_gcode(output_path, m_fff_print->config())) {
+			if (post_processed)
+				boost::nowide::remove(ascii_path.c_str());
+			// The binary G-code is a temporary copy as well.
+			post_processed = true;
+		}
+	}
+
 	//FIXME localize the messages
 	std::string error_message;
 	int copy_ret_val = CopyFileResult::SUCCESS;
@@ -860,6 +888,7 @@ void BackgroundSlicingProcess::export_gcode()
 	// Perform the final post-processing of the export path by applying the print statistics over the file name.
 	std::string export_path = m_fff_print->print_statistics().finalize_output_path(m_export_path);
 	std::string output_path = m_temp_output_path;
+	const bool  binary      = convert_to_binary_gcode(output_path, m_fff_print->config());
 
 	//FIXME localize the messages
 	std::string error_message;
@@ -867,9 +896,13 @@ void BackgroundSlicingProcess::export_gcode()
 	try
 	{
 		copy_ret_val = copy_file(output_path, export_path, error_message, m_export_path_on_removable_media);
+		if (binary)
+			boost::nowide::remove(output_path.c_str());
 	}
 	catch (...)
 	{
+		if (binary)
+			boost::nowide::remove(output_path.c_str());
 		throw Slic3r::ExportError(_utf8(L("Unknown error when exporting G-code.")));
 	}
 	switch (copy_ret_val) {
@@ -920,7 +953,9 @@ void BackgroundSlicingProcess::prepare_upload()
         } else {
 		    m_print->set_status(95, _utf8(L("Running post-processing scripts")));
 		    std::string error_message;
-		    if (copy_file(m_temp_output_path, source_path.string(), error_message) != SUCCESS)
+		    if (m_fff_print->config().binary_gcode.value)
+		    	BinaryGCode::convert_ascii_to_binary(m_temp_output_path, source_path.string());
+		    else if (copy_file(m_temp_output_path, source_path.string(), error_message) != SUCCESS)
 		    	throw Slic3r::RuntimeError(_utf8(L("Copying of the temporary G-code to the output G-code failed")));
             m_upload_job.upload_data.upload_path = m_fff_print->print_statistics().finalize_output_path(m_upload_job.upload_data.upload_path.string());
 		    // Orca: skip post-processing scripts for BBL printers as we have run them already in finalize_gcode()
@@ -0,0 +1,399 @@
+// Slicing performance benchmark.
+//
+// Slices a curated set of models (the OBJ files of the test data directory and synthetic large meshes) with the
+// default print profile, measures the wall time of each PrintObjectStep, PrintStep and of the G-code export and
+// the peak resident memory, and writes the results as JSON. The results may be compared against a baseline
+// produced by a previous run: The benchmark fails with exit code 1 if any measurement regressed above the threshold.
+//
+// Usage:
+//     benchmark [--output results.json] [--baseline baseline.json] [--threshold 0.1] [--repeat 3]
+//               [--filter substring] [--quick]
+
+#include "libslic3r/libslic3r.h"
+#include "libslic3r/Model.hpp"
+#include "libslic3r/ModelArrange.hpp"
+#include "libslic3r/Print.hpp"
+#include "libslic3r/TriangleMesh.hpp"
+#include "libslic3r/Utils.hpp"
+#include "libslic3r/Format/OBJ.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/nowide/fstream.hpp>
+
+#include "nlohmann/json.hpp"
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+using namespace Slic3r;
+namespace fs = boost::filesystem;
+
+// Version of the format of the results. Results of different versions are not compared.
+static constexpr int RESULTS_VERSION = 1;
+
+static const char *print_object_step_names[posCount] = {
+    "posSlice", "posPerimeters", "posEstimateCurledExtrusions", "posPrepareInfill",
+    "posInfill", "posIroning", "posSupportMaterial", "posSimplifyPath", "posSimplifySupportPath",
+    "posDetectOverhangsForLift",
+    "posSimplifyWall", "posSimplifyInfill",
+};
+
+static const char *print_step_names[psCount] = {
+    "psWipeTower", "psSkirtBrim", "psGCodeExport", "psConflictCheck",
+};
+
+// Peak resident memory of this process in bytes, 0 if not available.
+// The peak only ever grows, thus the value reported for a model is the peak of the models benchmarked so far.
+static size_t peak_rss()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return size_t(pmc.PeakWorkingSetSize);
+    return 0;
+#else
+    rusage memory_info;
+    if (getrusage(RUSAGE_SELF, &memory_info) != 0)
+        return 0;
+    #ifdef __APPLE__
+    // Bytes on macOS.
+    return size_t(memory_info.ru_maxrss);
+    #else
+    // Kilobytes on Linux.
+    return size_t(memory_info.ru_maxrss) * 1024;
+    #endif
+#endif
+}
+
+struct BenchmarkModel
+{
+    std::string                         name;
+    // Synthetic models are large, they are skipped by --quick.
+    bool                                synthetic { false };
+    std::function<std::vector<TriangleMesh>()> meshes;
+    // Adjustments of the default print config specific to this model, may be empty.
+    std::function<void(DynamicPrintConfig&)>   configure;
+};
+
+static std::vector<BenchmarkModel> benchmark_models()
+{
+    std::vector<BenchmarkModel> out;
+
+    // All the OBJ files of the test data, sorted for a stable order of the results.
+    std::vector<fs::path> obj_files;
+    for (fs::directory_iterator it(fs::path(TEST_DATA_DIR)), end; it != end; ++ it)
+        if (fs::is_regular_file(it->status()) && boost::iequals(it->path().extension().string(), ".obj"))
+            obj_files.emplace_back(it->path());
+    std::sort(obj_files.begin(), obj_files.end());
+    for (const fs::path &path : obj_files)
+        out.push_back({ path.stem().string(), false, [path]() {
+            TriangleMesh mesh;
+            ObjInfo      obj_info;
+            std::string  message;
+            if (! load_obj(path.string().c_str(), &mesh, obj_info, message))
+                throw Slic3r::RuntimeError("Failed to load " + path.string() + ": " + message);
+            return std::vector<TriangleMesh>{ std::move(mesh) };
+        } });
+
+    // A finely tessellated sphere, about a million triangles: Stresses slicing and the seam placer visibility.
+    out.push_back({ "synthetic_sphere_1M", true, []() {
+        return std::vector<TriangleMesh>{ make_sphere(60., PI / 512.) };
+    } });
+    // A tall cylinder: Many layers with a simple cross section, stresses the per layer overhead.
+    out.push_back({ "synthetic_tall_cylinder", true, []() {
+        return std::vector<TriangleMesh>{ make_cylinder(30., 200., 2. * PI / 720.) };
+    } });
+    // Many small islands in a single object: Stresses travel planning and the ordering of extrusions.
+    out.push_back({ "synthetic_pin_array", true, []() {
+        TriangleMesh mesh;
+        for (int i = 0; i < 12; ++ i)
+            for (int j = 0; j < 12; ++ j) {
+                TriangleMesh pin = make_cylinder(2.5, 40., 2. * PI / 90.);
+                pin.translate(float(i * 9.), float(j * 9.), 0.f);
+                mesh.merge(pin);
+            }
+        return std::vector<TriangleMesh>{ std::move(mesh) };
+    } });
+    // Multiple objects sharing the bed, with supports: Stresses the G-code export of many objects per layer.
+    out.push_back({ "synthetic_plate", true, []() {
+        std::vector<TriangleMesh> meshes;
+        for (int i = 0; i < 6; ++ i) {
+            TriangleMesh mesh = make_sphere(15., 2. * PI / 180.);
+            mesh.merge(make_cube(20., 20., 10.));
+            meshes.emplace_back(std::move(mesh));
+        }
+        return meshes;
+    } });
+    // A large sphere filled with lightning infill: Its top half overhangs the infill below, stresses the lightning
+    // tree generation of PrintObject::prepare_infill().
+    out.push_back({ "synthetic_lightning_sphere", true, []() {
+        return std::vector<TriangleMesh>{ make_sphere(50., 2. * PI / 360.) };
+    }, [](DynamicPrintConfig &config) {
+        config.set_key_value("sparse_infill_pattern", new ConfigOptionEnum<InfillPattern>(ipLightning));
+        config.set_key_value("sparse_infill_density", new ConfigOptionPercent(15));
+    } });
+    return out;
+}
+
+// Measurements of a single run, all times in seconds.
+struct RunResult
+{
+    double                  wall_time     { 0. };
+    double                  process_time  { 0. };
+    double                  export_time   { 0. };
+    std::vector<double>     object_steps  = std::vector<double>(posCount, 0.);
+    std::vector<double>     print_steps   = std::vector<double>(psCount, 0.);
+    nlohmann::json          gcode_pipeline;
+};
+
+static RunResult run_once(const std::vector<TriangleMesh> &meshes, const DynamicPrintConfig &config, const fs::path &gcode_path)
+{
+    RunResult out;
+    Model     model;
+    Print     print;
+    for (const TriangleMesh &mesh : meshes) {
+        ModelObject *object = model.add_object();
+        object->name = "benchmark.stl";
+        object->add_volume(mesh);
+        object->add_instance();
+    }
+    arrange_objects(model, InfiniteBed{}, ArrangeParams{ scaled(min_object_distance(config)) });
+    for (ModelObject *mo : model.objects) {
+        mo->ensure_on_bed();
+        print.auto_assign_extruders(mo);
+    }
+    print.apply(model, config);
+    print.validate();
+    print.set_status_silent();
+
+    auto t_start = std::chrono::steady_clock::now();
+    print.process();
+    auto t_processed = std::chrono::steady_clock::now();
+    print.export_gcode(gcode_path.string(), nullptr, nullptr);
+    auto t_exported = std::chrono::steady_clock::now();
+
+    out.process_time = std::chrono::duration<double>(t_processed - t_start).count();
+    out.export_time  = std::chrono::duration<double>(t_exported - t_processed).count();
+    out.wall_time    = out.process_time + out.export_time;
+    // PrintObjects are processed in parallel, thus the sum of the object step times may exceed the wall time.
+    for (const PrintObject *object : print.objects())
+        for (int step = 0; step < posCount; ++ step)
+            out.object_steps[step] += object->step_state_with_timestamp(PrintObjectStep(step)).duration;
+    for (int step = 0; step < psCount; ++ step)
+        out.print_steps[step] = print.step_state_with_timestamp(PrintStep(step)).duration;
+    out.gcode_pipeline = print.print_statistics().gcode_pipeline.to_json();
+    return out;
+}
+
+static double median(std::vector<double> values)
+{
+    assert(! values.empty());
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return (n % 2 == 1) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+static nlohmann::json benchmark_model(const BenchmarkModel &bm, const DynamicPrintConfig &default_config, int repeat, const fs::path &gcode_path)
+{
+    DynamicPrintConfig config = default_config;
+    if (bm.configure)
+        bm.configure(config);
+    std::vector<TriangleMesh> meshes = bm.meshes();
+    size_t triangles = 0;
+    for (const TriangleMesh &mesh : meshes)
+        triangles += mesh.facets_count();
+
+    std::vector<RunResult> runs;
+    for (int i = 0; i < repeat; ++ i)
+        runs.emplace_back(run_once(meshes, config, gcode_path));
+
+    auto median_of = [&runs](auto get) {
+        std::vector<double> values;
+        for (const RunResult &run : runs)
+            values.emplace_back(get(run));
+        return median(values);
+    };
+
+    nlohmann::json out;
+    out["triangles"]    = triangles;
+    out["objects"]      = meshes.size();
+    out["wall_time"]    = median_of([](const RunResult &r) { return r.wall_time; });
+    out["process_time"] = median_of([](const RunResult &r) { return r.process_time; });
+    out["export_time"]  = median_of([](const RunResult &r) { return r.export_time; });
+    out["peak_rss"]     = peak_rss();
+    nlohmann::json steps = nlohmann::json::object();
+    for (int step = 0; step < posCount; ++ step)
+        steps[print_object_step_names[step]] = median_of([step](const RunResult &r) { return r.object_steps[step]; });
+    for (int step = 0; step < psCount; ++ step)
+        steps[print_step_names[step]] = median_of([step](const RunResult &r) { return r.print_steps[step]; });
+    out["steps"] = std::move(steps);
+    // Stage timing of the last run, for information only.
+    out["gcode_pipeline"] = runs.back().gcode_pipeline;
+    return out;
+}
+
+// Compare a measurement against its baseline. Small absolute differences are ignored, as they are dominated by noise.
+static bool regressed(double value, double baseline, double threshold, double min_delta)
+{
+    return value > baseline * (1. + threshold) && value - baseline > min_delta;
+}
+
+// Returns the number of regressions found.
+static int compare_with_baseline(const nlohmann::json &results, const nlohmann::json &baseline, double threshold)
+{
+    if (baseline.value("version", 0) != RESULTS_VERSION) {
+        std::cerr << "Baseline has an incompatible version, not comparing." << std::endl;
+        return 0;
+    }
+    // Times shorter than 50ms and memory differences below 32MB are not reported.
+    static constexpr double min_time_delta = 0.05;
+    static constexpr double min_rss_delta  = 32. * 1024. * 1024.;
+
+    int num_regressions = 0;
+    auto report = [&num_regressions](const std::string &model, const std::string &metric, double value, double base) {
+        ++ num_regressions;
+        std::cerr << "REGRESSION " << model << " " << metric << ": " << base << " -> " << value
+                  << " (+" << std::fixed << std::setprecision(1) << 100. * (value / base - 1.) << "%)" << std::defaultfloat << std::endl;
+    };
+    for (const auto &[name, model] : results["models"].items()) {
+        auto it_base = baseline["models"].find(name);
+        if (it_base == baseline["models"].end())
+            continue;
+        const nlohmann::json &base = *it_base;
+        for (const char *metric : { "wall_time", "process_time", "export_time" })
+            if (base.contains(metric) && regressed(model[metric].get<double>(), base[metric].get<double>(), threshold, min_time_delta))
+                report(name, metric, model[metric].get<double>(), base[metric].get<double>());
+        if (base.contains("peak_rss") && regressed(model["peak_rss"].get<double>(), base["peak_rss"].get<double>(), threshold, min_rss_delta))
+            report(name, "peak_rss", model["peak_rss"].get<double>(), base["peak_rss"].get<double>());
+        if (base.contains("steps"))
+            for (const auto &[step, value] : model["steps"].items())
+                if (base["steps"].contains(step) && regressed(value.get<double>(), base["steps"][step].get<double>(), threshold, min_time_delta))
+                    report(name, step, value.get<double>(), base["steps"][step].get<double>());
+    }
+    return num_regressions;
+}
+
+static void print_usage()
+{
+    std::cout <<
+        "Usage: benchmark [options]\n"
+        "  --output FILE       Write the results as JSON into FILE (default: stdout).\n"
+        "  --baseline FILE     Compare the results against the results of a previous run.\n"
+        "  --threshold RATIO   Relative slowdown reported as a regression (default: 0.1).\n"
+        "  --repeat N          Slice each model N times, report the median (default: 3).\n"
+        "  --filter TEXT       Only benchmark models with TEXT in their name.\n"
+        "  --quick             Skip the synthetic large models.\n";
+}
+
+int main(int argc, char **argv)
+{
+    std::string output_path;
+    std::string baseline_path;
+    std::string filter;
+    double      threshold = 0.1;
+    int         repeat    = 3;
+    bool        quick     = false;
+    for (int i = 1; i < argc; ++ i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value of " << arg << std::endl;
+                std::exit(2);
+            }
+            return argv[++ i];
+        };
+        if (arg == "--output")
+            output_path = next();
+        else if (arg == "--baseline")
+            baseline_path = next();
+        else if (arg == "--threshold")
+            threshold = std::stod(next());
+        else if (arg == "--repeat")
+            repeat = std::max(1, std::stoi(next()));
+        else if (arg == "--filter")
+            filter = next();
+        else if (arg == "--quick")
+            quick = true;
+        else {
+            print_usage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    set_logging_level(1);
+    DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+    config.set_key_value("enable_support", new ConfigOptionBool(true));
+
+    fs::path gcode_path = fs::temp_directory_path() / fs::unique_path("orca-benchmark-%%%%-%%%%.gcode");
+
+    nlohmann::json results;
+    results["version"]   = RESULTS_VERSION;
+    results["repeat"]    = repeat;
+    results["models"]    = nlohmann::json::object();
+    auto t_start = std::chrono::steady_clock::now();
+    try {
+        for (const BenchmarkModel &bm : benchmark_models()) {
+            if ((quick && bm.synthetic) || (! filter.empty() && bm.name.find(filter) == std::string::npos))
+                continue;
+            std::cerr << "Benchmarking " << bm.name << "..." << std::flush;
+            nlohmann::json result = benchmark_model(bm, config, repeat, gcode_path);
+            std::cerr << " " << result["wall_time"].get<double>() << " s" << std::endl;
+            results["models"][bm.name] = std::move(result);
+        }
+    } catch (const std::exception &ex) {
+        std::cerr << std::endl << "Benchmark failed: " << ex.what() << std::endl;
+        boost::system::error_code ec;
+        fs::remove(gcode_path, ec);
+        return 2;
+    }
+    boost::system::error_code ec;
+    fs::remove(gcode_path, ec);
+    results["total_time"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+    results["peak_rss"]   = peak_rss();
+
+    if (output_path.empty())
+        std::cout << results.dump(2) << std::endl;
+    else {
+        boost::nowide::ofstream ofs(output_path);
+        ofs << results.dump(2) << std::endl;
+        if (! ofs) {
+            std::cerr << "Cannot write " << output_path << std::endl;
+            return 2;
+        }
+    }
+
+    if (! baseline_path.empty()) {
+        boost::nowide::ifstream ifs(baseline_path);
+        nlohmann::json baseline;
+        try {
+            ifs >> baseline;
+        } catch (const std::exception &ex) {
+            std::cerr << "Cannot read baseline " << baseline_path << ": " << ex.what() << std::endl;
+            return 2;
+        }
+        int num_regressions = compare_with_baseline(results, baseline, threshold);
+        if (num_regressions > 0) {
+            std::cerr << num_regressions << " regression(s) above " << 100. * threshold << "% found." << std::endl;
+            return 1;
+        }
+        std::cerr << "No regressions above " << 100. * threshold << "% found." << std::endl;
+    }
+    return 0;
+}
@@ -74,6 +74,8 @@ void init_and_process_print(std::initializer_list<TestMesh> 	meshes, Slic3r::Pri
 void init_and_process_print(std::initializer_list<TriangleMesh> meshes, Slic3r::Print &print, std::initializer_list<Slic3r::ConfigBase::SetDeserializeItem> config_items, bool comments = false);
 
 std::string gcode(Print& print);
+// Removes the time stamp of the G-code, which differs between the exports.
+std::string strip_timestamp(std::string gcode);
 
 std::string slice(std::initializer_list<TestMesh> meshes, const DynamicPrintConfig &config, bool comments = false);
 std::string slice(std::initializer_list<TriangleMesh> meshes, const DynamicPrintConfig &config, bool comments = false);
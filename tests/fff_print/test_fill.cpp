@@ -5,6 +5,8 @@
 
 #include "libslic3r/ClipperUtils.hpp"
 #include "libslic3r/Fill/Fill.hpp"
+#include "libslic3r/Fill/FillGyroid.hpp"
+#include "libslic3r/Fill/WavePatternCache.hpp"
 #include "libslic3r/Flow.hpp"
 #include "libslic3r/Geometry.hpp"
 #include "libslic3r/Print.hpp"
@@ -429,6 +431,33 @@ for my $pattern (qw(rectilinear honeycomb hilbertcurve concentric)) {
 }
 */
 
+TEST_CASE("Fill: Gyroid layers of the same phase share the waves", "[Fill]") {
+    std::unique_ptr<Slic3r::Fill> filler(Slic3r::Fill::new_from_type(ipGyroid));
+    filler->spacing = 0.45;
+    FillParams fill_params;
+    fill_params.density = 0.2f;
+    ExPolygon square({ Point::new_scale(0, 0), Point::new_scale(20, 0), Point::new_scale(20, 20), Point::new_scale(0, 20) });
+    filler->bounding_box = get_extents(square.contour);
+
+    auto fill_at = [&filler, &fill_params, &square](double z) {
+        filler->z = z;
+        Surface surface(stInternal, square);
+        return filler->fill_surface(&surface, fill_params);
+    };
+    // The gyroid repeats with this period in z.
+    const double period = 2. * PI * filler->spacing / (fill_params.density * FillGyroid::DensityAdjust);
+
+    FillGyroid::wave_cache().clear();
+    Polylines first = fill_at(1.);
+    REQUIRE(! first.empty());
+    REQUIRE(FillGyroid::wave_cache().statistics().misses == 1);
+    Polylines second = fill_at(1. + 3. * period);
+    REQUIRE(FillGyroid::wave_cache().statistics().hits == 1);
+    REQUIRE(first.size() == second.size());
+    for (size_t i = 0; i < first.size(); ++ i)
+        REQUIRE(first[i].points == second[i].points);
+}
+
 bool test_if_solid_surface_filled(const ExPolygon& expolygon, double flow_spacing, double angle, double density)
 {
     std::unique_ptr<Slic3r::Fill> filler(Slic3r::Fill::new_from_type("rectilinear"));
@@ -1,8 +1,16 @@
 #include <catch2/catch_all.hpp>
 
 #include <memory>
+#include <fstream>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/nowide/cstdio.hpp>
 
 #include "libslic3r/GCode.hpp"
+#include "libslic3r/GCodeReader.hpp"
+#include "libslic3r/GCode/GCodeLayerBuffer.hpp"
+#include "libslic3r/GCode/GCodeProcessor.hpp"
+#include "libslic3r/Format/BinaryGCode.hpp"
 
 using namespace Slic3r;
 
@@ -20,3 +28,232 @@ SCENARIO("Origin manipulation", "[GCode]") {
     	}
     }
 }
+
+SCENARIO("G-code layer buffer", "[GCode]") {
+    const std::string gcode = "G1 Z0.4 F600\n;TYPE:Outer wall\nG1 X10 Y5 E0.5 ;_EXTRUDE_SET_SPEED\n  G1 X20 Y5 E1.2\nM106 S255\n";
+    GIVEN("A layer parsed into lines") {
+        GCodeLayerBuffer buffer{ std::string(gcode) };
+        THEN("The commands, axes and tags are parsed") {
+            REQUIRE(buffer.size() == 5);
+            REQUIRE(buffer.command(0) == GCodeLayerBuffer::Command::G1);
+            REQUIRE(buffer.has(0, Z));
+            REQUIRE(buffer.value(0, F) == 600.f);
+            REQUIRE(! buffer.has(0, X));
+            REQUIRE(buffer.has_tag(1, GCodeLayerBuffer::TAG_TYPE));
+            REQUIRE(buffer.role(1) == erExternalPerimeter);
+            REQUIRE(buffer.has_tag(2, GCodeLayerBuffer::TAG_EXTRUDE_SET_SPEED));
+            REQUIRE(buffer.value(2, E) == Catch::Approx(0.5f));
+            REQUIRE(buffer.indented(3));
+            REQUIRE(buffer.command(3) == GCodeLayerBuffer::Command::G1);
+            REQUIRE(buffer.command(4) == GCodeLayerBuffer::Command::Other);
+            REQUIRE(buffer.command_word(4) == "M106");
+        }
+        THEN("The layer formats back to the same G-code") {
+            REQUIRE(buffer.format() == gcode);
+            REQUIRE(buffer.formatted_size() == gcode.size());
+        }
+        THEN("The position follows the moves") {
+            GCodeLayerBuffer::Position position(false);
+            for (size_t idx = 0; idx < 3; ++ idx)
+                position.end_line(buffer, idx);
+            REQUIRE(position.dist(buffer, 3, X) == Catch::Approx(10.f));
+            REQUIRE(position.dist_xy(buffer, 3) == Catch::Approx(10.f));
+            REQUIRE(position[Z] == Catch::Approx(0.4f));
+        }
+        WHEN("Lines are edited, removed and inserted") {
+            buffer.set_axis(2, E, 0.75f, 5);
+            buffer.remove(1);
+            buffer.insert(4, "M107\n");
+            const size_t copy = buffer.add_copy(0);
+            buffer.insert(5, copy, copy + 1);
+            buffer.commit();
+            THEN("The edits are formatted in place") {
+                REQUIRE(buffer.value(1, E) == Catch::Approx(0.75f));
+                REQUIRE(buffer.format() == "G1 Z0.4 F600\nG1 X10 Y5 E0.75000 ;_EXTRUDE_SET_SPEED\n  G1 X20 Y5 E1.2\nM107\nM106 S255\nG1 Z0.4 F600\n");
+            }
+        }
+    }
+}
+
+SCENARIO("Binary G-code", "[GCode]") {
+    std::string gcode = "; HEADER_BLOCK_START\n; generated by OrcaSlicer\n; HEADER_BLOCK_END\n\n"
+                        "; THUMBNAIL_BLOCK_START\n; thumbnail begin 2x2 12\n; iVBORw0KGgo=\n; thumbnail end\n; THUMBNAIL_BLOCK_END\n\n";
+    for (int i = 0; i < 20000; ++ i)
+        gcode += "G1 X" + std::to_string(i % 200) + " Y" + std::to_string(i % 150) + " E0.0123\n";
+    gcode += "; filament used [mm] = 1234.56\n; estimated printing time (normal mode) = 1h 2m 3s\n"
+             "; CONFIG_BLOCK_START\n; layer_height = 0.2\n; printer_model = Generic\n; CONFIG_BLOCK_END\n";
+
+    auto read_file = [](const std::string &path) {
+        std::ifstream f(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    };
+    const std::string ascii_path  = boost::filesystem::unique_path().string();
+    const std::string binary_path = ascii_path + ".bgcode";
+    const std::string decoded_path = ascii_path + ".decoded";
+    {
+        std::ofstream f(ascii_path, std::ios::binary);
+        f << gcode;
+    }
+
+    GIVEN("An ASCII G-code converted to a binary G-code") {
+        BinaryGCode::convert_ascii_to_binary(ascii_path, binary_path);
+        THEN("The binary G-code is detected and compressed") {
+            REQUIRE(BinaryGCode::is_binary_gcode_file(binary_path));
+            REQUIRE(! BinaryGCode::is_binary_gcode_file(ascii_path));
+            REQUIRE(read_file(binary_path).size() < gcode.size() / 2);
+        }
+        THEN("The G-code survives the round trip") {
+            BinaryGCode::convert_binary_to_ascii(binary_path, decoded_path);
+            REQUIRE(read_file(decoded_path) == gcode);
+        }
+        THEN("The metadata and the thumbnails are filled in") {
+            BinaryGCode::BinaryData data;
+            BinaryGCode::read_binary_gcode(binary_path, data, nullptr);
+            REQUIRE(data.slicer_metadata == BinaryGCode::Metadata{ { "layer_height", "0.2" }, { "printer_model", "Generic" } });
+            REQUIRE(data.print_metadata.size() == 2);
+            REQUIRE(data.print_metadata.front() == std::make_pair(std::string("filament used [mm]"), std::string("1234.56")));
+            REQUIRE(data.thumbnails.size() == 1);
+            REQUIRE(data.thumbnails.front().width == 2);
+            REQUIRE(data.thumbnails.front().data.substr(1, 3) == "PNG");
+        }
+        THEN("The G-code processor processes a temporary ASCII G-code removed together with the result") {
+            std::string processed_path;
+            {
+                GCodeProcessor processor;
+                processor.process_file(binary_path);
+                processed_path = processor.result().filename;
+                REQUIRE(processed_path != binary_path);
+                REQUIRE(read_file(processed_path) == gcode);
+                // Another binary G-code of the same name does not reuse the temporary file.
+                GCodeProcessor processor2;
+                processor2.process_file(binary_path);
+                REQUIRE(processor2.result().filename != processed_path);
+            }
+            REQUIRE(! boost::filesystem::exists(processed_path));
+        }
+        WHEN("A byte of the binary G-code is corrupted") {
+            std::string binary = read_file(binary_path);
+            binary[binary.size() / 2] ^= 0x55;
+            {
+                std::ofstream f(binary_path, std::ios::binary);
+                f << binary;
+            }
+            THEN("Reading the binary G-code fails") {
+                REQUIRE_THROWS(BinaryGCode::convert_binary_to_ascii(binary_path, decoded_path));
+            }
+        }
+        // The first block header follows the 10 bytes of the file header: type, compression, uncompressed size, compressed size.
+        auto patch_binary = [&read_file, &binary_path](size_t offset, const std::string &bytes) {
+            std::string binary = read_file(binary_path);
+            binary.replace(offset, bytes.size(), bytes);
+            std::ofstream f(binary_path, std::ios::binary);
+            f << binary;
+        };
+        WHEN("The size of a block exceeds the file") {
+            patch_binary(18, std::string("\xf0\xff\xff\x7f", 4));
+            THEN("Reading the binary G-code fails without allocating the block") {
+                REQUIRE_THROWS_WITH(BinaryGCode::convert_binary_to_ascii(binary_path, decoded_path), Catch::Matchers::ContainsSubstring("Invalid block size"));
+            }
+        }
+        WHEN("A block uses an unknown compression") {
+            patch_binary(12, std::string("\x07\x00", 2));
+            THEN("The compression is reported as unsupported") {
+                REQUIRE_THROWS_WITH(BinaryGCode::convert_binary_to_ascii(binary_path, decoded_path), Catch::Matchers::ContainsSubstring("Unknown compression type 7"));
+            }
+        }
+    }
+
+    boost::nowide::remove(ascii_path.c_str());
+    boost::nowide::remove(binary_path.c_str());
+    boost::nowide::remove(decoded_path.c_str());
+}
+
+SCENARIO("GCodeReader line ends", "[GCode]") {
+    // Lines longer than the vectorized line end search, CRLF line ends and no line end at the end of file.
+    const std::string gcode = "G1 X1.5 Y2.5 E0.1 ; " + std::string(100, 'c') + "\r\n"
+                              "G1 X3 Y4\n"
+                              "\n"
+                              ";" + std::string(33, 'x') + "\n"
+                              "G1 Z0.6 F1200";
+    const std::string path = boost::filesystem::unique_path().string();
+    {
+        std::ofstream f(path, std::ios::binary);
+        f << gcode;
+    }
+    GIVEN("A G-code file") {
+        GCodeReader                reader;
+        std::vector<std::string>   raw;
+        std::vector<size_t>        lines_ends;
+        reader.parse_file(path, [&raw](GCodeReader &, const GCodeReader::GCodeLine &line) { raw.emplace_back(line.raw()); }, lines_ends);
+        THEN("Lines and line ends match the file") {
+            REQUIRE(raw.size() == 5);
+            REQUIRE(raw.front() == "G1 X1.5 Y2.5 E0.1 ; " + std::string(100, 'c'));
+            REQUIRE(raw[3] == ";" + std::string(33, 'x'));
+            REQUIRE(raw.back() == "G1 Z0.6 F1200");
+            REQUIRE(lines_ends == std::vector<size_t>{ 122, 131, 132, 167 });
+            REQUIRE(reader.x() == 3.f);
+            REQUIRE(reader.z() == Catch::Approx(0.6));
+        }
+        THEN("The parallel parser produces the same lines and line ends") {
+            GCodeReader                parallel_reader;
+            std::vector<std::string>   parallel_raw;
+            std::vector<size_t>        parallel_lines_ends;
+            parallel_reader.parse_file_parallel(path, [&parallel_raw](GCodeReader &, const GCodeReader::GCodeLine &line) { parallel_raw.emplace_back(line.raw()); }, parallel_lines_ends);
+            REQUIRE(parallel_raw == raw);
+            REQUIRE(parallel_lines_ends == lines_ends);
+            REQUIRE(parallel_reader.x() == reader.x());
+            REQUIRE(parallel_reader.z() == reader.z());
+        }
+    }
+    boost::nowide::remove(path.c_str());
+}
+
+SCENARIO("GCodeReader parallel parsing", "[GCode]") {
+    GIVEN("A G-code file split into several chunks") {
+        const std::string path = boost::filesystem::unique_path().string();
+        {
+            std::ofstream f(path, std::ios::binary);
+            for (int i = 0; i < 300000; ++ i)
+                f << "N" << i << " G1 X" << i % 200 << " Y" << i % 150 << " E0.5 ; move " << i << (i % 3 == 0 ? "\r\n" : "\n");
+        }
+        std::vector<float>  x, parallel_x;
+        std::vector<size_t> lines_ends, parallel_lines_ends;
+        GCodeReader         reader, parallel_reader;
+        reader.parse_file(path, [&x](GCodeReader &r, const GCodeReader::GCodeLine &line) { x.emplace_back(r.x() + line.dist_X(r)); }, lines_ends);
+        parallel_reader.parse_file_parallel(path, [&parallel_x](GCodeReader &r, const GCodeReader::GCodeLine &line) { parallel_x.emplace_back(r.x() + line.dist_X(r)); }, parallel_lines_ends);
+        THEN("The lines are processed in order") {
+            REQUIRE(x.size() == 300000);
+            REQUIRE(parallel_x == x);
+            REQUIRE(parallel_lines_ends == lines_ends);
+        }
+        boost::nowide::remove(path.c_str());
+    }
+}
+
+// Run with the "[Benchmark]" tag. Set the SLIC3R_BENCHMARK_GCODE environment variable to benchmark loading of a real G-code.
+TEST_CASE("Benchmark GCodeReader::parse_file", "[.][Benchmark]") {
+    std::string path;
+    bool        temp = false;
+    if (const char *env = std::getenv("SLIC3R_BENCHMARK_GCODE"); env != nullptr)
+        path = env;
+    else {
+        path = boost::filesystem::unique_path().string();
+        temp = true;
+        std::ofstream f(path, std::ios::binary);
+        for (int i = 0; i < 500000; ++ i) {
+            if (i % 50 == 0)
+                f << "; FEATURE: Outer wall\n; LINE_WIDTH: 0.42\n";
+            f << "G1 X" << 100 + (i % 97) * 0.173 << " Y" << 80 + (i % 89) * 0.211 << " E" << 0.01 + (i % 7) * 0.003 << "\n";
+        }
+    }
+    INFO("G-code: " << path << ", " << boost::filesystem::file_size(path) << " bytes");
+    std::vector<size_t> lines_ends;
+    BENCHMARK("parse_file") {
+        GCodeReader reader;
+        reader.parse_file(path, [](GCodeReader &, const GCodeReader::GCodeLine &) {}, lines_ends);
+        return lines_ends.size();
+    };
+    REQUIRE(! lines_ends.empty());
+    if (temp)
+        boost::nowide::remove(path.c_str());
+}
@@ -2,10 +2,13 @@
 
 #include "libslic3r/libslic3r.h"
 #include "libslic3r/Print.hpp"
+#include "libslic3r/ClipperUtils.hpp"
 #include "libslic3r/Layer.hpp"
 
 #include "test_data.hpp"
 
+#include <tbb/task_arena.h>
+
 using namespace Slic3r;
 using namespace Slic3r::Test;
 
@@ -138,3 +141,43 @@ SCENARIO("Print: Brim generation", "[Print][.]") {
         }
     }
 }
+
+SCENARIO("Print: Clipper2 backend produces the same slices as Clipper", "[Print][ClipperUtils]") {
+    GIVEN("Models with holes, overhangs and bridges") {
+        WHEN("sliced with the Clipper backends compared") {
+            const ClipperBackend old_backend = clipper_backend();
+            set_clipper_backend(ClipperBackend::Compare);
+            reset_clipper_backend_comparison();
+            Slic3r::Test::slice({ TestMesh::cube_with_hole }, { { "enable_support", 1 } });
+            Slic3r::Test::slice({ TestMesh::overhang, TestMesh::bridge_with_hole }, { { "sparse_infill_density", "20%" } });
+            const ClipperBackendComparison comparison = clipper_backend_comparison();
+            set_clipper_backend(old_backend);
+            THEN("Clipper2 results match Clipper results") {
+                REQUIRE(comparison.operations > 0);
+                REQUIRE(comparison.mismatches == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Print: Objects processed concurrently produce the same G-code as processed serially", "[Print]") {
+    GIVEN("A print of several objects with supports") {
+        auto slice = [](int max_concurrency) {
+            std::string gcode;
+            tbb::task_arena arena(max_concurrency);
+            arena.execute([&gcode]() {
+                gcode = Slic3r::Test::slice({ TestMesh::cube_with_hole, TestMesh::overhang, TestMesh::bridge, TestMesh::sphere_50mm },
+                    { { "enable_support", 1 }, { "sparse_infill_density", "20%" } });
+            });
+            return Slic3r::Test::strip_timestamp(std::move(gcode));
+        };
+        WHEN("processed by a single thread and by all threads") {
+            const std::string serial     = slice(1);
+            const std::string concurrent = slice(tbb::task_arena::automatic);
+            THEN("The G-code is the same") {
+                REQUIRE(! serial.empty());
+                REQUIRE(serial == concurrent);
+            }
+        }
+    }
+}
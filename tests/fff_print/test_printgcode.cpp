@@ -12,10 +12,16 @@
 
 #include "libslic3r/libslic3r.h"
 #include "libslic3r/GCodeReader.hpp"
+#include "libslic3r/Format/BinaryGCode.hpp"
+#include "libslic3r/GCode/GCodeProcessor.hpp"
 
 #include "test_data.hpp"
 
 #include <algorithm>
+#include <fstream>
+#include <memory>
+#include <boost/filesystem/operations.hpp>
+#include <boost/nowide/cstdio.hpp>
 #include <boost/regex.hpp>
 
 using namespace Slic3r;
@@ -25,6 +31,30 @@ boost::regex perimeters_regex("G1 X[-0-9.]* Y[-0-9.]* E[-0-9.]* ; perimeter");
 boost::regex infill_regex("G1 X[-0-9.]* Y[-0-9.]* E[-0-9.]* ; infill");
 boost::regex skirt_regex("G1 X[-0-9.]* Y[-0-9.]* E[-0-9.]* ; skirt");
 
+SCENARIO("PrintGCode pipeline statistics", "[PrintGCode]") {
+    GIVEN("A print of a cube") {
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({TestMesh::cube_20x20x20}, print, model, {
+            { "layer_height",                   0.2 },
+            { "first_layer_height",             0.2 },
+            { "start_gcode",                    "" }
+            });
+        WHEN("the G-code is exported") {
+            std::string gcode = Slic3r::Test::gcode(print);
+            THEN("The stages of the G-code export pipeline are timed") {
+                const GCodePipelineStats &stats = print.print_statistics().gcode_pipeline;
+                REQUIRE(stats.pipelines == 1);
+                REQUIRE(stats.stages.front().name == "prepare_layer");
+                REQUIRE(stats.stages.back().name == "output");
+                REQUIRE(stats.stages.back().layers == stats.layer_bytes.size());
+                REQUIRE(stats.stages.back().bytes_out > 0);
+                REQUIRE(stats.stages.back().bytes_out < gcode.size());
+            }
+        }
+    }
+}
+
 SCENARIO( "PrintGCode basic functionality", "[PrintGCode][.]") {
     GIVEN("A default configuration and a print test object") {
         WHEN("the output is executed with no support material") {
@@ -279,3 +309,62 @@ SCENARIO( "PrintGCode basic functionality", "[PrintGCode][.]") {
         }
     }
 }
+
+SCENARIO("PrintGCode binary export", "[PrintGCode]") {
+    auto count_moves = [](const std::string &gcode) {
+        size_t n = 0;
+        for (size_t pos = gcode.find("\nG1 "); pos != std::string::npos; pos = gcode.find("\nG1 ", pos + 1))
+            ++ n;
+        return n;
+    };
+    GIVEN("A print with binary G-code enabled") {
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({TestMesh::cube_20x20x20}, print, model, { { "binary_gcode", true } });
+        print.set_status_silent();
+        print.process();
+        const std::string path         = boost::filesystem::unique_path().string() + ".bgcode";
+        const std::string decoded_path = path + ".decoded";
+        WHEN("The G-code is exported") {
+            print.export_gcode(path, nullptr, nullptr);
+            THEN("A binary G-code is written") {
+                REQUIRE(BinaryGCode::is_binary_gcode_file(path));
+            }
+            THEN("The binary G-code decodes to the same moves as the ASCII export") {
+                BinaryGCode::convert_binary_to_ascii(path, decoded_path);
+                std::ifstream f(decoded_path, std::ios::binary);
+                std::string decoded((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+                f.close();
+                std::string ascii = Slic3r::Test::slice({TestMesh::cube_20x20x20}, { { "binary_gcode", false } });
+                REQUIRE(count_moves(decoded) > 0);
+                REQUIRE(count_moves(decoded) == count_moves(ascii));
+            }
+        }
+        WHEN("The G-code is exported with a G-code processor result") {
+            auto result = std::make_unique<GCodeProcessorResult>();
+            print.export_gcode(path, result.get(), nullptr);
+            const std::string ascii_path = result->filename;
+            THEN("The result references the lines of an ASCII G-code, which is removed with the result") {
+                REQUIRE(BinaryGCode::is_binary_gcode_file(path));
+                REQUIRE(ascii_path != path);
+                REQUIRE(! BinaryGCode::is_binary_gcode_file(ascii_path));
+                std::ifstream f(ascii_path, std::ios::binary);
+                std::string ascii((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+                f.close();
+                REQUIRE(! result->lines_ends.empty());
+                REQUIRE(result->lines_ends.back() <= ascii.size());
+                REQUIRE(ascii[result->lines_ends.front() - 1] == '\n');
+                result.reset();
+                REQUIRE(! boost::filesystem::exists(ascii_path));
+            }
+        }
+        WHEN("The G-code is exported for the preview") {
+            print.export_gcode(path, nullptr, nullptr, true);
+            THEN("The ASCII G-code is kept") {
+                REQUIRE(! BinaryGCode::is_binary_gcode_file(path));
+            }
+        }
+        boost::nowide::remove(path.c_str());
+        boost::nowide::remove(decoded_path.c_str());
+    }
+}
@@ -87,3 +87,108 @@ SCENARIO("PrintObject: object layer heights", "[PrintObject][.]") {
 #endif
     }
 }
+
+SCENARIO("PrintObject: Changing a height range modifier reslices its layers only", "[PrintObject]") {
+    GIVEN("20mm cube with a height range modifier of 3 walls from 5mm to 10mm") {
+        DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+        config.set_deserialize_strict({ { "sparse_infill_density", "20%" } });
+        auto set_wall_loops = [](Slic3r::Model &model, int wall_loops) {
+            model.objects.front()->layer_config_ranges[{ 5., 10. }].set("wall_loops", wall_loops);
+        };
+        auto perimeters = [](const Layer &layer) {
+            std::vector<const ExtrusionEntity*> out;
+            for (const LayerRegion *layerm : layer.regions())
+                out.insert(out.end(), layerm->perimeters.entities.begin(), layerm->perimeters.entities.end());
+            return out;
+        };
+        auto gcode = [](Print &print) { return Slic3r::Test::strip_timestamp(Slic3r::Test::gcode(print)); };
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({ TestMesh::cube_20x20x20 }, print, model, config);
+        set_wall_loops(model, 3);
+        print.apply(model, config);
+        print.process();
+        const PrintObject                        &object            = *print.objects().front();
+        const std::vector<const ExtrusionEntity*> bottom_perimeters = perimeters(*object.get_layer(1));
+        WHEN("the modifier is changed to 4 walls") {
+            set_wall_loops(model, 4);
+            print.apply(model, config);
+            THEN("The object is not resliced, only its perimeters are invalidated") {
+                REQUIRE(object.is_step_done(posSlice));
+                REQUIRE(! object.is_step_done(posPerimeters));
+            }
+            const std::string partial = gcode(print);
+            THEN("The perimeters of the layers below the modifier are kept") {
+                REQUIRE(! bottom_perimeters.empty());
+                REQUIRE(perimeters(*object.get_layer(1)) == bottom_perimeters);
+            }
+            THEN("The layers and the G-code match a full reslice") {
+                Slic3r::Print full_print;
+                Slic3r::Model full_model;
+                Slic3r::Test::init_print({ TestMesh::cube_20x20x20 }, full_print, full_model, config);
+                set_wall_loops(full_model, 4);
+                full_print.apply(full_model, config);
+                const std::string full = gcode(full_print);
+                const PrintObject &full_object = *full_print.objects().front();
+                REQUIRE(object.layer_count() == full_object.layer_count());
+                for (size_t i = 0; i < object.layer_count(); ++ i)
+                    REQUIRE(perimeters(*object.get_layer(int(i))).size() == perimeters(*full_object.get_layer(int(i))).size());
+                REQUIRE(partial == full);
+            }
+        }
+    }
+}
+
+SCENARIO("PrintObject: Reprocessing a z range rebuilds its travel boundaries", "[PrintObject]") {
+    GIVEN("20mm cube with avoid crossing walls and a height range modifier of 3 walls from 5mm to 10mm") {
+        DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+        config.set_deserialize_strict({ { "sparse_infill_density", "20%" }, { "reduce_crossing_wall", "1" } });
+        auto set_wall_loops = [](Slic3r::Model &model, int wall_loops) {
+            model.objects.front()->layer_config_ranges[{ 5., 10. }].set("wall_loops", wall_loops);
+        };
+        auto extrusions = [](const Layer &layer) {
+            std::vector<const ExtrusionEntity*> out;
+            for (const LayerRegion *layerm : layer.regions()) {
+                out.insert(out.end(), layerm->perimeters.entities.begin(), layerm->perimeters.entities.end());
+                out.insert(out.end(), layerm->fills.entities.begin(), layerm->fills.entities.end());
+            }
+            return out;
+        };
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({ TestMesh::cube_20x20x20 }, print, model, config);
+        set_wall_loops(model, 3);
+        print.apply(model, config);
+        Slic3r::Test::gcode(print);
+        const PrintObject &object = *print.objects().front();
+        std::vector<std::vector<const ExtrusionEntity*>>                                  old_extrusions;
+        std::vector<std::shared_ptr<const AvoidCrossingPerimeters::LayerBoundaries>>     old_boundaries;
+        for (const Layer *layer : object.layers()) {
+            old_extrusions.emplace_back(extrusions(*layer));
+            old_boundaries.emplace_back(object.travel_boundaries_cache().get(*layer));
+        }
+        WHEN("the modifier is changed to 4 walls and the G-code is exported again") {
+            set_wall_loops(model, 4);
+            print.apply(model, config);
+            Slic3r::Test::gcode(print);
+            // Topmost layer of the reprocessed z range.
+            int top_reprocessed = -1;
+            for (int i = 0; i < int(object.layer_count()); ++ i)
+                if (extrusions(*object.get_layer(i)) != old_extrusions[i])
+                    top_reprocessed = i;
+            THEN("The boundaries of all the reprocessed layers are rebuilt, including the topmost one") {
+                REQUIRE(top_reprocessed > 0);
+                for (int i = 0; i < int(object.layer_count()); ++ i)
+                    if (extrusions(*object.get_layer(i)) != old_extrusions[i])
+                        REQUIRE(object.travel_boundaries_cache().get(*object.get_layer(i)) != old_boundaries[i]);
+            }
+            THEN("The cached boundaries of the topmost reprocessed layer match a full rebuild") {
+                const Layer &layer = *object.get_layer(top_reprocessed);
+                std::shared_ptr<const AvoidCrossingPerimeters::LayerBoundaries> cached = object.travel_boundaries_cache().get(layer);
+                std::shared_ptr<const AvoidCrossingPerimeters::LayerBoundaries> rebuilt = AvoidCrossingPerimeters::build_layer_boundaries(layer);
+                REQUIRE(cached->lslices_offset == rebuilt->lslices_offset);
+                REQUIRE(cached->internal.boundaries == rebuilt->internal.boundaries);
+            }
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#include <catch2/catch_all.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/nowide/fstream.hpp>
+
+#include "libslic3r/libslic3r.h"
+#include "libslic3r/Print.hpp"
+#include "libslic3r/SlicingCache.hpp"
+
+#include "test_data.hpp"
+
+using namespace Slic3r;
+using namespace Slic3r::Test;
+
+namespace fs = boost::filesystem;
+
+// Empty cache directory, removed at the end of the test.
+struct TemporaryCacheDirectory
+{
+    TemporaryCacheDirectory() : path((fs::temp_directory_path() / fs::unique_path("slicing_cache_%%%%-%%%%-%%%%")).string()) {}
+    ~TemporaryCacheDirectory() { boost::system::error_code ec; fs::remove_all(fs::path(path), ec); }
+    std::string path;
+};
+
+TEST_CASE("SlicingCache: Keys are stable hashes of the inputs", "[SlicingCache]")
+{
+    auto key = [](const std::string &str, int value) {
+        SlicingCacheKey key;
+        key.update(str);
+        key.update(value);
+        return key.digest();
+    };
+    REQUIRE(SlicingCacheKey().digest() == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    REQUIRE(key("layer_height", 1) == key("layer_height", 1));
+    REQUIRE(key("layer_height", 1) != key("layer_height", 2));
+    REQUIRE(key("layer_height", 1) != key("layer_heigh", 1));
+}
+
+TEST_CASE("SlicingCache: Entries are stored and loaded", "[SlicingCache]")
+{
+    TemporaryCacheDirectory dir;
+    SlicingCache            cache(dir.path, 1024 * 1024);
+    const std::vector<uint8_t> payload { 1, 2, 3, 4, 5 };
+    std::vector<uint8_t>       loaded;
+
+    REQUIRE(! cache.load("a", loaded));
+    REQUIRE(cache.store("a", payload));
+    REQUIRE(cache.load("a", loaded));
+    REQUIRE(loaded == payload);
+    REQUIRE(cache.statistics().hits == 1);
+    REQUIRE(cache.statistics().misses == 1);
+
+    SECTION("A damaged payload size is a cache miss") {
+        const std::string path = (fs::path(dir.path) / "a.slc").string();
+        {
+            // Overwrite the payload size following the magic and the version.
+            boost::nowide::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+            const uint64_t size = uint64_t(1) << 60;
+            f.seekp(12);
+            f.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        }
+        REQUIRE(! cache.load("a", loaded));
+        REQUIRE(cache.statistics().misses == 2);
+    }
+}
+
+TEST_CASE("SlicingCache: The least recently used entries are evicted", "[SlicingCache]")
+{
+    TemporaryCacheDirectory    dir;
+    const std::vector<uint8_t> payload(1000, 0);
+    // Room for two entries.
+    SlicingCache               cache(dir.path, 2500);
+    REQUIRE(cache.store("a", payload));
+    REQUIRE(cache.store("b", payload));
+    const std::time_t now = std::time(nullptr);
+    fs::last_write_time(fs::path(dir.path) / "a.slc", now - 100);
+    fs::last_write_time(fs::path(dir.path) / "b.slc", now - 200);
+    REQUIRE(cache.store("c", payload));
+    std::vector<uint8_t> loaded;
+    REQUIRE(cache.statistics().evicted == 1);
+    REQUIRE(! cache.load("b", loaded));
+    REQUIRE(cache.load("a", loaded));
+    REQUIRE(cache.load("c", loaded));
+}
+
+TEST_CASE("SlicingCache: An entry larger than the cache is not stored", "[SlicingCache]")
+{
+    TemporaryCacheDirectory dir;
+    SlicingCache            cache(dir.path, 1000);
+    REQUIRE(! cache.store("a", std::vector<uint8_t>(1000, 0)));
+    REQUIRE(! fs::exists(fs::path(dir.path) / "a.slc"));
+    REQUIRE(cache.store("b", std::vector<uint8_t>(500, 0)));
+    REQUIRE(cache.statistics().stores == 1);
+    REQUIRE(cache.statistics().evicted == 0);
+}
+
+TEST_CASE("SlicingCache: Stale temporary files are removed", "[SlicingCache]")
+{
+    TemporaryCacheDirectory dir;
+    SlicingCache            cache(dir.path, 1024 * 1024);
+    REQUIRE(cache.store("a", std::vector<uint8_t>(10, 0)));
+    // Temporary files left behind by a crashed process and by a process still writing its entry.
+    const fs::path stale = fs::path(dir.path) / "b.slc.tmp12345";
+    const fs::path fresh = fs::path(dir.path) / "c.slc.tmp67890";
+    boost::nowide::ofstream(stale.string()) << "stale";
+    boost::nowide::ofstream(fresh.string()) << "fresh";
+    fs::last_write_time(stale, std::time(nullptr) - 2 * 60 * 60);
+    cache.evict(1024 * 1024);
+    REQUIRE(! fs::exists(stale));
+    REQUIRE(fs::exists(fresh));
+    REQUIRE(fs::exists(fs::path(dir.path) / "a.slc"));
+}
+
+TEST_CASE("SlicingCache: Moving an object is a cache miss", "[SlicingCache]")
+{
+    TemporaryCacheDirectory dir;
+    auto cache = std::make_shared<SlicingCache>(dir.path, size_t(1) << 30);
+    DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+    config.set_deserialize_strict({ { "enable_support", 1 }, { "support_type", "tree(auto)" } });
+    auto process = [&config, &cache](const Vec3d *offset) {
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({ TestMesh::overhang }, print, model, config);
+        if (offset != nullptr) {
+            model.objects.front()->instances.front()->set_offset(*offset);
+            print.apply(model, config);
+        }
+        print.set_slicing_cache(cache);
+        print.process();
+        return model.objects.front()->instances.front()->get_offset();
+    };
+    const Vec3d offset = process(nullptr);
+    REQUIRE(cache->statistics().stores == 1);
+    process(&offset);
+    REQUIRE(cache->statistics().hits == 1);
+    const Vec3d moved = offset + Vec3d(10., 5., 0.);
+    process(&moved);
+    REQUIRE(cache->statistics().hits == 1);
+    REQUIRE(cache->statistics().stores == 2);
+}
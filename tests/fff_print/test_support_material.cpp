@@ -2,6 +2,7 @@
 
 #include "libslic3r/GCodeReader.hpp"
 #include "libslic3r/Layer.hpp"
+#include "libslic3r/Support/TreeModelVolumes.hpp"
 
 #include "test_data.hpp" // get access to init_print, etc
 
@@ -236,3 +237,59 @@ SCENARIO("SupportMaterial: Checking bridge speed", "[SupportMaterial]")
 }
 
 #endif
+
+namespace Slic3r::TreeSupport3D {
+// Access to the private polygon cache of TreeModelVolumes.
+struct TreeModelVolumesTest
+{
+    using RadiusLayerPolygonCache = TreeModelVolumes::RadiusLayerPolygonCache;
+};
+} // namespace Slic3r::TreeSupport3D
+
+TEST_CASE("SupportMaterial: Tree support polygon cache", "[SupportMaterial]")
+{
+    TreeSupport3D::TreeModelVolumesTest::RadiusLayerPolygonCache cache;
+    const Polygons square { Polygon({ { 0, 0 }, { 100, 0 }, { 100, 100 }, { 0, 100 } }) };
+
+    SECTION("Any number of radii is cached") {
+        const coord_t num_radii = 1000;
+        for (coord_t radius = 0; radius < num_radii; ++ radius)
+            cache.insert(std::vector<Polygons>(3, square), 0, radius);
+        REQUIRE(cache.num_radii() == size_t(num_radii));
+        for (coord_t radius = 0; radius < num_radii; ++ radius) {
+            REQUIRE(cache.getMaxCalculatedLayer(radius) == 2);
+            REQUIRE(cache.getArea({ radius, 2 }));
+        }
+    }
+
+    SECTION("Radii inserted in any order are found") {
+        const std::vector<coord_t> radii { 50, 10, 40, 20, 30 };
+        for (coord_t radius : radii)
+            cache.insert(std::vector<Polygons>(radius == 30 ? 1 : 2, square), 0, radius);
+        for (coord_t radius : radii) {
+            REQUIRE(cache.getArea({ radius, 0 }));
+            REQUIRE(! cache.getArea({ radius + 1, 0 }));
+        }
+        REQUIRE(! cache.get_lower_bound_area({ 5, 1 }));
+        REQUIRE(cache.get_lower_bound_area({ 45, 1 })->first == 40);
+        // Radius 30 has no area at layer 1.
+        REQUIRE(cache.get_lower_bound_area({ 35, 1 })->first == 20);
+        REQUIRE(cache.get_lower_bound_area({ 35, 0 })->first == 30);
+    }
+
+    SECTION("Evicted areas are recalculated") {
+        const coord_t radius = 5;
+        cache.insert(std::vector<Polygons>(10, square), 0, radius);
+        const size_t resident = cache.statistics().resident_bytes;
+        REQUIRE(cache.evict(0, 4) > 0);
+        REQUIRE(cache.statistics().resident_bytes < resident);
+        REQUIRE(cache.getMaxCalculatedLayer(radius) == 4);
+        REQUIRE(cache.getArea({ radius, 4 }));
+        REQUIRE(! cache.getArea({ radius, 7 }));
+        // The caller recalculates the areas above the highest calculated layer.
+        cache.insert(std::vector<Polygons>(5, square), 5, radius);
+        REQUIRE(cache.getMaxCalculatedLayer(radius) == 9);
+        REQUIRE(cache.getArea({ radius, 7 }));
+        REQUIRE(cache.statistics().resident_bytes == resident);
+    }
+}
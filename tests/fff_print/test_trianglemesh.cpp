@@ -175,6 +175,23 @@ SCENARIO( "TriangleMesh: slice behavior.") {
             }
         }
     }
+    GIVEN( "A sphere of radius 10mm") {
+        indexed_triangle_set sphere = its_make_sphere(10., 2. * PI / 360.);
+        WHEN("It is sliced with many more layers than threads") {
+            std::vector<float> zs;
+            for (float z = -9.45f; z < 9.5f; z += 0.1f)
+                zs.emplace_back(z);
+            std::vector<Polygons> layers = slice_mesh(sphere, zs, MeshSlicingParams{});
+            THEN( "Each layer is a single closed loop of the area of the sphere cut") {
+                REQUIRE(layers.size() == zs.size());
+                for (size_t i = 0; i < zs.size(); ++ i) {
+                    REQUIRE(layers[i].size() == 1);
+                    double r2 = 100. - double(zs[i]) * double(zs[i]);
+                    REQUIRE(unscaled<double>(unscaled<double>(layers[i].front().area())) == Catch::Approx(PI * r2).epsilon(0.01));
+                }
+            }
+        }
+    }
 }
 
 SCENARIO( "make_xxx functions produce meshes.") {
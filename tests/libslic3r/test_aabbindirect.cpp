@@ -3,6 +3,9 @@
 
 #include <libslic3r/TriangleMesh.hpp>
 #include <libslic3r/AABBTreeIndirect.hpp>
+#include <libslic3r/AABBTreeWide.hpp>
+
+#include <random>
 
 using namespace Slic3r;
 
@@ -58,3 +61,55 @@ TEST_CASE("Building a tree over a box, ray caster and closest query", "[AABBIndi
     REQUIRE(closest_point.y() == Catch::Approx(0.5));
     REQUIRE(closest_point.z() == Catch::Approx(1.));
 }
+
+TEST_CASE("Wide tree ray casting matches the balanced tree", "[AABBIndirect]")
+{
+    TriangleMesh tmesh = make_sphere(10., PI / 64.);
+    tmesh.merge(make_cube(4., 4., 4.));
+
+    auto tree  = AABBTreeIndirect::build_aabb_tree_over_indexed_triangle_set(tmesh.its.vertices, tmesh.its.indices);
+    auto wide4 = AABBTreeIndirect::build_wide_aabb_tree_over_indexed_triangle_set<4>(tmesh.its.vertices, tmesh.its.indices);
+    auto wide8 = AABBTreeIndirect::build_wide_aabb_tree_over_indexed_triangle_set<8>(tmesh.its.vertices, tmesh.its.indices);
+    REQUIRE(! wide4.empty());
+    REQUIRE(wide4.primitives().size() == tmesh.its.indices.size());
+    REQUIRE(wide8.primitives().size() == tmesh.its.indices.size());
+
+    // Bundles of rays shot from a common origin, some of them from inside the cube and along the axes.
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> dist(-1., 1.);
+    std::vector<Vec3d> origins, dirs;
+    for (size_t i = 0; i < 50; ++ i) {
+        Vec3d origin = i % 5 == 0 ? Vec3d(0.3, 0.2, 0.1) : Vec3d(15. * dist(rng), 15. * dist(rng), 15. * dist(rng));
+        for (size_t j = 0; j < 40; ++ j) {
+            origins.emplace_back(origin);
+            dirs.emplace_back(j % 10 == 0 ? Vec3d(0., 0., 1.) : Vec3d(Vec3d(dist(rng), dist(rng), dist(rng)).normalized()));
+        }
+    }
+
+    std::vector<igl::Hit>              first_hits;
+    std::vector<std::vector<igl::Hit>> all_hits;
+    size_t num_hit       = AABBTreeIndirect::intersect_rays_first_hit(tmesh.its.vertices, tmesh.its.indices, wide8, origins, dirs, first_hits);
+    size_t num_hit_all   = AABBTreeIndirect::intersect_rays_all_hits(tmesh.its.vertices, tmesh.its.indices, wide4, origins, dirs, all_hits);
+    size_t num_hit_ref   = 0;
+    REQUIRE(first_hits.size() == origins.size());
+    REQUIRE(all_hits.size() == origins.size());
+    for (size_t i = 0; i < origins.size(); ++ i) {
+        igl::Hit hit_ref, hit;
+        bool intersected_ref = AABBTreeIndirect::intersect_ray_first_hit(tmesh.its.vertices, tmesh.its.indices, tree, origins[i], dirs[i], hit_ref);
+        bool intersected     = AABBTreeIndirect::intersect_ray_first_hit(tmesh.its.vertices, tmesh.its.indices, wide4, origins[i], dirs[i], hit);
+        REQUIRE(intersected == intersected_ref);
+        REQUIRE((first_hits[i].id != -1) == intersected_ref);
+        if (intersected_ref) {
+            ++ num_hit_ref;
+            REQUIRE(hit.t == Catch::Approx(hit_ref.t));
+            REQUIRE(first_hits[i].t == Catch::Approx(hit_ref.t));
+        }
+        std::vector<igl::Hit> hits_ref;
+        AABBTreeIndirect::intersect_ray_all_hits(tmesh.its.vertices, tmesh.its.indices, tree, origins[i], dirs[i], hits_ref);
+        REQUIRE(all_hits[i].size() == hits_ref.size());
+        for (size_t k = 0; k < hits_ref.size(); ++ k)
+            REQUIRE(all_hits[i][k].t == Catch::Approx(hits_ref[k].t));
+    }
+    REQUIRE(num_hit == num_hit_ref);
+    REQUIRE(num_hit_all == num_hit_ref);
+}
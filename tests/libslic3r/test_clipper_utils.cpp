@@ -299,3 +299,34 @@ TEST_CASE("Traversing Clipper PolyTree", "[ClipperUtils]") {
         REQUIRE(count_polys(output) == reference.size());
     }
 }
+
+TEST_CASE("Clipper2 backend matches Clipper", "[ClipperUtils]") {
+    Slic3r::Polygon   square{ { 200, 100 }, {200, 200}, {100, 200}, {100, 100} };
+    Slic3r::Polygon   hole_in_square{ { 160, 140 }, { 140, 140 }, { 140, 160 }, { 160, 160 } };
+    Slic3r::ExPolygon square_with_hole(square, hole_in_square);
+    Slic3r::Polygon   square2{ { 250, 150 }, {250, 250}, {150, 250}, {150, 150} };
+
+    auto run = [&](ClipperBackend backend) {
+        const ClipperBackend old_backend = clipper_backend();
+        set_clipper_backend(backend);
+        std::vector<double> areas {
+            area(union_(Polygons{ square, square2 })),
+            area(diff(square, square2)),
+            area(intersection_ex(ExPolygons{ square_with_hole }, Polygons{ square2 })),
+            area(union_ex(ExPolygons{ square_with_hole, ExPolygon(square2) })),
+            area(offset(square_with_hole, 5.f)),
+            area(offset_ex(square_with_hole, -5.f)),
+            area(offset2_ex(ExPolygons{ square_with_hole }, -5.f, 5.f))
+        };
+        set_clipper_backend(old_backend);
+        return areas;
+    };
+
+    std::vector<double> clipper  = run(ClipperBackend::Clipper);
+    std::vector<double> clipper2 = run(ClipperBackend::Clipper2);
+    REQUIRE(clipper.size() == clipper2.size());
+    for (size_t i = 0; i < clipper.size(); ++ i) {
+        REQUIRE(clipper[i] > 0.);
+        REQUIRE(clipper2[i] == Catch::Approx(clipper[i]));
+    }
+}
@@ -0,0 +1,105 @@
+#include <catch2/catch_all.hpp>
+
+#include <list>
+#include <memory>
+#include <set>
+
+#include "libslic3r/Arachne/utils/MemoryArena.hpp"
+
+using namespace Slic3r::Arachne;
+
+TEST_CASE("Memory arena reuses the blocks of destroyed arenas", "[MemoryArena]")
+{
+    MemoryArena::release_cached_blocks();
+    std::set<const char*> blocks;
+    {
+        MemoryArena arena;
+        // Three blocks worth of small allocations.
+        for (size_t i = 0; i < 3 * MemoryArena::BLOCK_SIZE / 1024; ++ i) {
+            auto *ptr = static_cast<char*>(arena.allocate(1024, alignof(std::max_align_t)));
+            REQUIRE(reinterpret_cast<uintptr_t>(ptr) % alignof(std::max_align_t) == 0);
+            if (i % (MemoryArena::BLOCK_SIZE / 1024) == 0)
+                blocks.insert(ptr);
+        }
+        REQUIRE(MemoryArena::cached_blocks() == 0);
+    }
+    REQUIRE(MemoryArena::cached_blocks() == 3);
+    {
+        MemoryArena arena;
+        const char *ptr = static_cast<const char*>(arena.allocate(16, 8));
+        REQUIRE(blocks.count(ptr) == 1);
+        REQUIRE(MemoryArena::cached_blocks() == 2);
+        // Alignment of an allocation following an odd sized one.
+        arena.allocate(1, 1);
+        REQUIRE(reinterpret_cast<uintptr_t>(arena.allocate(sizeof(double), alignof(double))) % alignof(double) == 0);
+    }
+    REQUIRE(MemoryArena::cached_blocks() == 3);
+    MemoryArena::release_cached_blocks();
+    REQUIRE(MemoryArena::cached_blocks() == 0);
+}
+
+TEST_CASE("Memory arena allocates large blocks separately", "[MemoryArena]")
+{
+    MemoryArena::release_cached_blocks();
+    {
+        MemoryArena arena;
+        auto *small = static_cast<char*>(arena.allocate(64, 8));
+        auto *large = static_cast<char*>(arena.allocate(2 * MemoryArena::BLOCK_SIZE, alignof(std::max_align_t)));
+        std::fill(large, large + 2 * MemoryArena::BLOCK_SIZE, 0x55);
+        // The rest of the current block is still used by the small allocations.
+        REQUIRE(static_cast<char*>(arena.allocate(64, 8)) == small + 64);
+    }
+    // The large blocks are not cached.
+    REQUIRE(MemoryArena::cached_blocks() == 1);
+    MemoryArena::release_cached_blocks();
+}
+
+TEST_CASE("Memory arena limits its block cache", "[MemoryArena]")
+{
+    MemoryArena::release_cached_blocks();
+    {
+        MemoryArena arena;
+        // Four allocations per block, twice as many blocks as cached.
+        for (size_t i = 0; i < 4 * 2 * MemoryArena::MAX_CACHED_BLOCKS; ++ i)
+            arena.allocate(MemoryArena::BLOCK_SIZE / 4, alignof(std::max_align_t));
+        REQUIRE(MemoryArena::cached_blocks() == 0);
+    }
+    REQUIRE(MemoryArena::cached_blocks() == MemoryArena::MAX_CACHED_BLOCKS);
+    MemoryArena::release_cached_blocks();
+}
+
+TEST_CASE("Objects allocated by an arena allocator are destroyed before the arena", "[MemoryArena]")
+{
+    struct Tracked {
+        explicit Tracked(int &destroyed) : destroyed(destroyed) {}
+        ~Tracked() { ++ destroyed; }
+        int &destroyed;
+        std::shared_ptr<Tracked> next;
+    };
+    // Same layout as HalfEdgeGraph: The arena is declared first to outlive the objects allocated from it.
+    struct Owner {
+        Owner() : list(ArenaAllocator<Tracked>(arena)) {}
+        MemoryArena                                    arena;
+        std::list<Tracked, ArenaAllocator<Tracked>>    list;
+        std::shared_ptr<Tracked>                       shared;
+    };
+    int destroyed = 0;
+    {
+        Owner owner;
+        for (int i = 0; i < 100; ++ i)
+            owner.list.emplace_back(destroyed);
+        owner.shared = std::allocate_shared<Tracked>(ArenaAllocator<Tracked>(owner.arena), destroyed);
+        // A chain of shared pointers into the arena, released recursively.
+        owner.shared->next = std::allocate_shared<Tracked>(ArenaAllocator<Tracked>(owner.arena), destroyed);
+        std::weak_ptr<Tracked> weak = owner.shared->next;
+        owner.list.front().next = owner.shared->next;
+        owner.shared.reset();
+        REQUIRE(destroyed == 1);
+        REQUIRE(! weak.expired());
+        owner.list.pop_front();
+        REQUIRE(destroyed == 3);
+        REQUIRE(weak.expired());
+    }
+    REQUIRE(destroyed == 102);
+    MemoryArena::release_cached_blocks();
+}
@@ -0,0 +1,113 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "libslic3r/GCode/ToolOrderUtils.hpp"
+
+using namespace Slic3r;
+
+static FlushMatrix random_flush_matrix(size_t num_filaments, unsigned int seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> dist(10, 500);
+    FlushMatrix out(num_filaments, std::vector<float>(num_filaments, 0.f));
+    for (size_t i = 0; i < num_filaments; ++ i)
+        for (size_t j = 0; j < num_filaments; ++ j)
+            if (i != j)
+                out[i][j] = float(dist(rng));
+    return out;
+}
+
+static float sequence_cost(const FlushMatrix &flush_matrix, const std::vector<unsigned int> &sequence, std::optional<unsigned int> prev)
+{
+    float cost = 0;
+    for (unsigned int f : sequence) {
+        if (prev)
+            cost += flush_matrix[*prev][f];
+        prev = f;
+    }
+    return cost;
+}
+
+TEST_CASE("ExtruderOrderSolver finds the minimum flush order", "[ToolOrdering]") {
+    const FlushMatrix         flush_matrix = random_flush_matrix(8, 1);
+    std::vector<unsigned int> filaments { 1, 2, 4, 5, 7 };
+    ExtruderOrderSolver       solver(flush_matrix);
+
+    float cost = 0;
+    std::vector<unsigned int> sequence = solver.solve(filaments, {}, 3u, false, &cost);
+    REQUIRE(sequence.size() == filaments.size());
+    REQUIRE(cost == Catch::Approx(sequence_cost(flush_matrix, sequence, 3u)));
+
+    float best = std::numeric_limits<float>::max();
+    do {
+        best = std::min(best, sequence_cost(flush_matrix, filaments, 3u));
+    } while (std::next_permutation(filaments.begin(), filaments.end()));
+    REQUIRE(cost == Catch::Approx(best));
+
+    SECTION("Repeated layers are memoized") {
+        // In any order of the filaments.
+        std::reverse(filaments.begin(), filaments.end());
+        const size_t misses = solver.cache_misses();
+        float cost2 = 0;
+        REQUIRE(solver.solve(filaments, {}, 3u, false, &cost2) == sequence);
+        REQUIRE(cost2 == cost);
+        REQUIRE(solver.cache_misses() == misses);
+        REQUIRE(solver.cache_hits() == 1);
+    }
+}
+
+TEST_CASE("ExtruderOrderSolver orders the maximum number of filaments from another start filament", "[ToolOrdering]") {
+    const FlushMatrix         flush_matrix = random_flush_matrix(ExtruderOrderSolver::MaxExactExtruders + 1, 3);
+    std::vector<unsigned int> filaments(ExtruderOrderSolver::MaxExactExtruders);
+    std::iota(filaments.begin(), filaments.end(), 1u);
+    ExtruderOrderSolver       solver(flush_matrix);
+
+    float cost = 0;
+    std::vector<unsigned int> sequence = solver.solve(filaments, {}, 0u, false, &cost);
+    REQUIRE(cost == Catch::Approx(sequence_cost(flush_matrix, sequence, 0u)));
+    std::sort(sequence.begin(), sequence.end());
+    REQUIRE(sequence == filaments);
+}
+
+TEST_CASE("ExtruderOrderSolver whole print optimization", "[ToolOrdering]") {
+    const FlushMatrix flush_matrix = random_flush_matrix(6, 2);
+    const std::vector<std::vector<unsigned int>> layers { { 0, 1, 2 }, { 1, 2, 3 }, {}, { 0, 3, 4 }, { 2, 4, 5 } };
+    ExtruderOrderSolver solver(flush_matrix);
+
+    float joint_cost = 0;
+    std::vector<std::vector<unsigned int>> joint = solver.solve_layers(layers, {}, std::nullopt, &joint_cost);
+    REQUIRE(joint.size() == layers.size());
+    std::optional<unsigned int> prev;
+    float total = 0;
+    for (size_t i = 0; i < layers.size(); ++ i) {
+        std::vector<unsigned int> sorted = joint[i];
+        std::sort(sorted.begin(), sorted.end());
+        REQUIRE(sorted == layers[i]);
+        total += sequence_cost(flush_matrix, joint[i], prev);
+        if (! joint[i].empty())
+            prev = joint[i].back();
+    }
+    REQUIRE(joint_cost == Catch::Approx(total));
+
+    // Not worse than ordering each layer on its own.
+    float layer_by_layer_cost = 0;
+    prev.reset();
+    for (const std::vector<unsigned int> &layer : layers) {
+        float cost = 0;
+        std::vector<unsigned int> sequence = solver.solve(layer, {}, prev, false, &cost);
+        layer_by_layer_cost += cost;
+        if (! sequence.empty())
+            prev = sequence.back();
+    }
+    REQUIRE(joint_cost <= layer_by_layer_cost + 1e-3f);
+
+    SECTION("Fixed layers keep their order") {
+        std::vector<bool> fixed(layers.size(), false);
+        fixed[1] = true;
+        std::vector<std::vector<unsigned int>> out = solver.solve_layers(layers, fixed, std::nullopt);
+        REQUIRE(out[1] == layers[1]);
+    }
+}